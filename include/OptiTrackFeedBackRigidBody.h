@@ -5,10 +5,14 @@
 #include "geometry_msgs/PoseStamped.h"
 //#include "UtilityFunctions.h"
 #include <Eigen/Eigen>
-//maximum window size
+#include <vector>
+//maximum window size (buffers are allocated to the requested window, this is only a sanity limit)
 #ifndef max_windowsize
-#define max_windowsize 10
+#define max_windowsize 1000
 #endif
+// linear velocity filter
+#define VELOCITY_FILTER_MOVING_AVERAGE 0 // moving window average of one-step differences
+#define VELOCITY_FILTER_SAVITZKY_GOLAY 1 // Savitzky-Golay polynomial differentiator over the last linear_window poses
 using namespace Eigen;
 
 struct optitrack_pose{
@@ -44,13 +48,32 @@ class OptiTrackFeedBackRigidBody{
     void OptiTrackCallback(const geometry_msgs::PoseStamped& msg);   
     unsigned int FeedbackState;// 0 no feedback, 1 has feedback
     ros::Subscriber subOptiTrack;// OptiTrack Data
+    //--------Timing-------//
+    double dropout_time; // feedback is lost when no pose arrives within this time [s]; the differentiation is restarted after such a gap
+    double prediction_max; // upper limit of the forward prediction horizon [s]
+    double time_received; // ros time when the latest pose was received
+    double latency; // filtered transport latency, receive time - header stamp [s]
+    unsigned int latency_samples; // number of latency samples, the filter is initialized with the first one
+    unsigned int discarded_poses; // poses discarded for a duplicate or out-of-order stamp
     //--------Filter Parameters-------//
     unsigned int linear_velocity_window; // window size
     unsigned int angular_velocity_window; // window size
+    unsigned int velocity_filter; // VELOCITY_FILTER_*
+    unsigned int polynomial_order; // order of the Savitzky-Golay polynomial
     //--------Filter Buffer-----------//
-    // raw velocity buffer from numerical differentiation
-    Vector3d  velocity_raw[max_windowsize];
-    Vector3d  angular_velocity_raw[max_windowsize];
+    // raw velocity ring buffer from numerical differentiation, the running sums are updated in O(1) per sample
+    std::vector<Vector3d> velocity_raw;
+    std::vector<Vector3d> angular_velocity_raw;
+    unsigned int velocity_head; // index of the latest raw velocity
+    unsigned int angular_velocity_head;
+    Vector3d velocity_sum;
+    Vector3d angular_velocity_sum;
+    // position ring buffer for the Savitzky-Golay differentiator
+    std::vector<Vector3d> position_history;
+    std::vector<double> time_history;
+    unsigned int position_head; // index of the latest position
+    unsigned int position_count; // number of valid positions in the buffer
+    VectorXd savitzky_golay_weights; // derivative weights at the latest sample, oldest first, for unit sample time
     Vector3d  velocity_filtered;        // filtered velocity
     Vector3d  angular_velocity_filtered;// filtered angular velocity
     optitrack_pose  pose[2];/*pose info from optitrack pose[1] should be the latest mesaured value, 
@@ -59,16 +82,23 @@ class OptiTrackFeedBackRigidBody{
     //--------Filter Methods-----------//
     void CalculateVelocityFromPose();// calculate velocity info from pose update measurements
     void MovingWindowAveraging();// a filter using moving window
+    void SavitzkyGolayDifferentiation();// polynomial fit of the last poses, differentiated at the latest sample
+    void CalculateSavitzkyGolayWeights();
     void PushRawVelocity(Vector3d& new_linear_velocity, Vector3d& new_angular_velocity);// push newly measured velocity into raw velocity buffer
     void PushPose();//push newly measured pose into dronepose buffer
     void SetZeroVelocity();
     //--------Update Rigid-body State ------//
     rigidbody_state state;
 public:
-    OptiTrackFeedBackRigidBody(const char* name,ros::NodeHandle& n, unsigned int linear_window, unsigned int angular_window);
+    OptiTrackFeedBackRigidBody(const char* name,ros::NodeHandle& n, unsigned int linear_window, unsigned int angular_window,
+                               unsigned int linear_filter = VELOCITY_FILTER_MOVING_AVERAGE, unsigned int order = 2);
     ~OptiTrackFeedBackRigidBody();
     int GetOptiTrackState();
     void GetState(rigidbody_state& state);
+    void GetPredictedState(rigidbody_state& state, double t);// state predicted forward to ros time t using the measured latency
+    void SetTiming(double dropout, double prediction);// dropout time and maximum prediction horizon [s]
+    double GetLatency();// filtered transport latency [s]
+    unsigned int GetDiscardedPoses();
     void GetRaWVelocity(Vector3d& linear_velocity,Vector3d& angular_velocity);
     void RosWhileLoopRun();// This function should be put into ros while loop
     void GetEulerAngleFromQuaterion_NormalConvention(double (&eulerangle)[3]);
@@ -0,0 +1,170 @@
+/***************************************************************************************************************************
+* att_controller.h
+*
+* Author: Qyp
+*
+* Update Time: 2019.8.2
+*
+* Introduction:  Onboard attitude controller (attitude loop only, output body rates)
+*         1. 机载闭合姿态环：期望姿态(AttitudeReference, 位置环输出) + 当前姿态(/mavros/imu/data) -> 期望机体角速度
+*         2. 期望角速度及期望油门通过command_to_mavros::send_attitude_rate_setpoint发送，飞控只执行角速度环
+*         3. 控制律与PX4 AttitudeControl一致：先对齐推力方向(roll pitch)，偏航按yaw_weight加权，四元数误差乘P得到期望角速度
+*            Ref to : https://github.com/PX4/Firmware/blob/master/src/modules/mc_att_control/AttitudeControl/AttitudeControl.cpp
+*         4. 姿态环为纯比例控制，无内部状态，可以与位置环以不同频率运行（见px4_pos_controller中的Body_rate参数）
+*         5. 四元数均为机体系(FLU)至ENU系，期望角速度为机体系(FLU)，与mavros一致
+*         6. AttitudeReference中的角速度前馈desired_rate_ff（微分平坦前馈，未启用时为0）在限幅前叠加
+***************************************************************************************************************************/
+#ifndef ATT_CONTROLLER_H
+#define ATT_CONTROLLER_H
+
+#include <ros/ros.h>
+#include <Eigen/Eigen>
+#include <math.h>
+#include <math_utils.h>
+
+#include <px4_command/AttitudeReference.h>
+
+using namespace std;
+
+class att_controller
+{
+    public:
+
+        //构造函数
+        att_controller(void):
+            att_nh("~")
+        {
+            att_nh.param<float>("Att_control/roll_p", att_p[0], 6.5);
+            att_nh.param<float>("Att_control/pitch_p", att_p[1], 6.5);
+            att_nh.param<float>("Att_control/yaw_p", att_p[2], 2.8);
+            att_nh.param<float>("Att_control/rollrate_max", rate_max[0], 220.0);
+            att_nh.param<float>("Att_control/pitchrate_max", rate_max[1], 220.0);
+            att_nh.param<float>("Att_control/yawrate_max", rate_max[2], 200.0);
+
+            set_gain();
+
+            rates_sp = Eigen::Vector3d(0.0,0.0,0.0);
+            att_error = Eigen::Vector3d(0.0,0.0,0.0);
+        }
+
+        //Attitude P gain [roll pitch yaw] (MC_ROLL_P, MC_PITCH_P, MC_YAW_P)
+        Eigen::Vector3f att_p;
+        //Body rate limit [deg/s] (MC_ROLLRATE_MAX, MC_PITCHRATE_MAX, MC_YAWRATE_MAX)
+        Eigen::Vector3f rate_max;
+
+        //偏航权重 = yaw_p / roll_p，限幅[0,1]
+        float yaw_weight;
+
+        //Output of the last step
+        Eigen::Vector3d att_error;                  // 2 * 误差四元数虚部 [rad]
+        Eigen::Vector3d rates_sp;                   // 期望机体角速度 [rad/s]
+
+        // Attitude control main function
+        // [Input: current attitude (quaternion, body to ENU), AttitudeReference; Output: body rate setpoint [rad/s], filled in place;]
+        void att_control(const Eigen::Quaterniond& q, const px4_command::AttitudeReference& _AttitudeReference, Eigen::Vector3d& rate_setpoint);
+
+        //Printf the attitude control parameter
+        void printf_param();
+
+        //Printf the control result
+        void printf_result();
+
+    private:
+
+        ros::NodeHandle att_nh;
+
+        //实际使用的比例系数（偏航经yaw_weight缩放后补偿）
+        Eigen::Vector3d gain;
+
+        void set_gain();
+};
+
+void att_controller::set_gain()
+{
+    gain = att_p.cast<double>();
+
+    yaw_weight = att_p[0] > 1e-4 ? constrain_function2(att_p[2] / att_p[0], 0.0, 1.0) : 1.0;
+
+    // 偏航误差被yaw_weight缩小，此处补偿，使小角度时偏航增益仍为yaw_p
+    if(yaw_weight > 1e-4)
+    {
+        gain[2] = att_p[2] / yaw_weight;
+    }
+}
+
+void att_controller::att_control(const Eigen::Quaterniond& q, const px4_command::AttitudeReference& _AttitudeReference, Eigen::Vector3d& rate_setpoint)
+{
+    Eigen::Quaterniond qd(_AttitudeReference.desired_att_q.w, _AttitudeReference.desired_att_q.x,
+                          _AttitudeReference.desired_att_q.y, _AttitudeReference.desired_att_q.z);
+    qd.normalize();
+
+    // 不考虑偏航的期望姿态：当前机体z轴旋转至期望机体z轴的最短旋转
+    Eigen::Vector3d e_z = q * Eigen::Vector3d::UnitZ();
+    Eigen::Vector3d e_z_d = qd * Eigen::Vector3d::UnitZ();
+    Eigen::Quaterniond qd_red = Eigen::Quaterniond::FromTwoVectors(e_z, e_z_d);
+
+    if(fabs(qd_red.x()) > (1.0 - 1e-5) || fabs(qd_red.y()) > (1.0 - 1e-5))
+    {
+        // 当前推力方向与期望推力方向完全相反时，直接使用完整的期望姿态
+        qd_red = qd;
+    }else
+    {
+        qd_red = qd_red * q;
+    }
+
+    // 完整期望姿态与不考虑偏航的期望姿态之差只剩偏航，按yaw_weight加权
+    Eigen::Quaterniond q_mix = qd_red.conjugate() * qd;
+    if(q_mix.w() < 0.0)
+    {
+        q_mix.coeffs() = -q_mix.coeffs();
+    }
+
+    double q_mix_w = constrain_function2(q_mix.w(), -1.0, 1.0);
+    double q_mix_z = constrain_function2(q_mix.z(), -1.0, 1.0);
+    qd = qd_red * Eigen::Quaterniond(cos(yaw_weight * acos(q_mix_w)), 0.0, 0.0, sin(yaw_weight * asin(q_mix_z)));
+
+    // 误差四元数：当前姿态至期望姿态
+    Eigen::Quaterniond qe = q.conjugate() * qd;
+    if(qe.w() < 0.0)
+    {
+        qe.coeffs() = -qe.coeffs();
+    }
+
+    att_error = 2.0 * qe.vec();
+
+    for(int i = 0; i < 3; i++)
+    {
+        rate_setpoint[i] = constrain_function(gain[i] * att_error[i] + _AttitudeReference.desired_rate_ff[i], rate_max[i] / 180.0 * M_PI);
+    }
+
+    rates_sp = rate_setpoint;
+}
+
+void att_controller::printf_result()
+{
+    cout <<">>>>>>>>>>>>>>>>>>>>>>>>  Attitude Controller  <<<<<<<<<<<<<<<<<<<<<<<<<" <<endl;
+
+    //固定的浮点显示
+    cout.setf(ios::fixed);
+    //左对齐
+    cout.setf(ios::left);
+    // 强制显示小数点
+    cout.setf(ios::showpoint);
+    // 强制显示符号
+    cout.setf(ios::showpos);
+
+    cout<<setprecision(2);
+
+    cout << "att_error [X Y Z] : " << att_error[0] / M_PI *180 << " [deg] "<< att_error[1] / M_PI *180 <<" [deg] "<< att_error[2] / M_PI *180 <<" [deg] "<<endl;
+    cout << "rates_sp [X Y Z] : " << rates_sp[0] / M_PI *180 << " [deg/s] "<< rates_sp[1] / M_PI *180 <<" [deg/s] "<< rates_sp[2] / M_PI *180 <<" [deg/s] "<<endl;
+}
+
+// 【打印参数函数】
+void att_controller::printf_param()
+{
+    cout <<">>>>>>>>>>>>>>>>>>>>>>>>>>Attitude Control Parameter <<<<<<<<<<<<<<<<<<<<<<<<<" <<endl;
+    cout <<"roll_p : "<< att_p[0] << "  pitch_p : "<< att_p[1] << "  yaw_p : "<< att_p[2] << "  yaw_weight : "<< yaw_weight << endl;
+    cout <<"rate_max [R P Y] : "<< rate_max[0] << " " << rate_max[1] << " " << rate_max[2] << " [deg/s] " << endl;
+}
+
+#endif
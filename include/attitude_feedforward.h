@@ -0,0 +1,120 @@
+/***************************************************************************************************************************
+* attitude_feedforward.h
+*
+* Author: Qyp
+*
+* Update Time: 2019.8.28
+*
+* Introduction:  Body-rate / throttle-rate feed-forward for the attitude setpoint (Feedforward/enable)
+*         1. 前馈的目的是让姿态环跟上位置环发出的期望姿态，因此期望推力矢量的导数须来自实际发出的期望姿态：
+*            v = desired_throttle * 期望机体z轴（ThrottleToAttitude的油门矢量，或SE3等控制律直接给出的期望姿态）
+*         2. enable为1时v'由相邻两次位置环输出差分并低通滤波（Feedforward/T_filter）得到，v''取0，对所有控制律成立：
+*            PID、UDE等经thrustToThrottle逐分量换算及扰动估计后，期望姿态的转动速率与参考轨迹的平坦输出不同（circle r=2 v=2时约为一半）
+*         3. enable为2时v' v''取参考轨迹的jerk、snap（微分平坦），只在期望姿态由参考加速度主导时（如SE3）与实际发出的期望姿态一致
+*         4. 前馈项再由px4_command_utils::flatness_feedforward换算为机体角速度、角加速度及油门变化率，写入AttitudeReference
+*         5. 模式切换（reset）或两次调用间隔大于dt_max后重新开始差分，该次前馈为0
+***************************************************************************************************************************/
+#ifndef ATTITUDE_FEEDFORWARD_H
+#define ATTITUDE_FEEDFORWARD_H
+
+#include <ros/ros.h>
+#include <Eigen/Eigen>
+#include <math.h>
+#include <px4_command_utils.h>
+
+#include <px4_command/TrajectoryPoint.h>
+#include <px4_command/AttitudeReference.h>
+
+using namespace std;
+
+class attitude_feedforward
+{
+    public:
+
+        //构造函数
+        attitude_feedforward(void):
+            feedforward_nh("~")
+        {
+            feedforward_nh.param<int>("Feedforward/enable", source, 0);
+            feedforward_nh.param<float>("Feedforward/T_filter", T_filter, 0.05);
+            feedforward_nh.param<float>("Feedforward/dt_max", dt_max, 0.2);
+
+            reset();
+        }
+
+        enum source_type
+        {
+            SOURCE_OFF = 0,
+            SOURCE_COMMAND = 1,             // 实际发出的期望姿态差分
+            SOURCE_REFERENCE = 2,           // 参考轨迹的jerk、snap
+        };
+
+        //Parameter
+        int source;                         // Feedforward/enable
+        float T_filter;                     // v'的低通滤波时间常数 [s]
+        float dt_max;                       // 两次位置环间隔大于该值时重新开始差分 [s]
+
+        // 模式切换时调用
+        void reset();
+
+        // 在位置环得到期望姿态（ThrottleToAttitude或控制器直接给出）之后调用
+        // [Input: 参考量（偏航角速度，SOURCE_REFERENCE时还有jerk、snap）, 当前时刻 time [s]; Output: AttitudeReference中的前馈项]
+        void update(const px4_command::TrajectoryPoint& _Reference_State, float time, px4_command::AttitudeReference& _AttitudeReference);
+
+        void printf_param();
+
+    private:
+
+        ros::NodeHandle feedforward_nh;
+
+        Eigen::Vector3d throttle_last;      // 上一次位置环的v
+        Eigen::Vector3d throttle_rate;      // 滤波后的v'
+        float time_last;                    // 上一次调用的时刻 [s]
+        bool initialized;
+};
+
+void attitude_feedforward::reset()
+{
+    throttle_last.setZero();
+    throttle_rate.setZero();
+    time_last = 0.0;
+    initialized = false;
+}
+
+void attitude_feedforward::update(const px4_command::TrajectoryPoint& _Reference_State, float time, px4_command::AttitudeReference& _AttitudeReference)
+{
+    if(source == SOURCE_REFERENCE)
+    {
+        px4_command_utils::flatness_feedforward(_Reference_State, _AttitudeReference);
+        return;
+    }
+
+    Eigen::Quaterniond q_sp(_AttitudeReference.desired_att_q.w, _AttitudeReference.desired_att_q.x,
+                            _AttitudeReference.desired_att_q.y, _AttitudeReference.desired_att_q.z);
+    Eigen::Vector3d throttle_now = _AttitudeReference.desired_throttle * (q_sp.normalized() * Eigen::Vector3d::UnitZ());
+
+    float dt = time - time_last;
+    time_last = time;
+
+    if(!initialized || dt <= 0.0 || dt > dt_max)
+    {
+        throttle_rate.setZero();
+        initialized = true;
+    }else
+    {
+        throttle_rate = throttle_rate + dt / (T_filter + dt) * ((throttle_now - throttle_last) / dt - throttle_rate);
+    }
+    throttle_last = throttle_now;
+
+    // c_min约为0.1g对应的油门
+    px4_command_utils::flatness_feedforward(throttle_now, throttle_rate, Eigen::Vector3d::Zero(), 0.05,
+                                            _Reference_State.yaw_ref, _Reference_State.yaw_rate_ref, _AttitudeReference);
+}
+
+void attitude_feedforward::printf_param()
+{
+    cout <<">>>>>>>>>>>>>>>>>>>>>>>>>>>>>> Attitude Feedforward <<<<<<<<<<<<<<<<<<<<<<<" <<endl;
+    cout <<"source : "<< source << " (1 for commanded attitude, 2 for reference jerk/snap)  T_filter : "<< T_filter << " [s]  dt_max : "<< dt_max << " [s] " << endl;
+}
+
+#endif
@@ -3,48 +3,49 @@
 *
 * Author: Qyp
 *
-* Update Time: 2019.6.28
+* Update Time: 2019.8.12
 *
 * Introduction:  Circle trajectory generation code
-*         1. Generating the circle trajectory
-*         2. Parameter: center, radius, linear_vel, time_total, direction
-*         3. Input: time_from_start
+*         1. Generating the circle trajectory (and the helix trajectory: circle + constant climb rate)
+*         2. Parameter: center, radius, linear_vel, time_total, direction (Helix_Trajectory: + climb_rate)
+*         3. Input: time_from_start, or a whole horizon (see parametric_trajectory.h)
 *         4. Output: position, velocity, acceleration, jerk, snap
 ***************************************************************************************************************************/
 #ifndef CIRCLE_TRAJECTORY_H
 #define CIRCLE_TRAJECTORY_H
 
+#include <ros/ros.h>
 #include <Eigen/Eigen>
 #include <math.h>
 #include <math_utils.h>
+#include <parametric_trajectory.h>
 #include <px4_command/TrajectoryPoint.h>
 #include <command_to_mavros.h>
 
 using namespace std;
 
-class Circle_Trajectory
+class Circle_Trajectory : public parametric_trajectory
 {
      //public表明该数据成员、成员函数是对全部用户开放的。全部用户都能够直接进行调用，在程序的不论什么其他地方訪问。
     public:
 
-        //构造函数
-        Circle_Trajectory(void):
+        //构造函数 [Input: 参数命名空间，Helix_Trajectory使用"Helix_Trajectory"]
+        Circle_Trajectory(const string& param_ns = "Circle_Trajectory"):
             Circle_Trajectory_nh("~")
         {
-            Circle_Trajectory_nh.param<float>("Circle_Trajectory/Center_x", center[0], 0.0);
-            Circle_Trajectory_nh.param<float>("Circle_Trajectory/Center_y", center[1], 0.0);
-            Circle_Trajectory_nh.param<float>("Circle_Trajectory/Center_z", center[2], 1.0);
-            Circle_Trajectory_nh.param<float>("Circle_Trajectory/radius", radius, 1.0);
-            Circle_Trajectory_nh.param<float>("Circle_Trajectory/linear_vel", linear_vel, 0.5);
-            Circle_Trajectory_nh.param<float>("Circle_Trajectory/time_total", time_total, 10.0);
-            Circle_Trajectory_nh.param<float>("Circle_Trajectory/direction", direction, 1.0);
+            Circle_Trajectory_nh.param<float>(param_ns + "/Center_x", center[0], 0.0);
+            Circle_Trajectory_nh.param<float>(param_ns + "/Center_y", center[1], 0.0);
+            Circle_Trajectory_nh.param<float>(param_ns + "/Center_z", center[2], 1.0);
+            Circle_Trajectory_nh.param<float>(param_ns + "/radius", radius, 1.0);
+            Circle_Trajectory_nh.param<float>(param_ns + "/linear_vel", linear_vel, 0.5);
+            Circle_Trajectory_nh.param<float>(param_ns + "/time_total", time_total, 10.0);
+            Circle_Trajectory_nh.param<float>(param_ns + "/direction", direction, 1.0);
         }
         
         // Parameter
         Eigen::Vector3f center;
         float radius;
         float linear_vel;
-        float time_total;
         float direction;         //direction = 1 for CCW 逆时针, direction = -1 for CW 顺时针
 
         //Printf the Circle_Trajectory parameter
@@ -56,59 +57,69 @@ class Circle_Trajectory
         //Circle_Trajectory Calculation [Input: time_from_start; Output: Circle_trajectory;]
         px4_command::TrajectoryPoint Circle_trajectory_generation(float time_from_start);
 
-    private:
+        // 计算horizon.time中各时刻的参考量
+        void evaluate(trajectory_horizon& horizon) const;
+
+    protected:
 
         ros::NodeHandle Circle_Trajectory_nh;
+
+        // 角速度 [rad/s]
+        float get_omega() const;
 };
 
+class Helix_Trajectory : public Circle_Trajectory
+{
+    public:
 
-px4_command::TrajectoryPoint Circle_Trajectory::Circle_trajectory_generation(float time_from_start)
+        //构造函数
+        Helix_Trajectory(void):
+            Circle_Trajectory("Helix_Trajectory")
+        {
+            Circle_Trajectory_nh.param<float>("Helix_Trajectory/climb_rate", climb_rate, 0.1);
+        }
+
+        float climb_rate;        //上升速度 [m/s]，负值为下降
+
+        void evaluate(trajectory_horizon& horizon) const;
+
+        void printf_param();
+};
+
+float Circle_Trajectory::get_omega() const
 {
-    px4_command::TrajectoryPoint Circle_trajectory;
-    float omega;
     if( radius != 0)
     {
-        omega = direction * fabs(linear_vel / radius);
-    }else
-    {
-        omega = 0.0;
+        return direction * fabs(linear_vel / radius);
     }
-    const float angle = time_from_start * omega;
-    const float cos_angle = cos(angle);
-    const float sin_angle = sin(angle);
-
-    // cout << "omega : " << omega  * 180/M_PI <<" [deg/s] " <<endl;
-    // cout << "angle : " << angle  * 180/M_PI <<" [deg] " <<endl;
 
-    Circle_trajectory.header.stamp = ros::Time::now();
-
-    Circle_trajectory.time_from_start = time_from_start;
+    return 0.0;
+}
 
-    Circle_trajectory.Sub_mode  = command_to_mavros::XYZ_POS;
+void Circle_Trajectory::evaluate(trajectory_horizon& horizon) const
+{
+    const float omega = get_omega();
 
-    Circle_trajectory.position_ref[0] = radius * cos_angle + center[0];
-    Circle_trajectory.position_ref[1] = radius * sin_angle + center[1];
-    Circle_trajectory.position_ref[2] = center[2];
+    horizon.reset(center);
 
-    Circle_trajectory.velocity_ref[0] = - radius * omega * sin_angle;
-    Circle_trajectory.velocity_ref[1] = radius * omega * cos_angle;
-    Circle_trajectory.velocity_ref[2] = 0;
+    // x = r cos(wt), y = r sin(wt)
+    add_sinusoid(0, radius, omega, M_PI / 2, horizon);
+    add_sinusoid(1, radius, omega, 0.0, horizon);
+}
 
-    Circle_trajectory.acceleration_ref[0] = - radius * pow(omega, 2.0) * cos_angle;
-    Circle_trajectory.acceleration_ref[1] = - radius * pow(omega, 2.0) * sin_angle;
-    Circle_trajectory.acceleration_ref[2] = 0;
+void Helix_Trajectory::evaluate(trajectory_horizon& horizon) const
+{
+    Circle_Trajectory::evaluate(horizon);
 
-    // Circle_trajectory.jerk_ref[0] = radius * pow(omega, 3.0) * sin_angle;
-    // Circle_trajectory.jerk_ref[1] = - radius * pow(omega, 3.0) * cos_angle;
-    // Circle_trajectory.jerk_ref[2] = 0;
+    horizon.position.col(2) += climb_rate * horizon.time;
+    horizon.velocity.col(2).setConstant(climb_rate);
+}
 
-    // Circle_trajectory.snap_ref[0] = radius * pow(omega, 4.0) * cos_angle;
-    // Circle_trajectory.snap_ref[1] = radius * pow(omega, 4.0) * sin_angle;
-    // Circle_trajectory.snap_ref[2] = 0;
+px4_command::TrajectoryPoint Circle_Trajectory::Circle_trajectory_generation(float time_from_start)
+{
+    px4_command::TrajectoryPoint Circle_trajectory;
 
-    Circle_trajectory.yaw_ref = 0;
-    // Circle_trajectory.yaw_rate_ref = 0;
-    // Circle_trajectory.yaw_acceleration_ref = 0;
+    sample(time_from_start, Circle_trajectory);
 
     return Circle_trajectory;
 }
@@ -137,9 +148,9 @@ void Circle_Trajectory::printf_result(px4_command::TrajectoryPoint& Circle_traje
 
     cout << "acceleration [X Y Z] : " << Circle_trajectory.acceleration_ref[0] << " [m/s^2] "<< Circle_trajectory.acceleration_ref[1]<<" [m/s^2] "<< Circle_trajectory.acceleration_ref[2]<<" [m/s^2] "<<endl;
 
-    // cout << "jerk [X Y Z] : " << Circle_trajectory.jerk_ref[0] << " [m/s^3] "<< Circle_trajectory.jerk_ref[1]<<" [m/s^3] "<<Circle_trajectory.jerk_ref[2]<<" [m/s^3] "<<endl;
+    cout << "jerk [X Y Z] : " << Circle_trajectory.jerk_ref[0] << " [m/s^3] "<< Circle_trajectory.jerk_ref[1]<<" [m/s^3] "<<Circle_trajectory.jerk_ref[2]<<" [m/s^3] "<<endl;
 
-    // cout << "snap [X Y Z] : " << Circle_trajectory.snap_ref[0] << " [m/s^4] "<< Circle_trajectory.snap_ref[1]<<" [m/s^4] "<<Circle_trajectory.snap_ref[2]<<" [m/s^4] "<<endl;
+    cout << "snap [X Y Z] : " << Circle_trajectory.snap_ref[0] << " [m/s^4] "<< Circle_trajectory.snap_ref[1]<<" [m/s^4] "<<Circle_trajectory.snap_ref[2]<<" [m/s^4] "<<endl;
 
 }
 
@@ -156,6 +167,13 @@ void Circle_Trajectory::printf_param()
     //direction = 1 for CCW 逆时针, direction = -1 for CW 顺时针
 }
 
+void Helix_Trajectory::printf_param()
+{
+    Circle_Trajectory::printf_param();
+
+    cout <<"climb_rate : "<< climb_rate << " [m/s] " <<endl;
+}
+
 
 
 #endif
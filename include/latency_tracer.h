@@ -0,0 +1,245 @@
+/***************************************************************************************************************************
+* latency_tracer.h
+*
+* Author: Qyp
+*
+* Update Time: 2019.7.24
+*
+* Introduction:  End-to-end latency tracing from the positioning source to the mavros setpoint
+*         1. 定位数据源时间戳随DroneState.header传递，估计节点在DroneState中记录收到及发布的时刻
+*         2. 控制节点记录收到DroneState、开始控制计算、发送至mavros的时刻，计算各环节延迟
+*         3. 每个环节维护一个滚动直方图（固定窗口长度，新样本进入时移除最旧样本），百分位数由直方图计算
+*         4. 数据源与机载电脑不在同一台机器上时（如动捕），sensor_to_estimator及total依赖时钟同步(chrony/ntp)
+***************************************************************************************************************************/
+#ifndef LATENCY_TRACER_H
+#define LATENCY_TRACER_H
+
+#include <ros/ros.h>
+#include <vector>
+#include <algorithm>
+
+#include <px4_command/DroneState.h>
+#include <px4_command/LatencyBreakdown.h>
+
+using namespace std;
+
+// 单个环节的滚动直方图
+class latency_histogram
+{
+    public:
+
+        //构造函数
+        latency_histogram(void)
+        {
+            init(1.0, 50, 1000);
+        }
+
+        // [Input: bin width [ms], number of bins, window length (samples)]
+        void init(float bin_width_ms, int bin_num, int window_size);
+
+        // 加入一个样本 [ms]
+        void add(float latency_ms);
+
+        // 窗口内的 p50, p99（所在格的上边界）及最大值 [ms]
+        void get_percentile(float& p50, float& p99, float& max);
+
+        // 窗口内各格的样本数
+        const vector<unsigned int>& histogram() const { return hist; }
+
+        float bin_width;
+        int sample_num;
+
+    private:
+
+        vector<unsigned int> hist;
+        vector<float> sample;       // 窗口内的原始样本，用于求最大值
+        vector<int> sample_bin;     // 窗口内各样本所在格，用于移除最旧样本
+        int sample_index;
+};
+
+void latency_histogram::init(float bin_width_ms, int bin_num, int window_size)
+{
+    bin_width = bin_width_ms > 0 ? bin_width_ms : 1.0;
+
+    hist.assign(bin_num > 1 ? bin_num : 1, 0);
+    sample.assign(window_size > 1 ? window_size : 1, 0.0f);
+    sample_bin.assign(sample.size(), 0);
+
+    sample_index = 0;
+    sample_num = 0;
+}
+
+void latency_histogram::add(float latency_ms)
+{
+    // 时钟不同步时可能出现负值，计入第0格
+    int bin = (int)(latency_ms / bin_width);
+    if(bin < 0) bin = 0;
+    if(bin >= (int)hist.size()) bin = hist.size() - 1;
+
+    if(sample_num == (int)sample.size())
+    {
+        hist[sample_bin[sample_index]]--;
+    }else
+    {
+        sample_num++;
+    }
+
+    hist[bin]++;
+    sample[sample_index] = latency_ms;
+    sample_bin[sample_index] = bin;
+
+    sample_index = (sample_index + 1) % sample.size();
+}
+
+void latency_histogram::get_percentile(float& p50, float& p99, float& max)
+{
+    p50 = p99 = max = 0.0;
+
+    if(sample_num == 0)
+    {
+        return;
+    }
+
+    unsigned int n50 = (sample_num + 1) / 2;
+    unsigned int n99 = (sample_num * 99 + 99) / 100;
+    unsigned int count = 0;
+    bool found_50 = false;
+
+    for(unsigned int i = 0; i < hist.size(); i++)
+    {
+        count += hist[i];
+
+        if(!found_50 && count >= n50)
+        {
+            p50 = (i + 1) * bin_width;
+            found_50 = true;
+        }
+
+        if(count >= n99)
+        {
+            p99 = (i + 1) * bin_width;
+            break;
+        }
+    }
+
+    max = *std::max_element(sample.begin(), sample.begin() + sample_num);
+}
+
+// 定位数据 -> 估计节点 -> 控制节点 -> mavros 各环节延迟
+class latency_tracer
+{
+    public:
+
+        //构造函数
+        latency_tracer(void)
+        {
+            flag_new_state = false;
+        }
+
+        // 各环节：数据源->估计节点收到，估计节点计算，传输，控制节点排队，控制计算，总延迟
+        latency_histogram sensor_to_estimator;
+        latency_histogram estimator;
+        latency_histogram transport;
+        latency_histogram queue;
+        latency_histogram compute;
+        latency_histogram total;
+
+        void init(float bin_width_ms, int bin_num, int window_size);
+
+        // 控制节点收到DroneState时调用，stamp_arrival为回调线程收到该消息的时刻
+        void state_received(const px4_command::DroneState& _DroneState, const ros::Time& stamp_arrival);
+
+        // 开始控制计算时调用
+        void step_begin();
+
+        // 发送至mavros后调用，每个DroneState只记录一次（定周期模式下同一状态会被重复使用）
+        void setpoint_sent();
+
+        // 填充诊断消息
+        void fill_breakdown(px4_command::LatencyBreakdown& breakdown);
+
+    private:
+
+        bool flag_new_state;
+
+        ros::Time stamp_source;
+        ros::Time stamp_estimator_received;
+        ros::Time stamp_estimator_published;
+        ros::Time stamp_controller_received;
+        ros::Time stamp_step_begin;
+
+        static float to_ms(const ros::Time& end, const ros::Time& begin)
+        {
+            return (end - begin).toSec() * 1000.0;
+        }
+};
+
+void latency_tracer::init(float bin_width_ms, int bin_num, int window_size)
+{
+    sensor_to_estimator.init(bin_width_ms, bin_num, window_size);
+    estimator.init(bin_width_ms, bin_num, window_size);
+    transport.init(bin_width_ms, bin_num, window_size);
+    queue.init(bin_width_ms, bin_num, window_size);
+    compute.init(bin_width_ms, bin_num, window_size);
+    total.init(bin_width_ms, bin_num, window_size);
+}
+
+void latency_tracer::state_received(const px4_command::DroneState& _DroneState, const ros::Time& stamp_arrival)
+{
+    stamp_controller_received = stamp_arrival;
+
+    stamp_source              = _DroneState.header.stamp;
+    stamp_estimator_received  = _DroneState.stamp_received;
+    stamp_estimator_published = _DroneState.stamp_published;
+
+    // 旧版估计节点不填写时间戳，不统计
+    flag_new_state = !stamp_estimator_published.isZero();
+}
+
+void latency_tracer::step_begin()
+{
+    stamp_step_begin = ros::Time::now();
+}
+
+void latency_tracer::setpoint_sent()
+{
+    if(!flag_new_state)
+    {
+        return;
+    }
+
+    ros::Time stamp_sent = ros::Time::now();
+
+    sensor_to_estimator.add(to_ms(stamp_estimator_received, stamp_source));
+    estimator.add(to_ms(stamp_estimator_published, stamp_estimator_received));
+    transport.add(to_ms(stamp_controller_received, stamp_estimator_published));
+    queue.add(to_ms(stamp_step_begin, stamp_controller_received));
+    compute.add(to_ms(stamp_sent, stamp_step_begin));
+    total.add(to_ms(stamp_sent, stamp_source));
+
+    flag_new_state = false;
+}
+
+void latency_tracer::fill_breakdown(px4_command::LatencyBreakdown& breakdown)
+{
+    breakdown.header.stamp = ros::Time::now();
+
+    breakdown.window = total.sample_num;
+    breakdown.bin_width = total.bin_width;
+
+    sensor_to_estimator.get_percentile(breakdown.sensor_to_estimator[0], breakdown.sensor_to_estimator[1], breakdown.sensor_to_estimator[2]);
+    estimator.get_percentile(breakdown.estimator[0], breakdown.estimator[1], breakdown.estimator[2]);
+    transport.get_percentile(breakdown.transport[0], breakdown.transport[1], breakdown.transport[2]);
+    queue.get_percentile(breakdown.queue[0], breakdown.queue[1], breakdown.queue[2]);
+    compute.get_percentile(breakdown.compute[0], breakdown.compute[1], breakdown.compute[2]);
+    total.get_percentile(breakdown.total[0], breakdown.total[1], breakdown.total[2]);
+
+    breakdown.hist_sensor_to_estimator = sensor_to_estimator.histogram();
+    breakdown.hist_estimator = estimator.histogram();
+    breakdown.hist_transport = transport.histogram();
+    breakdown.hist_queue = queue.histogram();
+    breakdown.hist_compute = compute.histogram();
+    breakdown.hist_total = total.histogram();
+}
+
+#endif
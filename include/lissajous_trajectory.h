@@ -0,0 +1,146 @@
+/***************************************************************************************************************************
+* lissajous_trajectory.h
+*
+* Author: Qyp
+*
+* Update Time: 2019.8.12
+*
+* Introduction:  Lissajous and lemniscate (figure-eight) trajectory generation code
+*         1. Lissajous: 每轴 center + amplitude * sin(omega * t + phase)，各轴幅值、角频率、相位独立设置
+*         2. Lemniscate: Gerono 8字曲线 x = a cos(wt), y = (a/2) sin(2wt)，即 x:y 频率比为1:2的Lissajous曲线，
+*            从(center_x + a, center_y)出发，一个周期period内飞完整个8字
+*         3. Input: time_from_start, or a whole horizon (see parametric_trajectory.h)
+*         4. Output: position, velocity, acceleration, jerk, snap
+***************************************************************************************************************************/
+#ifndef LISSAJOUS_TRAJECTORY_H
+#define LISSAJOUS_TRAJECTORY_H
+
+#include <ros/ros.h>
+#include <Eigen/Eigen>
+#include <math.h>
+#include <parametric_trajectory.h>
+
+using namespace std;
+
+class Lissajous_Trajectory : public parametric_trajectory
+{
+    public:
+
+        //构造函数
+        Lissajous_Trajectory(void):
+            Lissajous_Trajectory_nh("~")
+        {
+            Lissajous_Trajectory_nh.param<float>("Lissajous_Trajectory/Center_x", center[0], 0.0);
+            Lissajous_Trajectory_nh.param<float>("Lissajous_Trajectory/Center_y", center[1], 0.0);
+            Lissajous_Trajectory_nh.param<float>("Lissajous_Trajectory/Center_z", center[2], 1.0);
+            Lissajous_Trajectory_nh.param<float>("Lissajous_Trajectory/amplitude_x", amplitude[0], 1.0);
+            Lissajous_Trajectory_nh.param<float>("Lissajous_Trajectory/amplitude_y", amplitude[1], 1.0);
+            Lissajous_Trajectory_nh.param<float>("Lissajous_Trajectory/amplitude_z", amplitude[2], 0.0);
+            Lissajous_Trajectory_nh.param<float>("Lissajous_Trajectory/omega_x", omega[0], 0.3);
+            Lissajous_Trajectory_nh.param<float>("Lissajous_Trajectory/omega_y", omega[1], 0.4);
+            Lissajous_Trajectory_nh.param<float>("Lissajous_Trajectory/omega_z", omega[2], 0.0);
+            Lissajous_Trajectory_nh.param<float>("Lissajous_Trajectory/phase_x", phase[0], M_PI / 2);
+            Lissajous_Trajectory_nh.param<float>("Lissajous_Trajectory/phase_y", phase[1], 0.0);
+            Lissajous_Trajectory_nh.param<float>("Lissajous_Trajectory/phase_z", phase[2], 0.0);
+            Lissajous_Trajectory_nh.param<float>("Lissajous_Trajectory/time_total", time_total, 30.0);
+        }
+
+        // Parameter
+        Eigen::Vector3f center;
+        Eigen::Vector3f amplitude;          // [m]
+        Eigen::Vector3f omega;              // [rad/s]
+        Eigen::Vector3f phase;              // [rad]
+
+        void evaluate(trajectory_horizon& horizon) const;
+
+        //Printf the Lissajous_Trajectory parameter
+        void printf_param();
+
+    private:
+
+        ros::NodeHandle Lissajous_Trajectory_nh;
+};
+
+class Lemniscate_Trajectory : public parametric_trajectory
+{
+    public:
+
+        //构造函数
+        Lemniscate_Trajectory(void):
+            Lemniscate_Trajectory_nh("~")
+        {
+            Lemniscate_Trajectory_nh.param<float>("Lemniscate_Trajectory/Center_x", center[0], 0.0);
+            Lemniscate_Trajectory_nh.param<float>("Lemniscate_Trajectory/Center_y", center[1], 0.0);
+            Lemniscate_Trajectory_nh.param<float>("Lemniscate_Trajectory/Center_z", center[2], 1.0);
+            Lemniscate_Trajectory_nh.param<float>("Lemniscate_Trajectory/size", size, 1.0);
+            Lemniscate_Trajectory_nh.param<float>("Lemniscate_Trajectory/period", period, 20.0);
+            Lemniscate_Trajectory_nh.param<float>("Lemniscate_Trajectory/time_total", time_total, 40.0);
+            Lemniscate_Trajectory_nh.param<float>("Lemniscate_Trajectory/direction", direction, 1.0);
+        }
+
+        // Parameter
+        Eigen::Vector3f center;
+        float size;                         // x方向半宽a [m]，y方向半宽a/2
+        float period;                       // 飞完一个8字的时间 [s]
+        float direction;                    // 1 or -1，飞行方向
+
+        void evaluate(trajectory_horizon& horizon) const;
+
+        //Printf the Lemniscate_Trajectory parameter
+        void printf_param();
+
+    private:
+
+        ros::NodeHandle Lemniscate_Trajectory_nh;
+};
+
+void Lissajous_Trajectory::evaluate(trajectory_horizon& horizon) const
+{
+    horizon.reset(center);
+
+    for(int j = 0; j < 3; j++)
+    {
+        add_sinusoid(j, amplitude[j], omega[j], phase[j], horizon);
+    }
+}
+
+void Lemniscate_Trajectory::evaluate(trajectory_horizon& horizon) const
+{
+    float omega = 0.0;
+    if(period > 0)
+    {
+        omega = direction * 2 * M_PI / period;
+    }
+
+    horizon.reset(center);
+
+    // x = a cos(wt), y = (a/2) sin(2wt)
+    add_sinusoid(0, size, omega, M_PI / 2, horizon);
+    add_sinusoid(1, 0.5 * size, 2 * omega, 0.0, horizon);
+}
+
+// 【打印参数函数】
+void Lissajous_Trajectory::printf_param()
+{
+    cout <<">>>>>>>>>>>>>>>>>>>>>>>>>>>>>>Lissajous_Trajectory Parameter <<<<<<<<<<<<<<<<<<<<<<<<<<<" <<endl;
+
+    cout <<"center :  "<< center.transpose() <<endl;
+    cout <<"amplitude : "<< amplitude.transpose() << " [m] " <<endl;
+    cout <<"omega : "<< omega.transpose() << " [rad/s] " <<endl;
+    cout <<"phase : "<< phase.transpose() << " [rad] " <<endl;
+    cout <<"time_total : "<< time_total << endl;
+}
+
+// 【打印参数函数】
+void Lemniscate_Trajectory::printf_param()
+{
+    cout <<">>>>>>>>>>>>>>>>>>>>>>>>>>>>>>Lemniscate_Trajectory Parameter <<<<<<<<<<<<<<<<<<<<<<<<<<<" <<endl;
+
+    cout <<"center :  "<< center.transpose() <<endl;
+    cout <<"size : "<< size << " [m] " <<endl;
+    cout <<"period : "<< period << " [s] " <<endl;
+    cout <<"time_total : "<< time_total << endl;
+    cout <<"direction : "<< direction << endl;
+}
+
+#endif
@@ -0,0 +1,359 @@
+/***************************************************************************************************************************
+* minimum_snap.h
+*
+* Author: Qyp
+*
+* Update Time: 2019.8.9
+*
+* Introduction:  Minimum-snap piecewise polynomial trajectory generation
+*         1. 输入航点 [x y z yaw]，每段为7次多项式（8个系数），x y z yaw分别求解
+*            Ref to : Mellinger D, Kumar V. Minimum snap trajectory generation and control for quadrotors. ICRA 2011.
+*         2. 航点处位置固定、起点及终点速度/加速度/加加速度为0时，最小snap解在中间航点处1-6阶导数连续，
+*            因此直接求解由位置约束及连续性约束组成的8n维带状线性方程组（SparseLU，一次分解求解4个轴），不需要QP
+*         3. 每段使用归一化时间 s = t/T ∈ [0,1]，避免段时长差异大时方程组病态
+*         4. 段时长按梯形速度曲线(Min_snap/max_vel, max_acc)分配，也可由调用者指定
+*         5. 系数存于连续的一维数组 [段][轴][8]，查询时二分查找所在段并用Horner法计算位置至snap及偏航角速度，直接填入TrajectoryPoint
+*         6. 50个航点求解耗时约1ms量级，可在飞行中重规划（见px4_benchmark）
+***************************************************************************************************************************/
+#ifndef MINIMUM_SNAP_H
+#define MINIMUM_SNAP_H
+
+#include <ros/ros.h>
+#include <Eigen/Eigen>
+#include <Eigen/Sparse>
+#include <math.h>
+#include <vector>
+#include <algorithm>
+
+#include <px4_command/Trajectory.h>
+#include <px4_command/TrajectoryPoint.h>
+#include <command_to_mavros.h>
+
+using namespace std;
+
+// 每段多项式系数个数及轴数 (x y z yaw)
+#define MIN_SNAP_COEFF_NUM 8
+#define MIN_SNAP_AXIS_NUM 4
+
+// 航点 [x y z yaw]：Vector4d为16字节对齐的固定维数类型，C++11下std::vector须使用Eigen::aligned_allocator
+typedef vector<Eigen::Vector4d, Eigen::aligned_allocator<Eigen::Vector4d> > min_snap_waypoints;
+
+class minimum_snap
+{
+    public:
+
+        //构造函数
+        minimum_snap(void):
+            min_snap_nh("~")
+        {
+            min_snap_nh.param<float>("Min_snap/max_vel", max_vel, 1.0);
+            min_snap_nh.param<float>("Min_snap/max_acc", max_acc, 1.0);
+
+            segment_num = 0;
+        }
+
+        //Parameter for time allocation
+        float max_vel;                              // [m/s]
+        float max_acc;                              // [m/s^2]
+
+        // 求解，段时长按梯形速度曲线分配 [Input: waypoints (x y z yaw), at least 2; Output: false for 求解失败]
+        bool solve(const min_snap_waypoints& waypoints);
+
+        // 求解，段时长由调用者指定 [Input: waypoints, segment_time (size = waypoints.size() - 1) [s]]
+        bool solve(const min_snap_waypoints& waypoints, const vector<double>& segment_time);
+
+        // 查询time_from_start时刻的参考量，直接写入_TrajectoryPoint [Output: false for 未求解]
+        bool sample(float time_from_start, px4_command::TrajectoryPoint& _TrajectoryPoint) const;
+
+        // 按dt采样整条轨迹，用于发送至/px4_command/trajectory
+        void to_trajectory(float dt, px4_command::Trajectory& _Trajectory) const;
+
+        float total_time() const { return segment_num > 0 ? time_knots[segment_num] : 0.0; }
+
+        int get_segment_num() const { return segment_num; }
+
+        //Printf the minimum_snap parameter
+        void printf_param();
+
+        //Printf the solve result
+        void printf_result();
+
+    private:
+
+        ros::NodeHandle min_snap_nh;
+
+        int segment_num;
+        vector<double> time_knots;                  //各段起始时刻，size = segment_num + 1
+        vector<double> segment_T;                   //各段时长
+        vector<double> coeff;                       //[段][轴][8]，s的升幂
+
+        // k!/(k-m)!
+        static double falling_factorial(int k, int m);
+
+        // 梯形速度曲线时长
+        double allocate_time(double distance) const;
+};
+
+double minimum_snap::falling_factorial(int k, int m)
+{
+    double value = 1.0;
+    for(int i = 0; i < m; i++)
+    {
+        value = value * (k - i);
+    }
+    return value;
+}
+
+double minimum_snap::allocate_time(double distance) const
+{
+    double T;
+
+    if(distance < max_vel * max_vel / max_acc)
+    {
+        T = 2.0 * sqrt(distance / max_acc);
+    }else
+    {
+        T = distance / max_vel + max_vel / max_acc;
+    }
+
+    return max(T, 0.1);
+}
+
+bool minimum_snap::solve(const min_snap_waypoints& waypoints)
+{
+    if(waypoints.size() < 2)
+    {
+        return false;
+    }
+
+    vector<double> segment_time(waypoints.size() - 1);
+    for(unsigned int i = 0; i + 1 < waypoints.size(); i++)
+    {
+        segment_time[i] = allocate_time((waypoints[i + 1].head<3>() - waypoints[i].head<3>()).norm());
+    }
+
+    return solve(waypoints, segment_time);
+}
+
+bool minimum_snap::solve(const min_snap_waypoints& waypoints, const vector<double>& segment_time)
+{
+    int n = waypoints.size() - 1;
+
+    if(n < 1 || (int)segment_time.size() != n)
+    {
+        return false;
+    }
+
+    const int N = MIN_SNAP_COEFF_NUM;
+    const int dim = N * n;
+
+    vector< Eigen::Triplet<double> > triplets;
+    triplets.reserve(dim * 10);
+
+    Eigen::MatrixXd b = Eigen::MatrixXd::Zero(dim, MIN_SNAP_AXIS_NUM);
+
+    // 偏航角航点展开，保证相邻航点间按最短角度旋转
+    vector<double> yaw(n + 1);
+    yaw[0] = waypoints[0][3];
+    for(int i = 1; i <= n; i++)
+    {
+        double yaw_error = waypoints[i][3] - waypoints[i - 1][3];
+        yaw[i] = yaw[i - 1] + atan2(sin(yaw_error), cos(yaw_error));
+    }
+
+    int row = 0;
+
+    // 起点1-3阶导数为0
+    for(int m = 1; m <= 3; m++)
+    {
+        triplets.push_back(Eigen::Triplet<double>(row, m, falling_factorial(m, m)));
+        row++;
+    }
+
+    for(int i = 0; i < n; i++)
+    {
+        // 段起点及终点位置
+        triplets.push_back(Eigen::Triplet<double>(row, N * i, 1.0));
+        b.block<1,3>(row, 0) = waypoints[i].head<3>().transpose();
+        b(row, 3) = yaw[i];
+        row++;
+
+        for(int k = 0; k < N; k++)
+        {
+            triplets.push_back(Eigen::Triplet<double>(row, N * i + k, 1.0));
+        }
+        b.block<1,3>(row, 0) = waypoints[i + 1].head<3>().transpose();
+        b(row, 3) = yaw[i + 1];
+        row++;
+
+        // 中间航点1-6阶导数连续，归一化时间下右段导数乘以(T_i/T_i+1)^m
+        if(i + 1 < n)
+        {
+            double ratio = segment_time[i] / segment_time[i + 1];
+
+            for(int m = 1; m <= 6; m++)
+            {
+                for(int k = m; k < N; k++)
+                {
+                    triplets.push_back(Eigen::Triplet<double>(row, N * i + k, falling_factorial(k, m)));
+                }
+                triplets.push_back(Eigen::Triplet<double>(row, N * (i + 1) + m, - pow(ratio, m) * falling_factorial(m, m)));
+                row++;
+            }
+        }
+    }
+
+    // 终点1-3阶导数为0
+    for(int m = 1; m <= 3; m++)
+    {
+        for(int k = m; k < N; k++)
+        {
+            triplets.push_back(Eigen::Triplet<double>(row, N * (n - 1) + k, falling_factorial(k, m)));
+        }
+        row++;
+    }
+
+    Eigen::SparseMatrix<double> A(dim, dim);
+    A.setFromTriplets(triplets.begin(), triplets.end());
+
+    Eigen::SparseLU< Eigen::SparseMatrix<double> > solver;
+    solver.compute(A);
+
+    if(solver.info() != Eigen::Success)
+    {
+        return false;
+    }
+
+    Eigen::MatrixXd x = solver.solve(b);
+
+    if(solver.info() != Eigen::Success)
+    {
+        return false;
+    }
+
+    // 存为 [段][轴][8]
+    segment_num = n;
+    segment_T = segment_time;
+    time_knots.resize(n + 1);
+    coeff.resize(n * MIN_SNAP_AXIS_NUM * N);
+
+    time_knots[0] = 0.0;
+    for(int i = 0; i < n; i++)
+    {
+        time_knots[i + 1] = time_knots[i] + segment_time[i];
+
+        for(int axis = 0; axis < MIN_SNAP_AXIS_NUM; axis++)
+        {
+            for(int k = 0; k < N; k++)
+            {
+                coeff[(i * MIN_SNAP_AXIS_NUM + axis) * N + k] = x(N * i + k, axis);
+            }
+        }
+    }
+
+    return true;
+}
+
+bool minimum_snap::sample(float time_from_start, px4_command::TrajectoryPoint& _TrajectoryPoint) const
+{
+    if(segment_num == 0)
+    {
+        return false;
+    }
+
+    double t = min(max((double)time_from_start, 0.0), time_knots[segment_num]);
+
+    // 二分查找所在段
+    int i = upper_bound(time_knots.begin() + 1, time_knots.begin() + segment_num, t) - (time_knots.begin() + 1);
+
+    double T = segment_T[i];
+    double s = (t - time_knots[i]) / T;
+
+    // value[轴][导数阶次 0-4]
+    double value[MIN_SNAP_AXIS_NUM][5];
+
+    for(int axis = 0; axis < MIN_SNAP_AXIS_NUM; axis++)
+    {
+        const double* c = &coeff[(i * MIN_SNAP_AXIS_NUM + axis) * MIN_SNAP_COEFF_NUM];
+
+        // Horner法，第m阶导数系数为 k!/(k-m)! c_k
+        double scale = 1.0;
+        for(int m = 0; m < 5; m++)
+        {
+            double d = falling_factorial(MIN_SNAP_COEFF_NUM - 1, m) * c[MIN_SNAP_COEFF_NUM - 1];
+            for(int k = MIN_SNAP_COEFF_NUM - 2; k >= m; k--)
+            {
+                d = d * s + falling_factorial(k, m) * c[k];
+            }
+
+            value[axis][m] = d / scale;
+            scale = scale * T;
+        }
+    }
+
+    _TrajectoryPoint.time_from_start = time_from_start;
+    _TrajectoryPoint.Sub_mode = command_to_mavros::XYZ_POS;
+
+    for(int j = 0; j < 3; j++)
+    {
+        _TrajectoryPoint.position_ref[j] = value[j][0];
+        _TrajectoryPoint.velocity_ref[j] = value[j][1];
+        _TrajectoryPoint.acceleration_ref[j] = value[j][2];
+        _TrajectoryPoint.jerk_ref[j] = value[j][3];
+        _TrajectoryPoint.snap_ref[j] = value[j][4];
+    }
+
+    _TrajectoryPoint.yaw_ref = atan2(sin(value[3][0]), cos(value[3][0]));
+    _TrajectoryPoint.yaw_rate_ref = value[3][1];
+
+    return true;
+}
+
+void minimum_snap::to_trajectory(float dt, px4_command::Trajectory& _Trajectory) const
+{
+    _Trajectory.points.clear();
+
+    if(segment_num == 0 || dt <= 0)
+    {
+        return;
+    }
+
+    int point_num = ceil(total_time() / dt) + 1;
+    _Trajectory.points.resize(point_num);
+
+    for(int i = 0; i < point_num; i++)
+    {
+        sample(min(i * dt, total_time()), _Trajectory.points[i]);
+    }
+}
+
+void minimum_snap::printf_result()
+{
+    cout <<">>>>>>>>>>>>>>>>>>>>>>>>>>> Minimum Snap Trajectory <<<<<<<<<<<<<<<<<<<<<<<<<" <<endl;
+
+    //固定的浮点显示
+    cout.setf(ios::fixed);
+    //左对齐
+    cout.setf(ios::left);
+    // 强制显示小数点
+    cout.setf(ios::showpoint);
+
+    cout<<setprecision(2);
+
+    cout << "segment_num : " << segment_num << "  total_time : " << total_time() << " [s] " <<endl;
+
+    for(int i = 0; i < segment_num; i++)
+    {
+        cout << "segment " << i << " : " << time_knots[i] << " [s] -> " << time_knots[i + 1] << " [s] " <<endl;
+    }
+}
+
+// 【打印参数函数】
+void minimum_snap::printf_param()
+{
+    cout <<">>>>>>>>>>>>>>>>>>>>>>>>>>>>>>Minimum Snap Parameter <<<<<<<<<<<<<<<<<<<<<<<<<<<" <<endl;
+    cout <<"max_vel : "<< max_vel << " [m/s] " << endl;
+    cout <<"max_acc : "<< max_acc << " [m/s^2] " << endl;
+}
+
+#endif
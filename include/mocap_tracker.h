@@ -0,0 +1,399 @@
+/***************************************************************************************************************************
+* mocap_tracker.h
+*
+* Author: Qyp
+*
+* Update Time: 2019.8.26
+*
+* Introduction:  Multi-rigid-body mocap ingestion with struct-of-arrays storage
+*         1. 由Mocap/bodies给出的N个刚体名订阅 topic_prefix + name + topic_suffix（默认/vrpn_client_node/<name>/pose），
+*            所有刚体的状态存放在按刚体索引的列矩阵中（位置3xN、四元数4xN、速度3xN ...），历史位姿为3x(N*window)的连续存储，
+*            刚体数增加时只增加列数，不增加对象及订阅以外的开销
+*         2. 时间戳校验同OptiTrackFeedBackRigidBody：重复/乱序的时间戳被丢弃，超过dropout_time的间隔后重新开始差分
+*         3. 速度：window个位姿内一步差分的平均，等价于(p_newest - p_oldest)/(t_newest - t_oldest)，每个位姿O(1)；
+*            velocity_filter为1时使用Savitzky-Golay多项式微分（各刚体共用一组权重）；角速度由最早与最新姿态的相对旋转得到（机体系）
+*         4. 由px4_mocap_tracker节点以Mocap/rate发布/px4_command/rigid_bodies（RigidBodyArray），一条消息包含全部刚体，
+*            px4_pos_estimator、ground_station等使用者按刚体名取出状态（find + get_state），不再各自订阅并差分同一刚体
+*         5. get_state可按消息中的传输延迟将状态外推至指定时刻（同OptiTrackFeedBackRigidBody::GetPredictedState）
+***************************************************************************************************************************/
+#ifndef MOCAP_TRACKER_H
+#define MOCAP_TRACKER_H
+
+#include <ros/ros.h>
+#include <Eigen/Eigen>
+#include <math.h>
+#include <vector>
+#include <string>
+#include <iostream>
+#include <iomanip>
+#include <geometry_msgs/PoseStamped.h>
+#include <OptiTrackFeedBackRigidBody.h>
+
+#include <px4_command/RigidBodyArray.h>
+
+using namespace std;
+
+class mocap_tracker
+{
+    public:
+
+        //构造函数
+        mocap_tracker(ros::NodeHandle& nh)
+        {
+            nh.getParam("Mocap/bodies", names);
+            nh.param<string>("Mocap/topic_prefix", topic_prefix, "/vrpn_client_node/");
+            nh.param<string>("Mocap/topic_suffix", topic_suffix, "/pose");
+            nh.param<int>("Mocap/window", window, 10);
+            nh.param<int>("Mocap/velocity_filter", velocity_filter, VELOCITY_FILTER_MOVING_AVERAGE);
+            nh.param<int>("Mocap/poly_order", poly_order, 2);
+            nh.param<float>("Mocap/dropout_time", dropout_time, 0.1);
+
+            window = max(window, 2);
+            if(velocity_filter == VELOCITY_FILTER_SAVITZKY_GOLAY && (poly_order < 1 || window <= poly_order))
+            {
+                ROS_INFO("Mocap: Savitzky-Golay window [%d] must be larger than polynomial order [%d], use moving average", window, poly_order);
+                velocity_filter = VELOCITY_FILTER_MOVING_AVERAGE;
+            }
+
+            int N = names.size();
+
+            position = Eigen::Matrix3Xd::Zero(3, N);
+            orientation = Eigen::Matrix4Xd::Zero(4, N);
+            orientation.row(0).setOnes();
+            velocity = Eigen::Matrix3Xd::Zero(3, N);
+            angular_velocity = Eigen::Matrix3Xd::Zero(3, N);
+            stamp = Eigen::VectorXd::Zero(N);
+            stamp_received = Eigen::VectorXd::Zero(N);
+            latency = Eigen::VectorXd::Zero(N);
+            valid.assign(N, 0);
+            discarded.assign(N, 0);
+
+            position_history = Eigen::Matrix3Xd::Zero(3, N * window);
+            orientation_history = Eigen::Matrix4Xd::Zero(4, N * window);
+            time_history = Eigen::VectorXd::Zero(N * window);
+            head.assign(N, 0);
+            count.assign(N, 0);
+
+            if(velocity_filter == VELOCITY_FILTER_SAVITZKY_GOLAY)
+            {
+                calculate_savitzky_golay_weights();
+            }
+
+            // 每个刚体一个订阅，回调中只写入该刚体所在的列
+            for(int i = 0; i < N; i++)
+            {
+                subscribers.push_back(nh.subscribe<geometry_msgs::PoseStamped>(topic_prefix + names[i] + topic_suffix, 10,
+                                      [this, i](const geometry_msgs::PoseStamped::ConstPtr& msg){ pose_cb(msg, i); }));
+            }
+        }
+
+        //Parameter
+        vector<string> names;               // Mocap/bodies
+        string topic_prefix;
+        string topic_suffix;
+        int window;                         // 差分窗口（位姿个数）
+        int velocity_filter;                // VELOCITY_FILTER_*
+        int poly_order;
+        float dropout_time;                 // [s]
+
+        int size() const { return names.size(); }
+
+        // [Output: 刚体索引, -1 for 未跟踪该刚体]
+        int index(const string& name) const;
+
+        // 丢失检测（在处理完回调之后调用） [Input: 当前时刻 [s]]
+        void update(double now);
+
+        // [Output: RigidBodyArray, filled in place (header is not touched)]
+        void fill_array(px4_command::RigidBodyArray& bodies) const;
+
+        // 【使用者】在消息中查找刚体，hint为上一次的索引（刚体顺序不变时直接命中） [Output: 索引, -1 for 未找到]
+        static int find(const px4_command::RigidBodyArray& bodies, const string& name, int& hint);
+
+        // 【使用者】取出第i个刚体的状态，t_predict > 0时按传输延迟外推至t_predict，外推不超过prediction_max
+        // [Output: false for 该刚体无效]
+        static bool get_state(const px4_command::RigidBodyArray& bodies, int i, rigidbody_state& state,
+                              double t_predict = 0.0, double prediction_max = 0.0);
+
+        void printf_param();
+
+        void printf_result();
+
+    private:
+
+        vector<ros::Subscriber> subscribers;
+
+        // 各刚体的最新状态，第i列为第i个刚体
+        Eigen::Matrix3Xd position;
+        Eigen::Matrix4Xd orientation;       // [w x y z]
+        Eigen::Matrix3Xd velocity;
+        Eigen::Matrix3Xd angular_velocity;
+        Eigen::VectorXd stamp;
+        Eigen::VectorXd stamp_received;
+        Eigen::VectorXd latency;
+        vector<unsigned char> valid;
+        vector<unsigned int> discarded;
+
+        // 历史位姿，第i个刚体占据第 i*window ... i*window+window-1 列（环形）
+        Eigen::Matrix3Xd position_history;
+        Eigen::Matrix4Xd orientation_history;
+        Eigen::VectorXd time_history;
+        vector<int> head;                   // 最新位姿在环中的位置
+        vector<int> count;                  // 环中有效位姿数
+
+        Eigen::VectorXd savitzky_golay_weights;
+
+        void pose_cb(const geometry_msgs::PoseStamped::ConstPtr& msg, int i);
+
+        void restart(int i);
+
+        void calculate_savitzky_golay_weights();
+};
+
+int mocap_tracker::index(const string& name) const
+{
+    for(int i = 0; i < size(); i++)
+    {
+        if(names[i] == name)
+        {
+            return i;
+        }
+    }
+    return -1;
+}
+
+void mocap_tracker::pose_cb(const geometry_msgs::PoseStamped::ConstPtr& msg, int i)
+{
+    double t_received = ros::Time::now().toSec();
+    double t = msg->header.stamp.isZero() ? t_received : msg->header.stamp.toSec();
+
+    // 重复或乱序的时间戳
+    if(count[i] > 0 && t <= stamp[i])
+    {
+        discarded[i]++;
+        return;
+    }
+
+    // 间隔超过dropout_time，不跨越间隔差分
+    if(count[i] > 0 && t - stamp[i] > dropout_time)
+    {
+        restart(i);
+    }
+
+    latency[i] = count[i] == 0 && !valid[i] ? t_received - t : latency[i] + 0.05 * (t_received - t - latency[i]);
+
+    Eigen::Vector3d p(msg->pose.position.x, msg->pose.position.y, msg->pose.position.z);
+    Eigen::Quaterniond q(msg->pose.orientation.w, msg->pose.orientation.x, msg->pose.orientation.y, msg->pose.orientation.z);
+
+    position.col(i) = p;
+    orientation.col(i) << q.w(), q.x(), q.y(), q.z();
+    stamp[i] = t;
+    stamp_received[i] = t_received;
+    valid[i] = 1;
+
+    head[i] = (head[i] + 1) % window;
+    count[i] = min(count[i] + 1, window);
+
+    int base = i * window;
+    position_history.col(base + head[i]) = p;
+    orientation_history.col(base + head[i]) = orientation.col(i);
+    time_history[base + head[i]] = t;
+
+    if(count[i] < 2)
+    {
+        return;
+    }
+
+    int oldest = base + (head[i] - count[i] + 1 + window) % window;
+    double dt = t - time_history[oldest];
+
+    // 一步差分的平均 = 首尾差分
+    velocity.col(i) = (p - position_history.col(oldest)) / dt;
+
+    if(velocity_filter == VELOCITY_FILTER_SAVITZKY_GOLAY && count[i] == window)
+    {
+        Eigen::Vector3d sum = Eigen::Vector3d::Zero();
+        for(int k = 0; k < window; k++)
+        {
+            sum = sum + savitzky_golay_weights[k] * position_history.col(base + (head[i] + 1 + k) % window);
+        }
+        velocity.col(i) = sum / (dt / (window - 1));
+    }
+
+    // 机体系角速度：q_oldest^-1 * q 的旋转向量 / dt
+    Eigen::Vector4d q_old = orientation_history.col(oldest);
+    Eigen::Quaterniond q_rel = Eigen::Quaterniond(q_old[0], q_old[1], q_old[2], q_old[3]).conjugate() * q;
+    if(q_rel.w() < 0.0)
+    {
+        q_rel.coeffs() = - q_rel.coeffs();
+    }
+    Eigen::AngleAxisd rotation(q_rel);
+    angular_velocity.col(i) = rotation.axis() * rotation.angle() / dt;
+}
+
+void mocap_tracker::restart(int i)
+{
+    count[i] = 0;
+    velocity.col(i).setZero();
+    angular_velocity.col(i).setZero();
+}
+
+void mocap_tracker::update(double now)
+{
+    for(int i = 0; i < size(); i++)
+    {
+        if(valid[i] && now - stamp_received[i] > dropout_time)
+        {
+            valid[i] = 0;
+            restart(i);
+        }
+    }
+}
+
+void mocap_tracker::calculate_savitzky_golay_weights()
+{
+    // 同OptiTrackFeedBackRigidBody::CalculateSavitzkyGolayWeights：k = -(window-1)...0 处的多项式拟合在k=0处的导数
+    Eigen::MatrixXd A(window, poly_order + 1);
+    for(int i = 0; i < window; i++)
+    {
+        double k = i - (window - 1);
+        A(i,0) = 1.0;
+        for(int j = 1; j <= poly_order; j++)
+        {
+            A(i,j) = A(i,j-1) * k;
+        }
+    }
+    Eigen::MatrixXd coefficients = (A.transpose() * A).ldlt().solve(A.transpose());
+    savitzky_golay_weights = coefficients.row(1).transpose();
+}
+
+void mocap_tracker::fill_array(px4_command::RigidBodyArray& bodies) const
+{
+    int N = size();
+
+    bodies.name = names;
+    bodies.valid.resize(N);
+    bodies.stamp.resize(N);
+    bodies.stamp_received.resize(N);
+    bodies.latency.resize(N);
+    bodies.position.resize(N);
+    bodies.orientation.resize(N);
+    bodies.velocity.resize(N);
+    bodies.angular_velocity.resize(N);
+
+    for(int i = 0; i < N; i++)
+    {
+        bodies.valid[i] = valid[i];
+        bodies.stamp[i] = ros::Time(stamp[i]);
+        bodies.stamp_received[i] = ros::Time(stamp_received[i]);
+        bodies.latency[i] = latency[i];
+
+        bodies.position[i].x = position(0,i);
+        bodies.position[i].y = position(1,i);
+        bodies.position[i].z = position(2,i);
+
+        bodies.orientation[i].w = orientation(0,i);
+        bodies.orientation[i].x = orientation(1,i);
+        bodies.orientation[i].y = orientation(2,i);
+        bodies.orientation[i].z = orientation(3,i);
+
+        bodies.velocity[i].x = velocity(0,i);
+        bodies.velocity[i].y = velocity(1,i);
+        bodies.velocity[i].z = velocity(2,i);
+
+        bodies.angular_velocity[i].x = angular_velocity(0,i);
+        bodies.angular_velocity[i].y = angular_velocity(1,i);
+        bodies.angular_velocity[i].z = angular_velocity(2,i);
+    }
+}
+
+int mocap_tracker::find(const px4_command::RigidBodyArray& bodies, const string& name, int& hint)
+{
+    if(hint >= 0 && hint < (int)bodies.name.size() && bodies.name[hint] == name)
+    {
+        return hint;
+    }
+
+    for(int i = 0; i < (int)bodies.name.size(); i++)
+    {
+        if(bodies.name[i] == name)
+        {
+            hint = i;
+            return i;
+        }
+    }
+
+    hint = -1;
+    return -1;
+}
+
+bool mocap_tracker::get_state(const px4_command::RigidBodyArray& bodies, int i, rigidbody_state& state, double t_predict, double prediction_max)
+{
+    if(i < 0 || i >= (int)bodies.name.size())
+    {
+        return false;
+    }
+
+    Eigen::Vector3d p(bodies.position[i].x, bodies.position[i].y, bodies.position[i].z);
+    Eigen::Quaterniond q(bodies.orientation[i].w, bodies.orientation[i].x, bodies.orientation[i].y, bodies.orientation[i].z);
+    Eigen::Vector3d v(bodies.velocity[i].x, bodies.velocity[i].y, bodies.velocity[i].z);
+    Eigen::Vector3d omega(bodies.angular_velocity[i].x, bodies.angular_velocity[i].y, bodies.angular_velocity[i].z);
+    double t = bodies.stamp[i].toSec();
+
+    if(t_predict > 0.0 && bodies.valid[i])
+    {
+        double horizon = t_predict - bodies.stamp_received[i].toSec() + bodies.latency[i];
+        horizon = min(max(horizon, 0.0), prediction_max);
+
+        p = p + v * horizon;
+        Eigen::Vector3d rotation = omega * horizon;
+        if(rotation.norm() > 1e-9)
+        {
+            q = q * Eigen::Quaterniond(Eigen::AngleAxisd(rotation.norm(), rotation.normalized()));
+            q.normalize();
+        }
+        t = t + horizon;
+    }
+
+    state.time_stamp = t;
+    state.Position = p;
+    state.V_I = v;
+    state.Omega_BI = omega;
+    state.Omega_Cross << 0.0, - omega[2], omega[1],
+                         omega[2], 0.0, - omega[0],
+                         - omega[1], omega[0], 0.0;
+    state.quaterion << q.w(), q.x(), q.y(), q.z();
+    state.R_IB = q.toRotationMatrix();
+    state.R_BI = state.R_IB.transpose();
+    state.Euler[0] = atan2(2.0 * (q.w() * q.x() + q.y() * q.z()), 1.0 - 2.0 * (q.x() * q.x() + q.y() * q.y()));
+    state.Euler[1] = asin(min(max(2.0 * (q.w() * q.y() - q.z() * q.x()), -1.0), 1.0));
+    state.Euler[2] = atan2(2.0 * (q.w() * q.z() + q.x() * q.y()), 1.0 - 2.0 * (q.y() * q.y() + q.z() * q.z()));
+
+    return bodies.valid[i];
+}
+
+void mocap_tracker::printf_param()
+{
+    cout <<">>>>>>>>>>>>>>>>>>>>>>>>>>>>>> Mocap Tracker <<<<<<<<<<<<<<<<<<<<<<<<<<<<<" <<endl;
+    cout <<"bodies : " << size() << "  topic : " << topic_prefix << "<name>" << topic_suffix << endl;
+    cout <<"window : "<< window << "  velocity_filter : "<< velocity_filter << "  poly_order : "<< poly_order << "  dropout_time : "<< dropout_time << " [s] " << endl;
+}
+
+void mocap_tracker::printf_result()
+{
+    cout <<">>>>>>>>>>>>>>>>>>>>>>>>>>>>  Mocap Tracker  <<<<<<<<<<<<<<<<<<<<<<<<<<<<<" <<endl;
+
+    cout.setf(ios::fixed);
+    cout.setf(ios::left);
+    cout.setf(ios::showpoint);
+    cout<<setprecision(3);
+
+    for(int i = 0; i < size(); i++)
+    {
+        cout << names[i] << (valid[i] ? " [valid]  " : " [lost]   ") << "Pos [X Y Z] : " << position(0,i) << " " << position(1,i) << " " << position(2,i)
+             << " [m]  Vel [X Y Z] : " << velocity(0,i) << " " << velocity(1,i) << " " << velocity(2,i)
+             << " [m/s]  latency : " << latency[i] * 1000 << " [ms]  discarded : " << discarded[i] << endl;
+    }
+}
+
+#endif
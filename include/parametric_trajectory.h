@@ -0,0 +1,157 @@
+/***************************************************************************************************************************
+* parametric_trajectory.h
+*
+* Author: Qyp
+*
+* Update Time: 2019.8.12
+*
+* Introduction:  Common interface of the analytic (parametric) trajectories
+*         1. 圆形(Circle)、螺旋(Helix)、8字(Lemniscate)、Lissajous及带过渡的折线(Polyline)轨迹均继承此类，创建见trajectory_registry.h
+*         2. evaluate()一次计算整段时域（trajectory_horizon中的N个时刻）的位置至snap及偏航角，用于前馈及MPC的预测时域
+*            正弦类轨迹对整列时刻使用Eigen数组运算（逐轴一次sin/cos），不逐点调用ros::Time::now()及pow()
+*         3. trajectory_horizon按列存储（每轴连续），同样长度的时域重复计算时不分配内存
+*         4. sample()计算单个时刻并直接写入TrajectoryPoint，用于控制循环
+***************************************************************************************************************************/
+#ifndef PARAMETRIC_TRAJECTORY_H
+#define PARAMETRIC_TRAJECTORY_H
+
+#include <Eigen/Eigen>
+#include <math.h>
+#include <px4_command/TrajectoryPoint.h>
+#include <command_to_mavros.h>
+
+using namespace std;
+
+// 预测时域内的参考量，第i行为第i个时刻
+struct trajectory_horizon
+{
+    Eigen::ArrayXf time;                                    // [s]
+    Eigen::Array<float, Eigen::Dynamic, 3> position;        // [m]
+    Eigen::Array<float, Eigen::Dynamic, 3> velocity;        // [m/s]
+    Eigen::Array<float, Eigen::Dynamic, 3> acceleration;    // [m/s^2]
+    Eigen::Array<float, Eigen::Dynamic, 3> jerk;            // [m/s^3]
+    Eigen::Array<float, Eigen::Dynamic, 3> snap;            // [m/s^4]
+    Eigen::ArrayXf yaw;                                     // [rad]
+    Eigen::ArrayXf yaw_rate;                                // [rad/s]
+
+    // 长度不变时不重新分配
+    void resize(int N)
+    {
+        if(time.size() == N)
+        {
+            return;
+        }
+
+        time.resize(N);
+        position.resize(N, 3);
+        velocity.resize(N, 3);
+        acceleration.resize(N, 3);
+        jerk.resize(N, 3);
+        snap.resize(N, 3);
+        yaw.resize(N);
+        yaw_rate.resize(N);
+    }
+
+    int size() const { return time.size(); }
+
+    // 位置置为offset，其余量置0，time不变
+    void reset(const Eigen::Vector3f& offset)
+    {
+        for(int j = 0; j < 3; j++)
+        {
+            position.col(j).setConstant(offset[j]);
+        }
+        velocity.setZero();
+        acceleration.setZero();
+        jerk.setZero();
+        snap.setZero();
+        yaw.setZero();
+        yaw_rate.setZero();
+    }
+
+    // 第i个时刻写入_TrajectoryPoint
+    void get_point(int i, px4_command::TrajectoryPoint& _TrajectoryPoint) const
+    {
+        _TrajectoryPoint.time_from_start = time[i];
+        _TrajectoryPoint.Sub_mode = command_to_mavros::XYZ_POS;
+
+        for(int j = 0; j < 3; j++)
+        {
+            _TrajectoryPoint.position_ref[j] = position(i, j);
+            _TrajectoryPoint.velocity_ref[j] = velocity(i, j);
+            _TrajectoryPoint.acceleration_ref[j] = acceleration(i, j);
+            _TrajectoryPoint.jerk_ref[j] = jerk(i, j);
+            _TrajectoryPoint.snap_ref[j] = snap(i, j);
+        }
+
+        _TrajectoryPoint.yaw_ref = yaw[i];
+        _TrajectoryPoint.yaw_rate_ref = yaw_rate[i];
+    }
+};
+
+class parametric_trajectory
+{
+    public:
+
+        parametric_trajectory(void)
+        {
+            single.resize(1);
+        }
+
+        virtual ~parametric_trajectory() {}
+
+        float time_total;                   //轨迹时长，超过后控制器悬停于最后一个参考点 [s]
+
+        // 计算horizon.time中各时刻的参考量（horizon须已resize并填好time）
+        virtual void evaluate(trajectory_horizon& horizon) const = 0;
+
+        // 计算 t0, t0 + dt, ..., t0 + (N-1)dt 共N个时刻
+        void evaluate_horizon(float t0, float dt, int N, trajectory_horizon& horizon) const
+        {
+            horizon.resize(N);
+            horizon.time = t0 + dt * Eigen::ArrayXf::LinSpaced(N, 0.0, N - 1);
+            evaluate(horizon);
+        }
+
+        // 单个时刻 [Input: time_from_start; Output: _TrajectoryPoint (filled in place)]
+        void sample(float time_from_start, px4_command::TrajectoryPoint& _TrajectoryPoint)
+        {
+            single.time[0] = time_from_start;
+            evaluate(single);
+            single.get_point(0, _TrajectoryPoint);
+        }
+
+        //Printf the trajectory parameter
+        virtual void printf_param() = 0;
+
+    protected:
+
+        // 叠加 amplitude * sin(omega * t + phase) 及其1-4阶导数至第axis轴（需先reset；jerk、snap列用作中间量，每轴只能调用一次）
+        static void add_sinusoid(int axis, float amplitude, float omega, float phase, trajectory_horizon& horizon);
+
+    private:
+
+        trajectory_horizon single;          //sample()使用，构造时分配
+};
+
+void parametric_trajectory::add_sinusoid(int axis, float amplitude, float omega, float phase, trajectory_horizon& horizon)
+{
+    if(amplitude == 0.0)
+    {
+        return;
+    }
+
+    const float w2 = omega * omega;
+
+    // 整列时刻一次计算 sin/cos；n阶导数为 A w^n sin(wt + phase + n*pi/2)
+    horizon.snap.col(axis) = (omega * horizon.time + phase).sin();
+    horizon.jerk.col(axis) = (omega * horizon.time + phase).cos();
+
+    horizon.position.col(axis) += amplitude * horizon.snap.col(axis);
+    horizon.velocity.col(axis) += amplitude * omega * horizon.jerk.col(axis);
+    horizon.acceleration.col(axis) -= amplitude * w2 * horizon.snap.col(axis);
+    horizon.snap.col(axis) *= amplitude * w2 * w2;
+    horizon.jerk.col(axis) *= - amplitude * w2 * omega;
+}
+
+#endif
@@ -0,0 +1,230 @@
+/***************************************************************************************************************************
+* polyline_trajectory.h
+*
+* Author: Qyp
+*
+* Update Time: 2019.8.12
+*
+* Introduction:  Polyline trajectory with smooth corner blends
+*         1. 依次飞过航点 Polyline_Trajectory/waypoints ([x0 y0 z0 x1 y1 z1 ...])，各段以linear_vel匀速直线飞行
+*         2. 航点处（含起点、终点）速度在blend_time内由前一段速度平滑过渡至后一段速度，过渡函数为7次smoothstep
+*            S(s) = 35s^4 - 84s^5 + 70s^6 - 20s^7，加速度、jerk、snap均连续；过渡关于航点时刻对称，因此过渡段外与折线完全重合，
+*            拐角处从内侧切过
+*         3. 过渡时间不超过相邻段时长的一半，各过渡区间互不重叠；起点及终点速度为0，轨迹时长由航点及linear_vel确定
+*         4. 查询时二分查找所在段 O(log n)，逐时刻计算
+***************************************************************************************************************************/
+#ifndef POLYLINE_TRAJECTORY_H
+#define POLYLINE_TRAJECTORY_H
+
+#include <ros/ros.h>
+#include <Eigen/Eigen>
+#include <math.h>
+#include <vector>
+#include <algorithm>
+#include <parametric_trajectory.h>
+
+using namespace std;
+
+class Polyline_Trajectory : public parametric_trajectory
+{
+    public:
+
+        //构造函数
+        Polyline_Trajectory(void):
+            Polyline_Trajectory_nh("~")
+        {
+            Polyline_Trajectory_nh.param<float>("Polyline_Trajectory/linear_vel", linear_vel, 0.5);
+            Polyline_Trajectory_nh.param<float>("Polyline_Trajectory/blend_time", blend_time, 1.0);
+
+            vector<double> waypoint_list;
+            if(!Polyline_Trajectory_nh.getParam("Polyline_Trajectory/waypoints", waypoint_list) || waypoint_list.size() < 6)
+            {
+                // 默认为1m x 1m的正方形
+                double square[15] = {0.0,0.0,1.0, 1.0,0.0,1.0, 1.0,1.0,1.0, 0.0,1.0,1.0, 0.0,0.0,1.0};
+                waypoint_list.assign(square, square + 15);
+            }
+
+            vector<Eigen::Vector3f> waypoints;
+            for(unsigned int i = 0; i + 2 < waypoint_list.size(); i = i + 3)
+            {
+                waypoints.push_back(Eigen::Vector3f(waypoint_list[i], waypoint_list[i + 1], waypoint_list[i + 2]));
+            }
+
+            set_waypoints(waypoints);
+        }
+
+        // Parameter
+        float linear_vel;                   // [m/s]
+        float blend_time;                   // 航点处速度过渡时间 [s]
+
+        // 设置航点并计算各航点时刻，time_total随之更新（重复航点被忽略）
+        void set_waypoints(const vector<Eigen::Vector3f>& waypoints);
+
+        void evaluate(trajectory_horizon& horizon) const;
+
+        //Printf the Polyline_Trajectory parameter
+        void printf_param();
+
+    private:
+
+        ros::NodeHandle Polyline_Trajectory_nh;
+
+        vector<Eigen::Vector3f> points;     //航点
+        vector<Eigen::Vector3f> segment_vel;//第k段速度
+        vector<float> knot_time;            //到达第k个航点的时刻（未过渡的折线）
+        vector<float> half_blend;           //第k个航点处过渡时间的一半
+
+        // 第k段速度，k < 0 或 k >= 段数 时为0（起点前及终点后悬停）
+        Eigen::Vector3f get_segment_vel(int k) const;
+};
+
+void Polyline_Trajectory::set_waypoints(const vector<Eigen::Vector3f>& waypoints)
+{
+    points.clear();
+    segment_vel.clear();
+    knot_time.clear();
+    half_blend.clear();
+
+    for(unsigned int i = 0; i < waypoints.size(); i++)
+    {
+        if(points.empty() || (waypoints[i] - points.back()).norm() > 1e-3)
+        {
+            points.push_back(waypoints[i]);
+        }
+    }
+
+    if(points.empty())
+    {
+        points.push_back(Eigen::Vector3f(0.0, 0.0, 1.0));
+    }
+
+    const float vel = max(linear_vel, 0.01f);
+    const int n = points.size() - 1;
+
+    vector<float> segment_T(n);
+    for(int k = 0; k < n; k++)
+    {
+        segment_T[k] = (points[k + 1] - points[k]).norm() / vel;
+        segment_vel.push_back((points[k + 1] - points[k]) / segment_T[k]);
+    }
+
+    // 各航点处过渡时间的一半，不超过相邻段时长的一半
+    for(int k = 0; k <= n; k++)
+    {
+        float h = 0.5 * max(blend_time, 0.0f);
+        if(k > 0) h = min(h, 0.5f * segment_T[k - 1]);
+        if(k < n) h = min(h, 0.5f * segment_T[k]);
+        half_blend.push_back(h);
+    }
+
+    // 起点过渡从t = 0开始
+    knot_time.push_back(half_blend[0]);
+    for(int k = 0; k < n; k++)
+    {
+        knot_time.push_back(knot_time[k] + segment_T[k]);
+    }
+
+    time_total = knot_time[n] + half_blend[n];
+}
+
+Eigen::Vector3f Polyline_Trajectory::get_segment_vel(int k) const
+{
+    if(k < 0 || k >= (int)segment_vel.size())
+    {
+        return Eigen::Vector3f(0.0, 0.0, 0.0);
+    }
+
+    return segment_vel[k];
+}
+
+void Polyline_Trajectory::evaluate(trajectory_horizon& horizon) const
+{
+    const int n = points.size() - 1;
+
+    horizon.reset(Eigen::Vector3f(0.0, 0.0, 0.0));
+
+    for(int i = 0; i < horizon.size(); i++)
+    {
+        const float t = horizon.time[i];
+
+        // 所在段：knot_time[k] <= t < knot_time[k+1]，k取-1至n
+        int k = upper_bound(knot_time.begin(), knot_time.end(), t) - knot_time.begin() - 1;
+
+        // 未过渡的折线
+        Eigen::Vector3f position;
+        if(k < 0)
+        {
+            position = points[0];
+        }else if(k >= n)
+        {
+            position = points[n];
+        }else
+        {
+            position = points[k] + segment_vel[k] * (t - knot_time[k]);
+        }
+        Eigen::Vector3f velocity = get_segment_vel(k);
+        Eigen::Vector3f acceleration(0.0, 0.0, 0.0);
+        Eigen::Vector3f jerk(0.0, 0.0, 0.0);
+        Eigen::Vector3f snap(0.0, 0.0, 0.0);
+
+        // 前后两个航点中处于过渡区间内的一个（过渡区间互不重叠）
+        for(int m = max(k, 0); m <= min(k + 1, n); m++)
+        {
+            const float h = half_blend[m];
+            if(h <= 0 || fabs(t - knot_time[m]) >= h)
+            {
+                continue;
+            }
+
+            const Eigen::Vector3f delta_vel = get_segment_vel(m) - get_segment_vel(m - 1);
+            const float width = 2 * h;
+            const float s = (t - knot_time[m] + h) / width;
+            const float s2 = s * s;
+            const float s3 = s2 * s;
+            const float s4 = s3 * s;
+
+            // S及其积分、各阶导数
+            const float S = s4 * (35 - 84 * s + 70 * s2 - 20 * s3);
+            const float S_int = s4 * s * (7 - 14 * s + 10 * s2 - 2.5 * s3);
+            const float S_d1 = 140 * s3 * (1 - s) * (1 - s) * (1 - s);
+            const float S_d2 = s2 * (420 - 1680 * s + 2100 * s2 - 840 * s3);
+            const float S_d3 = s * (840 - 5040 * s + 8400 * s2 - 4200 * s3);
+
+            // 将折线的速度阶跃H(t - knot_time)替换为S
+            const float step = t >= knot_time[m] ? 1.0 : 0.0;
+
+            position += delta_vel * (width * S_int - step * (t - knot_time[m]));
+            velocity += delta_vel * (S - step);
+            acceleration = delta_vel * S_d1 / width;
+            jerk = delta_vel * S_d2 / (width * width);
+            snap = delta_vel * S_d3 / (width * width * width);
+            break;
+        }
+
+        for(int j = 0; j < 3; j++)
+        {
+            horizon.position(i, j) = position[j];
+            horizon.velocity(i, j) = velocity[j];
+            horizon.acceleration(i, j) = acceleration[j];
+            horizon.jerk(i, j) = jerk[j];
+            horizon.snap(i, j) = snap[j];
+        }
+    }
+}
+
+// 【打印参数函数】
+void Polyline_Trajectory::printf_param()
+{
+    cout <<">>>>>>>>>>>>>>>>>>>>>>>>>>>>>>Polyline_Trajectory Parameter <<<<<<<<<<<<<<<<<<<<<<<<<<<" <<endl;
+
+    cout <<"linear_vel : "<< linear_vel << " [m/s] " <<endl;
+    cout <<"blend_time : "<< blend_time << " [s] " <<endl;
+    cout <<"time_total : "<< time_total << " [s] " <<endl;
+
+    for(unsigned int k = 0; k < points.size(); k++)
+    {
+        cout <<"waypoint " << k << " : "<< points[k].transpose() << " [m]  t = " << knot_time[k] << " [s] " <<endl;
+    }
+}
+
+#endif
@@ -0,0 +1,224 @@
+/***************************************************************************************************************************
+* pos_controller_INDI.h
+*
+* Author: Qyp
+*
+* Update Time: 2019.8.18
+*
+* Introduction:  Position Controller using incremental nonlinear dynamic inversion (INDI)
+*         1. 虚拟控制量：nu = a_ref + Kp e_p + Kv e_v（误差限幅同UDE）
+*         2. 扰动直接由测得的加速度得到：d = LPF(a) - (LPF(A(T/m)) - g e3)，a为DroneState.acceleration(IMU)，
+*            T/m为上一次发出的期望推力加速度（已限幅的矢量），A为执行机构模型（姿态环+电机的一阶近似，Pos_indi/T_actuator），
+*            两者使用相同的低通滤波器（Pos_indi/T_filter），保证时间上对齐
+*         3. 期望加速度 a_sp = nu + g e3 - d，即在上一次推力的基础上增量修正 T_cmd/m = LPF(A(T/m)) + nu - LPF(a)
+*         4. 推力取期望矢量而非当前机体z轴：thrustToThrottle逐分量换算带来的方向偏差、悬停油门误差一并作为扰动消除
+*         5. 扰动估计只有一个滤波器的延迟，不需要积分，对质量、悬停油门误差及外力的响应比UDE/NE快；
+*            代价是对加速度计噪声及振动敏感，T_filter不宜过小
+*         6. 非OFFBOARD模式下推力不由本控制器给出，扰动估计输出为0（滤波器照常运行）
+*         Ref to : Smeur E J J, et al. Cascaded incremental nonlinear dynamic inversion for MAV disturbance rejection. CEP 2018.
+***************************************************************************************************************************/
+#ifndef POS_CONTROLLER_INDI_H
+#define POS_CONTROLLER_INDI_H
+
+#include <Eigen/Eigen>
+#include <math.h>
+#include <command_to_mavros.h>
+#include <px4_command_utils.h>
+#include <math_utils.h>
+#include <LowPassFilter.h>
+
+#include <px4_command/DroneState.h>
+#include <px4_command/TrajectoryPoint.h>
+#include <px4_command/AttitudeReference.h>
+#include <px4_command/ControlOutput.h>
+#include <pos_controller_base.h>
+
+using namespace std;
+
+class pos_controller_INDI : public pos_controller_base
+{
+     //public表明该数据成员、成员函数是对全部用户开放的。全部用户都能够直接进行调用，在程序的不论什么其他地方訪问。
+    public:
+
+        //构造函数
+        pos_controller_INDI(void):
+            pos_INDI_nh("~")
+        {
+            pos_INDI_nh.param<float>("Quad/mass", Quad_MASS, 1.0);
+
+            pos_INDI_nh.param<float>("Pos_indi/Kp_xy", Kp[0], 2.0);
+            pos_INDI_nh.param<float>("Pos_indi/Kp_xy", Kp[1], 2.0);
+            pos_INDI_nh.param<float>("Pos_indi/Kp_z", Kp[2], 2.0);
+            pos_INDI_nh.param<float>("Pos_indi/Kv_xy", Kv[0], 3.0);
+            pos_INDI_nh.param<float>("Pos_indi/Kv_xy", Kv[1], 3.0);
+            pos_INDI_nh.param<float>("Pos_indi/Kv_z", Kv[2], 3.0);
+            pos_INDI_nh.param<float>("Pos_indi/T_filter", T_filter, 0.05);
+            pos_INDI_nh.param<float>("Pos_indi/T_actuator", T_actuator, 0.05);
+            pos_INDI_nh.param<float>("Pos_indi/dist_max_xy", dist_max[0], 3.0);
+            pos_INDI_nh.param<float>("Pos_indi/dist_max_xy", dist_max[1], 3.0);
+            pos_INDI_nh.param<float>("Pos_indi/dist_max_z", dist_max[2], 3.0);
+
+            pos_INDI_nh.param<float>("Limit/pxy_error_max", pos_error_max[0], 0.6);
+            pos_INDI_nh.param<float>("Limit/pxy_error_max", pos_error_max[1], 0.6);
+            pos_INDI_nh.param<float>("Limit/pz_error_max" , pos_error_max[2], 1.0);
+            pos_INDI_nh.param<float>("Limit/vxy_error_max", vel_error_max[0], 0.3);
+            pos_INDI_nh.param<float>("Limit/vxy_error_max", vel_error_max[1], 0.3);
+            pos_INDI_nh.param<float>("Limit/vz_error_max" , vel_error_max[2], 1.0);
+            pos_INDI_nh.param<float>("Limit/tilt_max", tilt_max, 20.0);
+
+            for(int i = 0; i < 3; i++)
+            {
+                LPF_accel[i].set_Time_constant(T_filter);
+                LPF_thrust[i].set_Time_constant(T_filter);
+                actuator[i].set_Time_constant(T_actuator);
+            }
+
+            u_l         = Eigen::Vector3f(0.0,0.0,0.0);
+            disturbance = Eigen::Vector3f(0.0,0.0,0.0);
+
+            // 初始为悬停推力
+            thrust_accel_last = Eigen::Vector3d(0.0,0.0,9.8);
+        }
+
+        //Quadrotor Parameter
+        float Quad_MASS;
+
+        //INDI control parameter
+        Eigen::Vector3f Kp;
+        Eigen::Vector3f Kv;
+        float T_filter;                         //加速度及推力滤波时间常数 [s]
+        float T_actuator;                       //期望推力至实际推力的时间常数 [s]
+        Eigen::Vector3f dist_max;               //扰动估计限幅 [m/s^2]
+
+        //Limitation
+        Eigen::Vector3f pos_error_max;
+        Eigen::Vector3f vel_error_max;
+        float tilt_max;
+
+        //u_l for nominal contorol(PD), disturbance for INDI estimate
+        Eigen::Vector3f u_l, disturbance;
+
+        //Printf the INDI parameter
+        void printf_param();
+
+        //Printf the control result
+        void printf_result();
+
+        // Position control main function
+        // [Input: Current state, Reference state, _Reference_State.Sub_mode, dt; Output: ControlOutput (filled in place);]
+        void pos_controller(const px4_command::DroneState& _DroneState, const px4_command::TrajectoryPoint& _Reference_State, float dt, px4_command::ControlOutput& _ControlOutput);
+
+        // 在线估计的有效质量（thrust_estimator.h），用于accelToThrust；悬停油门已由thrustToThrottle的电机曲线决定，不使用
+        void set_thrust_model(float mass, float /*hover_throttle*/) { Quad_MASS = mass; }
+
+    private:
+
+        ros::NodeHandle pos_INDI_nh;
+
+        LowPassFilter LPF_accel[3];
+        LowPassFilter LPF_thrust[3];
+        LowPassFilter actuator[3];
+
+        //上一次发出的期望推力加速度（已限幅） [m/s^2]
+        Eigen::Vector3d thrust_accel_last;
+};
+
+void pos_controller_INDI::pos_controller(
+    const px4_command::DroneState& _DroneState,
+    const px4_command::TrajectoryPoint& _Reference_State, float dt, px4_command::ControlOutput& _ControlOutput)
+{
+    Eigen::Vector3f pos_error = px4_command_utils::cal_pos_error(_DroneState, _Reference_State);
+    Eigen::Vector3f vel_error = px4_command_utils::cal_vel_error(_DroneState, _Reference_State);
+
+    bool offboard = _DroneState.flight_mode == px4_command::DroneState::MODE_OFFBOARD;
+
+    Eigen::Vector3d accel_sp;
+    for (int i=0; i<3; i++)
+    {
+        pos_error[i] = constrain_function(pos_error[i], pos_error_max[i]);
+        vel_error[i] = constrain_function(vel_error[i], vel_error_max[i]);
+
+        u_l[i] = _Reference_State.acceleration_ref[i] + Kp[i] * pos_error[i] + Kv[i] * vel_error[i];
+
+        float gravity = i == 2 ? 9.8 : 0.0;
+        // 非OFFBOARD时推力不由本控制器给出，以测得的加速度代替，使扰动估计为0
+        float thrust_input = offboard ? thrust_accel_last[i] : _DroneState.acceleration[i] + gravity;
+        thrust_input = actuator[i].apply(thrust_input, dt);
+
+        float accel_filtered = LPF_accel[i].apply(_DroneState.acceleration[i], dt);
+        float thrust_filtered = LPF_thrust[i].apply(thrust_input, dt);
+
+        disturbance[i] = constrain_function(accel_filtered - (thrust_filtered - gravity), dist_max[i]);
+
+        if(!offboard)
+        {
+            disturbance[i] = 0;
+        }
+
+        accel_sp[i] = u_l[i] - disturbance[i] + gravity;
+    }
+
+    // 期望推力 = 期望加速度 × 质量
+    // 归一化推力 ： 根据电机模型，反解出归一化推力
+    Eigen::Vector3d thrust_sp;
+    Eigen::Vector3d throttle_sp;
+    thrust_sp =  px4_command_utils::accelToThrust(accel_sp, Quad_MASS, tilt_max);
+    throttle_sp = px4_command_utils::thrustToThrottle(thrust_sp);
+
+    // 限幅后发出的推力加速度
+    thrust_accel_last = thrust_sp * NUM_MOTOR / Quad_MASS;
+
+    for (int i=0; i<3; i++)
+    {
+        _ControlOutput.u_l[i] = u_l[i];
+        _ControlOutput.u_d[i] = - disturbance[i];
+        _ControlOutput.Thrust[i] = thrust_sp[i];
+        _ControlOutput.Throttle[i] = throttle_sp[i];
+    }
+}
+
+void pos_controller_INDI::printf_result()
+{
+    cout <<">>>>>>>>>>>>>>>>>>>>>>  INDI Position Controller  <<<<<<<<<<<<<<<<<<<<<<" <<endl;
+
+    //固定的浮点显示
+    cout.setf(ios::fixed);
+    //左对齐
+    cout.setf(ios::left);
+    // 强制显示小数点
+    cout.setf(ios::showpoint);
+    // 强制显示符号
+    cout.setf(ios::showpos);
+
+    cout<<setprecision(2);
+
+    cout << "u_l [X Y Z] : " << u_l[0] << " [m/s^2] "<< u_l[1]<<" [m/s^2] "<<u_l[2]<<" [m/s^2] "<<endl;
+    cout << "disturbance [X Y Z] : " << disturbance[0] << " [m/s^2] "<< disturbance[1]<<" [m/s^2] "<<disturbance[2]<<" [m/s^2] "<<endl;
+}
+
+// 【打印参数函数】
+void pos_controller_INDI::printf_param()
+{
+    cout <<">>>>>>>>>>>>>>>>>>>>>>>>>>INDI Parameter <<<<<<<<<<<<<<<<<<<<<<<<<" <<endl;
+    cout <<"Quad_MASS : "<< Quad_MASS << endl;
+
+    cout <<"Kp_x : "<< Kp[0] << endl;
+    cout <<"Kp_y : "<< Kp[1] << endl;
+    cout <<"Kp_z : "<< Kp[2] << endl;
+
+    cout <<"Kv_x : "<< Kv[0] << endl;
+    cout <<"Kv_y : "<< Kv[1] << endl;
+    cout <<"Kv_z : "<< Kv[2] << endl;
+
+    cout <<"T_filter : "<< T_filter << " [s]  T_actuator : "<< T_actuator << " [s] " << endl;
+    cout <<"dist_max_xy : "<< dist_max[0] << "  dist_max_z : "<< dist_max[2] << " [m/s^2] " << endl;
+
+    cout <<"Limit:  " <<endl;
+    cout <<"pxy_error_max : "<< pos_error_max[0] << endl;
+    cout <<"pz_error_max :  "<< pos_error_max[2] << endl;
+    cout <<"vxy_error_max : "<< vel_error_max[0] << endl;
+    cout <<"vz_error_max :  "<< vel_error_max[2] << endl;
+    cout <<"tilt_max : "<< tilt_max << endl;
+}
+
+#endif
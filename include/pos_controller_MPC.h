@@ -0,0 +1,536 @@
+/***************************************************************************************************************************
+* pos_controller_MPC.h
+*
+* Author: Qyp
+*
+* Update Time: 2019.8.16
+*
+* Introduction:  Position Controller using linear MPC
+*         1. 模型：各轴独立的双积分器 p' = v, v' = a，采样周期Pos_mpc/dt，预测步数MPC_HORIZON，输入为期望加速度(不含重力)
+*         2. 压缩(condensed)形式：消去状态后只以N步加速度为优化变量(3N维)，代价为位置、速度跟踪误差及与参考加速度之差的二次型
+*            终端代价取同一权重下无约束LQR的离散Riccati解P_f：时域(N*dt)短于倾斜角受限时的刹车时间时，仍按无限时域计入末状态误差，
+*            否则小tilt_max下会加速至无法刹停而发散
+*         3. 约束：倾斜角 |a_xy| ≤ tan(tilt_max)(g + a_z) 用内接正八边形线性化（与accelToThrust的限幅一致），|a_z| ≤ Pos_mpc/acc_z_max
+*         4. 求解：ADMM（同OSQP），KKT矩阵只与参数有关，构造时一次Cholesky分解；每次求解以上一次的解平移一步作为初值(warm start)，
+*            迭代次数及耗时均有上限(Pos_mpc/max_iter, Pos_mpc/max_time)，超时返回当前迭代值（始终满足约束的投影值）
+*         5. 矩阵均为固定维数，控制步中不分配内存
+*         6. 预测时域内的参考量由当前参考点的位置至jerk按泰勒展开外推
+*         7. 位置误差积分补偿模型误差（质量、悬停油门）：积分项d = Ki*int与模型误差相抵，预测模型不变，
+*            但d计入QP约束（发出的加速度u + d满足约束），并限幅于Pos_mpc/int_ratio倍的水平（tan(tilt_max)*g）及垂直(acc_z_max)加速度能力，
+*            为位置控制保留余量
+*         8. 输出与其他控制律相同的ControlOutput，后续ThrottleToAttitude不变
+***************************************************************************************************************************/
+#ifndef POS_CONTROLLER_MPC_H
+#define POS_CONTROLLER_MPC_H
+
+#include <Eigen/Eigen>
+#include <math.h>
+#include <time.h>
+#include <command_to_mavros.h>
+#include <px4_command_utils.h>
+#include <math_utils.h>
+
+#include <px4_command/DroneState.h>
+#include <px4_command/TrajectoryPoint.h>
+#include <px4_command/AttitudeReference.h>
+#include <px4_command/ControlOutput.h>
+#include <pos_controller_base.h>
+
+using namespace std;
+
+// 预测步数、优化变量维数、每步约束数（8条倾斜角约束 + 1条垂直加速度约束）
+#define MPC_HORIZON 10
+#define MPC_VAR_NUM (3 * MPC_HORIZON)
+#define MPC_STEP_CONSTRAINT_NUM 9
+
+class pos_controller_MPC : public pos_controller_base
+{
+     //public表明该数据成员、成员函数是对全部用户开放的。全部用户都能够直接进行调用，在程序的不论什么其他地方訪问。
+    public:
+
+        // 含固定维数可向量化的Eigen成员，由pos_controller_registry在堆上创建，C++11下需对齐的operator new
+        EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+
+        //构造函数
+        pos_controller_MPC(void):
+            pos_MPC_nh("~")
+        {
+            pos_MPC_nh.param<float>("Quad/mass", Quad_MASS, 1.0);
+
+            pos_MPC_nh.param<float>("Pos_mpc/dt", mpc_dt, 0.1);
+            pos_MPC_nh.param<float>("Pos_mpc/Q_pos_xy", Q_pos[0], 10.0);
+            pos_MPC_nh.param<float>("Pos_mpc/Q_pos_xy", Q_pos[1], 10.0);
+            pos_MPC_nh.param<float>("Pos_mpc/Q_pos_z", Q_pos[2], 10.0);
+            pos_MPC_nh.param<float>("Pos_mpc/Q_vel_xy", Q_vel[0], 2.0);
+            pos_MPC_nh.param<float>("Pos_mpc/Q_vel_xy", Q_vel[1], 2.0);
+            pos_MPC_nh.param<float>("Pos_mpc/Q_vel_z", Q_vel[2], 2.0);
+            pos_MPC_nh.param<float>("Pos_mpc/R_xy", R_acc[0], 0.5);
+            pos_MPC_nh.param<float>("Pos_mpc/R_xy", R_acc[1], 0.5);
+            pos_MPC_nh.param<float>("Pos_mpc/R_z", R_acc[2], 0.5);
+            pos_MPC_nh.param<float>("Pos_mpc/Ki_xy", Ki[0], 1.0);
+            pos_MPC_nh.param<float>("Pos_mpc/Ki_xy", Ki[1], 1.0);
+            pos_MPC_nh.param<float>("Pos_mpc/Ki_z", Ki[2], 1.0);
+            pos_MPC_nh.param<float>("Pos_mpc/acc_z_max", acc_z_max, 3.0);
+            pos_MPC_nh.param<float>("Pos_mpc/int_ratio", int_ratio, 0.5);
+            pos_MPC_nh.param<float>("Pos_mpc/rho", rho, 1.0);
+            pos_MPC_nh.param<int>("Pos_mpc/max_iter", max_iter, 50);
+            pos_MPC_nh.param<float>("Pos_mpc/max_time", max_time, 0.5);
+            pos_MPC_nh.param<float>("Pos_mpc/eps", eps, 1e-3);
+
+            pos_MPC_nh.param<float>("Limit/pxy_int_max"  , int_max[0], 0.5);
+            pos_MPC_nh.param<float>("Limit/pxy_int_max"  , int_max[1], 0.5);
+            pos_MPC_nh.param<float>("Limit/pz_int_max"   , int_max[2], 0.5);
+            pos_MPC_nh.param<float>("Limit/tilt_max", tilt_max, 20.0);
+            pos_MPC_nh.param<float>("Limit/int_start_error"  , int_start_error, 0.3);
+
+            integral = Eigen::Vector3f(0.0,0.0,0.0);
+            accel_int = Eigen::Vector3d(0.0,0.0,0.0);
+            u_mpc = Eigen::Vector3d(0.0,0.0,0.0);
+
+            iterations = 0;
+            solve_time = 0.0;
+            converged = false;
+
+            setup();
+        }
+
+        //Quadrotor Parameter
+        float Quad_MASS;
+
+        //MPC parameter
+        float mpc_dt;                           //预测模型采样周期 [s]
+        Eigen::Vector3f Q_pos;
+        Eigen::Vector3f Q_vel;
+        Eigen::Vector3f R_acc;
+        Eigen::Vector3f Ki;
+
+        //Solver parameter
+        float rho;                              //ADMM罚参数
+        int max_iter;                           //最大迭代次数
+        float max_time;                         //单次求解耗时上限 [ms]
+        float eps;                              //收敛判据（原始、对偶残差的无穷范数）
+
+        //Limitation
+        Eigen::Vector3f int_max;
+        float tilt_max;
+        float acc_z_max;                        // [m/s^2]
+        float int_ratio;                        //积分项占加速度能力的上限比例
+        float int_start_error;
+
+        Eigen::Vector3f integral;
+        Eigen::Vector3d accel_int;              //积分项 Ki*int（限幅后），QP中的加速度偏置 [m/s^2]
+
+        //最近一次求解结果
+        Eigen::Vector3d u_mpc;                  //第一步期望加速度(不含重力) [m/s^2]
+        int iterations;
+        float solve_time;                       // [ms]
+        bool converged;
+
+        //Printf the MPC parameter
+        void printf_param();
+
+        //Printf the control result
+        void printf_result();
+
+        // Position control main function
+        // [Input: Current state, Reference state, _Reference_State.Sub_mode, dt; Output: ControlOutput (filled in place);]
+        void pos_controller(const px4_command::DroneState& _DroneState, const px4_command::TrajectoryPoint& _Reference_State, float dt, px4_command::ControlOutput& _ControlOutput);
+
+        // 在线估计的有效质量（thrust_estimator.h），用于accelToThrust；悬停油门已由thrustToThrottle的电机曲线决定，不使用
+        void set_thrust_model(float mass, float /*hover_throttle*/) { Quad_MASS = mass; }
+
+        // 构造预测矩阵、约束及KKT分解，构造函数中已调用；修改权重、mpc_dt、rho或约束后需重新调用
+        void setup();
+
+    private:
+
+        ros::NodeHandle pos_MPC_nh;
+
+        typedef Eigen::Matrix<double, MPC_VAR_NUM, 1> Vector_var;
+        typedef Eigen::Matrix<double, MPC_STEP_CONSTRAINT_NUM * MPC_HORIZON, 1> Vector_con;
+
+        // 单轴预测矩阵：第k+1步位置、速度对初始状态及各步输入的系数
+        Eigen::Matrix<double, MPC_HORIZON, 2> S_pos_x;
+        Eigen::Matrix<double, MPC_HORIZON, 2> S_vel_x;
+        Eigen::Matrix<double, MPC_HORIZON, MPC_HORIZON> S_pos_u;
+        Eigen::Matrix<double, MPC_HORIZON, MPC_HORIZON> S_vel_u;
+        Eigen::Matrix<double, 2, MPC_HORIZON> S_end_u;                  //末状态（位置、速度）对各步输入的系数
+
+        // 终端代价 x_N' W x_N 的附加权重 W = P_f - diag(Q_pos, Q_vel)（末状态已计入一次阶段代价）
+        Eigen::Matrix2d W_terminal[3];
+
+        // 代价 0.5 U'PU + q'U，变量按 [u_0x u_0y u_0z u_1x ...] 排列
+        Eigen::Matrix<double, MPC_VAR_NUM, MPC_VAR_NUM> P;
+        Vector_var q;
+
+        // 每步约束 l ≤ A_step u_k ≤ u（各步相同）
+        Eigen::Matrix<double, MPC_STEP_CONSTRAINT_NUM, 3> A_step;
+        Eigen::Matrix<double, MPC_STEP_CONSTRAINT_NUM, 1> l_step;
+        Eigen::Matrix<double, MPC_STEP_CONSTRAINT_NUM, 1> u_step;
+
+        // 计入积分偏置后的约束 l - A_step d ≤ A_step u_k ≤ u - A_step d，每次求解前更新（不影响KKT分解）
+        Eigen::Matrix<double, MPC_STEP_CONSTRAINT_NUM, 1> l_shift;
+        Eigen::Matrix<double, MPC_STEP_CONSTRAINT_NUM, 1> u_shift;
+
+        // (P + sigma I + rho A'A) 的Cholesky分解
+        Eigen::LLT< Eigen::Matrix<double, MPC_VAR_NUM, MPC_VAR_NUM> > kkt;
+
+        // ADMM变量，保留用于warm start
+        Vector_var x_admm;
+        Vector_con z_admm;
+        Vector_con y_admm;
+
+        // z = A x
+        void multiply_A(const Vector_var& x, Vector_con& z) const;
+
+        // x = A' z
+        void multiply_At(const Vector_con& z, Vector_var& x) const;
+
+        // ADMM求解，结果在x_admm中
+        void solve();
+};
+
+void pos_controller_MPC::setup()
+{
+    const double h = mpc_dt;
+
+    // 双积分器 s_{k+1} = [1 h; 0 1] s_k + [h²/2; h] u_k
+    S_pos_u.setZero();
+    S_vel_u.setZero();
+    for(int k = 0; k < MPC_HORIZON; k++)
+    {
+        S_pos_x(k, 0) = 1.0;
+        S_pos_x(k, 1) = (k + 1) * h;
+        S_vel_x(k, 0) = 0.0;
+        S_vel_x(k, 1) = 1.0;
+
+        for(int j = 0; j <= k; j++)
+        {
+            S_pos_u(k, j) = (k - j + 0.5) * h * h;
+            S_vel_u(k, j) = h;
+        }
+    }
+
+    // 终端代价：迭代离散Riccati方程至收敛（双积分器可控，Q_pos > 0时收敛）
+    Eigen::Matrix2d A_d;
+    A_d << 1.0, h, 0.0, 1.0;
+    Eigen::Vector2d B_d(0.5 * h * h, h);
+    for(int axis = 0; axis < 3; axis++)
+    {
+        Eigen::Matrix2d Q_d = Eigen::Vector2d(Q_pos[axis], Q_vel[axis]).asDiagonal();
+        Eigen::Matrix2d P_f = Q_d;
+        for(int i = 0; i < 1000; i++)
+        {
+            Eigen::Vector2d PB = P_f * B_d;
+            Eigen::Matrix2d P_next = Q_d + A_d.transpose() * (P_f - PB * PB.transpose() / (R_acc[axis] + B_d.dot(PB))) * A_d;
+            double change = (P_next - P_f).lpNorm<Eigen::Infinity>();
+            P_f = P_next;
+            if(change < 1e-9 * P_f.lpNorm<Eigen::Infinity>())
+            {
+                break;
+            }
+        }
+        W_terminal[axis] = P_f - Q_d;
+    }
+
+    S_end_u.row(0) = S_pos_u.row(MPC_HORIZON - 1);
+    S_end_u.row(1) = S_vel_u.row(MPC_HORIZON - 1);
+
+    // Hessian（各轴独立）
+    P.setZero();
+    for(int axis = 0; axis < 3; axis++)
+    {
+        Eigen::Matrix<double, MPC_HORIZON, MPC_HORIZON> H = Q_pos[axis] * S_pos_u.transpose() * S_pos_u
+                                                          + Q_vel[axis] * S_vel_u.transpose() * S_vel_u
+                                                          + S_end_u.transpose() * W_terminal[axis] * S_end_u;
+        H.diagonal().array() += R_acc[axis];
+
+        for(int k = 0; k < MPC_HORIZON; k++)
+        {
+            for(int j = 0; j < MPC_HORIZON; j++)
+            {
+                P(3 * k + axis, 3 * j + axis) = H(k, j);
+            }
+        }
+    }
+
+    // 倾斜角约束：内接正八边形 n_j·a_xy ≤ tan(tilt_max) cos(pi/8) (g + a_z)
+    const double tan_tilt = tan(tilt_max / 180.0 * M_PI) * cos(M_PI / 8);
+    for(int j = 0; j < 8; j++)
+    {
+        A_step(j, 0) = cos(j * M_PI / 4);
+        A_step(j, 1) = sin(j * M_PI / 4);
+        A_step(j, 2) = - tan_tilt;
+        l_step[j] = -1e9;
+        u_step[j] = tan_tilt * 9.8;
+    }
+    A_step(8, 0) = 0.0;
+    A_step(8, 1) = 0.0;
+    A_step(8, 2) = 1.0;
+    l_step[8] = - acc_z_max;
+    u_step[8] = acc_z_max;
+
+    l_shift = l_step;
+    u_shift = u_step;
+
+    // KKT = P + sigma I + rho A'A，A为块对角
+    const double sigma = 1e-6;
+    Eigen::Matrix<double, MPC_VAR_NUM, MPC_VAR_NUM> KKT = P;
+    KKT.diagonal().array() += sigma;
+    Eigen::Matrix3d AtA = rho * A_step.transpose() * A_step;
+    for(int k = 0; k < MPC_HORIZON; k++)
+    {
+        KKT.block<3,3>(3 * k, 3 * k) += AtA;
+    }
+    kkt.compute(KKT);
+
+    x_admm.setZero();
+    z_admm.setZero();
+    y_admm.setZero();
+}
+
+void pos_controller_MPC::multiply_A(const Vector_var& x, Vector_con& z) const
+{
+    for(int k = 0; k < MPC_HORIZON; k++)
+    {
+        z.segment<MPC_STEP_CONSTRAINT_NUM>(MPC_STEP_CONSTRAINT_NUM * k) = A_step * x.segment<3>(3 * k);
+    }
+}
+
+void pos_controller_MPC::multiply_At(const Vector_con& z, Vector_var& x) const
+{
+    for(int k = 0; k < MPC_HORIZON; k++)
+    {
+        x.segment<3>(3 * k) = A_step.transpose() * z.segment<MPC_STEP_CONSTRAINT_NUM>(MPC_STEP_CONSTRAINT_NUM * k);
+    }
+}
+
+void pos_controller_MPC::solve()
+{
+    const double sigma = 1e-6;
+    const double alpha = 1.6;               //over-relaxation
+
+    struct timespec time_begin, time_now;
+    clock_gettime(CLOCK_MONOTONIC, &time_begin);
+
+    Vector_var rhs, x_tilde, Aty;
+    Vector_con z_tilde, z_prev, Ax;
+
+    converged = false;
+
+    for(iterations = 1; iterations <= max_iter; iterations++)
+    {
+        // x_tilde = KKT^-1 (sigma x - q + A'(rho z - y))
+        multiply_At(rho * z_admm - y_admm, rhs);
+        rhs = rhs + sigma * x_admm - q;
+        x_tilde = kkt.solve(rhs);
+
+        multiply_A(x_tilde, z_tilde);
+
+        x_admm = alpha * x_tilde + (1.0 - alpha) * x_admm;
+        z_tilde = alpha * z_tilde + (1.0 - alpha) * z_admm;
+
+        // 投影至 [l, u]
+        z_prev = z_admm;
+        for(int k = 0; k < MPC_HORIZON; k++)
+        {
+            for(int j = 0; j < MPC_STEP_CONSTRAINT_NUM; j++)
+            {
+                int row = MPC_STEP_CONSTRAINT_NUM * k + j;
+                z_admm[row] = min(max(z_tilde[row] + y_admm[row] / rho, l_shift[j]), u_shift[j]);
+            }
+        }
+
+        y_admm = y_admm + rho * (z_tilde - z_admm);
+
+        // 每5次检查收敛及耗时
+        if(iterations % 5 == 0)
+        {
+            multiply_A(x_admm, Ax);
+            multiply_At(y_admm, Aty);
+
+            double primal_residual = (Ax - z_admm).lpNorm<Eigen::Infinity>();
+            double dual_residual = (P * x_admm + q + Aty).lpNorm<Eigen::Infinity>();
+
+            if(primal_residual < eps && dual_residual < eps)
+            {
+                converged = true;
+                break;
+            }
+
+            clock_gettime(CLOCK_MONOTONIC, &time_now);
+            if((time_now.tv_sec - time_begin.tv_sec) * 1e3 + (time_now.tv_nsec - time_begin.tv_nsec) * 1e-6 > max_time)
+            {
+                break;
+            }
+        }
+    }
+
+    iterations = min(iterations, max_iter);
+
+    clock_gettime(CLOCK_MONOTONIC, &time_now);
+    solve_time = (time_now.tv_sec - time_begin.tv_sec) * 1e3 + (time_now.tv_nsec - time_begin.tv_nsec) * 1e-6;
+}
+
+void pos_controller_MPC::pos_controller(
+    const px4_command::DroneState& _DroneState,
+    const px4_command::TrajectoryPoint& _Reference_State, float dt, px4_command::ControlOutput& _ControlOutput)
+{
+    // 位置误差积分
+    Eigen::Vector3f pos_error = px4_command_utils::cal_pos_error(_DroneState, _Reference_State);
+    for (int i=0; i<3; i++)
+    {
+        if(abs(pos_error[i]) < int_start_error)
+        {
+            integral[i] += pos_error[i] * dt;
+        }else
+        {
+            integral[i] = 0;
+        }
+
+        if(_DroneState.flight_mode != px4_command::DroneState::MODE_OFFBOARD)
+        {
+            integral[i] = 0;
+        }
+
+        integral[i] = constrain_function(integral[i], int_max[i]);
+    }
+
+    // 积分偏置限幅于加速度能力的int_ratio倍，超出部分不再累积（抗饱和）
+    const double acc_xy_max = tan(tilt_max / 180.0 * M_PI) * cos(M_PI / 8) * 9.8;
+    const double accel_int_max[3] = {int_ratio * acc_xy_max, int_ratio * acc_xy_max, int_ratio * acc_z_max};
+    for (int i=0; i<3; i++)
+    {
+        if(Ki[i] > 0.0 && abs(Ki[i] * integral[i]) > accel_int_max[i])
+        {
+            integral[i] = constrain_function(integral[i], accel_int_max[i] / Ki[i]);
+        }
+        accel_int[i] = Ki[i] * integral[i];
+    }
+
+    // 发出的加速度 u + d 满足约束
+    Eigen::Matrix<double, MPC_STEP_CONSTRAINT_NUM, 1> con_int = A_step * accel_int;
+    l_shift = l_step - con_int;
+    u_shift = u_step - con_int;
+
+    // 线性项 q，参考量由当前参考点泰勒展开外推
+    for(int axis = 0; axis < 3; axis++)
+    {
+        Eigen::Vector2d state(_DroneState.position[axis], _DroneState.velocity[axis]);
+
+        Eigen::Matrix<double, MPC_HORIZON, 1> pos_ref, vel_ref, acc_ref;
+        for(int k = 0; k < MPC_HORIZON; k++)
+        {
+            double t = (k + 1) * mpc_dt;
+            double t_u = k * mpc_dt;
+
+            pos_ref[k] = _Reference_State.position_ref[axis] + _Reference_State.velocity_ref[axis] * t
+                       + 0.5 * _Reference_State.acceleration_ref[axis] * t * t + _Reference_State.jerk_ref[axis] * t * t * t / 6.0;
+            vel_ref[k] = _Reference_State.velocity_ref[axis] + _Reference_State.acceleration_ref[axis] * t
+                       + 0.5 * _Reference_State.jerk_ref[axis] * t * t;
+            acc_ref[k] = _Reference_State.acceleration_ref[axis] + _Reference_State.jerk_ref[axis] * t_u;
+        }
+
+        // 速度追踪子模式(Sub_mode 对应位为1)：位置误差不计入代价
+        float q_pos = Q_pos[axis];
+        int sub_mode_bit = axis < 2 ? 0b10 : 0b01;
+        if((_Reference_State.Sub_mode & sub_mode_bit) != 0)
+        {
+            q_pos = 0.0;
+        }
+
+        Eigen::Matrix<double, MPC_HORIZON, 1> pos_free = S_pos_x * state - pos_ref;
+        Eigen::Matrix<double, MPC_HORIZON, 1> vel_free = S_vel_x * state - vel_ref;
+
+        // 末状态误差，速度追踪子模式下位置分量取0
+        Eigen::Vector2d end_free(q_pos > 0.0 ? pos_free[MPC_HORIZON - 1] : 0.0, vel_free[MPC_HORIZON - 1]);
+
+        Eigen::Matrix<double, MPC_HORIZON, 1> q_axis = q_pos * S_pos_u.transpose() * pos_free
+                                                     + Q_vel[axis] * S_vel_u.transpose() * vel_free
+                                                     + S_end_u.transpose() * (W_terminal[axis] * end_free)
+                                                     - R_acc[axis] * acc_ref;
+
+        for(int k = 0; k < MPC_HORIZON; k++)
+        {
+            q[3 * k + axis] = q_axis[k];
+        }
+    }
+
+    // warm start：上一次的解平移一步
+    for(int k = 0; k + 1 < MPC_HORIZON; k++)
+    {
+        x_admm.segment<3>(3 * k) = x_admm.segment<3>(3 * k + 3);
+        z_admm.segment<MPC_STEP_CONSTRAINT_NUM>(MPC_STEP_CONSTRAINT_NUM * k) = z_admm.segment<MPC_STEP_CONSTRAINT_NUM>(MPC_STEP_CONSTRAINT_NUM * k + MPC_STEP_CONSTRAINT_NUM);
+        y_admm.segment<MPC_STEP_CONSTRAINT_NUM>(MPC_STEP_CONSTRAINT_NUM * k) = y_admm.segment<MPC_STEP_CONSTRAINT_NUM>(MPC_STEP_CONSTRAINT_NUM * k + MPC_STEP_CONSTRAINT_NUM);
+    }
+
+    solve();
+
+    // 第一步输入；未收敛时的微小约束违反由accelToThrust的倾斜角限幅兜底
+    u_mpc = x_admm.segment<3>(0);
+
+    // 期望加速度
+    Eigen::Vector3d accel_sp;
+    accel_sp[0] = u_mpc[0] + accel_int[0];
+    accel_sp[1] = u_mpc[1] + accel_int[1];
+    accel_sp[2] = u_mpc[2] + accel_int[2] + 9.8;
+
+    // 期望推力 = 期望加速度 × 质量
+    // 归一化推力 ： 根据电机模型，反解出归一化推力
+    Eigen::Vector3d thrust_sp;
+    Eigen::Vector3d throttle_sp;
+    thrust_sp =  px4_command_utils::accelToThrust(accel_sp, Quad_MASS, tilt_max);
+    throttle_sp = px4_command_utils::thrustToThrottle(thrust_sp);
+
+    for (int i=0; i<3; i++)
+    {
+        _ControlOutput.u_l[i] = u_mpc[i];
+        _ControlOutput.u_d[i] = accel_int[i];
+        _ControlOutput.Thrust[i] = thrust_sp[i];
+        _ControlOutput.Throttle[i] = throttle_sp[i];
+    }
+}
+
+void pos_controller_MPC::printf_result()
+{
+    cout <<">>>>>>>>>>>>>>>>>>>>>>  MPC Position Controller  <<<<<<<<<<<<<<<<<<<<<<" <<endl;
+
+    //固定的浮点显示
+    cout.setf(ios::fixed);
+    //左对齐
+    cout.setf(ios::left);
+    // 强制显示小数点
+    cout.setf(ios::showpoint);
+    // 强制显示符号
+    cout.setf(ios::showpos);
+
+    cout<<setprecision(2);
+
+    cout << "u_mpc [X Y Z] : " << u_mpc[0] << " [m/s^2] "<< u_mpc[1]<<" [m/s^2] "<<u_mpc[2]<<" [m/s^2] "<<endl;
+    cout << "int [X Y Z] : " << integral[0] << " [m*s] "<< integral[1]<<" [m*s] "<<integral[2]<<" [m*s] "<<endl;
+    cout << "iterations : " << iterations << "  solve_time : " << solve_time << " [ms] " << (converged ? "converged" : "not converged") <<endl;
+}
+
+// 【打印参数函数】
+void pos_controller_MPC::printf_param()
+{
+    cout <<">>>>>>>>>>>>>>>>>>>>>>>>>>MPC Parameter <<<<<<<<<<<<<<<<<<<<<<<<<" <<endl;
+    cout <<"Quad_MASS : "<< Quad_MASS << endl;
+
+    cout <<"horizon : "<< MPC_HORIZON << "  dt : "<< mpc_dt << " [s] " << endl;
+    cout <<"Q_pos : "<< Q_pos.transpose() << endl;
+    cout <<"Q_vel : "<< Q_vel.transpose() << endl;
+    cout <<"R_acc : "<< R_acc.transpose() << endl;
+    cout <<"Ki : "<< Ki.transpose() << endl;
+    cout <<"rho : "<< rho << "  max_iter : "<< max_iter << "  max_time : "<< max_time << " [ms]  eps : "<< eps << endl;
+
+    cout <<"Limit:  " <<endl;
+    cout <<"pxy_int_max : "<< int_max[0] << endl;
+    cout <<"pz_int_max : "<< int_max[2] << endl;
+    cout <<"tilt_max : "<< tilt_max << endl;
+    cout <<"acc_z_max : "<< acc_z_max << endl;
+    cout <<"int_ratio : "<< int_ratio << endl;
+    cout <<"int_start_error : "<< int_start_error << endl;
+}
+
+#endif
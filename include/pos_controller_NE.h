@@ -20,6 +20,7 @@
 #include <HighPassFilter.h>
 #include <LeadLagFilter.h>
 #include <px4_command/ControlOutput.h>
+#include <pos_controller_base.h>
 
 
 #include <px4_command/DroneState.h>
@@ -29,7 +30,7 @@
 
 using namespace std;
  
-class pos_controller_NE
+class pos_controller_NE : public pos_controller_base
 {
      //public表明该数据成员、成员函数是对全部用户开放的。全部用户都能够直接进行调用，在程序的不论什么其他地方訪问。
     public:
@@ -69,6 +70,7 @@ class pos_controller_NE
             integral_LLF    = Eigen::Vector3f(0.0,0.0,0.0);
             NoiseEstimator  = Eigen::Vector3f(0.0,0.0,0.0);
             output_LLF      = Eigen::Vector3f(0.0,0.0,0.0);
+            u_d_saturated[0] = u_d_saturated[1] = u_d_saturated[2] = false;
             set_filter();
         }
 
@@ -89,7 +91,9 @@ class pos_controller_NE
         Eigen::Vector3f Kd;
         Eigen::Vector3f T_ude;
         float T_ne;
-        px4_command::ControlOutput _ControlOutput;
+
+        //u_d是否饱和（最近一次控制）
+        bool u_d_saturated[3];
 
 
         //Filter for NE
@@ -126,8 +130,11 @@ class pos_controller_NE
         void printf_result();
 
         // Position control main function 
-        // [Input: Current state, Reference state, sub_mode, dt; Output: AttitudeReference;]
-        px4_command::ControlOutput pos_controller(const px4_command::DroneState& _DroneState, const px4_command::TrajectoryPoint& _Reference_State, float dt);
+        // [Input: Current state, Reference state, sub_mode, dt; Output: ControlOutput (filled in place);]
+        void pos_controller(const px4_command::DroneState& _DroneState, const px4_command::TrajectoryPoint& _Reference_State, float dt, px4_command::ControlOutput& _ControlOutput);
+
+        // 在线估计的有效质量（thrust_estimator.h），用于accelToThrust；悬停油门已由thrustToThrottle的电机曲线决定，不使用
+        void set_thrust_model(float mass, float /*hover_throttle*/) { Quad_MASS = mass; }
 
         void set_initial_pos(const Eigen::Vector3d& pos);
 
@@ -159,9 +166,9 @@ void pos_controller_NE::set_initial_pos(const Eigen::Vector3d& pos)
     pos_initial = pos;
 }
 
-px4_command::ControlOutput pos_controller_NE::pos_controller(
+void pos_controller_NE::pos_controller(
     const px4_command::DroneState& _DroneState, 
-    const px4_command::TrajectoryPoint& _Reference_State, float dt)
+    const px4_command::TrajectoryPoint& _Reference_State, float dt, px4_command::ControlOutput& _ControlOutput)
 {
     Eigen::Vector3d accel_sp;
     
@@ -214,16 +221,13 @@ px4_command::ControlOutput pos_controller_NE::pos_controller(
         integral[i] = integral[i] +  ( _Reference_State.acceleration_ref[i] +  Kp[i] * pos_error[i] + Kd[i] * vel_error[i]) * dt;
 
         // If not in OFFBOARD mode, set all intergral to zero.
-        if(_DroneState.mode != "OFFBOARD")
+        if(_DroneState.flight_mode != px4_command::DroneState::MODE_OFFBOARD)
         {
             integral[i] = 0;
         }
 
-        if(abs(u_d[i]) > int_max[i])
-        {
-            cout << "u_d saturation! " << " [0-1-2] "<< i <<endl;
-            cout << "[u_d]: "<< u_d[i]<<" [u_d_max]: "<<int_max[i]<<" [m/s] "<<endl;
-        }
+        // 饱和只记录，在printf_result中打印，控制步中不做输出
+        u_d_saturated[i] = abs(u_d[i]) > int_max[i];
 
         u_d[i] = constrain_function(u_d[i], int_max[i]);
     }
@@ -249,7 +253,6 @@ px4_command::ControlOutput pos_controller_NE::pos_controller(
         _ControlOutput.NE[i] = NoiseEstimator[i];
     }
 
-    return _ControlOutput;
 }
 
 void pos_controller_NE::printf_result()
@@ -274,6 +277,14 @@ void pos_controller_NE::printf_result()
     cout << "u_l [X Y Z] : " << u_l[0] << " [N] "<< u_l[1]<<" [N] "<<u_l[2]<<" [N] "<<endl;
 
     cout << "u_d [X Y Z] : " << u_d[0] << " [N] "<< u_d[1]<<" [N] "<<u_d[2]<<" [N] "<<endl;
+
+    for (int i=0; i<3; i++)
+    {
+        if(u_d_saturated[i])
+        {
+            cout << "u_d saturation! " << " [0-1-2] "<< i << " [u_d_max]: "<<int_max[i]<<" [m/s] "<<endl;
+        }
+    }
 }
 
 // 【打印参数函数】
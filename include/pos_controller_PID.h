@@ -18,11 +18,12 @@
 #include <px4_command/TrajectoryPoint.h>
 #include <px4_command/AttitudeReference.h>
 #include <px4_command/ControlOutput.h>
+#include <pos_controller_base.h>
 
 
 using namespace std;
 
-class pos_controller_PID
+class pos_controller_PID : public pos_controller_base
 {
      //public表明该数据成员、成员函数是对全部用户开放的。全部用户都能够直接进行调用，在程序的不论什么其他地方訪问。
     public:
@@ -76,9 +77,6 @@ class pos_controller_PID
         //积分项
         Eigen::Vector3f integral;
 
-        //输出
-        px4_command::ControlOutput _ControlOutput;
-
 
         //Printf the PID parameter
         void printf_param();
@@ -86,17 +84,20 @@ class pos_controller_PID
         void printf_result();
 
         // Position control main function 
-        // [Input: Current state, Reference state, sub_mode, dt; Output: AttitudeReference;]
-        px4_command::ControlOutput pos_controller(const px4_command::DroneState& _DroneState, const px4_command::TrajectoryPoint& _Reference_State, float dt);
+        // [Input: Current state, Reference state, sub_mode, dt; Output: ControlOutput (filled in place);]
+        void pos_controller(const px4_command::DroneState& _DroneState, const px4_command::TrajectoryPoint& _Reference_State, float dt, px4_command::ControlOutput& _ControlOutput);
+
+        // 在线估计的有效质量（thrust_estimator.h），用于accelToThrust；悬停油门已由thrustToThrottle的电机曲线决定，不使用
+        void set_thrust_model(float mass, float /*hover_throttle*/) { Quad_MASS = mass; }
 
     private:
         ros::NodeHandle pos_pid_nh;
 
 };
 
-px4_command::ControlOutput pos_controller_PID::pos_controller(
+void pos_controller_PID::pos_controller(
     const px4_command::DroneState& _DroneState, 
-    const px4_command::TrajectoryPoint& _Reference_State, float dt)
+    const px4_command::TrajectoryPoint& _Reference_State, float dt, px4_command::ControlOutput& _ControlOutput)
 {
     Eigen::Vector3d accel_sp;
     
@@ -142,7 +143,7 @@ px4_command::ControlOutput pos_controller_PID::pos_controller(
         }
 
         // If not in OFFBOARD mode, set all intergral to zero.
-        if(_DroneState.mode != "OFFBOARD")
+        if(_DroneState.flight_mode != px4_command::DroneState::MODE_OFFBOARD)
         {
             integral[i] = 0;
         }
@@ -161,7 +162,6 @@ px4_command::ControlOutput pos_controller_PID::pos_controller(
         _ControlOutput.Throttle[i] = throttle_sp[i];
     }
 
-    return _ControlOutput;
 
 }
 
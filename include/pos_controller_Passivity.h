@@ -21,11 +21,12 @@
 #include <px4_command/TrajectoryPoint.h>
 #include <px4_command/AttitudeReference.h>
 #include <px4_command/ControlOutput.h>
+#include <pos_controller_base.h>
 
 
 using namespace std;
  
-class pos_controller_passivity
+class pos_controller_passivity : public pos_controller_base
 {
      //public表明该数据成员、成员函数是对全部用户开放的。全部用户都能够直接进行调用，在程序的不论什么其他地方訪问。
     public:
@@ -92,7 +93,6 @@ class pos_controller_passivity
         //u_l for nominal contorol(PD), u_d for passivity control(disturbance estimator)
         Eigen::Vector3f u_l,u_d;
         Eigen::Vector3f integral;
-        px4_command::ControlOutput _ControlOutput;
 
 
         HighPassFilter HPF_pos_error_x;
@@ -125,8 +125,11 @@ class pos_controller_passivity
         void set_filter();
 
         // Position control main function 
-        // [Input: Current state, Reference state, sub_mode, dt; Output: AttitudeReference;]
-        px4_command::ControlOutput pos_controller(const px4_command::DroneState& _DroneState, const px4_command::TrajectoryPoint& _Reference_State, float dt);
+        // [Input: Current state, Reference state, sub_mode, dt; Output: ControlOutput (filled in place);]
+        void pos_controller(const px4_command::DroneState& _DroneState, const px4_command::TrajectoryPoint& _Reference_State, float dt, px4_command::ControlOutput& _ControlOutput);
+
+        // 在线估计的有效质量（thrust_estimator.h），用于accelToThrust；悬停油门已由thrustToThrottle的电机曲线决定，不使用
+        void set_thrust_model(float mass, float /*hover_throttle*/) { Quad_MASS = mass; }
 
     private:
 
@@ -152,9 +155,9 @@ void pos_controller_passivity::set_filter()
     LPF_int_x.set_Time_constant(T_ude[2]);
 }
 
-px4_command::ControlOutput pos_controller_passivity::pos_controller(
+void pos_controller_passivity::pos_controller(
     const px4_command::DroneState& _DroneState, 
-    const px4_command::TrajectoryPoint& _Reference_State, float dt)
+    const px4_command::TrajectoryPoint& _Reference_State, float dt, px4_command::ControlOutput& _ControlOutput)
 {
     Eigen::Vector3d accel_sp;
 
@@ -204,7 +207,7 @@ px4_command::ControlOutput pos_controller_passivity::pos_controller(
         integral[i] += pos_error[i] * dt;
 
         // If not in OFFBOARD mode, set all intergral to zero.
-        if(_DroneState.mode != "OFFBOARD")
+        if(_DroneState.flight_mode != px4_command::DroneState::MODE_OFFBOARD)
         {
             integral[i] = 0;
         }
@@ -238,7 +241,6 @@ px4_command::ControlOutput pos_controller_passivity::pos_controller(
         _ControlOutput.Throttle[i] = throttle_sp[i];
     }
 
-    return _ControlOutput;
 }
 
 
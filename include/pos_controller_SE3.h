@@ -0,0 +1,316 @@
+/***************************************************************************************************************************
+* pos_controller_SE3.h
+*
+* Author: Qyp
+*
+* Update Time: 2019.8.17
+*
+* Introduction:  Geometric tracking controller on SE(3)
+*         1. 位置环：期望合力 F = m (-Kp e_p - Kv e_v + Ki ∫e_p + a_ref + g e3)，水平分量按tilt_max限幅（同accelToThrust）
+*         2. 期望姿态直接在SO(3)上构造：b3d = F/|F|，b2d = b3d × b1c / |b3d × b1c| (b1c为期望偏航方向)，b1d = b2d × b3d，
+*            不经过欧拉角，俯仰接近±90°时仍然有效；b3d与b1c平行时沿用上一次的b2d
+*         3. 推力取期望合力在当前机体z轴上的投影 f = F·R e3，姿态误差大时自动减小推力，之后按电机曲线换算油门（对推力大小而非分量）
+*         4. 机体角速度：Omega = R^T R_d Omega_d - kR e_R，e_R = 0.5 vee(R_d^T R - R^T R_d)，
+*            Omega_d取AttitudeReference中的desired_rate_ff（微分平坦前馈，未启用时为0）
+*         5. 通过pos_controller_base的attitude_reference()、rate_control()直接输出期望姿态、油门及机体角速度，
+*            px4_pos_controller中不再调用ThrottleToAttitude；Body_rate模式下代替att_controller
+*         Ref to : Lee T, Leok M, McClamroch N H. Geometric tracking control of a quadrotor UAV on SE(3). CDC 2010.
+***************************************************************************************************************************/
+#ifndef POS_CONTROLLER_SE3_H
+#define POS_CONTROLLER_SE3_H
+
+#include <Eigen/Eigen>
+#include <math.h>
+#include <command_to_mavros.h>
+#include <px4_command_utils.h>
+#include <math_utils.h>
+
+#include <px4_command/DroneState.h>
+#include <px4_command/TrajectoryPoint.h>
+#include <px4_command/AttitudeReference.h>
+#include <px4_command/ControlOutput.h>
+#include <pos_controller_base.h>
+
+using namespace std;
+
+class pos_controller_SE3 : public pos_controller_base
+{
+     //public表明该数据成员、成员函数是对全部用户开放的。全部用户都能够直接进行调用，在程序的不论什么其他地方訪问。
+    public:
+
+        //构造函数
+        pos_controller_SE3(void):
+            pos_SE3_nh("~")
+        {
+            pos_SE3_nh.param<float>("Quad/mass", Quad_MASS, 1.0);
+
+            pos_SE3_nh.param<float>("Pos_se3/Kp_xy", Kp[0], 2.0);
+            pos_SE3_nh.param<float>("Pos_se3/Kp_xy", Kp[1], 2.0);
+            pos_SE3_nh.param<float>("Pos_se3/Kp_z", Kp[2], 2.0);
+            pos_SE3_nh.param<float>("Pos_se3/Kv_xy", Kv[0], 2.5);
+            pos_SE3_nh.param<float>("Pos_se3/Kv_xy", Kv[1], 2.5);
+            pos_SE3_nh.param<float>("Pos_se3/Kv_z", Kv[2], 2.5);
+            pos_SE3_nh.param<float>("Pos_se3/Ki_xy", Ki[0], 0.5);
+            pos_SE3_nh.param<float>("Pos_se3/Ki_xy", Ki[1], 0.5);
+            pos_SE3_nh.param<float>("Pos_se3/Ki_z", Ki[2], 0.5);
+            pos_SE3_nh.param<float>("Pos_se3/kR_xy", kR[0], 6.5);
+            pos_SE3_nh.param<float>("Pos_se3/kR_xy", kR[1], 6.5);
+            pos_SE3_nh.param<float>("Pos_se3/kR_z", kR[2], 2.8);
+            pos_SE3_nh.param<float>("Pos_se3/rate_max_xy", rate_max[0], 220.0);
+            pos_SE3_nh.param<float>("Pos_se3/rate_max_xy", rate_max[1], 220.0);
+            pos_SE3_nh.param<float>("Pos_se3/rate_max_z", rate_max[2], 200.0);
+
+            pos_SE3_nh.param<float>("Limit/pxy_error_max", pos_error_max[0], 0.6);
+            pos_SE3_nh.param<float>("Limit/pxy_error_max", pos_error_max[1], 0.6);
+            pos_SE3_nh.param<float>("Limit/pz_error_max" , pos_error_max[2], 1.0);
+            pos_SE3_nh.param<float>("Limit/vxy_error_max", vel_error_max[0], 0.3);
+            pos_SE3_nh.param<float>("Limit/vxy_error_max", vel_error_max[1], 0.3);
+            pos_SE3_nh.param<float>("Limit/vz_error_max" , vel_error_max[2], 1.0);
+            pos_SE3_nh.param<float>("Limit/pxy_int_max"  , int_max[0], 0.5);
+            pos_SE3_nh.param<float>("Limit/pxy_int_max"  , int_max[1], 0.5);
+            pos_SE3_nh.param<float>("Limit/pz_int_max"   , int_max[2], 0.5);
+            pos_SE3_nh.param<float>("Limit/tilt_max", tilt_max, 20.0);
+            pos_SE3_nh.param<float>("Limit/int_start_error"  , int_start_error, 0.3);
+
+            integral = Eigen::Vector3f(0.0,0.0,0.0);
+            accel_sp = Eigen::Vector3d(0.0,0.0,9.8);
+            R_d = Eigen::Matrix3d::Identity();
+            thrust = 0.0;
+            throttle = 0.0;
+            att_error = Eigen::Vector3d(0.0,0.0,0.0);
+            rates_sp = Eigen::Vector3d(0.0,0.0,0.0);
+        }
+
+        //Quadrotor Parameter
+        float Quad_MASS;
+
+        //SE3 control parameter
+        Eigen::Vector3f Kp;
+        Eigen::Vector3f Kv;
+        Eigen::Vector3f Ki;
+        Eigen::Vector3f kR;                     //姿态误差增益 [1/s]
+        Eigen::Vector3f rate_max;               //机体角速度限幅 [deg/s]
+
+        //Limitation
+        Eigen::Vector3f pos_error_max;
+        Eigen::Vector3f vel_error_max;
+        Eigen::Vector3f int_max;
+        float tilt_max;
+        float int_start_error;
+
+        Eigen::Vector3f integral;
+
+        //最近一次的结果
+        Eigen::Vector3d accel_sp;               //期望合加速度(含重力) [m/s^2]
+        Eigen::Matrix3d R_d;                    //期望姿态
+        float thrust;                           //单个电机推力 [N]
+        float throttle;                         //油门 [0-1]
+        Eigen::Vector3d att_error;              //e_R [rad]
+        Eigen::Vector3d rates_sp;               //期望机体角速度 [rad/s]
+
+        //Printf the SE3 parameter
+        void printf_param();
+
+        //Printf the control result
+        void printf_result();
+
+        // Position control main function
+        // [Input: Current state, Reference state, _Reference_State.Sub_mode, dt; Output: ControlOutput (filled in place);]
+        void pos_controller(const px4_command::DroneState& _DroneState, const px4_command::TrajectoryPoint& _Reference_State, float dt, px4_command::ControlOutput& _ControlOutput);
+
+        // 在线估计的有效质量（thrust_estimator.h），用于accelToThrust；悬停油门已由thrustToThrottle的电机曲线决定，不使用
+        void set_thrust_model(float mass, float /*hover_throttle*/) { Quad_MASS = mass; }
+
+        // 期望姿态R_d及油门，直接写入AttitudeReference
+        bool attitude_reference(px4_command::AttitudeReference& _AttitudeReference);
+
+        // 几何姿态控制律，输出期望机体角速度
+        bool rate_control(const Eigen::Quaterniond& q, const px4_command::AttitudeReference& _AttitudeReference, Eigen::Vector3d& rate_setpoint);
+
+    private:
+
+        ros::NodeHandle pos_SE3_nh;
+};
+
+void pos_controller_SE3::pos_controller(
+    const px4_command::DroneState& _DroneState,
+    const px4_command::TrajectoryPoint& _Reference_State, float dt, px4_command::ControlOutput& _ControlOutput)
+{
+    Eigen::Vector3f pos_error = px4_command_utils::cal_pos_error(_DroneState, _Reference_State);
+    Eigen::Vector3f vel_error = px4_command_utils::cal_vel_error(_DroneState, _Reference_State);
+
+    Eigen::Vector3d u_l, u_d;
+    for (int i=0; i<3; i++)
+    {
+        // 积分，误差较大时不积分
+        if(abs(pos_error[i]) < int_start_error)
+        {
+            integral[i] += pos_error[i] * dt;
+        }else
+        {
+            integral[i] = 0;
+        }
+
+        if(_DroneState.flight_mode != px4_command::DroneState::MODE_OFFBOARD)
+        {
+            integral[i] = 0;
+        }
+
+        integral[i] = constrain_function(integral[i], int_max[i]);
+
+        pos_error[i] = constrain_function(pos_error[i], pos_error_max[i]);
+        vel_error[i] = constrain_function(vel_error[i], vel_error_max[i]);
+
+        u_l[i] = Kp[i] * pos_error[i] + Kv[i] * vel_error[i];
+        u_d[i] = Ki[i] * integral[i];
+
+        accel_sp[i] = _Reference_State.acceleration_ref[i] + u_l[i] + u_d[i];
+    }
+    accel_sp[2] = accel_sp[2] + 9.8;
+
+    // 期望合力（单个电机），水平分量按最大倾斜角限幅
+    Eigen::Vector3d thrust_sp = px4_command_utils::accelToThrust(accel_sp, Quad_MASS, tilt_max);
+
+    // 期望姿态：b3d沿期望合力方向，b1d尽量指向期望偏航方向
+    Eigen::Vector3d b3d = thrust_sp.norm() > 1e-5 ? thrust_sp.normalized() : Eigen::Vector3d(0.0, 0.0, 1.0);
+    Eigen::Vector3d b1c(cos(_Reference_State.yaw_ref), sin(_Reference_State.yaw_ref), 0.0);
+    Eigen::Vector3d b2d = b3d.cross(b1c);
+
+    if(b2d.norm() > 1e-3)
+    {
+        b2d.normalize();
+    }else
+    {
+        // b3d与偏航方向平行，偏航无定义，沿用上一次的b2d
+        b2d = R_d.col(1) - R_d.col(1).dot(b3d) * b3d;
+        b2d = b2d.norm() > 1e-3 ? b2d.normalized() : b3d.unitOrthogonal();
+    }
+
+    R_d.col(0) = b2d.cross(b3d);
+    R_d.col(1) = b2d;
+    R_d.col(2) = b3d;
+
+    // 推力为期望合力在当前机体z轴上的投影
+    Eigen::Quaterniond q(_DroneState.attitude_q.w, _DroneState.attitude_q.x, _DroneState.attitude_q.y, _DroneState.attitude_q.z);
+    Eigen::Vector3d b3 = q.normalized() * Eigen::Vector3d::UnitZ();
+
+    thrust = max(thrust_sp.dot(b3), 0.0);
+    throttle = px4_command_utils::thrustToThrottle(Eigen::Vector3d(thrust, thrust, thrust))[0];
+
+    for (int i=0; i<3; i++)
+    {
+        _ControlOutput.u_l[i] = u_l[i];
+        _ControlOutput.u_d[i] = u_d[i];
+        _ControlOutput.Thrust[i] = thrust_sp[i];
+        // 沿期望推力方向，仅供显示及Use_accel模式使用
+        _ControlOutput.Throttle[i] = throttle * b3d[i];
+    }
+}
+
+bool pos_controller_SE3::attitude_reference(px4_command::AttitudeReference& _AttitudeReference)
+{
+    Eigen::Quaterniond q_sp(R_d);
+    Eigen::Vector3d att_sp = quaternion_to_euler(q_sp);
+
+    for (int i=0; i<3; i++)
+    {
+        _AttitudeReference.throttle_sp[i] = throttle * R_d(i, 2);
+        _AttitudeReference.desired_attitude[i] = att_sp[i];
+
+        // 前馈由flatness_feedforward单独计算
+        _AttitudeReference.desired_rate_ff[i] = 0.0;
+        _AttitudeReference.desired_angular_acc_ff[i] = 0.0;
+    }
+    _AttitudeReference.desired_throttle_rate_ff = 0.0;
+
+    _AttitudeReference.desired_throttle = throttle;
+
+    _AttitudeReference.desired_att_q.w = q_sp.w();
+    _AttitudeReference.desired_att_q.x = q_sp.x();
+    _AttitudeReference.desired_att_q.y = q_sp.y();
+    _AttitudeReference.desired_att_q.z = q_sp.z();
+
+    return true;
+}
+
+bool pos_controller_SE3::rate_control(const Eigen::Quaterniond& q, const px4_command::AttitudeReference& _AttitudeReference, Eigen::Vector3d& rate_setpoint)
+{
+    // 使用AttitudeReference中的期望姿态（可能已被前馈向前推算）
+    Eigen::Quaterniond qd(_AttitudeReference.desired_att_q.w, _AttitudeReference.desired_att_q.x,
+                          _AttitudeReference.desired_att_q.y, _AttitudeReference.desired_att_q.z);
+
+    Eigen::Matrix3d R = q.normalized().toRotationMatrix();
+    Eigen::Matrix3d Rd = qd.normalized().toRotationMatrix();
+
+    // e_R = 0.5 vee(R_d^T R - R^T R_d)
+    Eigen::Matrix3d E = 0.5 * (Rd.transpose() * R - R.transpose() * Rd);
+    att_error = Eigen::Vector3d(E(2, 1), E(0, 2), E(1, 0));
+
+    Eigen::Vector3d rate_d(_AttitudeReference.desired_rate_ff[0], _AttitudeReference.desired_rate_ff[1], _AttitudeReference.desired_rate_ff[2]);
+    Eigen::Vector3d rate_ff = R.transpose() * Rd * rate_d;
+
+    for(int i = 0; i < 3; i++)
+    {
+        rate_setpoint[i] = constrain_function(rate_ff[i] - kR[i] * att_error[i], rate_max[i] / 180.0 * M_PI);
+    }
+
+    rates_sp = rate_setpoint;
+
+    return true;
+}
+
+void pos_controller_SE3::printf_result()
+{
+    cout <<">>>>>>>>>>>>>>>>>>>>>>  SE3 Position Controller  <<<<<<<<<<<<<<<<<<<<<<" <<endl;
+
+    //固定的浮点显示
+    cout.setf(ios::fixed);
+    //左对齐
+    cout.setf(ios::left);
+    // 强制显示小数点
+    cout.setf(ios::showpoint);
+    // 强制显示符号
+    cout.setf(ios::showpos);
+
+    cout<<setprecision(2);
+
+    cout << "accel_sp [X Y Z] : " << accel_sp[0] << " [m/s^2] "<< accel_sp[1]<<" [m/s^2] "<<accel_sp[2]<<" [m/s^2] "<<endl;
+    cout << "int [X Y Z] : " << integral[0] << " [m*s] "<< integral[1]<<" [m*s] "<<integral[2]<<" [m*s] "<<endl;
+    cout << "thrust : " << thrust << " [N]  throttle : " << throttle << endl;
+    cout << "e_R [X Y Z] : " << att_error[0] << " [rad] "<< att_error[1]<<" [rad] "<<att_error[2]<<" [rad] "<<endl;
+    cout << "rates_sp [X Y Z] : " << rates_sp[0] << " [rad/s] "<< rates_sp[1]<<" [rad/s] "<<rates_sp[2]<<" [rad/s] "<<endl;
+}
+
+// 【打印参数函数】
+void pos_controller_SE3::printf_param()
+{
+    cout <<">>>>>>>>>>>>>>>>>>>>>>>>>>SE3 Parameter <<<<<<<<<<<<<<<<<<<<<<<<<" <<endl;
+    cout <<"Quad_MASS : "<< Quad_MASS << endl;
+
+    cout <<"Kp_x : "<< Kp[0] << endl;
+    cout <<"Kp_y : "<< Kp[1] << endl;
+    cout <<"Kp_z : "<< Kp[2] << endl;
+
+    cout <<"Kv_x : "<< Kv[0] << endl;
+    cout <<"Kv_y : "<< Kv[1] << endl;
+    cout <<"Kv_z : "<< Kv[2] << endl;
+
+    cout <<"Ki_x : "<< Ki[0] << endl;
+    cout <<"Ki_y : "<< Ki[1] << endl;
+    cout <<"Ki_z : "<< Ki[2] << endl;
+
+    cout <<"kR [R P Y] : "<< kR.transpose() << endl;
+    cout <<"rate_max [R P Y] : "<< rate_max.transpose() << " [deg/s] " << endl;
+
+    cout <<"Limit:  " <<endl;
+    cout <<"pxy_error_max : "<< pos_error_max[0] << endl;
+    cout <<"pz_error_max :  "<< pos_error_max[2] << endl;
+    cout <<"vxy_error_max : "<< vel_error_max[0] << endl;
+    cout <<"vz_error_max :  "<< vel_error_max[2] << endl;
+    cout <<"pxy_int_max : "<< int_max[0] << endl;
+    cout <<"pz_int_max : "<< int_max[2] << endl;
+    cout <<"tilt_max : "<< tilt_max << endl;
+    cout <<"int_start_error : "<< int_start_error << endl;
+}
+
+#endif
@@ -27,12 +27,13 @@
 #include <px4_command/TrajectoryPoint.h>
 #include <px4_command/AttitudeReference.h>
 #include <px4_command/ControlOutput.h>
+#include <pos_controller_base.h>
 
 
 using namespace std;
 
 
-class pos_controller_UDE
+class pos_controller_UDE : public pos_controller_base
 {
      //public表明该数据成员、成员函数是对全部用户开放的。全部用户都能够直接进行调用，在程序的不论什么其他地方訪问。
     public:
@@ -68,6 +69,8 @@ class pos_controller_UDE
             u_l      = Eigen::Vector3f(0.0,0.0,0.0);
             u_d      = Eigen::Vector3f(0.0,0.0,0.0);
             integral = Eigen::Vector3f(0.0,0.0,0.0);
+
+            u_d_saturated[0] = u_d_saturated[1] = u_d_saturated[2] = false;
         }
 
         //Quadrotor Parameter
@@ -92,7 +95,8 @@ class pos_controller_UDE
 
         Eigen::Vector3f integral;
 
-        px4_command::ControlOutput _ControlOutput;
+        //u_d是否饱和（最近一次控制）
+        bool u_d_saturated[3];
 
 
         //Printf the UDE parameter
@@ -102,8 +106,11 @@ class pos_controller_UDE
         void printf_result();
 
         // Position control main function 
-        // [Input: Current state, Reference state, sub_mode, dt; Output: AttitudeReference;]
-        px4_command::ControlOutput pos_controller(const px4_command::DroneState& _DroneState, const px4_command::TrajectoryPoint& _Reference_State, float dt);
+        // [Input: Current state, Reference state, sub_mode, dt; Output: ControlOutput (filled in place);]
+        void pos_controller(const px4_command::DroneState& _DroneState, const px4_command::TrajectoryPoint& _Reference_State, float dt, px4_command::ControlOutput& _ControlOutput);
+
+        // 在线估计的有效质量（thrust_estimator.h），用于accelToThrust；悬停油门已由thrustToThrottle的电机曲线决定，不使用
+        void set_thrust_model(float mass, float /*hover_throttle*/) { Quad_MASS = mass; }
 
     private:
 
@@ -111,9 +118,9 @@ class pos_controller_UDE
 
 };
 
-px4_command::ControlOutput pos_controller_UDE::pos_controller(
+void pos_controller_UDE::pos_controller(
     const px4_command::DroneState& _DroneState, 
-    const px4_command::TrajectoryPoint& _Reference_State, float dt)
+    const px4_command::TrajectoryPoint& _Reference_State, float dt, px4_command::ControlOutput& _ControlOutput)
 {
     Eigen::Vector3d accel_sp;
 
@@ -149,16 +156,13 @@ px4_command::ControlOutput pos_controller_UDE::pos_controller(
             integral[i] = 0;
         }
 
-        if(_DroneState.mode != "OFFBOARD")
+        if(_DroneState.flight_mode != px4_command::DroneState::MODE_OFFBOARD)
         {
             integral[i] = 0;
         }
 
-        if(abs(u_d[i]) > int_max[i])
-        {
-            cout << "u_d saturation! " << " [0-1-2] "<< i <<endl;
-            cout << "[u_d]: "<< u_d[i]<<" [u_d_max]: "<<int_max[i]<<" [m/s] "<<endl;
-        }
+        // 饱和只记录，在printf_result中打印，控制步中不做输出
+        u_d_saturated[i] = abs(u_d[i]) > int_max[i];
 
         u_d[i] = constrain_function(u_d[i], int_max[i]);
     }
@@ -183,7 +187,6 @@ px4_command::ControlOutput pos_controller_UDE::pos_controller(
         _ControlOutput.Throttle[i] = throttle_sp[i];
     }
 
-    return _ControlOutput;
 }
 
 void pos_controller_UDE::printf_result()
@@ -204,6 +207,14 @@ void pos_controller_UDE::printf_result()
     cout << "u_l [X Y Z] : " << u_l[0] << " [N] "<< u_l[1]<<" [N] "<<u_l[2]<<" [N] "<<endl;
     cout << "int [X Y Z] : " << integral[0] << " [N] "<< integral[1]<<" [N] "<<integral[2]<<" [N] "<<endl;
     cout << "u_d [X Y Z] : " << u_d[0] << " [N] "<< u_d[1]<<" [N] "<<u_d[2]<<" [N] "<<endl;
+
+    for (int i=0; i<3; i++)
+    {
+        if(u_d_saturated[i])
+        {
+            cout << "u_d saturation! " << " [0-1-2] "<< i << " [u_d_max]: "<<int_max[i]<<" [m/s] "<<endl;
+        }
+    }
 }
 
 // 【打印参数函数】
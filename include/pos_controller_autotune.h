@@ -0,0 +1,509 @@
+/***************************************************************************************************************************
+* pos_controller_autotune.h
+*
+* Author: Qyp
+*
+* Update Time: 2019.8.19
+*
+* Introduction:  Relay-feedback auto-tuner for the gains of pos_controller_cascade_PID
+*         1. 作为一种位置控制律(switch_ude = 8)使用：内部为cascade_PID，悬停稳定后依次对z、x、y轴的速度环做继电反馈实验，
+*            其余两轴由cascade_PID保持悬停
+*         2. 继电实验：u = u0 ± d（油门），速度误差 e = Kp_hold (p_ref - p) - v 过 ±hysteresis 时切换，
+*            u0为实验前悬停时该轴的平均油门；跳过前skip_cycles个周期，取之后cycles个周期的平均振幅a及周期Tu
+*            临界增益 Ku = 4d / (pi sqrt(a^2 - hysteresis^2))
+*         3. 速度环按Ziegler-Nichols "no overshoot"规则：Kp_v = 0.2 Ku，Ki_v = 0.4 Ku / Tu，Kd_v = 0.0667 Ku Tu；
+*            位置环 Kp = 2 pi / (pos_ratio Tu)，即位置环带宽为速度环临界频率的1/pos_ratio；z轴的平均油门作为Hover_throttle
+*         4. 每轴整定完成后立即使用新增益；全部完成后打印结果，Autotune/output_file非空时写入YAML文件(Pos_cascade_pid格式)
+*            控制步中只记录事件，打印及写文件在non_realtime_update()中进行（主循环的1Hz状态发布处及退出时）
+*         5. 继电实验期间冻结cascade_PID该轴的速度环积分，避免积分偏置整定结果，及交还控制时的积分冲击
+*         6. 安全：非OFFBOARD、位置误差超过max_pos_error或单轴超时则中止，恢复原增益，之后作为普通cascade_PID运行
+*         7. 先用px4_sim_headless验证（switch_ude = 8，Sim/time_total足够长），再实飞；实飞时以Takeoff/Move_ENU悬停于开阔位置
+***************************************************************************************************************************/
+#ifndef POS_CONTROLLER_AUTOTUNE_H
+#define POS_CONTROLLER_AUTOTUNE_H
+
+#include <ros/ros.h>
+#include <Eigen/Eigen>
+#include <math.h>
+#include <stdio.h>
+#include <string>
+#include <math_utils.h>
+#include <command_to_mavros.h>
+#include <px4_command_utils.h>
+
+#include <px4_command/DroneState.h>
+#include <px4_command/TrajectoryPoint.h>
+#include <px4_command/ControlOutput.h>
+#include <pos_controller_base.h>
+#include <pos_controller_cascade_PID.h>
+
+using namespace std;
+
+class pos_controller_autotune : public pos_controller_base
+{
+     //public表明该数据成员、成员函数是对全部用户开放的。全部用户都能够直接进行调用，在程序的不论什么其他地方訪问。
+    public:
+
+        //构造函数
+        pos_controller_autotune(void):
+            autotune_nh("~")
+        {
+            autotune_nh.param<float>("Autotune/relay_xy", relay_amplitude[0], 0.03);
+            autotune_nh.param<float>("Autotune/relay_xy", relay_amplitude[1], 0.03);
+            autotune_nh.param<float>("Autotune/relay_z", relay_amplitude[2], 0.05);
+            autotune_nh.param<float>("Autotune/hysteresis", hysteresis, 0.02);
+            autotune_nh.param<float>("Autotune/Kp_hold", Kp_hold, 0.3);
+            autotune_nh.param<int>("Autotune/cycles", cycles, 4);
+            autotune_nh.param<int>("Autotune/skip_cycles", skip_cycles, 2);
+            autotune_nh.param<float>("Autotune/settle_time", settle_time, 3.0);
+            autotune_nh.param<float>("Autotune/axis_timeout", axis_timeout, 20.0);
+            autotune_nh.param<float>("Autotune/max_pos_error", max_pos_error, 1.0);
+            autotune_nh.param<float>("Autotune/pos_ratio", pos_ratio, 4.0);
+            autotune_nh.param<string>("Autotune/output_file", output_file, "");
+
+            save_gains(gains_origin);
+
+            state = WAIT_HOVER;
+            axis = 2;
+            state_time = 0.0;
+            trim_sum = 0.0;
+            trim_num = 0;
+
+            int_hold = 0.0;
+            event_num = 0;
+            event_dropped = 0;
+
+            for(int i = 0; i < 3; i++)
+            {
+                Ku[i] = 0.0;
+                Tu[i] = 0.0;
+                amplitude[i] = 0.0;
+            }
+            hover_throttle = pid.Hover_throttle;
+        }
+
+        enum Autotune_State
+        {
+            WAIT_HOVER = 0,             //等待悬停稳定，统计该轴平均油门
+            RELAY,                      //继电实验
+            FINISHED,                   //完成，使用新增益
+            ABORTED                     //中止，使用原增益
+        };
+
+        // cascade_PID，整定过程中保持其余轴，整定完成后即为整定结果
+        pos_controller_cascade_PID pid;
+
+        //Autotune parameter
+        Eigen::Vector3f relay_amplitude;        //继电幅值 [油门]
+        float hysteresis;                       //切换滞环 [m/s]
+        float Kp_hold;                          //实验轴的弱位置保持 [1/s]
+        int cycles;
+        int skip_cycles;
+        float settle_time;                      // [s]
+        float axis_timeout;                     // [s]
+        float max_pos_error;                    // [m]
+        float pos_ratio;
+        string output_file;
+
+        //结果
+        int state;
+        int axis;                               //当前整定的轴 (2 -> 0 -> 1)
+        Eigen::Vector3f Ku;                     //临界增益 [油门/(m/s)]
+        Eigen::Vector3f Tu;                     //临界周期 [s]
+        Eigen::Vector3f amplitude;              //速度振幅 [m/s]
+        float hover_throttle;
+
+        //Printf the autotune parameter
+        void printf_param();
+
+        //Printf the autotune state and result
+        void printf_result();
+
+        // Position control main function
+        // [Input: Current state, Reference state, _Reference_State.Sub_mode, dt; Output: ControlOutput (filled in place);]
+        void pos_controller(const px4_command::DroneState& _DroneState, const px4_command::TrajectoryPoint& _Reference_State, float dt, px4_command::ControlOutput& _ControlOutput);
+
+        // 打印控制步中记录的事件，整定完成时写入YAML文件
+        void non_realtime_update();
+
+        // 将整定结果写入YAML文件，返回是否成功
+        bool write_yaml(const string& file_name);
+
+    private:
+
+        enum Autotune_Event
+        {
+            EVENT_RELAY = 0,            //开始继电实验
+            EVENT_AXIS_DONE,            //单轴整定完成
+            EVENT_FINISHED,             //全部完成
+            EVENT_ABORTED               //中止
+        };
+
+        // 控制步中记录的事件，由non_realtime_update()取出
+        struct autotune_event
+        {
+            int type;
+            int axis;
+            float value;                        //EVENT_RELAY: 平均油门
+            const char* reason;                 //EVENT_ABORTED: 原因（字符串常量）
+        };
+
+        autotune_event events[8];
+        int event_num;
+        int event_dropped;
+
+        void push_event(int type, float value, const char* reason);
+
+        ros::NodeHandle autotune_nh;
+
+        // cascade_PID的增益 [Kp_xy Kp_z Kp_vxvy Kp_vz Ki_vxvy Ki_vz Kd_vxvy Kd_vz Hover_throttle]
+        float gains_origin[9];
+
+        // 继电实验的中间量
+        float state_time;
+        double trim_sum;
+        int trim_num;
+        float trim;                             //该轴平均油门 u0
+        float relay_output;                     //+1 or -1
+        int switch_num;                         //上升切换的次数
+        float time_last_switch;                 //上一次上升切换的时刻
+        float vel_max, vel_min;                 //本周期速度极值
+        float period_sum, amplitude_sum;
+        double int_hold;                        //实验开始时cascade_PID该轴的速度环积分，实验期间保持不变
+
+        void save_gains(float gains[9]);
+        void load_gains(const float gains[9]);
+
+        // 由Ku、Tu计算增益
+        void apply_tuning();
+
+        void start_axis(int next_axis);
+        void abort_tuning(const char* reason);
+};
+
+void pos_controller_autotune::save_gains(float gains[9])
+{
+    gains[0] = pid.Kp_xy;    gains[1] = pid.Kp_z;
+    gains[2] = pid.Kp_vxvy;  gains[3] = pid.Kp_vz;
+    gains[4] = pid.Ki_vxvy;  gains[5] = pid.Ki_vz;
+    gains[6] = pid.Kd_vxvy;  gains[7] = pid.Kd_vz;
+    gains[8] = pid.Hover_throttle;
+}
+
+void pos_controller_autotune::load_gains(const float gains[9])
+{
+    pid.Kp_xy = gains[0];    pid.Kp_z = gains[1];
+    pid.Kp_vxvy = gains[2];  pid.Kp_vz = gains[3];
+    pid.Ki_vxvy = gains[4];  pid.Ki_vz = gains[5];
+    pid.Kd_vxvy = gains[6];  pid.Kd_vz = gains[7];
+    pid.Hover_throttle = gains[8];
+}
+
+void pos_controller_autotune::push_event(int type, float value, const char* reason)
+{
+    if(event_num >= 8)
+    {
+        event_dropped++;
+        return;
+    }
+
+    events[event_num].type = type;
+    events[event_num].axis = axis;
+    events[event_num].value = value;
+    events[event_num].reason = reason;
+    event_num++;
+}
+
+void pos_controller_autotune::start_axis(int next_axis)
+{
+    axis = next_axis;
+    state = WAIT_HOVER;
+    state_time = 0.0;
+    trim_sum = 0.0;
+    trim_num = 0;
+}
+
+void pos_controller_autotune::abort_tuning(const char* reason)
+{
+    load_gains(gains_origin);
+    state = ABORTED;
+    push_event(EVENT_ABORTED, 0.0, reason);
+}
+
+void pos_controller_autotune::apply_tuning()
+{
+    const float kp_v = 0.2 * Ku[axis];
+    const float ki_v = 0.4 * Ku[axis] / Tu[axis];
+    const float kd_v = 0.0667 * Ku[axis] * Tu[axis];
+    const float kp = 2 * M_PI / (pos_ratio * Tu[axis]);
+
+    if(axis == 2)
+    {
+        pid.Kp_z = kp;
+        pid.Kp_vz = kp_v;
+        pid.Ki_vz = ki_v;
+        pid.Kd_vz = kd_v;
+        pid.Hover_throttle = hover_throttle;
+    }else
+    {
+        // x、y共用一组增益，y轴完成后取两轴平均
+        if(axis == 1)
+        {
+            pid.Kp_xy = 0.5 * (pid.Kp_xy + kp);
+            pid.Kp_vxvy = 0.5 * (pid.Kp_vxvy + kp_v);
+            pid.Ki_vxvy = 0.5 * (pid.Ki_vxvy + ki_v);
+            pid.Kd_vxvy = 0.5 * (pid.Kd_vxvy + kd_v);
+        }else
+        {
+            pid.Kp_xy = kp;
+            pid.Kp_vxvy = kp_v;
+            pid.Ki_vxvy = ki_v;
+            pid.Kd_vxvy = kd_v;
+        }
+    }
+}
+
+void pos_controller_autotune::pos_controller(
+    const px4_command::DroneState& _DroneState,
+    const px4_command::TrajectoryPoint& _Reference_State, float dt, px4_command::ControlOutput& _ControlOutput)
+{
+    pid.pos_controller(_DroneState, _Reference_State, dt, _ControlOutput);
+
+    if(state == FINISHED || state == ABORTED)
+    {
+        return;
+    }
+
+    // 继电实验期间该轴输出由继电给出，速度环积分保持实验开始时的值
+    if(state == RELAY)
+    {
+        pid.thurst_int[axis] = int_hold;
+    }
+
+    float pos_error = _Reference_State.position_ref[axis] - _DroneState.position[axis];
+    float speed = Eigen::Vector3f(_DroneState.velocity[0], _DroneState.velocity[1], _DroneState.velocity[2]).norm();
+
+    // 只在OFFBOARD定点悬停时整定
+    if(_DroneState.flight_mode != px4_command::DroneState::MODE_OFFBOARD || _Reference_State.Sub_mode != command_to_mavros::XYZ_POS)
+    {
+        if(state == RELAY)
+        {
+            abort_tuning("not in OFFBOARD position hold");
+        }else
+        {
+            start_axis(axis);
+        }
+        return;
+    }
+
+    state_time += dt;
+
+    if(state == WAIT_HOVER)
+    {
+        // 悬停稳定后统计该轴平均油门，作为继电中心
+        if(fabs(pos_error) > 0.2 || speed > 0.2)
+        {
+            state_time = 0.0;
+            trim_sum = 0.0;
+            trim_num = 0;
+            return;
+        }
+
+        if(state_time > 0.5 * settle_time)
+        {
+            trim_sum += _ControlOutput.Throttle[axis];
+            trim_num++;
+        }
+
+        if(state_time > settle_time && trim_num > 0)
+        {
+            trim = trim_sum / trim_num;
+            if(axis == 2)
+            {
+                hover_throttle = trim;
+            }
+
+            state = RELAY;
+            state_time = 0.0;
+            relay_output = 1.0;
+            switch_num = 0;
+            time_last_switch = 0.0;
+            vel_max = -1e3;
+            vel_min = 1e3;
+            period_sum = 0.0;
+            amplitude_sum = 0.0;
+            int_hold = pid.thurst_int[axis];
+
+            push_event(EVENT_RELAY, trim, NULL);
+        }
+        return;
+    }
+
+    // RELAY
+    if(fabs(pos_error) > max_pos_error)
+    {
+        abort_tuning("position error too large");
+        return;
+    }
+
+    if(state_time > axis_timeout)
+    {
+        abort_tuning("no stable oscillation before timeout");
+        return;
+    }
+
+    float vel = _DroneState.velocity[axis];
+    float error = Kp_hold * pos_error - vel;
+
+    vel_max = max(vel_max, vel);
+    vel_min = min(vel_min, vel);
+
+    if(relay_output < 0 && error > hysteresis)
+    {
+        // 上升切换：一个完整周期结束
+        relay_output = 1.0;
+        switch_num++;
+
+        if(switch_num > skip_cycles)
+        {
+            period_sum += state_time - time_last_switch;
+            amplitude_sum += 0.5 * (vel_max - vel_min);
+        }
+
+        time_last_switch = state_time;
+        vel_max = -1e3;
+        vel_min = 1e3;
+
+        if(switch_num >= skip_cycles + cycles)
+        {
+            Tu[axis] = period_sum / cycles;
+            amplitude[axis] = amplitude_sum / cycles;
+
+            float a = sqrt(max(amplitude[axis] * amplitude[axis] - hysteresis * hysteresis, 1e-6f));
+            Ku[axis] = 4 * relay_amplitude[axis] / (M_PI * a);
+
+            apply_tuning();
+
+            push_event(EVENT_AXIS_DONE, 0.0, NULL);
+
+            // z -> x -> y
+            if(axis == 2)
+            {
+                start_axis(0);
+            }else if(axis == 0)
+            {
+                start_axis(1);
+            }else
+            {
+                state = FINISHED;
+                push_event(EVENT_FINISHED, 0.0, NULL);
+            }
+            return;
+        }
+    }else if(relay_output > 0 && error < -hysteresis)
+    {
+        relay_output = -1.0;
+    }
+
+    _ControlOutput.Throttle[axis] = trim + relay_output * relay_amplitude[axis];
+}
+
+void pos_controller_autotune::non_realtime_update()
+{
+    for(int i = 0; i < event_num; i++)
+    {
+        const autotune_event& event = events[i];
+
+        if(event.type == EVENT_RELAY)
+        {
+            cout << "Autotune: relay on axis " << event.axis << ", trim throttle : " << event.value << endl;
+        }else if(event.type == EVENT_AXIS_DONE)
+        {
+            cout << "Autotune: axis " << event.axis << " Ku : " << Ku[event.axis] << " Tu : " << Tu[event.axis] << " [s] amplitude : " << amplitude[event.axis] << " [m/s]" << endl;
+        }else if(event.type == EVENT_ABORTED)
+        {
+            ROS_WARN("Autotune aborted on axis %d: %s, restore the original gains", event.axis, event.reason);
+        }else
+        {
+            printf_result();
+            if(!output_file.empty())
+            {
+                write_yaml(output_file);
+            }
+        }
+    }
+
+    if(event_dropped > 0)
+    {
+        ROS_WARN("Autotune: %d events dropped", event_dropped);
+    }
+
+    event_num = 0;
+    event_dropped = 0;
+}
+
+bool pos_controller_autotune::write_yaml(const string& file_name)
+{
+    FILE* fp = fopen(file_name.c_str(), "w");
+    if(fp == NULL)
+    {
+        ROS_ERROR("Autotune: can not open %s", file_name.c_str());
+        return false;
+    }
+
+    fprintf(fp, "## 自动整定结果 (pos_controller_autotune.h)\n");
+    fprintf(fp, "## Ku [x y z] : %.4f %.4f %.4f, Tu [x y z] : %.3f %.3f %.3f [s]\n", Ku[0], Ku[1], Ku[2], Tu[0], Tu[1], Tu[2]);
+    fprintf(fp, "Pos_cascade_pid:\n");
+    fprintf(fp, "   Kp_xy : %.3f\n", pid.Kp_xy);
+    fprintf(fp, "   Kp_z : %.3f\n", pid.Kp_z);
+    fprintf(fp, "   Kp_vxvy : %.4f\n", pid.Kp_vxvy);
+    fprintf(fp, "   Kp_vz : %.4f\n", pid.Kp_vz);
+    fprintf(fp, "   Ki_vxvy : %.4f\n", pid.Ki_vxvy);
+    fprintf(fp, "   Ki_vz : %.4f\n", pid.Ki_vz);
+    fprintf(fp, "   Kd_vxvy : %.4f\n", pid.Kd_vxvy);
+    fprintf(fp, "   Kd_vz : %.4f\n", pid.Kd_vz);
+    fprintf(fp, "   Hover_throttle : %.3f\n", pid.Hover_throttle);
+    fprintf(fp, "   MPC_VELD_LP: %.1f\n", pid.MPC_VELD_LP);
+
+    fclose(fp);
+
+    cout << "Autotune: gains written to " << file_name << endl;
+    return true;
+}
+
+void pos_controller_autotune::printf_result()
+{
+    cout <<">>>>>>>>>>>>>>>>>>>>>>  Relay Autotune  <<<<<<<<<<<<<<<<<<<<<<" <<endl;
+
+    const char* state_name[4] = {"wait hover", "relay", "finished", "aborted"};
+    const char* axis_name[3] = {"x", "y", "z"};
+
+    cout << "state : " << state_name[state] << "  axis : " << axis_name[axis] << endl;
+
+    for(int i = 0; i < 3; i++)
+    {
+        cout << axis_name[i] << " : Ku " << Ku[i] << "  Tu " << Tu[i] << " [s]  amplitude " << amplitude[i] << " [m/s] " << endl;
+    }
+
+    if(state == FINISHED)
+    {
+        pid.printf_param();
+    }
+}
+
+// 【打印参数函数】
+void pos_controller_autotune::printf_param()
+{
+    cout <<">>>>>>>>>>>>>>>>>>>>>>>>>>Autotune Parameter <<<<<<<<<<<<<<<<<<<<<<<<<" <<endl;
+
+    cout <<"relay_xy : "<< relay_amplitude[0] << "  relay_z : "<< relay_amplitude[2] << " [throttle] " << endl;
+    cout <<"hysteresis : "<< hysteresis << " [m/s]  Kp_hold : "<< Kp_hold << endl;
+    cout <<"cycles : "<< cycles << "  skip_cycles : "<< skip_cycles << endl;
+    cout <<"settle_time : "<< settle_time << " [s]  axis_timeout : "<< axis_timeout << " [s]  max_pos_error : "<< max_pos_error << " [m] " << endl;
+    cout <<"pos_ratio : "<< pos_ratio << endl;
+    cout <<"output_file : "<< output_file << endl;
+
+    pid.printf_param();
+}
+
+#endif
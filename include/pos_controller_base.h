@@ -0,0 +1,64 @@
+/***************************************************************************************************************************
+* pos_controller_base.h
+*
+* Author: Qyp
+*
+* Update Time: 2019.7.22
+*
+* Introduction:  Common interface of the position controllers
+*         1. 所有位置控制器（cascade_PID, PID, UDE, passivity, NE, MPC, SE3, INDI, autotune）均继承此类，主程序只通过一个基类指针调用
+*         2. 控制器的创建见pos_controller_registry.h，只创建被选中的控制器
+*         3. 控制步原地填写调用者预先分配的ControlOutput，不做堆内存分配及字符串操作
+*         4. 默认由ControlOutput.Throttle经ThrottleToAttitude得到期望姿态、由att_controller得到机体角速度；
+*            直接在SO(3)上计算的控制律（SE3）重写attitude_reference()及rate_control()并返回true
+***************************************************************************************************************************/
+#ifndef POS_CONTROLLER_BASE_H
+#define POS_CONTROLLER_BASE_H
+
+#include <Eigen/Eigen>
+#include <px4_command/DroneState.h>
+#include <px4_command/TrajectoryPoint.h>
+#include <px4_command/ControlOutput.h>
+#include <px4_command/AttitudeReference.h>
+
+class pos_controller_base
+{
+    public:
+
+        virtual ~pos_controller_base() {}
+
+        // Position control main function
+        // [Input: Current state, Reference state, dt; Output: ControlOutput (throttle setpoint, filled in place);]
+        virtual void pos_controller(const px4_command::DroneState& _DroneState, const px4_command::TrajectoryPoint& _Reference_State, float dt, px4_command::ControlOutput& _ControlOutput) = 0;
+
+        // 按值返回的版本，用于非实时场合
+        px4_command::ControlOutput pos_controller(const px4_command::DroneState& _DroneState, const px4_command::TrajectoryPoint& _Reference_State, float dt)
+        {
+            px4_command::ControlOutput _ControlOutput;
+            pos_controller(_DroneState, _Reference_State, dt, _ControlOutput);
+            return _ControlOutput;
+        }
+
+        //Printf the controller parameter
+        virtual void printf_param() = 0;
+
+        //Printf the control result
+        virtual void printf_result() = 0;
+
+        // 设置起飞初始位置，目前只有NE控制律需要
+        virtual void set_initial_pos(const Eigen::Vector3d& /*pos*/) {}
+
+        // 在线估计的有效质量[kg]及悬停油门（thrust_estimator.h），在pos_controller()之前调用；autotune由继电实验得到悬停油门，不使用
+        virtual void set_thrust_model(float /*mass*/, float /*hover_throttle*/) {}
+
+        // 在pos_controller()之后调用：由控制器直接给出期望姿态及油门，返回false时调用者使用ThrottleToAttitude
+        virtual bool attitude_reference(px4_command::AttitudeReference& /*_AttitudeReference*/) { return false; }
+
+        // 机载姿态环：由控制器直接给出期望机体角速度 [rad/s]，返回false时调用者使用att_controller
+        virtual bool rate_control(const Eigen::Quaterniond& /*q*/, const px4_command::AttitudeReference& /*_AttitudeReference*/, Eigen::Vector3d& /*rate_setpoint*/) { return false; }
+
+        // 在控制步之外调用（主循环的1Hz状态发布处及退出时）：打印、写文件等不能放在控制步中的操作
+        virtual void non_realtime_update() {}
+};
+
+#endif
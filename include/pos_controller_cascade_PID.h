@@ -27,12 +27,13 @@
 #include <px4_command/TrajectoryPoint.h>
 #include <px4_command/AttitudeReference.h>
 #include <px4_command/ControlOutput.h>
+#include <pos_controller_base.h>
 
 using namespace std;
 
 
 
-class pos_controller_cascade_PID
+class pos_controller_cascade_PID : public pos_controller_base
 {
      //public表明该数据成员、成员函数是对全部用户开放的。全部用户都能够直接进行调用，在程序的不论什么其他地方訪问。
     public:
@@ -119,7 +120,6 @@ class pos_controller_cascade_PID
         //Current state of the drone
         mavros_msgs::State current_state;
 
-        px4_command::ControlOutput _ControlOutput;
 
         //Printf the PID parameter
         void printf_param();
@@ -128,8 +128,11 @@ class pos_controller_cascade_PID
         void printf_result();
 
         // Position control main function 
-        // [Input: Current state, Reference state, _Reference_State.Sub_mode, dt; Output: AttitudeReference;]
-        px4_command::ControlOutput pos_controller(const px4_command::DroneState& _DroneState, const px4_command::TrajectoryPoint& _Reference_State, float dt);
+        // [Input: Current state, Reference state, _Reference_State.Sub_mode, dt; Output: ControlOutput (filled in place);]
+        void pos_controller(const px4_command::DroneState& _DroneState, const px4_command::TrajectoryPoint& _Reference_State, float dt, px4_command::ControlOutput& _ControlOutput);
+
+        // 在线估计的悬停油门（thrust_estimator.h），本控制律不使用质量
+        void set_thrust_model(float /*mass*/, float hover_throttle) { Hover_throttle = hover_throttle; }
 
         //Position control loop [Input: current pos, desired pos; Output: desired vel]
         void _positionController(const px4_command::DroneState& _DroneState, const px4_command::TrajectoryPoint& _Reference_State, Eigen::Vector3d& vel_setpoint);
@@ -144,10 +147,10 @@ class pos_controller_cascade_PID
         ros::NodeHandle pos_cascade_pid_nh;
 };
 
-px4_command::ControlOutput pos_controller_cascade_PID::pos_controller
+void pos_controller_cascade_PID::pos_controller
     (const px4_command::DroneState& _DroneState, 
      const px4_command::TrajectoryPoint& _Reference_State, 
-     float dt)
+     float dt, px4_command::ControlOutput& _ControlOutput)
 {
     delta_time = dt;
 
@@ -161,7 +164,6 @@ px4_command::ControlOutput pos_controller_cascade_PID::pos_controller
     _ControlOutput.Throttle[1] = thrust_sp[1];
     _ControlOutput.Throttle[2] = thrust_sp[2];
 
-    return _ControlOutput;
 }
 
 
@@ -300,7 +302,7 @@ void pos_controller_cascade_PID::_velocityController
     thurst_int[1] += Ki_vxvy * vel_err_lim_y * delta_time;
 
     //If not in OFFBOARD mode, set all intergral to zero.
-    if(_DroneState.mode != "OFFBOARD")
+    if(_DroneState.flight_mode != px4_command::DroneState::MODE_OFFBOARD)
     {
         thurst_int = Eigen::Vector3d(0.0,0.0,0.0);
     }
@@ -0,0 +1,130 @@
+/***************************************************************************************************************************
+* pos_controller_registry.h
+*
+* Author: Qyp
+*
+* Update Time: 2019.7.22
+*
+* Introduction:  Registry of the position controllers
+*         1. 根据编号创建对应的位置控制器，只有被选中的控制器会被构造（读取参数）
+*         2. 新增控制律时：继承pos_controller_base，在Controller_Type中增加编号，并在create()、clone()和name()中注册
+*         3. clone()复制已创建的控制器（参数及状态），批量仿真（px4_gain_sweep）时每个工作线程由同一原型复制，不重复读取参数
+***************************************************************************************************************************/
+#ifndef POS_CONTROLLER_REGISTRY_H
+#define POS_CONTROLLER_REGISTRY_H
+
+#include <pos_controller_base.h>
+#include <pos_controller_cascade_PID.h>
+#include <pos_controller_PID.h>
+#include <pos_controller_UDE.h>
+#include <pos_controller_Passivity.h>
+#include <pos_controller_NE.h>
+#include <pos_controller_MPC.h>
+#include <pos_controller_SE3.h>
+#include <pos_controller_INDI.h>
+#include <pos_controller_autotune.h>
+
+namespace pos_controller_registry
+{
+
+//控制律编号，对应参数switch_ude
+enum Controller_Type
+{
+    Cascade_PID = 0,
+    PID = 1,
+    UDE = 2,
+    Passivity = 3,
+    NE = 4,
+    MPC = 5,
+    SE3 = 6,
+    INDI = 7,
+    Autotune = 8,
+    Controller_Num
+};
+
+// 创建控制器，编号无效时返回NULL
+pos_controller_base* create(int controller_type)
+{
+    switch (controller_type)
+    {
+    case Cascade_PID:
+        return new pos_controller_cascade_PID;
+    case PID:
+        return new pos_controller_PID;
+    case UDE:
+        return new pos_controller_UDE;
+    case Passivity:
+        return new pos_controller_passivity;
+    case NE:
+        return new pos_controller_NE;
+    case MPC:
+        return new pos_controller_MPC;
+    case SE3:
+        return new pos_controller_SE3;
+    case INDI:
+        return new pos_controller_INDI;
+    case Autotune:
+        return new pos_controller_autotune;
+    default:
+        return NULL;
+    }
+}
+
+// 复制控制器（含参数及内部状态），用于由同一组参数批量创建控制器而不重复读取参数
+// [Input: 编号, 由create(编号)创建的控制器；编号无效时返回NULL]
+pos_controller_base* clone(int controller_type, const pos_controller_base* controller)
+{
+    switch (controller_type)
+    {
+    case Cascade_PID:
+        return new pos_controller_cascade_PID(*static_cast<const pos_controller_cascade_PID*>(controller));
+    case PID:
+        return new pos_controller_PID(*static_cast<const pos_controller_PID*>(controller));
+    case UDE:
+        return new pos_controller_UDE(*static_cast<const pos_controller_UDE*>(controller));
+    case Passivity:
+        return new pos_controller_passivity(*static_cast<const pos_controller_passivity*>(controller));
+    case NE:
+        return new pos_controller_NE(*static_cast<const pos_controller_NE*>(controller));
+    case MPC:
+        return new pos_controller_MPC(*static_cast<const pos_controller_MPC*>(controller));
+    case SE3:
+        return new pos_controller_SE3(*static_cast<const pos_controller_SE3*>(controller));
+    case INDI:
+        return new pos_controller_INDI(*static_cast<const pos_controller_INDI*>(controller));
+    case Autotune:
+        return new pos_controller_autotune(*static_cast<const pos_controller_autotune*>(controller));
+    default:
+        return NULL;
+    }
+}
+
+const char* name(int controller_type)
+{
+    switch (controller_type)
+    {
+    case Cascade_PID:
+        return "cascade_PID";
+    case PID:
+        return "PID";
+    case UDE:
+        return "UDE";
+    case Passivity:
+        return "passivity";
+    case NE:
+        return "NE";
+    case MPC:
+        return "MPC";
+    case SE3:
+        return "SE3";
+    case INDI:
+        return "INDI";
+    case Autotune:
+        return "autotune";
+    default:
+        return "unknown";
+    }
+}
+
+}
+#endif
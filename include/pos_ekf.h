@@ -0,0 +1,492 @@
+/***************************************************************************************************************************
+* pos_ekf.h
+*
+* Author: Qyp
+*
+* Update Time: 2019.8.24
+*
+* Introduction:  Error-state EKF fusing FCU IMU with external position sources (vision, laser, mocap, sonic, TFmini)
+*         1. 状态：ENU系位置p、速度v及机体系加速度计零偏b（9维），姿态直接使用飞控/mavros/imu/data中的四元数，不作为状态估计
+*         2. 预测：a = q * (f - b) - g e3，f为IMU比力，以IMU原始频率预测；误差状态协方差按加速度噪声(accel_noise)及零偏随机游走(bias_noise)传播
+*         3. 量测：vision/mocap为xyz，laser(cartographer)为xy，sonic为z，TFmini为z（距离乘以该时刻姿态的R(2,2)得到垂直高度），
+*            逐轴标量更新，不需要矩阵求逆；归一化新息超过gate的量测被拒绝
+*         4. 延迟处理：滤波器运行在延迟时间轴 t_imu - delay 上（同PX4 EKF2），IMU及量测先进入缓冲区，量测按自身时间戳排序，
+*            在延迟时间轴到达其时间戳时融合；比延迟时间轴还晚delay以上的量测被丢弃
+*         5. 输出：由延迟时间轴上的状态，用缓冲区中之后的IMU数据积分至最新IMU时刻，得到低延迟的位置及速度
+*         6. 各数据源独立统计融合/拒绝/过晚次数，超过timeout未融合视为失效；单一数据源失效时滤波器继续使用其余数据源
+*            (无数据源时仅靠IMU积分，位置方差增大至pos_std_max后输出无效)
+*         7. 数据源时间戳为0时，调用者应以收到时刻代替；IMU与其他数据源时间戳须在同一时钟下（mavros已将飞控时间同步至ROS时间）
+***************************************************************************************************************************/
+#ifndef POS_EKF_H
+#define POS_EKF_H
+
+#include <ros/ros.h>
+#include <Eigen/Eigen>
+#include <math.h>
+#include <iostream>
+#include <iomanip>
+#include <px4_command_utils.h>
+
+using namespace std;
+
+#define EKF_IMU_BUFFER_SIZE         512
+#define EKF_MEASUREMENT_BUFFER_SIZE 64
+
+// IMU数据（/mavros/imu/data），含Quaterniond，放入std::vector等容器时需Eigen::aligned_allocator
+struct ekf_imu
+{
+    double t;                               // 时间戳 [s]
+    Eigen::Vector3d specific_force;         // 机体系比力 [m/s^2]
+    Eigen::Quaterniond q;                   // 机体系 -> ENU系
+};
+
+// 外部定位数据
+struct ekf_measurement
+{
+    double t;                               // 时间戳 [s]
+    int source;                             // pos_ekf::SOURCE_*
+    Eigen::Vector3d z;                      // 位置 [m]，SOURCE_SONIC及SOURCE_TFMINI只使用z[2]（TFmini为原始距离）
+};
+
+class pos_ekf
+{
+    public:
+
+        enum
+        {
+            SOURCE_VISION = 0,
+            SOURCE_LASER,
+            SOURCE_MOCAP,
+            SOURCE_SONIC,
+            SOURCE_TFMINI,
+            NUM_SOURCE
+        };
+
+        // 含Quaterniond及Matrix<double,9,9>等可向量化的Eigen成员，由new创建，C++11下需对齐的operator new
+        EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+
+        //构造函数
+        pos_ekf(void):
+            ekf_nh("~")
+        {
+            ekf_nh.param<float>("EKF/delay", delay, 0.1);
+            ekf_nh.param<float>("EKF/accel_noise", accel_noise, 0.5);
+            ekf_nh.param<float>("EKF/bias_noise", bias_noise, 0.01);
+            ekf_nh.param<float>("EKF/bias_max", bias_max, 1.0);
+            ekf_nh.param<float>("EKF/gate", gate, 5.0);
+            ekf_nh.param<float>("EKF/timeout", timeout, 0.5);
+            ekf_nh.param<float>("EKF/imu_timeout", imu_timeout, 0.1);
+            ekf_nh.param<float>("EKF/pos_std_max", pos_std_max, 1.0);
+            ekf_nh.param<float>("EKF/dt_max", dt_max, 0.05);
+
+            ekf_nh.param<int>("EKF/use_vision", use_source[SOURCE_VISION], 1);
+            ekf_nh.param<int>("EKF/use_laser", use_source[SOURCE_LASER], 0);
+            ekf_nh.param<int>("EKF/use_mocap", use_source[SOURCE_MOCAP], 1);
+            ekf_nh.param<int>("EKF/use_sonic", use_source[SOURCE_SONIC], 0);
+            ekf_nh.param<int>("EKF/use_tfmini", use_source[SOURCE_TFMINI], 1);
+
+            ekf_nh.param<float>("EKF/vision_noise", noise_source[SOURCE_VISION], 0.05);
+            ekf_nh.param<float>("EKF/laser_noise", noise_source[SOURCE_LASER], 0.05);
+            ekf_nh.param<float>("EKF/mocap_noise", noise_source[SOURCE_MOCAP], 0.01);
+            ekf_nh.param<float>("EKF/sonic_noise", noise_source[SOURCE_SONIC], 0.05);
+            ekf_nh.param<float>("EKF/tfmini_noise", noise_source[SOURCE_TFMINI], 0.03);
+
+            reset();
+        }
+
+        //Parameter
+        float delay;                        // 延迟时间轴相对最新IMU的滞后 [s]，应大于各数据源的最大延迟
+        float accel_noise;                  // 加速度噪声 [m/s^2/sqrt(Hz)]
+        float bias_noise;                   // 零偏随机游走 [m/s^3/sqrt(Hz)]
+        float bias_max;                     // 零偏限幅 [m/s^2]
+        float gate;                         // 新息门限 [sigma]
+        float timeout;                      // 数据源超过该时间未融合视为失效 [s]
+        float imu_timeout;                  // IMU超过该时间无数据时输出无效 [s]
+        float pos_std_max;                  // 位置标准差超过该值时输出无效 [m]
+        float dt_max;                       // 单步预测的最大时间间隔 [s]
+        int use_source[NUM_SOURCE];
+        float noise_source[NUM_SOURCE];     // 量测标准差 [m]
+
+        // 重置滤波器，清空缓冲区
+        void reset();
+
+        // 【IMU】按时间顺序加入，时间戳不增加的数据被丢弃
+        void push_imu(const ekf_imu& imu);
+
+        // 【量测】可乱序加入，按时间戳排序
+        void push_measurement(const ekf_measurement& measurement);
+
+        // 将延迟时间轴推进至 t_imu - delay，融合其间的量测
+        void update();
+
+        // [Input: 当前时刻 [s]; Output: 最新IMU时刻的位置、速度及其时间戳，返回false for 输出无效]
+        bool get_output(double now, Eigen::Vector3d& pos, Eigen::Vector3d& vel, double& t);
+
+        // [Input: 当前时刻 [s]; Output: 数据源是否在timeout内融合过]
+        bool source_active(int source, double now) const;
+
+        void printf_param();
+
+        void printf_result(double now);
+
+    private:
+
+        ros::NodeHandle ekf_nh;
+
+        // 延迟时间轴上的状态 [p v b] 及误差状态协方差
+        Eigen::Matrix<double, 9, 1> x;
+        Eigen::Matrix<double, 9, 9> P;
+        Eigen::Quaterniond q_filter;        // 延迟时间轴上的姿态（最近一次预测所用IMU）
+        double t_filter;
+        bool started;                       // 延迟时间轴已开始
+        bool initialized[3];                // 各轴位置已由量测初始化
+
+        // IMU环形缓冲区，imu_total为累计写入数，第k个数据位于 k % EKF_IMU_BUFFER_SIZE
+        ekf_imu imu_buffer[EKF_IMU_BUFFER_SIZE];
+        unsigned long imu_total;
+        unsigned long imu_next;             // 延迟时间轴下一个要使用的IMU数据
+
+        // 按时间戳升序排列的量测
+        ekf_measurement measurement_buffer[EKF_MEASUREMENT_BUFFER_SIZE];
+        int measurement_count;
+
+        // 数据源统计
+        double last_fused[NUM_SOURCE];
+        unsigned long count_fused[NUM_SOURCE];
+        unsigned long count_rejected[NUM_SOURCE];
+        unsigned long count_late[NUM_SOURCE];
+        unsigned long count_imu_overrun;
+
+        void predict(const ekf_imu& imu);
+
+        void fuse_measurements();
+
+        // 单轴位置量测的标量更新 [Output: false for 被门限拒绝]
+        bool fuse_axis(int axis, double z, double noise);
+
+        // 由位置量测初始化该轴
+        void initialize_axis(int axis, double z, double noise);
+
+        const ekf_imu& imu_at(unsigned long k) const { return imu_buffer[k % EKF_IMU_BUFFER_SIZE]; }
+};
+
+void pos_ekf::reset()
+{
+    x.setZero();
+    P.setZero();
+    P.block<3,3>(3,3) = Eigen::Matrix3d::Identity();
+    P.block<3,3>(6,6) = Eigen::Matrix3d::Identity() * bias_max * bias_max;
+    q_filter.setIdentity();
+    t_filter = 0.0;
+    started = false;
+
+    imu_total = 0;
+    imu_next = 0;
+    measurement_count = 0;
+    count_imu_overrun = 0;
+
+    for(int i = 0; i < 3; i++)
+    {
+        initialized[i] = false;
+        P(i,i) = 1e4;
+    }
+
+    for(int i = 0; i < NUM_SOURCE; i++)
+    {
+        last_fused[i] = -1e9;
+        count_fused[i] = 0;
+        count_rejected[i] = 0;
+        count_late[i] = 0;
+    }
+}
+
+void pos_ekf::push_imu(const ekf_imu& imu)
+{
+    if(imu_total > 0 && imu.t <= imu_at(imu_total - 1).t)
+    {
+        return;
+    }
+
+    imu_buffer[imu_total % EKF_IMU_BUFFER_SIZE] = imu;
+    imu_total++;
+}
+
+void pos_ekf::push_measurement(const ekf_measurement& measurement)
+{
+    if(measurement.source < 0 || measurement.source >= NUM_SOURCE || !use_source[measurement.source])
+    {
+        return;
+    }
+
+    // 缓冲区满时丢弃最早的量测
+    if(measurement_count == EKF_MEASUREMENT_BUFFER_SIZE)
+    {
+        for(int i = 1; i < measurement_count; i++)
+        {
+            measurement_buffer[i-1] = measurement_buffer[i];
+        }
+        measurement_count--;
+    }
+
+    // 插入排序，通常新量测时间戳最大，只比较一次
+    int i = measurement_count;
+    while(i > 0 && measurement_buffer[i-1].t > measurement.t)
+    {
+        measurement_buffer[i] = measurement_buffer[i-1];
+        i--;
+    }
+    measurement_buffer[i] = measurement;
+    measurement_count++;
+}
+
+void pos_ekf::update()
+{
+    if(imu_total == 0)
+    {
+        return;
+    }
+
+    // 延迟时间轴过慢（如长时间未调用update）导致IMU数据被覆盖时，跳至缓冲区中最早的数据
+    unsigned long imu_oldest = imu_total > EKF_IMU_BUFFER_SIZE ? imu_total - EKF_IMU_BUFFER_SIZE : 0;
+    if(imu_next < imu_oldest)
+    {
+        count_imu_overrun++;
+        imu_next = imu_oldest;
+        t_filter = imu_at(imu_next).t;
+    }
+
+    if(!started)
+    {
+        t_filter = imu_at(imu_next).t;
+        q_filter = imu_at(imu_next).q;
+        imu_next++;
+        started = true;
+    }
+
+    double t_horizon = imu_at(imu_total - 1).t - delay;
+
+    while(imu_next < imu_total && imu_at(imu_next).t <= t_horizon)
+    {
+        // 时间戳不晚于当前延迟时间轴的量测在预测前融合，时间误差不超过一个IMU周期
+        fuse_measurements();
+        predict(imu_at(imu_next));
+        imu_next++;
+    }
+
+    fuse_measurements();
+}
+
+void pos_ekf::predict(const ekf_imu& imu)
+{
+    double dt = min(imu.t - t_filter, (double)dt_max);
+    t_filter = imu.t;
+    q_filter = imu.q;
+
+    if(dt <= 0.0)
+    {
+        return;
+    }
+
+    Eigen::Matrix3d R = imu.q.toRotationMatrix();
+    Eigen::Vector3d accel = R * (imu.specific_force - x.segment<3>(6)) - Eigen::Vector3d(0.0, 0.0, 9.81);
+
+    x.segment<3>(0) = x.segment<3>(0) + x.segment<3>(3) * dt + 0.5 * accel * dt * dt;
+    x.segment<3>(3) = x.segment<3>(3) + accel * dt;
+
+    // 误差状态转移矩阵
+    Eigen::Matrix<double, 9, 9> F = Eigen::Matrix<double, 9, 9>::Identity();
+    F.block<3,3>(0,3) = Eigen::Matrix3d::Identity() * dt;
+    F.block<3,3>(0,6) = - 0.5 * R * dt * dt;
+    F.block<3,3>(3,6) = - R * dt;
+
+    P = F * P * F.transpose();
+
+    for(int i = 0; i < 3; i++)
+    {
+        P(i,i) = P(i,i) + 0.25 * accel_noise * accel_noise * dt * dt * dt;
+        P(3+i,3+i) = P(3+i,3+i) + accel_noise * accel_noise * dt;
+        P(6+i,6+i) = P(6+i,6+i) + bias_noise * bias_noise * dt;
+    }
+}
+
+void pos_ekf::fuse_measurements()
+{
+    while(measurement_count > 0 && measurement_buffer[0].t <= t_filter)
+    {
+        const ekf_measurement& measurement = measurement_buffer[0];
+        int source = measurement.source;
+        double noise = noise_source[source];
+
+        if(t_filter - measurement.t > delay)
+        {
+            count_late[source]++;
+        }
+        else
+        {
+            bool accepted = true;
+
+            switch(source)
+            {
+                case SOURCE_VISION:
+                case SOURCE_MOCAP:
+                    for(int i = 0; i < 3; i++)
+                    {
+                        accepted = fuse_axis(i, measurement.z[i], noise) && accepted;
+                    }
+                    break;
+
+                case SOURCE_LASER:
+                    for(int i = 0; i < 2; i++)
+                    {
+                        accepted = fuse_axis(i, measurement.z[i], noise) && accepted;
+                    }
+                    break;
+
+                case SOURCE_SONIC:
+                    accepted = fuse_axis(2, measurement.z[2], noise);
+                    break;
+
+                case SOURCE_TFMINI:
+                    // 机体z轴向下的测距 -> 垂直高度
+                    accepted = fuse_axis(2, measurement.z[2] * q_filter.toRotationMatrix()(2,2), noise);
+                    break;
+            }
+
+            if(accepted)
+            {
+                count_fused[source]++;
+                last_fused[source] = measurement.t;
+            }
+            else
+            {
+                count_rejected[source]++;
+            }
+        }
+
+        for(int i = 1; i < measurement_count; i++)
+        {
+            measurement_buffer[i-1] = measurement_buffer[i];
+        }
+        measurement_count--;
+    }
+}
+
+bool pos_ekf::fuse_axis(int axis, double z, double noise)
+{
+    if(!initialized[axis])
+    {
+        initialize_axis(axis, z, noise);
+        return true;
+    }
+
+    double innovation = z - x[axis];
+    double S = P(axis,axis) + noise * noise;
+
+    if(innovation * innovation > gate * gate * S)
+    {
+        return false;
+    }
+
+    Eigen::Matrix<double, 9, 1> K = P.col(axis) / S;
+
+    x = x + K * innovation;
+    P = P - K * P.row(axis);
+    P = 0.5 * (P + P.transpose());
+
+    for(int i = 0; i < 3; i++)
+    {
+        x[6+i] = constrain_function2(x[6+i], - bias_max, bias_max);
+    }
+
+    return true;
+}
+
+void pos_ekf::initialize_axis(int axis, double z, double noise)
+{
+    x[axis] = z;
+    x[3+axis] = 0.0;
+
+    P.row(axis).setZero();
+    P.col(axis).setZero();
+    P.row(3+axis).setZero();
+    P.col(3+axis).setZero();
+    P(axis,axis) = noise * noise;
+    P(3+axis,3+axis) = 1.0;
+
+    initialized[axis] = true;
+}
+
+bool pos_ekf::get_output(double now, Eigen::Vector3d& pos, Eigen::Vector3d& vel, double& t)
+{
+    if(!started || !initialized[0] || !initialized[1] || !initialized[2])
+    {
+        return false;
+    }
+
+    pos = x.segment<3>(0);
+    vel = x.segment<3>(3);
+    t = t_filter;
+
+    // 由延迟时间轴积分至最新IMU时刻（只积分状态，不传播协方差）
+    for(unsigned long k = imu_next; k < imu_total; k++)
+    {
+        const ekf_imu& imu = imu_at(k);
+        double dt = min(imu.t - t, (double)dt_max);
+        t = imu.t;
+
+        Eigen::Vector3d accel = imu.q * (imu.specific_force - x.segment<3>(6)) - Eigen::Vector3d(0.0, 0.0, 9.81);
+        pos = pos + vel * dt + 0.5 * accel * dt * dt;
+        vel = vel + accel * dt;
+    }
+
+    double pos_var_max = pos_std_max * pos_std_max;
+
+    return now - t < imu_timeout && P(0,0) < pos_var_max && P(1,1) < pos_var_max && P(2,2) < pos_var_max;
+}
+
+bool pos_ekf::source_active(int source, double now) const
+{
+    return now - last_fused[source] < timeout;
+}
+
+void pos_ekf::printf_param()
+{
+    const char* source_name[NUM_SOURCE] = {"vision", "laser", "mocap", "sonic", "tfmini"};
+
+    cout <<">>>>>>>>>>>>>>>>>>>>>>>>>>>>>> Position EKF <<<<<<<<<<<<<<<<<<<<<<<<<<<<<<" <<endl;
+    cout <<"delay : "<< delay << " [s]  accel_noise : "<< accel_noise << "  bias_noise : "<< bias_noise << "  bias_max : "<< bias_max << " [m/s^2] " << endl;
+    cout <<"gate : "<< gate << " [sigma]  timeout : "<< timeout << " [s]  imu_timeout : "<< imu_timeout << " [s]  pos_std_max : "<< pos_std_max << " [m] " << endl;
+
+    for(int i = 0; i < NUM_SOURCE; i++)
+    {
+        cout << source_name[i] << " : " << use_source[i] << "  noise : " << noise_source[i] << " [m] " << endl;
+    }
+}
+
+void pos_ekf::printf_result(double now)
+{
+    const char* source_name[NUM_SOURCE] = {"vision", "laser", "mocap", "sonic", "tfmini"};
+
+    cout <<">>>>>>>>>>>>>>>>>>>>>>>>>>>>  Position EKF  <<<<<<<<<<<<<<<<<<<<<<<<<<<<<<" <<endl;
+
+    cout.setf(ios::fixed);
+    cout.setf(ios::left);
+    cout.setf(ios::showpoint);
+    cout<<setprecision(3);
+
+    cout << "Pos_std [X Y Z] : " << sqrt(P(0,0)) << " " << sqrt(P(1,1)) << " " << sqrt(P(2,2)) << " [m]  Bias [X Y Z] : "
+         << x[6] << " " << x[7] << " " << x[8] << " [m/s^2]" << endl;
+
+    for(int i = 0; i < NUM_SOURCE; i++)
+    {
+        if(!use_source[i])
+        {
+            continue;
+        }
+
+        cout << source_name[i] << (source_active(i, now) ? " [active]  " : " [lost]    ") << "fused : " << count_fused[i]
+             << "  rejected : " << count_rejected[i] << "  late : " << count_late[i] << endl;
+    }
+}
+
+#endif
@@ -154,6 +154,7 @@ void prinft_drone_state(const px4_command::DroneState& _Drone_state)
     cout << "Velocity [X Y Z] : " << _Drone_state.velocity[0] << " [m/s] "<< _Drone_state.velocity[1]<<" [m/s] "<<_Drone_state.velocity[2]<<" [m/s] "<<endl;
     cout << "Attitude [R P Y] : " << _Drone_state.attitude[0] * 180/M_PI <<" [deg] "<<_Drone_state.attitude[1] * 180/M_PI << " [deg] "<< _Drone_state.attitude[2] * 180/M_PI<<" [deg] "<<endl;
     cout << "Att_rate [R P Y] : " << _Drone_state.attitude_rate[0] * 180/M_PI <<" [deg/s] "<<_Drone_state.attitude_rate[1] * 180/M_PI << " [deg/s] "<< _Drone_state.attitude_rate[2] * 180/M_PI<<" [deg/s] "<<endl;
+    cout << "Accel [X Y Z] : " << _Drone_state.acceleration[0] << " [m/s^2] "<< _Drone_state.acceleration[1]<<" [m/s^2] "<<_Drone_state.acceleration[2]<<" [m/s^2] "<<endl;
 }
 
 // 打印位置控制器输出结果
@@ -268,16 +269,37 @@ Eigen::Vector3d thrustToThrottle(const Eigen::Vector3d& thrust_sp)
         // PX4内部默认假设 0.5油门为悬停推力 ， 在无人机重量为1kg时，直接除20得到0.5
         // throttle_sp[i] = thrust_sp[i]/20；
     }
-    return throttle_sp; 
+    return throttle_sp;
+}
+
+// 单个电机：油门[0-1] -> 推力[N]，为thrustToThrottle的反函数（电机曲线在[0, thrust_max_single_motor]内单调，二分求解）
+double throttleToThrust(double throttle)
+{
+    double thrust_low = 0.0;
+    double thrust_high = thrust_max_single_motor;
+
+    for(int i = 0; i < 24; i++)
+    {
+        double thrust_mid = 0.5 * (thrust_low + thrust_high);
+        double throttle_mid = MOTOR_P1 * pow(thrust_mid,4) + MOTOR_P2 * pow(thrust_mid,3) + MOTOR_P3 * pow(thrust_mid,2) + MOTOR_P4 * thrust_mid + MOTOR_P5;
+
+        if(throttle_mid < throttle)
+        {
+            thrust_low = thrust_mid;
+        }else
+        {
+            thrust_high = thrust_mid;
+        }
+    }
+    return 0.5 * (thrust_low + thrust_high);
 }
 
 //Throttle to Attitude
 //Thrust to Attitude
 //Input: desired thrust (desired throttle [0,1]) and yaw_sp(rad)
-//Output: desired attitude (quaternion)
-px4_command::AttitudeReference ThrottleToAttitude(const Eigen::Vector3d& thr_sp, float yaw_sp)
+//Output: desired attitude (quaternion), filled in place (header is not touched)
+void ThrottleToAttitude(const Eigen::Vector3d& thr_sp, float yaw_sp, px4_command::AttitudeReference& _AttitudeReference)
 {
-    px4_command::AttitudeReference _AttitudeReference;
     Eigen::Vector3d att_sp;
     att_sp[2] = yaw_sp;
 
@@ -357,9 +379,121 @@ px4_command::AttitudeReference ThrottleToAttitude(const Eigen::Vector3d& thr_sp,
     _AttitudeReference.desired_attitude[1] = att_sp[1]; 
     _AttitudeReference.desired_attitude[2] = att_sp[2]; 
 
+    // 前馈由flatness_feedforward单独计算
+    for(int i = 0; i < 3; i++)
+    {
+        _AttitudeReference.desired_rate_ff[i] = 0.0;
+        _AttitudeReference.desired_angular_acc_ff[i] = 0.0;
+    }
+    _AttitudeReference.desired_throttle_rate_ff = 0.0;
+}
+
+// 按值返回的版本，用于非实时场合
+px4_command::AttitudeReference ThrottleToAttitude(const Eigen::Vector3d& thr_sp, float yaw_sp)
+{
+    px4_command::AttitudeReference _AttitudeReference;
+    ThrottleToAttitude(thr_sp, yaw_sp, _AttitudeReference);
     return _AttitudeReference;
 }
 
+// 微分平坦前馈：由期望推力矢量的一、二阶导数及偏航角速度计算机体角速度、角加速度及油门变化率前馈
+// 需在ThrottleToAttitude之后调用，机体轴取期望姿态desired_att_q；推力矢量的导数来源见attitude_feedforward.h
+// Ref to : Faessler M, et al. Differential Flatness of Quadrotor Dynamics Subject to Rotor Drag for Accurate Tracking of High-Speed Trajectories. RA-L 2018.
+//   v = c z_b 为期望推力方向上的矢量，v' = c' z_b + c (w_y x_b - w_x y_b)  =>  w_x = -y_b·v' / c,  w_y = x_b·v' / c,  c' = z_b·v'
+//   w_z = (yaw_rate x_c·x_b + w_y y_c·z_b) / |y_c × z_b|
+//   v''在x_b, y_b上的投影 => 角加速度(roll pitch)
+// [Input: v, v', v'' (同一单位), c_min: c的下限（防止自由落体附近除零）, 期望偏航角及偏航角速度]
+void flatness_feedforward(const Eigen::Vector3d& v, const Eigen::Vector3d& v_dot, const Eigen::Vector3d& v_ddot, double c_min,
+                          float yaw, float yaw_rate, px4_command::AttitudeReference& _AttitudeReference)
+{
+    Eigen::Quaterniond q_sp(_AttitudeReference.desired_att_q.w, _AttitudeReference.desired_att_q.x,
+                            _AttitudeReference.desired_att_q.y, _AttitudeReference.desired_att_q.z);
+    Eigen::Matrix3d R_sp = q_sp.normalized().toRotationMatrix();
+
+    Eigen::Vector3d body_x = R_sp.col(0);
+    Eigen::Vector3d body_y = R_sp.col(1);
+    Eigen::Vector3d body_z = R_sp.col(2);
+
+    double c = body_z.dot(v);
+    if(c < c_min)
+    {
+        c = c_min;
+    }
+
+    double c_dot = body_z.dot(v_dot);
+
+    double w_x = - body_y.dot(v_dot) / c;
+    double w_y = body_x.dot(v_dot) / c;
+
+    Eigen::Vector3d x_c(cos(yaw), sin(yaw), 0.0);
+    Eigen::Vector3d y_c(-sin(yaw), cos(yaw), 0.0);
+
+    double w_z = 0.0;
+    double y_c_cross_z = y_c.cross(body_z).norm();
+    if(y_c_cross_z > 1e-3)
+    {
+        w_z = (yaw_rate * x_c.dot(body_x) + w_y * y_c.dot(body_z)) / y_c_cross_z;
+    }
+
+    _AttitudeReference.desired_rate_ff[0] = w_x;
+    _AttitudeReference.desired_rate_ff[1] = w_y;
+    _AttitudeReference.desired_rate_ff[2] = w_z;
+
+    _AttitudeReference.desired_angular_acc_ff[0] = - (body_y.dot(v_ddot) + 2.0 * c_dot * w_x) / c + w_y * w_z;
+    _AttitudeReference.desired_angular_acc_ff[1] = (body_x.dot(v_ddot) - 2.0 * c_dot * w_y) / c - w_x * w_z;
+    _AttitudeReference.desired_angular_acc_ff[2] = 0.0;
+
+    _AttitudeReference.desired_throttle_rate_ff = c_dot / c;
+}
+
+// 由参考轨迹计算：v = a_ref + g，只有期望姿态由参考加速度主导时（如SE3）才与实际发出的期望姿态一致
+void flatness_feedforward(const px4_command::TrajectoryPoint& _Reference_State, px4_command::AttitudeReference& _AttitudeReference)
+{
+    Eigen::Vector3d accel(_Reference_State.acceleration_ref[0], _Reference_State.acceleration_ref[1], _Reference_State.acceleration_ref[2] + 9.81);
+    Eigen::Vector3d jerk(_Reference_State.jerk_ref[0], _Reference_State.jerk_ref[1], _Reference_State.jerk_ref[2]);
+    Eigen::Vector3d snap(_Reference_State.snap_ref[0], _Reference_State.snap_ref[1], _Reference_State.snap_ref[2]);
+
+    flatness_feedforward(accel, jerk, snap, 1.0, _Reference_State.yaw_ref, _Reference_State.yaw_rate_ref, _AttitudeReference);
+}
+
+// 按前馈将期望姿态及油门向前推算dt：用于位置环两次更新之间（机载姿态环）或补偿姿态环的响应滞后（超前量）
+void propagate_attitude_reference(float dt, px4_command::AttitudeReference& _AttitudeReference)
+{
+    Eigen::Vector3d rate(_AttitudeReference.desired_rate_ff[0], _AttitudeReference.desired_rate_ff[1], _AttitudeReference.desired_rate_ff[2]);
+    Eigen::Vector3d angular_acc(_AttitudeReference.desired_angular_acc_ff[0], _AttitudeReference.desired_angular_acc_ff[1], _AttitudeReference.desired_angular_acc_ff[2]);
+
+    // 中点角速度，机体系转动右乘
+    Eigen::Vector3d rotation = (rate + 0.5 * dt * angular_acc) * dt;
+
+    Eigen::Quaterniond q_sp(_AttitudeReference.desired_att_q.w, _AttitudeReference.desired_att_q.x,
+                            _AttitudeReference.desired_att_q.y, _AttitudeReference.desired_att_q.z);
+
+    if(rotation.norm() > 1e-9)
+    {
+        q_sp = q_sp * Eigen::Quaterniond(Eigen::AngleAxisd(rotation.norm(), rotation.normalized()));
+        q_sp.normalize();
+    }
+
+    rate = rate + angular_acc * dt;
+
+    _AttitudeReference.desired_throttle = _AttitudeReference.desired_throttle * (1.0 + _AttitudeReference.desired_throttle_rate_ff * dt);
+
+    Eigen::Vector3d throttle_sp = _AttitudeReference.desired_throttle * (q_sp * Eigen::Vector3d::UnitZ());
+    Eigen::Vector3d att_sp = quaternion_to_euler(q_sp);
+
+    for(int i = 0; i < 3; i++)
+    {
+        _AttitudeReference.desired_rate_ff[i] = rate[i];
+        _AttitudeReference.throttle_sp[i] = throttle_sp[i];
+        _AttitudeReference.desired_attitude[i] = att_sp[i];
+    }
+
+    _AttitudeReference.desired_att_q.w = q_sp.w();
+    _AttitudeReference.desired_att_q.x = q_sp.x();
+    _AttitudeReference.desired_att_q.y = q_sp.y();
+    _AttitudeReference.desired_att_q.z = q_sp.z();
+}
+
 //random number Generation
 //if a = 0 b =0, random_num = [-1,1]
 //rand函数，C语言中用来产生一个随机数的函数
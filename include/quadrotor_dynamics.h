@@ -0,0 +1,295 @@
+/***************************************************************************************************************************
+* quadrotor_dynamics.h
+*
+* Author: Qyp
+*
+* Update Time: 2019.7.26
+*
+* Introduction:  Headless 6-DOF rigid-body quadrotor model for closed-loop testing without Gazebo
+*         1. 输入为位置控制器的输出AttitudeReference（期望姿态四元数 + 期望油门），与发送至飞控的指令一致
+*            或机载姿态环的输出（期望机体角速度 + 期望油门，对应send_attitude_rate_setpoint），此时跳过模型中的姿态环
+*         2. 油门->推力使用与px4_command_utils::thrustToThrottle相同的电机曲线(MOTOR_P1..P5)求逆，电机推力一阶延迟
+*         3. 飞控姿态环简化为：姿态P控制 -> 期望角速度(限幅) -> 角速度P控制输出力矩，刚体欧拉方程积分
+*         4. 平动：重力、机体z轴推力、线性阻力及外部扰动力，半隐式欧拉积分，地面处z方向速度置0
+*         5. 所有量均为ENU系（机体系为FLU），与mavros中的状态量一致
+***************************************************************************************************************************/
+#ifndef QUADROTOR_DYNAMICS_H
+#define QUADROTOR_DYNAMICS_H
+
+#include <ros/ros.h>
+#include <Eigen/Eigen>
+#include <math.h>
+#include <vector>
+#include <math_utils.h>
+#include <px4_command_utils.h>
+#include <px4_command/DroneState.h>
+#include <px4_command/AttitudeReference.h>
+
+using namespace std;
+
+// 油门-推力查找表的格数
+#define THROTTLE_TABLE_SIZE 256
+
+class quadrotor_dynamics
+{
+    public:
+
+        //构造函数
+        quadrotor_dynamics(void):
+            quad_nh("~")
+        {
+            quad_nh.param<float>("Quad/mass", mass, 1.0);
+
+            quad_nh.param<float>("Sim/Ixx", inertia[0], 0.012);
+            quad_nh.param<float>("Sim/Iyy", inertia[1], 0.012);
+            quad_nh.param<float>("Sim/Izz", inertia[2], 0.02);
+            quad_nh.param<float>("Sim/att_p", att_p, 6.5);
+            quad_nh.param<float>("Sim/yaw_p", yaw_p, 2.8);
+            quad_nh.param<float>("Sim/rate_p", rate_p, 20.0);
+            quad_nh.param<float>("Sim/rate_max", rate_max, 220.0);
+            quad_nh.param<float>("Sim/motor_tau", motor_tau, 0.03);
+            quad_nh.param<float>("Sim/drag", drag, 0.1);
+
+            build_throttle_table();
+
+            reset(Eigen::Vector3d(0.0,0.0,0.0), 0.0);
+        }
+
+        //Parameter
+        float mass;                         // [kg]
+        Eigen::Vector3f inertia;            // [kg m^2]
+        float att_p;                        // 姿态环P（roll pitch）
+        float yaw_p;                        // 姿态环P（yaw）
+        float rate_p;                       // 角速度环P [1/s]
+        float rate_max;                     // 最大角速度 [deg/s]
+        float motor_tau;                    // 电机时间常数 [s]
+        float drag;                         // 线性阻力系数 [N/(m/s)]
+
+        //State [ENU]
+        Eigen::Vector3d position;
+        Eigen::Vector3d velocity;
+        Eigen::Vector3d acceleration;
+        Eigen::Quaterniond q;               // 机体系至ENU系
+        Eigen::Vector3d omega;              // 机体系角速度 [rad/s]
+        double thrust;                      // 总推力 [N]
+        double time;                        // 仿真时间 [s]
+
+        //外部扰动力 [N]
+        Eigen::Vector3d disturbance;
+
+        // 重置至给定位置悬停
+        void reset(const Eigen::Vector3d& pos, float yaw);
+
+        // 设置控制输入（即发送至飞控的期望姿态及期望油门）
+        void set_attitude_reference(const px4_command::AttitudeReference& _AttitudeReference);
+
+        // 设置控制输入（即发送至飞控的期望机体角速度[rad/s]及期望油门）
+        void set_rate_reference(const Eigen::Vector3d& rate_reference, double throttle);
+
+        // 积分一步 [Input: dt [s]]
+        void step(double dt);
+
+        // 输出状态，与px4_pos_estimator发布的DroneState一致
+        void get_state(px4_command::DroneState& _DroneState);
+
+        // 单个电机：油门[0-1] -> 推力[N]，为thrustToThrottle的反函数
+        double throttle_to_thrust(double throttle);
+
+        void printf_param();
+
+    private:
+
+        ros::NodeHandle quad_nh;
+
+        Eigen::Quaterniond q_sp;
+        Eigen::Vector3d rate_ref;
+        double throttle_sp;
+        bool rate_input;                    // true for 输入为期望角速度
+
+        // 查找表：推力均匀分格，对应油门单调递增
+        vector<double> table_throttle;
+        double table_thrust_step;
+
+        void build_throttle_table();
+};
+
+void quadrotor_dynamics::build_throttle_table()
+{
+    table_throttle.resize(THROTTLE_TABLE_SIZE + 1);
+    table_thrust_step = thrust_max_single_motor / THROTTLE_TABLE_SIZE;
+
+    for(int i = 0; i <= THROTTLE_TABLE_SIZE; i++)
+    {
+        double thrust_i = i * table_thrust_step;
+        table_throttle[i] = px4_command_utils::thrustToThrottle(Eigen::Vector3d(thrust_i, thrust_i, thrust_i))[0];
+    }
+}
+
+double quadrotor_dynamics::throttle_to_thrust(double throttle)
+{
+    if(throttle <= table_throttle[0])
+    {
+        return 0.0;
+    }
+
+    if(throttle >= table_throttle[THROTTLE_TABLE_SIZE])
+    {
+        return thrust_max_single_motor;
+    }
+
+    // 二分查找所在格，格内线性插值
+    int low = 0;
+    int high = THROTTLE_TABLE_SIZE;
+    while(high - low > 1)
+    {
+        int mid = (low + high) / 2;
+        if(table_throttle[mid] <= throttle)
+        {
+            low = mid;
+        }else
+        {
+            high = mid;
+        }
+    }
+
+    double ratio = (throttle - table_throttle[low]) / (table_throttle[high] - table_throttle[low]);
+
+    return (low + ratio) * table_thrust_step;
+}
+
+void quadrotor_dynamics::reset(const Eigen::Vector3d& pos, float yaw)
+{
+    position = pos;
+    velocity = Eigen::Vector3d(0.0,0.0,0.0);
+    acceleration = Eigen::Vector3d(0.0,0.0,0.0);
+    omega = Eigen::Vector3d(0.0,0.0,0.0);
+    disturbance = Eigen::Vector3d(0.0,0.0,0.0);
+    q = Eigen::Quaterniond(Eigen::AngleAxisd(yaw, Eigen::Vector3d::UnitZ()));
+    q_sp = q;
+    rate_ref = Eigen::Vector3d(0.0,0.0,0.0);
+    rate_input = false;
+    time = 0.0;
+
+    // 离地时以悬停推力开始，在地面时推力为0
+    thrust = pos[2] > 0.0 ? mass * 9.81 : 0.0;
+    throttle_sp = px4_command_utils::thrustToThrottle(Eigen::Vector3d(1.0,1.0,1.0) * thrust / NUM_MOTOR)[0];
+}
+
+void quadrotor_dynamics::set_attitude_reference(const px4_command::AttitudeReference& _AttitudeReference)
+{
+    q_sp = Eigen::Quaterniond(_AttitudeReference.desired_att_q.w, _AttitudeReference.desired_att_q.x,
+                              _AttitudeReference.desired_att_q.y, _AttitudeReference.desired_att_q.z);
+    q_sp.normalize();
+
+    throttle_sp = constrain_function2(_AttitudeReference.desired_throttle, 0.0, 1.0);
+    rate_input = false;
+}
+
+void quadrotor_dynamics::set_rate_reference(const Eigen::Vector3d& rate_reference, double throttle)
+{
+    rate_ref = rate_reference;
+    throttle_sp = constrain_function2(throttle, 0.0, 1.0);
+    rate_input = true;
+}
+
+void quadrotor_dynamics::step(double dt)
+{
+    // 电机：每个电机油门相同，推力一阶延迟
+    double thrust_cmd = NUM_MOTOR * throttle_to_thrust(throttle_sp);
+    double k_motor = motor_tau > dt ? dt / motor_tau : 1.0;
+    thrust = thrust + (thrust_cmd - thrust) * k_motor;
+
+    // 姿态环：误差四元数 -> 期望角速度（机体系）；输入为期望角速度时跳过
+    Eigen::Vector3d rate_sp;
+    if(rate_input)
+    {
+        rate_sp = rate_ref;
+    }else
+    {
+        Eigen::Quaterniond q_error = q.conjugate() * q_sp;
+        if(q_error.w() < 0.0)
+        {
+            q_error.coeffs() = -q_error.coeffs();
+        }
+
+        rate_sp[0] = 2.0 * att_p * q_error.x();
+        rate_sp[1] = 2.0 * att_p * q_error.y();
+        rate_sp[2] = 2.0 * yaw_p * q_error.z();
+    }
+
+    double rate_max_rad = rate_max / 180.0 * M_PI;
+    for(int i = 0; i < 3; i++)
+    {
+        rate_sp[i] = constrain_function(rate_sp[i], rate_max_rad);
+    }
+
+    // 角速度环 + 刚体欧拉方程: J*omega_dot = torque - omega x (J*omega)
+    Eigen::Vector3d J = inertia.cast<double>();
+    Eigen::Vector3d torque = J.cwiseProduct(rate_p * (rate_sp - omega));
+    Eigen::Vector3d omega_dot = (torque - omega.cross(J.cwiseProduct(omega))).cwiseQuotient(J);
+
+    omega = omega + omega_dot * dt;
+
+    double angle = omega.norm() * dt;
+    if(angle > 1e-9)
+    {
+        q = q * Eigen::Quaterniond(Eigen::AngleAxisd(angle, omega.normalized()));
+        q.normalize();
+    }
+
+    // 平动
+    Eigen::Vector3d force = q * Eigen::Vector3d(0.0, 0.0, thrust) - drag * velocity + disturbance;
+    acceleration = force / mass - Eigen::Vector3d(0.0, 0.0, 9.81);
+
+    velocity = velocity + acceleration * dt;
+    position = position + velocity * dt;
+
+    // 地面
+    if(position[2] <= 0.0)
+    {
+        position[2] = 0.0;
+        if(velocity[2] < 0.0)
+        {
+            velocity = Eigen::Vector3d(0.0,0.0,0.0);
+        }
+    }
+
+    time = time + dt;
+}
+
+void quadrotor_dynamics::get_state(px4_command::DroneState& _DroneState)
+{
+    _DroneState.connected = true;
+    _DroneState.armed = true;
+    _DroneState.mode = "OFFBOARD";
+    _DroneState.flight_mode = px4_command::DroneState::MODE_OFFBOARD;
+    _DroneState.time_from_start = time;
+
+    Eigen::Vector3d euler = quaternion_to_euler(q);
+
+    for(int i = 0; i < 3; i++)
+    {
+        _DroneState.position[i] = position[i];
+        _DroneState.velocity[i] = velocity[i];
+        _DroneState.attitude[i] = euler[i];
+        _DroneState.attitude_rate[i] = omega[i];
+        _DroneState.acceleration[i] = acceleration[i];
+    }
+
+    _DroneState.attitude_q.w = q.w();
+    _DroneState.attitude_q.x = q.x();
+    _DroneState.attitude_q.y = q.y();
+    _DroneState.attitude_q.z = q.z();
+}
+
+void quadrotor_dynamics::printf_param()
+{
+    cout <<">>>>>>>>>>>>>>>>>>>>>>>>>>>>>> Quadrotor Dynamics <<<<<<<<<<<<<<<<<<<<<<<<<<" <<endl;
+    cout <<"mass : "<< mass << " [kg] " << endl;
+    cout <<"inertia : "<< inertia[0] << " " << inertia[1] << " " << inertia[2] << " [kg m^2] " << endl;
+    cout <<"att_p : "<< att_p << "  yaw_p : "<< yaw_p << "  rate_p : "<< rate_p << "  rate_max : "<< rate_max << " [deg/s] " << endl;
+    cout <<"motor_tau : "<< motor_tau << " [s]  drag : "<< drag << endl;
+    cout <<"hover throttle : "<< px4_command_utils::thrustToThrottle(Eigen::Vector3d(1.0,1.0,1.0) * mass * 9.81 / NUM_MOTOR)[0] << endl;
+}
+
+#endif
@@ -0,0 +1,299 @@
+/***************************************************************************************************************************
+* realtime_loop.h
+*
+* Author: Qyp
+*
+* Update Time: 2019.7.20
+*
+* Introduction:  Fixed-rate loop timer for the control node
+*         1. 使用CLOCK_MONOTONIC绝对时间唤醒(clock_nanosleep + TIMER_ABSTIME)，不受系统时间跳变影响，周期误差不累积
+*         2. 可选实时调度：SCHED_FIFO优先级、CPU亲和性、mlockall锁定内存，用于Odroid等机载电脑负载较高时保证控制频率
+*         3. 统计每个周期的实际周期、计算耗时、唤醒抖动，以及超时(deadline miss)次数
+*         4. 超时定义：本周期计算结束时已经超过下一周期的唤醒时刻。超时后以当前时刻重新对齐，不做补偿性连续执行
+*         5. 开启实时调度需要root权限或CAP_SYS_NICE，失败时退回普通调度并给出提示
+*         6. 事件驱动模式下由外部事件触发周期（begin_cycle/end_cycle/rearm），抖动为相对标称周期的到达偏差
+***************************************************************************************************************************/
+#ifndef REALTIME_LOOP_H
+#define REALTIME_LOOP_H
+
+#include <ros/ros.h>
+#include <time.h>
+#include <sched.h>
+#include <pthread.h>
+#include <string.h>
+#include <errno.h>
+#include <sys/mman.h>
+#include <vector>
+#include <algorithm>
+
+#include <px4_command/ControlLoopStatus.h>
+
+using namespace std;
+
+// 统计窗口长度（周期数）
+#define LOOP_STAT_WINDOW 1000
+
+class realtime_loop
+{
+    public:
+
+        //构造函数
+        realtime_loop(void)
+        {
+            loop_rate       = 50.0;
+            period_ns       = 20000000;
+            use_realtime    = 0;
+            rt_priority     = 0;
+            cpu_id          = -1;
+            realtime_active = false;
+
+            cycle_count     = 0;
+            deadline_miss   = 0;
+            sample_index    = 0;
+            sample_num      = 0;
+
+            period_sample.assign(LOOP_STAT_WINDOW, 0.0f);
+            compute_sample.assign(LOOP_STAT_WINDOW, 0.0f);
+            jitter_sample.assign(LOOP_STAT_WINDOW, 0.0f);
+            sort_buffer.assign(LOOP_STAT_WINDOW, 0.0f);
+        }
+
+        //Desired loop rate [Hz]
+        float loop_rate;
+
+        //1 for SCHED_FIFO + cpu affinity, 0 for normal scheduling
+        int use_realtime;
+        int rt_priority;
+        int cpu_id;
+
+        //Whether the realtime setting is applied successfully
+        bool realtime_active;
+
+        //Number of cycles and number of overruns since start
+        unsigned int cycle_count;
+        unsigned int deadline_miss;
+
+        // 设置频率及调度方式，需在控制线程中调用 [Input: rate, realtime flag, priority(1-99), cpu id(-1 for no affinity)]
+        void init(float rate, int realtime, int priority, int cpu);
+
+        // 记录起始时刻，第一个周期从此刻开始
+        void start();
+
+        // 周期开始，返回与上一周期开始之间的实际时间间隔 [s]
+        float begin_cycle();
+
+        // 周期内计算结束，记录计算耗时
+        void end_cycle();
+
+        // 睡眠至下一周期的唤醒时刻
+        void sleep();
+
+        // 事件驱动时不调用sleep()，以本周期开始时刻加标称周期作为下一周期的期望开始时刻（用于统计抖动）
+        void rearm();
+
+        // 填充诊断消息，百分位数在此计算（对统计窗口做nth_element）
+        // 控制节点每秒调用一次，在end_cycle()之后，不计入本周期的计算耗时
+        void fill_status(px4_command::ControlLoopStatus& status);
+
+        void printf_param();
+
+    private:
+
+        long period_ns;
+
+        struct timespec next_wakeup;        // 本周期计划唤醒时刻
+        struct timespec cycle_start;        // 本周期实际开始时刻
+        struct timespec last_cycle_start;
+
+        vector<float> period_sample;        // [ms]
+        vector<float> compute_sample;       // [ms]
+        vector<float> jitter_sample;        // [ms]
+        vector<float> sort_buffer;
+        int sample_index;
+        int sample_num;
+
+        static long diff_ns(const struct timespec& a, const struct timespec& b)
+        {
+            return (a.tv_sec - b.tv_sec) * 1000000000L + (a.tv_nsec - b.tv_nsec);
+        }
+
+        static void add_ns(struct timespec& t, long ns)
+        {
+            t.tv_nsec += ns;
+            while (t.tv_nsec >= 1000000000L)
+            {
+                t.tv_nsec -= 1000000000L;
+                t.tv_sec++;
+            }
+        }
+
+        void percentile(const vector<float>& sample, float& p50, float& p99, float& max);
+};
+
+void realtime_loop::init(float rate, int realtime, int priority, int cpu)
+{
+    loop_rate    = rate > 1.0 ? rate : 1.0;
+    period_ns    = (long)(1e9 / loop_rate);
+    use_realtime = realtime;
+    rt_priority  = priority;
+    cpu_id       = cpu;
+
+    realtime_active = false;
+
+    if(use_realtime != 1)
+    {
+        return;
+    }
+
+    realtime_active = true;
+
+    // 锁定内存，避免缺页中断导致的延迟
+    if(mlockall(MCL_CURRENT | MCL_FUTURE) != 0)
+    {
+        cout << "[realtime_loop] mlockall failed: " << strerror(errno) << endl;
+    }
+
+    struct sched_param param;
+    param.sched_priority = rt_priority;
+    if(param.sched_priority < sched_get_priority_min(SCHED_FIFO)) param.sched_priority = sched_get_priority_min(SCHED_FIFO);
+    if(param.sched_priority > sched_get_priority_max(SCHED_FIFO)) param.sched_priority = sched_get_priority_max(SCHED_FIFO);
+
+    int ret = pthread_setschedparam(pthread_self(), SCHED_FIFO, &param);
+    if(ret != 0)
+    {
+        cout << "[realtime_loop] SCHED_FIFO failed (need root or CAP_SYS_NICE): " << strerror(ret) << endl;
+        realtime_active = false;
+    }
+
+    if(cpu_id >= 0)
+    {
+        cpu_set_t cpuset;
+        CPU_ZERO(&cpuset);
+        CPU_SET(cpu_id, &cpuset);
+
+        ret = pthread_setaffinity_np(pthread_self(), sizeof(cpu_set_t), &cpuset);
+        if(ret != 0)
+        {
+            cout << "[realtime_loop] Set cpu affinity failed: " << strerror(ret) << endl;
+        }
+    }
+}
+
+void realtime_loop::start()
+{
+    clock_gettime(CLOCK_MONOTONIC, &next_wakeup);
+    cycle_start = next_wakeup;
+    last_cycle_start = next_wakeup;
+}
+
+float realtime_loop::begin_cycle()
+{
+    clock_gettime(CLOCK_MONOTONIC, &cycle_start);
+
+    long period_now = diff_ns(cycle_start, last_cycle_start);
+    long jitter_now = diff_ns(cycle_start, next_wakeup);
+
+    last_cycle_start = cycle_start;
+
+    period_sample[sample_index] = period_now / 1e6;
+    jitter_sample[sample_index] = (jitter_now > 0 ? jitter_now : -jitter_now) / 1e6;
+
+    return period_now / 1e9;
+}
+
+void realtime_loop::end_cycle()
+{
+    struct timespec cycle_end;
+    clock_gettime(CLOCK_MONOTONIC, &cycle_end);
+
+    compute_sample[sample_index] = diff_ns(cycle_end, cycle_start) / 1e6;
+
+    sample_index = (sample_index + 1) % LOOP_STAT_WINDOW;
+    if(sample_num < LOOP_STAT_WINDOW)
+    {
+        sample_num++;
+    }
+
+    cycle_count++;
+}
+
+void realtime_loop::sleep()
+{
+    add_ns(next_wakeup, period_ns);
+
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+
+    // 计算已经超过下一周期的唤醒时刻：记为超时，并以当前时刻重新对齐
+    if(diff_ns(now, next_wakeup) > 0)
+    {
+        deadline_miss++;
+        next_wakeup = now;
+        return;
+    }
+
+    while(clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &next_wakeup, NULL) == EINTR)
+    {
+    }
+}
+
+void realtime_loop::rearm()
+{
+    next_wakeup = cycle_start;
+    add_ns(next_wakeup, period_ns);
+}
+
+void realtime_loop::percentile(const vector<float>& sample, float& p50, float& p99, float& max)
+{
+    if(sample_num == 0)
+    {
+        p50 = p99 = max = 0.0;
+        return;
+    }
+
+    std::copy(sample.begin(), sample.begin() + sample_num, sort_buffer.begin());
+
+    vector<float>::iterator end = sort_buffer.begin() + sample_num;
+
+    int i50 = (sample_num - 1) * 50 / 100;
+    int i99 = (sample_num - 1) * 99 / 100;
+
+    std::nth_element(sort_buffer.begin(), sort_buffer.begin() + i99, end);
+    p99 = sort_buffer[i99];
+    max = *std::max_element(sort_buffer.begin() + i99, end);
+
+    std::nth_element(sort_buffer.begin(), sort_buffer.begin() + i50, sort_buffer.begin() + i99);
+    p50 = sort_buffer[i50];
+}
+
+void realtime_loop::fill_status(px4_command::ControlLoopStatus& status)
+{
+    status.header.stamp = ros::Time::now();
+
+    status.rate_desired = loop_rate;
+    status.realtime = realtime_active;
+    status.cycle_count = cycle_count;
+    status.deadline_miss = deadline_miss;
+    status.window = sample_num;
+
+    percentile(period_sample, status.period[0], status.period[1], status.period[2]);
+    percentile(compute_sample, status.compute_time[0], status.compute_time[1], status.compute_time[2]);
+    percentile(jitter_sample, status.jitter[0], status.jitter[1], status.jitter[2]);
+
+    float period_sum = 0.0;
+    for(int i = 0; i < sample_num; i++)
+    {
+        period_sum += period_sample[i];
+    }
+    status.rate_actual = (period_sum > 0) ? 1000.0 * sample_num / period_sum : 0.0;
+}
+
+void realtime_loop::printf_param()
+{
+    cout <<">>>>>>>>>>>>>>>>>>>>>>>>>>>>>> Control Loop <<<<<<<<<<<<<<<<<<<<<<<<<<<<" <<endl;
+    cout << "loop_rate : "<< loop_rate << " [Hz] " << endl;
+    cout << "realtime : "<< use_realtime << "  priority : " << rt_priority << "  cpu_id : " << cpu_id << endl;
+    cout << "realtime_active : "<< realtime_active << endl;
+}
+
+#endif
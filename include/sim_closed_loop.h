@@ -0,0 +1,419 @@
+/***************************************************************************************************************************
+* sim_closed_loop.h
+*
+* Author: Qyp
+*
+* Update Time: 2019.7.26
+*
+* Introduction:  Closed-loop simulation of a position controller with quadrotor_dynamics
+*         1. 与px4_pos_controller相同的控制链：pos_controller -> ThrottleToAttitude(或控制器的attitude_reference) -> AttitudeReference -> 飞控(此处为模型)
+*         2. 控制器按Control_loop/rate执行，模型按Sim/dt积分，不做任何等待，运行速度远快于实时
+*         3. 参考轨迹：Sim/reference 0 for 定点阶跃(Sim/target_*), 1 for 解析轨迹(Trajectory_type及对应轨迹参数，见trajectory_registry.h)
+*         4. 输出跟踪误差等指标，可选输出csv文件用于作图
+*         5. Body_rate/enable = 1 时与px4_pos_controller的机载姿态环模式一致：每个控制周期执行att_controller并输入期望角速度，
+*            位置环每Body_rate/pos_divider个周期执行一次
+*         6. Feedforward/enable非0时与px4_pos_controller一致叠加姿态前馈（见attitude_feedforward.h；enable为2时阶跃参考量的前馈为0）
+*         7. Sim/disturbance_* 非0时在[disturbance_start, disturbance_end)内施加阶跃扰动力，用于对比扰动抑制
+*         8. 控制量指标control_effort为惯性系油门矢量(AttitudeReference.throttle_sp)变化率的均方根，反映控制器的激进程度及对噪声的放大
+*         9. Sim/payload 非0时模型携带负载，在payload_drop_time投放；Thrust_estimator/enable非0时与px4_pos_controller一致运行有效质量估计
+*         10. 姿态指标att_error：每次位置环更新时，实际机体z轴与本次期望机体z轴（前馈推算之前）的夹角均方根，反映姿态环的跟踪滞后
+***************************************************************************************************************************/
+#ifndef SIM_CLOSED_LOOP_H
+#define SIM_CLOSED_LOOP_H
+
+#include <ros/ros.h>
+#include <Eigen/Eigen>
+#include <math.h>
+#include <stdio.h>
+#include <string>
+
+#include <quadrotor_dynamics.h>
+#include <pos_controller_base.h>
+#include <att_controller.h>
+#include <trajectory_registry.h>
+#include <px4_command_utils.h>
+#include <thrust_estimator.h>
+#include <attitude_feedforward.h>
+
+#include <px4_command/DroneState.h>
+#include <px4_command/TrajectoryPoint.h>
+#include <px4_command/AttitudeReference.h>
+#include <px4_command/ControlOutput.h>
+
+using namespace std;
+
+// 仿真结果指标
+struct sim_result
+{
+    float rms_error;            // 位置误差均方根 [m]
+    float max_error;            // 位置误差最大值 [m]
+    float final_error;          // 结束时位置误差 [m]
+    float max_tilt;             // 最大倾斜角 [deg]
+    float control_effort;       // 油门矢量变化率均方根 [1/s]
+    float att_error;            // 位置环给出期望姿态时，实际机体z轴与期望机体z轴夹角的均方根（姿态环滞后） [deg]
+    float mass_estimate;        // 结束时有效质量估计 [kg]，未开启Thrust_estimator时为0
+    float time_sim;             // 仿真时长 [s]
+    float time_wall;            // 实际耗时 [s]
+    bool crashed;               // 触地、误差过大或出现nan
+};
+
+class sim_closed_loop
+{
+    public:
+
+        //构造函数
+        sim_closed_loop(void):
+            sim_nh("~")
+        {
+            sim_nh.param<float>("Sim/dt", dt_sim, 0.001);
+            sim_nh.param<float>("Sim/time_total", time_total, 20.0);
+            sim_nh.param<int>("Sim/reference", reference_type, 0);
+            sim_nh.param<float>("Sim/init_x", init_pos[0], 0.0);
+            sim_nh.param<float>("Sim/init_y", init_pos[1], 0.0);
+            sim_nh.param<float>("Sim/init_z", init_pos[2], 1.0);
+            sim_nh.param<float>("Sim/target_x", target_pos[0], 1.0);
+            sim_nh.param<float>("Sim/target_y", target_pos[1], 1.0);
+            sim_nh.param<float>("Sim/target_z", target_pos[2], 1.5);
+            sim_nh.param<float>("Sim/error_max", error_max, 10.0);
+            sim_nh.param<float>("Sim/disturbance_x", disturbance[0], 0.0);
+            sim_nh.param<float>("Sim/disturbance_y", disturbance[1], 0.0);
+            sim_nh.param<float>("Sim/disturbance_z", disturbance[2], 0.0);
+            sim_nh.param<float>("Sim/disturbance_start", disturbance_start, 5.0);
+            sim_nh.param<float>("Sim/disturbance_end", disturbance_end, 15.0);
+            sim_nh.param<float>("Sim/payload", payload, 0.0);
+            sim_nh.param<float>("Sim/payload_drop_time", payload_drop_time, 10.0);
+            sim_nh.param<int>("Thrust_estimator/enable", thrust_estimation, 0);
+
+            sim_nh.param<float>("Control_loop/rate", control_rate, 50.0);
+            sim_nh.param<int>("Body_rate/enable", body_rate, 0);
+            sim_nh.param<int>("Body_rate/pos_divider", pos_divider, 5);
+            if(pos_divider < 1) pos_divider = 1;
+            sim_nh.param<int>("Feedforward/enable", feedforward, 0);
+            sim_nh.param<float>("Feedforward/lead_time", feedforward_lead, 0.02);
+
+            sim_nh.param<int>("Trajectory_type", trajectory_type, 0);
+            _parametric_trajectory = trajectory_registry::create(trajectory_type);
+            if(_parametric_trajectory == NULL)
+            {
+                trajectory_type = trajectory_registry::Circle;
+                _parametric_trajectory = trajectory_registry::create(trajectory_type);
+            }
+
+            mass_empty = quad.mass;
+        }
+
+        ~sim_closed_loop()
+        {
+            delete _parametric_trajectory;
+        }
+
+        float dt_sim;
+        float time_total;
+        float control_rate;
+        int body_rate;                  // 1 for 机载姿态环（期望角速度输入）
+        int pos_divider;                // 机载姿态环模式下位置环分频
+        int feedforward;                // 同Feedforward/enable
+        float feedforward_lead;         // 非机载姿态环模式下期望姿态的超前时间 [s]
+        int reference_type;
+        int trajectory_type;            // Sim/reference为1时的解析轨迹编号，同Parameter_for_control.yaml中的Trajectory_type
+        Eigen::Vector3f init_pos;
+        Eigen::Vector3f target_pos;
+        float error_max;
+        Eigen::Vector3f disturbance;    // 外部扰动力 [N]，在[disturbance_start, disturbance_end)内阶跃作用
+        float disturbance_start;
+        float disturbance_end;
+        float payload;                  // 负载质量 [kg]，在payload_drop_time [s]投放
+        float payload_drop_time;
+        float mass_empty;               // 不含负载的模型质量 (Quad/mass) [kg]
+        int thrust_estimation;          // 同Thrust_estimator/enable
+
+        quadrotor_dynamics quad;
+        parametric_trajectory* _parametric_trajectory;      //Sim/reference为1时由Trajectory_type创建
+        att_controller _att_controller;
+        thrust_estimator _thrust_estimator;
+        attitude_feedforward _attitude_feedforward;
+
+        // 修改参考轨迹类型 [Input: Sim/reference, Trajectory_type (reference为1时有效)]
+        void set_reference(int _reference_type, int _trajectory_type);
+
+        // 参考轨迹 [Input: time from start]
+        px4_command::TrajectoryPoint reference(float time_from_start);
+
+        // 闭环仿真 [Input: controller, csv file name (empty for no log); Output: result]
+        sim_result run(pos_controller_base* controller, const string& log_file);
+
+        void printf_param();
+
+        void printf_result(const sim_result& result);
+
+    private:
+
+        ros::NodeHandle sim_nh;
+};
+
+void sim_closed_loop::set_reference(int _reference_type, int _trajectory_type)
+{
+    reference_type = _reference_type;
+
+    if(_reference_type == 1 && _trajectory_type != trajectory_type)
+    {
+        parametric_trajectory* _trajectory = trajectory_registry::create(_trajectory_type);
+        if(_trajectory != NULL)
+        {
+            delete _parametric_trajectory;
+            _parametric_trajectory = _trajectory;
+            trajectory_type = _trajectory_type;
+        }
+    }
+}
+
+px4_command::TrajectoryPoint sim_closed_loop::reference(float time_from_start)
+{
+    if(reference_type == 1)
+    {
+        px4_command::TrajectoryPoint _Reference_State;
+        _parametric_trajectory->sample(time_from_start, _Reference_State);
+        return _Reference_State;
+    }
+
+    px4_command::TrajectoryPoint _Reference_State;
+    _Reference_State.Sub_mode = command_to_mavros::XYZ_POS;
+    for(int i = 0; i < 3; i++)
+    {
+        _Reference_State.position_ref[i] = target_pos[i];
+        _Reference_State.velocity_ref[i] = 0.0;
+        _Reference_State.acceleration_ref[i] = 0.0;
+    }
+    _Reference_State.yaw_ref = 0.0;
+    _Reference_State.time_from_start = time_from_start;
+
+    return _Reference_State;
+}
+
+sim_result sim_closed_loop::run(pos_controller_base* controller, const string& log_file)
+{
+    sim_result result;
+    result.rms_error = 0.0;
+    result.max_error = 0.0;
+    result.final_error = 0.0;
+    result.max_tilt = 0.0;
+    result.control_effort = 0.0;
+    result.att_error = 0.0;
+    result.mass_estimate = 0.0;
+    result.crashed = false;
+
+    FILE* fp = NULL;
+    if(!log_file.empty())
+    {
+        fp = fopen(log_file.c_str(), "w");
+        if(fp != NULL)
+        {
+            fprintf(fp, "time,x,y,z,vx,vy,vz,roll,pitch,yaw,x_ref,y_ref,z_ref,throttle\n");
+        }
+    }
+
+    // 解析轨迹从轨迹起点开始，避免初始阶跃
+    Eigen::Vector3d start_pos = init_pos.cast<double>();
+    if(reference_type == 1)
+    {
+        px4_command::TrajectoryPoint start = reference(0.0);
+        start_pos = Eigen::Vector3d(start.position_ref[0], start.position_ref[1], start.position_ref[2]);
+    }
+
+    quad.mass = payload > 0.0 ? mass_empty + payload : mass_empty;
+    quad.reset(start_pos, 0.0);
+    _thrust_estimator.reset();
+    _attitude_feedforward.reset();
+    controller->set_initial_pos(start_pos);
+
+    float control_dt = 1.0 / control_rate;
+    int substeps = (int)(control_dt / dt_sim + 0.5);
+    if(substeps < 1) substeps = 1;
+    int control_steps = (int)(time_total * control_rate);
+
+    px4_command::DroneState _DroneState;
+    px4_command::TrajectoryPoint _Reference_State;
+    px4_command::ControlOutput _ControlOutput;
+    px4_command::AttitudeReference _AttitudeReference;
+    Eigen::Vector3d throttle_sp;
+    Eigen::Vector3d rate_sp;
+    int divider = body_rate == 1 ? pos_divider : 1;
+
+    double error_sum = 0.0;
+    double effort_sum = 0.0;
+    double att_error_sum = 0.0;
+    int att_error_num = 0;
+    int effort_num = 0;
+    Eigen::Vector3d throttle_last(0.0,0.0,0.0);
+    int k = 0;
+
+    ros::WallTime begin_time = ros::WallTime::now();
+
+    for(k = 0; k < control_steps; k++)
+    {
+        float t = k * control_dt;
+
+        quad.get_state(_DroneState);
+        _Reference_State = reference(t);
+
+        if(t >= disturbance_start && t < disturbance_end)
+        {
+            quad.disturbance = disturbance.cast<double>();
+        }else
+        {
+            quad.disturbance = Eigen::Vector3d(0.0,0.0,0.0);
+        }
+
+        if(payload > 0.0 && t >= payload_drop_time)
+        {
+            quad.mass = mass_empty;
+        }
+
+        // 位置环（机载姿态环模式下分频执行）
+        if(k % divider == 0)
+        {
+            // 当前加速度对应上一次发出的油门
+            if(thrust_estimation != 0 && k > 0)
+            {
+                _thrust_estimator.update(_DroneState, _AttitudeReference.desired_throttle, control_dt * divider);
+
+                if(thrust_estimation == 2 && _thrust_estimator.valid)
+                {
+                    controller->set_thrust_model(_thrust_estimator.mass, _thrust_estimator.hover_throttle);
+                }
+            }
+
+            controller->pos_controller(_DroneState, _Reference_State, control_dt * divider, _ControlOutput);
+
+            throttle_sp[0] = _ControlOutput.Throttle[0];
+            throttle_sp[1] = _ControlOutput.Throttle[1];
+            throttle_sp[2] = _ControlOutput.Throttle[2];
+
+            if(!controller->attitude_reference(_AttitudeReference))
+            {
+                px4_command_utils::ThrottleToAttitude(throttle_sp, _Reference_State.yaw_ref, _AttitudeReference);
+            }
+
+            Eigen::Quaterniond q_sp(_AttitudeReference.desired_att_q.w, _AttitudeReference.desired_att_q.x, _AttitudeReference.desired_att_q.y, _AttitudeReference.desired_att_q.z);
+            double cos_att = (quad.q * Eigen::Vector3d::UnitZ()).dot(q_sp.normalized() * Eigen::Vector3d::UnitZ());
+            double att_error = acos(constrain_function2(cos_att, -1.0, 1.0)) / M_PI * 180.0;
+            att_error_sum += att_error * att_error;
+            att_error_num++;
+
+            if(feedforward != 0)
+            {
+                _attitude_feedforward.update(_Reference_State, t, _AttitudeReference);
+
+                if(body_rate == 0 && feedforward_lead > 0.0)
+                {
+                    px4_command_utils::propagate_attitude_reference(feedforward_lead, _AttitudeReference);
+                }
+            }
+
+            Eigen::Vector3d throttle_now(_AttitudeReference.throttle_sp[0], _AttitudeReference.throttle_sp[1], _AttitudeReference.throttle_sp[2]);
+            if(k > 0)
+            {
+                effort_sum += (throttle_now - throttle_last).squaredNorm() / (control_dt * divider * control_dt * divider);
+                effort_num++;
+            }
+            throttle_last = throttle_now;
+        }else if(feedforward != 0)
+        {
+            px4_command_utils::propagate_attitude_reference(control_dt, _AttitudeReference);
+        }
+
+        if(body_rate == 1)
+        {
+            if(!controller->rate_control(quad.q, _AttitudeReference, rate_sp))
+            {
+                _att_controller.att_control(quad.q, _AttitudeReference, rate_sp);
+            }
+            quad.set_rate_reference(rate_sp, _AttitudeReference.desired_throttle);
+        }else
+        {
+            quad.set_attitude_reference(_AttitudeReference);
+        }
+
+        for(int j = 0; j < substeps; j++)
+        {
+            quad.step(control_dt / substeps);
+        }
+
+        // 指标
+        Eigen::Vector3d pos_ref(_Reference_State.position_ref[0], _Reference_State.position_ref[1], _Reference_State.position_ref[2]);
+        float error = (quad.position - pos_ref).norm();
+        float tilt = acos(constrain_function2((quad.q * Eigen::Vector3d::UnitZ())[2], -1.0, 1.0)) / M_PI * 180.0;
+
+        error_sum += error * error;
+        if(error > result.max_error) result.max_error = error;
+        if(tilt > result.max_tilt) result.max_tilt = tilt;
+        result.final_error = error;
+
+        if(fp != NULL)
+        {
+            fprintf(fp, "%.3f,%.4f,%.4f,%.4f,%.4f,%.4f,%.4f,%.4f,%.4f,%.4f,%.4f,%.4f,%.4f,%.4f\n", quad.time,
+                quad.position[0], quad.position[1], quad.position[2], quad.velocity[0], quad.velocity[1], quad.velocity[2],
+                _DroneState.attitude[0], _DroneState.attitude[1], _DroneState.attitude[2],
+                pos_ref[0], pos_ref[1], pos_ref[2], _AttitudeReference.desired_throttle);
+        }
+
+        if(error != error || error > error_max || (quad.position[2] <= 0.0 && start_pos[2] > 0.0))
+        {
+            result.crashed = true;
+            k++;
+            break;
+        }
+
+        // 同px4_pos_controller，每秒执行一次控制器的非实时操作
+        if(k % (int)control_rate == 0)
+        {
+            controller->non_realtime_update();
+        }
+    }
+
+    controller->non_realtime_update();
+
+    result.time_wall = (ros::WallTime::now() - begin_time).toSec();
+    result.time_sim = k * control_dt;
+    result.rms_error = k > 0 ? sqrt(error_sum / k) : 0.0;
+    result.control_effort = effort_num > 0 ? sqrt(effort_sum / effort_num) : 0.0;
+    result.att_error = att_error_num > 0 ? sqrt(att_error_sum / att_error_num) : 0.0;
+    result.mass_estimate = thrust_estimation != 0 ? _thrust_estimator.mass : 0.0;
+
+    if(fp != NULL)
+    {
+        fclose(fp);
+    }
+
+    return result;
+}
+
+void sim_closed_loop::printf_param()
+{
+    cout <<">>>>>>>>>>>>>>>>>>>>>>>>>>>>>> Closed-loop Simulation <<<<<<<<<<<<<<<<<<<<<<" <<endl;
+    cout <<"dt_sim : "<< dt_sim << " [s]  control_rate : "<< control_rate << " [Hz]  time_total : "<< time_total << " [s] " << endl;
+    cout <<"body_rate : "<< body_rate << "  pos_divider : "<< pos_divider << " (1 for onboard attitude loop) " << endl;
+    cout <<"feedforward : "<< feedforward << "  lead_time : "<< feedforward_lead << " [s] " << endl;
+    if(feedforward != 0) _attitude_feedforward.printf_param();
+    cout <<"reference : "<< reference_type << " (0 for step, 1 for parametric trajectory: "<< trajectory_registry::name(trajectory_type) <<") " << endl;
+    cout <<"init_pos : "<< init_pos[0] << " " << init_pos[1] << " " << init_pos[2] << " [m] " << endl;
+    cout <<"target_pos : "<< target_pos[0] << " " << target_pos[1] << " " << target_pos[2] << " [m] " << endl;
+    cout <<"payload : "<< payload << " [kg]  drop at "<< payload_drop_time << " [s]  Thrust_estimator : "<< thrust_estimation << endl;
+    cout <<"disturbance : "<< disturbance[0] << " " << disturbance[1] << " " << disturbance[2] << " [N]  from "<< disturbance_start << " to "<< disturbance_end << " [s] " << endl;
+}
+
+void sim_closed_loop::printf_result(const sim_result& result)
+{
+    cout.setf(ios::fixed);
+    cout << setprecision(4);
+    cout << "rms_error : "<< result.rms_error << " [m]  max_error : "<< result.max_error << " [m]  final_error : "<< result.final_error << " [m] " << endl;
+    cout << "max_tilt : "<< result.max_tilt << " [deg]  att_error : "<< result.att_error << " [deg]  control_effort : "<< result.control_effort << " [1/s]  crashed : "<< result.crashed << endl;
+    if(thrust_estimation != 0)
+    {
+        cout << "mass_estimate : "<< result.mass_estimate << " [kg]  model : "<< quad.mass << " [kg] " << endl;
+    }
+    cout << "time_sim : "<< result.time_sim << " [s]  time_wall : "<< result.time_wall << " [s]  real-time factor : "
+         << (result.time_wall > 0 ? result.time_sim / result.time_wall : 0.0) << endl;
+}
+
+#endif
@@ -7,9 +7,10 @@
 *
 * 主要功能：
 *    本库函数主要用于连接px4_command与mavros两个功能包。
-* 1、订阅mavros功能包发布的飞控状态量。状态量包括无人机状态、位置、速度、角度、角速度。
+* 1、订阅mavros功能包发布的飞控状态量。状态量包括无人机状态、位置、速度、角度、角速度、加速度。
 *     注： 这里并没有订阅所有可以来自飞控的消息，如需其他消息，请参阅mavros代码。
 *     注意：代码中，参与运算的角度均是以rad为单位，但是涉及到显示时或者需要手动输入时均以deg为单位。
+* 2、可指定回调队列（由调用者的AsyncSpinner在独立线程中处理），此时其他线程应通过snapshot读取状态，不要直接访问_DroneState。
 *
 ***************************************************************************************************************************/
 #ifndef STATE_FROM_MAVROS_H
@@ -30,6 +31,8 @@
 #include <bitset>
 #include <px4_command/AttitudeReference.h>
 #include <px4_command/DroneState.h>
+#include <ros/callback_queue.h>
+#include <state_snapshot.h>
 
 using namespace std;
 
@@ -37,9 +40,15 @@ class state_from_mavros
 {
     public:
     //constructed function
-    state_from_mavros(void):
+    // callback_queue为空时使用全局回调队列（由ros::spinOnce处理）
+    state_from_mavros(ros::CallbackQueueInterface* callback_queue = NULL):
         state_nh("~")
     {
+        if(callback_queue != NULL)
+        {
+            state_nh.setCallbackQueue(callback_queue);
+        }
+
         // 【订阅】无人机当前状态 - 来自飞控
         //  本话题来自飞控(通过Mavros功能包 /plugins/sys_status.cpp)
         state_sub = state_nh.subscribe<mavros_msgs::State>("/mavros/state", 10, &state_from_mavros::state_cb,this);
@@ -60,6 +69,9 @@ class state_from_mavros
     //变量声明 
     px4_command::DroneState _DroneState;
 
+    // 每次回调后发布的_DroneState，供其他线程无锁读取
+    state_snapshot<px4_command::DroneState> snapshot;
+
     private:
 
         ros::NodeHandle state_nh;
@@ -74,13 +86,44 @@ class state_from_mavros
             _DroneState.connected = msg->connected;
             _DroneState.armed = msg->armed;
             _DroneState.mode = msg->mode;
+            // 只在模式消息到达时解析一次字符串，控制循环中比较flight_mode
+            _DroneState.flight_mode = decode_flight_mode(msg->mode);
+
+            snapshot.write(_DroneState);
+        }
+
+        // PX4 custom_mode字符串 -> DroneState::MODE_*
+        uint8_t decode_flight_mode(const string& mode)
+        {
+            if(mode == "MANUAL")                return px4_command::DroneState::MODE_MANUAL;
+            if(mode == "ACRO")                  return px4_command::DroneState::MODE_ACRO;
+            if(mode == "ALTCTL")                return px4_command::DroneState::MODE_ALTCTL;
+            if(mode == "POSCTL")                return px4_command::DroneState::MODE_POSCTL;
+            if(mode == "OFFBOARD")              return px4_command::DroneState::MODE_OFFBOARD;
+            if(mode == "STABILIZED")            return px4_command::DroneState::MODE_STABILIZED;
+            if(mode == "RATTITUDE")             return px4_command::DroneState::MODE_RATTITUDE;
+            if(mode == "AUTO.MISSION")          return px4_command::DroneState::MODE_AUTO_MISSION;
+            if(mode == "AUTO.LOITER")           return px4_command::DroneState::MODE_AUTO_LOITER;
+            if(mode == "AUTO.RTL")              return px4_command::DroneState::MODE_AUTO_RTL;
+            if(mode == "AUTO.LAND")             return px4_command::DroneState::MODE_AUTO_LAND;
+            if(mode == "AUTO.TAKEOFF")          return px4_command::DroneState::MODE_AUTO_TAKEOFF;
+            if(mode == "AUTO.READY")            return px4_command::DroneState::MODE_AUTO_READY;
+            if(mode == "AUTO.PRECLAND")         return px4_command::DroneState::MODE_AUTO_PRECLAND;
+            if(mode == "AUTO.FOLLOW_TARGET")    return px4_command::DroneState::MODE_AUTO_FOLLOW_TARGET;
+            return px4_command::DroneState::MODE_UNKNOWN;
         }
 
         void pos_cb(const geometry_msgs::PoseStamped::ConstPtr &msg)
         {
+            // 记录定位数据时间戳及收到时刻，用于延迟追踪
+            _DroneState.header.stamp = msg->header.stamp;
+            _DroneState.stamp_received = ros::Time::now();
+
             _DroneState.position[0] = msg->pose.position.x;
             _DroneState.position[1] = msg->pose.position.y;
             _DroneState.position[2] = msg->pose.position.z;
+
+            snapshot.write(_DroneState);
         }
 
         void vel_cb(const geometry_msgs::TwistStamped::ConstPtr &msg)
@@ -88,6 +131,8 @@ class state_from_mavros
             _DroneState.velocity[0] = msg->twist.linear.x;
             _DroneState.velocity[1] = msg->twist.linear.y;
             _DroneState.velocity[2] = msg->twist.linear.z;
+
+            snapshot.write(_DroneState);
         }
 
         void att_cb(const sensor_msgs::Imu::ConstPtr& msg)
@@ -106,8 +151,18 @@ class state_from_mavros
             _DroneState.attitude[2] = euler_fcu[2];
 
             _DroneState.attitude_rate[0] = msg->angular_velocity.x;
-            _DroneState.attitude_rate[1] = msg->angular_velocity.x;
-            _DroneState.attitude_rate[2] = msg->angular_velocity.x;
+            _DroneState.attitude_rate[1] = msg->angular_velocity.y;
+            _DroneState.attitude_rate[2] = msg->angular_velocity.z;
+
+            // 比力(机体系) -> 加速度(ENU系)，静止时为0
+            Eigen::Vector3d specific_force(msg->linear_acceleration.x, msg->linear_acceleration.y, msg->linear_acceleration.z);
+            Eigen::Vector3d accel_enu = q_fcu * specific_force - Eigen::Vector3d(0.0, 0.0, 9.81);
+
+            _DroneState.acceleration[0] = accel_enu[0];
+            _DroneState.acceleration[1] = accel_enu[1];
+            _DroneState.acceleration[2] = accel_enu[2];
+
+            snapshot.write(_DroneState);
         }
 
 
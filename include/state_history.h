@@ -0,0 +1,240 @@
+/***************************************************************************************************************************
+* state_history.h
+*
+* Author: Qyp
+*
+* Update Time: 2019.8.27
+*
+* Introduction:  Short history of timestamped drone states, sampled at the controller tick
+*         1. 按header.stamp（定位数据源的时间戳）保存最近STATE_HISTORY_SIZE个DroneState，时间戳不大于最新一个的状态视为重复，不保存
+*            （px4_pos_estimator以100Hz发布，定位数据未更新时header.stamp不变）
+*         2. sample(t)给出t时刻的状态：两个状态之间位置用三次Hermite插值（两端的位置及速度），速度、加速度、角速度线性插值，
+*            姿态四元数slerp后重新计算欧拉角；连接、解锁、飞行模式等离散量取最新状态
+*         3. t晚于最新状态时按速度及角速度外推，外推时间限幅于extrapolation_max；t早于最早状态时返回最早状态
+*         4. 控制器在每个周期以 now - lag 采样：lag为0时得到当前时刻的状态（补偿定位延迟），lag略大于定位周期加延迟时只做插值
+*         5. 与回调到达时刻无关，状态的时刻与控制周期对齐，消除定位数据与控制周期之间的采样抖动
+***************************************************************************************************************************/
+#ifndef STATE_HISTORY_H
+#define STATE_HISTORY_H
+
+#include <ros/ros.h>
+#include <Eigen/Eigen>
+#include <math.h>
+#include <iostream>
+#include <math_utils.h>
+
+#include <px4_command/DroneState.h>
+
+using namespace std;
+
+#define STATE_HISTORY_SIZE 32
+
+class state_history
+{
+    public:
+
+        //构造函数
+        state_history(void):
+            history_nh("~")
+        {
+            history_nh.param<float>("State_history/lag", lag, 0.0);
+            history_nh.param<float>("State_history/extrapolation_max", extrapolation_max, 0.05);
+
+            if(extrapolation_max < 0.0) extrapolation_max = 0.0;
+
+            reset();
+        }
+
+        //Parameter
+        float lag;                          // 采样时刻相对于当前时刻的滞后 [s]
+        float extrapolation_max;            // 最大外推时间 [s]
+
+        //Statistics
+        unsigned int count_duplicate;       // 时间戳不递增而未保存的状态数
+        unsigned int count_extrapolated;    // 外推时间达到extrapolation_max的采样次数
+        float extrapolation_last;           // 上一次采样时刻与最新状态的时间差（插值时为负，未限幅） [s]
+
+        void reset();
+
+        // 保存一个状态，时间戳不递增时返回false
+        bool push(const px4_command::DroneState& _DroneState);
+
+        // [Input: 采样时刻 t [s]; Output: t时刻的状态, header.stamp保持为最新状态的时间戳（延迟追踪使用）]
+        // 无历史状态时返回false，state不变
+        bool sample(double t, px4_command::DroneState& _DroneState);
+
+        // 历史中的状态数
+        int size() const { return count; }
+
+        void printf_param();
+
+        void printf_result();
+
+    private:
+
+        ros::NodeHandle history_nh;
+
+        px4_command::DroneState history[STATE_HISTORY_SIZE];
+        double history_time[STATE_HISTORY_SIZE];
+        int head;                           // 最新状态的下标
+        int count;
+
+        const px4_command::DroneState& at(int i) const { return history[(head - i + STATE_HISTORY_SIZE) % STATE_HISTORY_SIZE]; }
+        double time_at(int i) const { return history_time[(head - i + STATE_HISTORY_SIZE) % STATE_HISTORY_SIZE]; }
+
+        static Eigen::Quaterniond get_q(const px4_command::DroneState& _DroneState)
+        {
+            return Eigen::Quaterniond(_DroneState.attitude_q.w, _DroneState.attitude_q.x, _DroneState.attitude_q.y, _DroneState.attitude_q.z);
+        }
+
+        static void set_q(const Eigen::Quaterniond& q, px4_command::DroneState& _DroneState);
+};
+
+void state_history::reset()
+{
+    head = STATE_HISTORY_SIZE - 1;
+    count = 0;
+
+    count_duplicate = 0;
+    count_extrapolated = 0;
+    extrapolation_last = 0.0;
+}
+
+bool state_history::push(const px4_command::DroneState& _DroneState)
+{
+    double t = _DroneState.header.stamp.toSec();
+
+    if(count > 0 && t <= time_at(0))
+    {
+        count_duplicate++;
+        return false;
+    }
+
+    head = (head + 1) % STATE_HISTORY_SIZE;
+    history[head] = _DroneState;
+    history_time[head] = t;
+
+    if(count < STATE_HISTORY_SIZE) count++;
+
+    return true;
+}
+
+bool state_history::sample(double t, px4_command::DroneState& _DroneState)
+{
+    if(count == 0)
+    {
+        return false;
+    }
+
+    const px4_command::DroneState& newest = at(0);
+    double t_newest = time_at(0);
+
+    // 离散量及未插值的字段取最新状态
+    _DroneState = newest;
+    extrapolation_last = t - t_newest;
+
+    if(t >= t_newest)
+    {
+        // 外推：位置按速度，姿态按机体角速度
+        double h = t - t_newest;
+        if(h > extrapolation_max)
+        {
+            h = extrapolation_max;
+            count_extrapolated++;
+        }
+
+        for(int j = 0; j < 3; j++)
+        {
+            _DroneState.position[j] = newest.position[j] + newest.velocity[j] * h;
+        }
+
+        Eigen::Vector3d rotation(newest.attitude_rate[0] * h, newest.attitude_rate[1] * h, newest.attitude_rate[2] * h);
+        if(rotation.norm() > 1e-9)
+        {
+            set_q(get_q(newest) * Eigen::Quaterniond(Eigen::AngleAxisd(rotation.norm(), rotation.normalized())), _DroneState);
+        }
+
+        return true;
+    }
+
+    // 找到 t0 <= t < t1
+    int i = 1;
+    while(i < count && time_at(i) > t)
+    {
+        i++;
+    }
+
+    if(i == count)
+    {
+        // 早于最早状态
+        const px4_command::DroneState& oldest = at(count - 1);
+        for(int j = 0; j < 3; j++)
+        {
+            _DroneState.position[j] = oldest.position[j];
+            _DroneState.velocity[j] = oldest.velocity[j];
+            _DroneState.acceleration[j] = oldest.acceleration[j];
+            _DroneState.attitude_rate[j] = oldest.attitude_rate[j];
+        }
+        set_q(get_q(oldest), _DroneState);
+        return true;
+    }
+
+    const px4_command::DroneState& s0 = at(i);
+    const px4_command::DroneState& s1 = at(i - 1);
+    double t0 = time_at(i);
+    double dt = time_at(i - 1) - t0;
+    double s = (t - t0) / dt;
+
+    // 三次Hermite基函数
+    double h00 = 2*s*s*s - 3*s*s + 1;
+    double h10 = s*s*s - 2*s*s + s;
+    double h01 = -2*s*s*s + 3*s*s;
+    double h11 = s*s*s - s*s;
+
+    for(int j = 0; j < 3; j++)
+    {
+        _DroneState.position[j] = h00 * s0.position[j] + h10 * dt * s0.velocity[j] + h01 * s1.position[j] + h11 * dt * s1.velocity[j];
+        _DroneState.velocity[j] = (1 - s) * s0.velocity[j] + s * s1.velocity[j];
+        _DroneState.acceleration[j] = (1 - s) * s0.acceleration[j] + s * s1.acceleration[j];
+        _DroneState.attitude_rate[j] = (1 - s) * s0.attitude_rate[j] + s * s1.attitude_rate[j];
+    }
+
+    set_q(get_q(s0).slerp(s, get_q(s1)), _DroneState);
+
+    return true;
+}
+
+void state_history::set_q(const Eigen::Quaterniond& q, px4_command::DroneState& _DroneState)
+{
+    Eigen::Quaterniond q_norm = q.normalized();
+
+    _DroneState.attitude_q.w = q_norm.w();
+    _DroneState.attitude_q.x = q_norm.x();
+    _DroneState.attitude_q.y = q_norm.y();
+    _DroneState.attitude_q.z = q_norm.z();
+
+    Eigen::Vector3d euler = quaternion_to_euler(q_norm);
+    _DroneState.attitude[0] = euler[0];
+    _DroneState.attitude[1] = euler[1];
+    _DroneState.attitude[2] = euler[2];
+}
+
+void state_history::printf_param()
+{
+    cout <<">>>>>>>>>>>>>>>>>>>>>>>>>>>>>> State History <<<<<<<<<<<<<<<<<<<<<<<<<<<<<" <<endl;
+    cout <<"size : "<< STATE_HISTORY_SIZE << "  lag : "<< lag << " [s]  extrapolation_max : "<< extrapolation_max << " [s] " << endl;
+}
+
+void state_history::printf_result()
+{
+    cout <<">>>>>>>>>>>>>>>>>>>>>>>>>  State History  <<<<<<<<<<<<<<<<<<<<<<<<<<<<<<" <<endl;
+
+    cout.setf(ios::fixed);
+    cout.setf(ios::left);
+    cout.setf(ios::showpoint);
+    cout<<setprecision(3);
+
+    cout << "extrapolation : " << extrapolation_last * 1000 << " [ms]  limited : " << count_extrapolated << "  duplicate : " << count_duplicate << endl;
+}
+
+#endif
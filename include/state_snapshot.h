@@ -0,0 +1,188 @@
+/***************************************************************************************************************************
+* state_snapshot.h
+*
+* Author: Qyp
+*
+* Update Time: 2019.8.5
+*
+* Introduction:  Lock-free state hand-over between callback threads and the control thread
+*         1. state_snapshot：单写者/单读者三缓冲。回调线程(AsyncSpinner)写入最新数据，控制线程读取最近一次完整写入的数据，
+*            双方均不加锁、不等待；写者独占back，读者独占front，两者通过middle的原子交换传递
+*         2. 读到的始终是一份完整的数据，不需要像seqlock一样重试，因此也可用于含std::string的ROS消息
+*         3. 每个快照只允许一个写线程和一个读线程（ROS中同一订阅的回调不会并发执行）
+*         4. control_trigger：事件驱动模式下由回调线程唤醒控制线程，只传递"有新数据"的信号，数据本身仍通过快照传递
+*         5. message_queue：单写者/单读者定长无锁队列，用于不能只保留最新一条的消息（如分段发送的轨迹）
+***************************************************************************************************************************/
+#ifndef STATE_SNAPSHOT_H
+#define STATE_SNAPSHOT_H
+
+#include <atomic>
+#include <mutex>
+#include <chrono>
+#include <condition_variable>
+
+// middle中低两位为缓冲区序号，第三位表示有未读取的新数据
+#define SNAPSHOT_INDEX_MASK 3u
+#define SNAPSHOT_FRESH      4u
+
+template <typename T>
+class state_snapshot
+{
+    public:
+
+        //构造函数
+        state_snapshot(void):
+            middle(1),
+            front(0),
+            back(2)
+        {
+        }
+
+        // 【写者】直接在写缓冲区中填写数据，填写完成后调用publish()，避免一次额外拷贝
+        T& write_buffer()
+        {
+            return buffer[back];
+        }
+
+        // 【写者】发布写缓冲区中的数据
+        void publish()
+        {
+            back = middle.exchange(back | SNAPSHOT_FRESH, std::memory_order_acq_rel) & SNAPSHOT_INDEX_MASK;
+        }
+
+        // 【写者】拷贝并发布
+        void write(const T& value)
+        {
+            buffer[back] = value;
+            publish();
+        }
+
+        // 【读者】有新数据时切换至最新数据并返回true，否则保持上一次的数据并返回false
+        bool update()
+        {
+            if((middle.load(std::memory_order_acquire) & SNAPSHOT_FRESH) == 0)
+            {
+                return false;
+            }
+
+            front = middle.exchange(front, std::memory_order_acq_rel) & SNAPSHOT_INDEX_MASK;
+            return true;
+        }
+
+        // 【读者】最近一次update()得到的数据
+        const T& read_buffer() const
+        {
+            return buffer[front];
+        }
+
+        // 【读者】有新数据时拷贝至value并返回true，否则value不变并返回false
+        bool read(T& value)
+        {
+            if(!update())
+            {
+                return false;
+            }
+
+            value = buffer[front];
+            return true;
+        }
+
+    private:
+
+        T buffer[3];
+
+        std::atomic<unsigned int> middle;
+
+        unsigned int front;                 //只由读者访问
+        unsigned int back;                  //只由写者访问
+};
+
+template <typename T, unsigned int N>
+class message_queue
+{
+    public:
+
+        //构造函数
+        message_queue(void):
+            head(0),
+            tail(0)
+        {
+        }
+
+        // 【写者】入队 [Output: false for 队列已满]
+        bool push(const T& value)
+        {
+            unsigned int t = tail.load(std::memory_order_relaxed);
+            unsigned int next = (t + 1) % N;
+
+            if(next == head.load(std::memory_order_acquire))
+            {
+                return false;
+            }
+
+            buffer[t] = value;
+            tail.store(next, std::memory_order_release);
+            return true;
+        }
+
+        // 【读者】出队 [Output: false for 队列为空]
+        bool pop(T& value)
+        {
+            unsigned int h = head.load(std::memory_order_relaxed);
+
+            if(h == tail.load(std::memory_order_acquire))
+            {
+                return false;
+            }
+
+            value = buffer[h];
+            buffer[h] = T();
+            head.store((h + 1) % N, std::memory_order_release);
+            return true;
+        }
+
+    private:
+
+        T buffer[N];
+
+        std::atomic<unsigned int> head;     //只由读者写入
+        std::atomic<unsigned int> tail;     //只由写者写入
+};
+
+class control_trigger
+{
+    public:
+
+        //构造函数
+        control_trigger(void):
+            flag(false)
+        {
+        }
+
+        // 【回调线程】通知控制线程有新数据
+        void notify()
+        {
+            {
+                std::lock_guard<std::mutex> lock(trigger_mutex);
+                flag = true;
+            }
+            trigger_cv.notify_one();
+        }
+
+        // 【控制线程】等待通知 [Input: timeout [s]; Output: true for 收到通知, false for 超时]
+        bool wait(float timeout)
+        {
+            std::unique_lock<std::mutex> lock(trigger_mutex);
+            bool notified = trigger_cv.wait_for(lock, std::chrono::duration<float>(timeout), [this]{ return flag; });
+            flag = false;
+            return notified;
+        }
+
+    private:
+
+        std::mutex trigger_mutex;
+        std::condition_variable trigger_cv;
+        bool flag;
+};
+
+#endif
@@ -0,0 +1,203 @@
+/***************************************************************************************************************************
+* thrust_estimator.h
+*
+* Author: Qyp
+*
+* Update Time: 2019.8.22
+*
+* Introduction:  Online estimation of the effective mass and hover throttle
+*         1. 模型：机体z轴比力 (a + g e3)·b3 = theta * T，T = NUM_MOTOR * throttleToThrust(desired_throttle)为按电机曲线(MOTOR_P1..P5)
+*            由发出的油门得到的名义总推力，theta = 1/m_eff；负载变化及电池电压下降（同一油门推力减小）都表现为m_eff的变化
+*         2. a为DroneState.acceleration(IMU)，b3由DroneState.attitude_q得到；T先经执行机构模型（Thrust_estimator/T_actuator），
+*            两者再经过相同的低通滤波器（Thrust_estimator/T_filter），保证时间上对齐（同INDI）
+*         3. 带遗忘因子的标量递推最小二乘，遗忘因子 lambda = exp(-dt/T_forget)，与控制频率无关
+*         4. 只在OFFBOARD、已解锁、离地高度大于height_min（地面时加速度计测得的是支持力，不能用于估计）、油门大于throttle_min
+*            且倾斜角小于tilt_max时更新，进入更新条件后等待滤波器稳定（warmup_time）
+*         5. 累计更新时间超过valid_time后估计值有效；输出 m_eff（限幅于[mass_min, mass_max]）及对应的悬停油门 thrustToThrottle(m_eff g / NUM_MOTOR)
+*         6. 持续的竖直外力（如风）同样会被估计为质量变化
+***************************************************************************************************************************/
+#ifndef THRUST_ESTIMATOR_H
+#define THRUST_ESTIMATOR_H
+
+#include <ros/ros.h>
+#include <Eigen/Eigen>
+#include <math.h>
+#include <px4_command_utils.h>
+#include <LowPassFilter.h>
+
+#include <px4_command/DroneState.h>
+#include <px4_command/ThrustEstimate.h>
+
+using namespace std;
+
+class thrust_estimator
+{
+    public:
+
+        //构造函数
+        thrust_estimator(void):
+            thrust_nh("~")
+        {
+            thrust_nh.param<float>("Quad/mass", mass_nominal, 1.0);
+
+            thrust_nh.param<float>("Thrust_estimator/T_forget", T_forget, 5.0);
+            thrust_nh.param<float>("Thrust_estimator/T_filter", T_filter, 0.1);
+            thrust_nh.param<float>("Thrust_estimator/T_actuator", T_actuator, 0.05);
+            thrust_nh.param<float>("Thrust_estimator/warmup_time", warmup_time, 0.5);
+            thrust_nh.param<float>("Thrust_estimator/valid_time", valid_time, 0.5);
+            thrust_nh.param<float>("Thrust_estimator/height_min", height_min, 0.2);
+            thrust_nh.param<float>("Thrust_estimator/throttle_min", throttle_min, 0.1);
+            thrust_nh.param<float>("Thrust_estimator/tilt_max", tilt_max, 30.0);
+            thrust_nh.param<float>("Thrust_estimator/mass_min", mass_min, 0.5 * mass_nominal);
+            thrust_nh.param<float>("Thrust_estimator/mass_max", mass_max, 2.0 * mass_nominal);
+            thrust_nh.param<float>("Thrust_estimator/variance_init", variance_init, 0.1);
+
+            LPF_accel.set_Time_constant(T_filter);
+            LPF_thrust.set_Time_constant(T_filter);
+            actuator.set_Time_constant(T_actuator);
+
+            ground_height = 0.0;
+
+            reset();
+        }
+
+        //Parameter
+        float mass_nominal;                 // Quad/mass [kg]
+        float T_forget;                     // 遗忘时间常数 [s]
+        float T_filter;                     // 比力及推力滤波时间常数 [s]
+        float T_actuator;                   // 期望推力至实际推力的时间常数 [s]
+        float warmup_time;                  // 进入更新条件后等待滤波器稳定的时间 [s]
+        float valid_time;                   // 累计更新时间超过该值后估计值有效 [s]
+        float height_min;                   // 离地高度大于该值时才更新 [m]
+        float ground_height;                // 地面高度（起飞位置） [m]
+        float throttle_min;
+        float tilt_max;                     // [deg]
+        float mass_min;
+        float mass_max;
+        float variance_init;                // theta的初始方差 [1/kg^2]
+
+        //Estimate
+        float thrust_scale;                 // theta = 1/m_eff [1/kg]
+        float variance;                     // theta的方差 [1/kg^2]
+        float mass;                         // 有效质量 [kg]
+        float hover_throttle;               // [0-1]
+        bool valid;
+
+        // 重置为名义质量
+        void reset();
+
+        // 设置地面高度（起飞位置的z） [m]
+        void set_ground_height(float z) { ground_height = z; }
+
+        // 估计一步（在计算新的期望值之前调用）
+        // [Input: 当前状态, 上一次发出的期望油门 desired_throttle [0-1], dt [s]]
+        void update(const px4_command::DroneState& _DroneState, float throttle, float dt);
+
+        // [Output: ThrustEstimate, filled in place (header is not touched)]
+        void fill_estimate(px4_command::ThrustEstimate& _ThrustEstimate);
+
+        void printf_param();
+
+        void printf_result();
+
+    private:
+
+        ros::NodeHandle thrust_nh;
+
+        LowPassFilter LPF_accel;
+        LowPassFilter LPF_thrust;
+        LowPassFilter actuator;
+
+        float time_warmup;                  // 本次满足更新条件的时间 [s]
+        float time_update;                  // 累计更新时间 [s]
+};
+
+void thrust_estimator::reset()
+{
+    thrust_scale = 1.0 / mass_nominal;
+    variance = variance_init;
+    mass = mass_nominal;
+    hover_throttle = px4_command_utils::thrustToThrottle(Eigen::Vector3d(1.0,1.0,1.0) * mass * 9.8 / NUM_MOTOR)[0];
+    valid = false;
+
+    time_warmup = 0.0;
+    time_update = 0.0;
+}
+
+void thrust_estimator::update(const px4_command::DroneState& _DroneState, float throttle, float dt)
+{
+    Eigen::Quaterniond q(_DroneState.attitude_q.w, _DroneState.attitude_q.x, _DroneState.attitude_q.y, _DroneState.attitude_q.z);
+    Eigen::Vector3d body_z = q * Eigen::Vector3d::UnitZ();
+
+    Eigen::Vector3d specific_force(_DroneState.acceleration[0], _DroneState.acceleration[1], _DroneState.acceleration[2] + 9.8);
+
+    // 滤波器始终运行，保证重新进入更新条件时两路信号对齐
+    float thrust_input = actuator.apply(NUM_MOTOR * px4_command_utils::throttleToThrust(throttle), dt);
+    float thrust_filtered = LPF_thrust.apply(thrust_input, dt);
+    float accel_filtered = LPF_accel.apply(specific_force.dot(body_z), dt);
+
+    bool excited = _DroneState.armed && _DroneState.flight_mode == px4_command::DroneState::MODE_OFFBOARD
+                   && _DroneState.position[2] - ground_height > height_min && throttle > throttle_min && body_z[2] > cos(tilt_max / 180.0 * M_PI);
+
+    if(!excited)
+    {
+        time_warmup = 0.0;
+        return;
+    }
+
+    time_warmup = time_warmup + dt;
+    if(time_warmup < warmup_time || thrust_filtered < 1e-3)
+    {
+        return;
+    }
+
+    // 标量递推最小二乘：y = theta * phi
+    float lambda = exp(- dt / T_forget);
+    float phi = thrust_filtered;
+    float gain = variance * phi / (lambda + phi * variance * phi);
+
+    thrust_scale = thrust_scale + gain * (accel_filtered - thrust_scale * phi);
+    variance = (variance - gain * phi * variance) / lambda;
+    variance = min(variance, variance_init);
+
+    thrust_scale = constrain_function2(thrust_scale, 1.0 / mass_max, 1.0 / mass_min);
+
+    mass = 1.0 / thrust_scale;
+    hover_throttle = px4_command_utils::thrustToThrottle(Eigen::Vector3d(1.0,1.0,1.0) * mass * 9.8 / NUM_MOTOR)[0];
+
+    time_update = time_update + dt;
+    valid = time_update > valid_time;
+}
+
+void thrust_estimator::fill_estimate(px4_command::ThrustEstimate& _ThrustEstimate)
+{
+    _ThrustEstimate.mass = mass;
+    _ThrustEstimate.mass_nominal = mass_nominal;
+    _ThrustEstimate.hover_throttle = hover_throttle;
+    _ThrustEstimate.thrust_scale = thrust_scale;
+    _ThrustEstimate.variance = variance;
+    _ThrustEstimate.valid = valid;
+}
+
+void thrust_estimator::printf_param()
+{
+    cout <<">>>>>>>>>>>>>>>>>>>>>>>>>>>>>> Thrust Estimator <<<<<<<<<<<<<<<<<<<<<<<<<<" <<endl;
+    cout <<"mass_nominal : "<< mass_nominal << " [kg]  mass_min : "<< mass_min << " [kg]  mass_max : "<< mass_max << " [kg] " << endl;
+    cout <<"T_forget : "<< T_forget << " [s]  T_filter : "<< T_filter << " [s]  T_actuator : "<< T_actuator << " [s] " << endl;
+    cout <<"warmup_time : "<< warmup_time << " [s]  valid_time : "<< valid_time << " [s]  height_min : "<< height_min << " [m] " << endl;
+    cout <<"throttle_min : "<< throttle_min << "  tilt_max : "<< tilt_max << " [deg]  variance_init : "<< variance_init << endl;
+}
+
+void thrust_estimator::printf_result()
+{
+    cout <<">>>>>>>>>>>>>>>>>>>>>>>>  Thrust Estimator  <<<<<<<<<<<<<<<<<<<<<<<<<<<<" <<endl;
+
+    cout.setf(ios::fixed);
+    cout.setf(ios::left);
+    cout.setf(ios::showpoint);
+    cout<<setprecision(3);
+
+    cout << "mass : " << mass << " [kg]  hover_throttle : " << hover_throttle << "  valid : " << valid << endl;
+}
+
+#endif
@@ -0,0 +1,477 @@
+/***************************************************************************************************************************
+* time_optimal_scaling.h
+*
+* Author: Qyp
+*
+* Update Time: 2019.8.14
+*
+* Introduction:  Time-optimal re-parameterization of a geometric path under the position controller limits
+*         1. 输入一条几何路径（按顺序的位置点，如最小snap轨迹或解析轨迹的密集采样），按弧长s重采样为步长path_step的网格，
+*            中心差分得到 p'(s), p''(s)，速度 v = p' ṡ，加速度 a = p' s̈ + p'' ṡ²
+*         2. 约束均取自Parameter_for_control.yaml，与控制器的限幅一致，乘以margin为反馈留出余量：
+*            水平速度 ≤ Limit/XY_VEL_MAX，垂直速度 ≤ Limit/Z_VEL_MAX（即pos_controller_cascade_PID的限幅），
+*            倾斜角 |a_xy| ≤ (g + a_z) tan(Limit/tilt_max)（即accelToThrust的限幅），|a_z| ≤ Time_scaling/acc_z_max
+*         3. 以 x = ṡ² 为状态、u = s̈ 为输入（x_{i+1} = x_i + 2 u Δs），每个网格点上给定x时u的可行域为一个区间（倾斜角约束为二阶锥，
+*            与直线的交集仍为区间，解析求解）；先由速度约束及"存在可行u"得到最大速度曲线，再后向传递（保证能在终点停下）、
+*            前向传递（最大加速），得到起终点静止、各约束在网格点上满足的最快时间分配（bang-bang型，TOPP-RA的离散形式）；
+*            加减速切换处若某网格的s̈在下一网格点超限，则降低该处最大速度曲线后重新传递
+*         4. 结果为加速度分段常值的速度曲线，因此jerk、snap参考量为0；按时间查询时在网格内按匀加速解析求s
+*         5. 只在规划时调用（分配内存），查询sample()不分配内存
+***************************************************************************************************************************/
+#ifndef TIME_OPTIMAL_SCALING_H
+#define TIME_OPTIMAL_SCALING_H
+
+#include <ros/ros.h>
+#include <Eigen/Eigen>
+#include <math.h>
+#include <vector>
+#include <algorithm>
+
+#include <px4_command/Trajectory.h>
+#include <px4_command/TrajectoryPoint.h>
+#include <command_to_mavros.h>
+
+using namespace std;
+
+class time_optimal_scaling
+{
+    public:
+
+        //构造函数
+        time_optimal_scaling(void):
+            time_scaling_nh("~")
+        {
+            time_scaling_nh.param<float>("Limit/XY_VEL_MAX", xy_vel_max, 1.0);
+            time_scaling_nh.param<float>("Limit/Z_VEL_MAX", z_vel_max, 0.5);
+            time_scaling_nh.param<float>("Limit/tilt_max", tilt_max, 5.0);
+            time_scaling_nh.param<float>("Time_scaling/acc_z_max", acc_z_max, 1.0);
+            time_scaling_nh.param<float>("Time_scaling/margin", margin, 0.8);
+            time_scaling_nh.param<float>("Time_scaling/path_step", path_step, 0.02);
+
+            if(path_step < 1e-3) path_step = 1e-3;
+
+            grid_num = 0;
+            ds = 0.0;
+            yaw_ref = 0.0;
+        }
+
+        //Limitation
+        float xy_vel_max;                           // [m/s]
+        float z_vel_max;                            // [m/s]
+        float tilt_max;                             // [deg]
+        float acc_z_max;                            // [m/s^2]
+        float margin;                               // 使用限幅的比例，(0, 1]
+        float path_step;                            // 弧长网格步长 [m]
+
+        // 求解 [Input: 按顺序的路径点（至少2个不重合的点）, yaw_ref; Output: false for 路径过短]
+        bool solve(const vector<Eigen::Vector3d>& path, float yaw = 0.0);
+
+        // 查询time_from_start时刻的参考量，直接写入_TrajectoryPoint [Output: false for 未求解]
+        bool sample(float time_from_start, px4_command::TrajectoryPoint& _TrajectoryPoint) const;
+
+        // 按dt采样整条轨迹，用于发送至/px4_command/trajectory
+        void to_trajectory(float dt, px4_command::Trajectory& _Trajectory) const;
+
+        float total_time() const { return time_knots.empty() ? 0.0 : time_knots.back(); }
+
+        // 路径长度 [m]
+        float path_length() const { return grid_num > 0 ? (grid_num - 1) * ds : 0.0; }
+
+        //Printf the time_optimal_scaling parameter
+        void printf_param();
+
+        //Printf the solve result
+        void printf_result();
+
+    private:
+
+        ros::NodeHandle time_scaling_nh;
+
+        int grid_num;                               //网格点数
+        double ds;                                  //网格步长 [m]
+        float yaw_ref;
+
+        vector<Eigen::Vector3d> position;           //p(s_i)
+        vector<Eigen::Vector3d> tangent;            //p'(s_i)
+        vector<Eigen::Vector3d> curvature;          //p''(s_i)
+        vector<double> sdot_sq;                     //x_i = ṡ²
+        vector<double> time_knots;                  //到达s_i的时刻
+
+        // 第i个网格点、给定x时u的可行区间 [Output: false for 空集]
+        bool control_interval(int i, double x, double& u_min, double& u_max) const;
+
+        // 第i个网格点在速度约束及加速度约束下的最大x
+        double max_sdot_sq(int i) const;
+
+        // 由最大速度曲线limit经后向、前向传递得到sdot_sq
+        void pass(const vector<double>& limit);
+};
+
+bool time_optimal_scaling::control_interval(int i, double x, double& u_min, double& u_max) const
+{
+    const double g = 9.81;
+    const double tan_tilt = tan(margin * tilt_max / 180.0 * M_PI);
+    const double az_max = margin * acc_z_max;
+
+    // a = A u + B
+    const Eigen::Vector3d& A = tangent[i];
+    const Eigen::Vector3d B = curvature[i] * x;
+
+    u_min = -1e9;
+    u_max = 1e9;
+
+    // 垂直加速度 |A_z u + B_z| ≤ az_max
+    if(fabs(A[2]) > 1e-9)
+    {
+        double u1 = (-az_max - B[2]) / A[2];
+        double u2 = (az_max - B[2]) / A[2];
+        u_min = max(u_min, min(u1, u2));
+        u_max = min(u_max, max(u1, u2));
+    }else if(fabs(B[2]) > az_max)
+    {
+        return false;
+    }
+
+    // 倾斜角 |A_xy u + B_xy| ≤ tan_tilt (g + A_z u + B_z)，展开为 a2 u² + a1 u + a0 ≤ 0，
+    // 同时要求 g + A_z u + B_z ≥ 0（排除锥的负半支）
+    const double a2 = A.head<2>().squaredNorm() - tan_tilt * tan_tilt * A[2] * A[2];
+    const double a1 = 2.0 * (A.head<2>().dot(B.head<2>()) - tan_tilt * tan_tilt * A[2] * (g + B[2]));
+    const double a0 = B.head<2>().squaredNorm() - tan_tilt * tan_tilt * (g + B[2]) * (g + B[2]);
+
+    if(fabs(a2) < 1e-9)
+    {
+        if(fabs(a1) < 1e-9)
+        {
+            if(a0 > 0) return false;
+        }else if(a1 > 0)
+        {
+            u_max = min(u_max, -a0 / a1);
+        }else
+        {
+            u_min = max(u_min, -a0 / a1);
+        }
+    }else
+    {
+        const double disc = a1 * a1 - 4.0 * a2 * a0;
+
+        if(a2 > 0)
+        {
+            if(disc < 0) return false;
+            u_min = max(u_min, (-a1 - sqrt(disc)) / (2.0 * a2));
+            u_max = min(u_max, (-a1 + sqrt(disc)) / (2.0 * a2));
+        }else if(disc >= 0)
+        {
+            // 两条射线，其中一条为锥的负半支，由 g + A_z u + B_z ≥ 0 排除（a2 < 0 时 A_z ≠ 0）
+            double r1 = (-a1 + sqrt(disc)) / (2.0 * a2);
+            double r2 = (-a1 - sqrt(disc)) / (2.0 * a2);
+            if(A[2] > 0)
+            {
+                u_min = max(u_min, r2);
+            }else
+            {
+                u_max = min(u_max, r1);
+            }
+        }
+    }
+
+    return u_min <= u_max;
+}
+
+double time_optimal_scaling::max_sdot_sq(int i) const
+{
+    // 速度约束
+    const Eigen::Vector3d& A = tangent[i];
+    double x_max = 1e6;
+
+    double v_xy = A.head<2>().norm();
+    if(v_xy > 1e-9)
+    {
+        x_max = min(x_max, pow(margin * xy_vel_max / v_xy, 2));
+    }
+    if(fabs(A[2]) > 1e-9)
+    {
+        x_max = min(x_max, pow(margin * z_vel_max / fabs(A[2]), 2));
+    }
+
+    // 加速度约束：可行x的集合为[0, x*]（x = 0, u = 0 时为悬停，总是可行），二分求x*
+    double u_min, u_max;
+    if(control_interval(i, x_max, u_min, u_max))
+    {
+        return x_max;
+    }
+
+    double low = 0.0;
+    double high = x_max;
+    for(int k = 0; k < 40; k++)
+    {
+        double mid = 0.5 * (low + high);
+        if(control_interval(i, mid, u_min, u_max))
+        {
+            low = mid;
+        }else
+        {
+            high = mid;
+        }
+    }
+
+    return low;
+}
+
+void time_optimal_scaling::pass(const vector<double>& limit)
+{
+    double u_min, u_max;
+
+    // 后向传递：终点静止，x_i不超过以最大减速度能在下一点满足约束的值
+    sdot_sq[grid_num - 1] = 0.0;
+    for(int i = grid_num - 2; i >= 0; i--)
+    {
+        double low = 0.0;
+        double high = limit[i];
+        if(control_interval(i, high, u_min, u_max) && high + 2.0 * ds * u_min <= sdot_sq[i + 1])
+        {
+            sdot_sq[i] = high;
+            continue;
+        }
+
+        for(int n = 0; n < 40; n++)
+        {
+            double mid = 0.5 * (low + high);
+            if(control_interval(i, mid, u_min, u_max) && mid + 2.0 * ds * u_min <= sdot_sq[i + 1])
+            {
+                low = mid;
+            }else
+            {
+                high = mid;
+            }
+        }
+        sdot_sq[i] = low;
+    }
+
+    // 前向传递：起点静止，最大加速
+    sdot_sq[0] = 0.0;
+    for(int i = 0; i + 1 < grid_num; i++)
+    {
+        if(control_interval(i, sdot_sq[i], u_min, u_max))
+        {
+            sdot_sq[i + 1] = min(sdot_sq[i + 1], sdot_sq[i] + 2.0 * ds * u_max);
+        }
+        sdot_sq[i + 1] = max(sdot_sq[i + 1], 0.0);
+    }
+}
+
+bool time_optimal_scaling::solve(const vector<Eigen::Vector3d>& path, float yaw)
+{
+    yaw_ref = yaw;
+
+    // 路径点累计弧长，去除重合点
+    vector<Eigen::Vector3d> points;
+    vector<double> arc;
+    for(unsigned int k = 0; k < path.size(); k++)
+    {
+        if(points.empty())
+        {
+            points.push_back(path[k]);
+            arc.push_back(0.0);
+        }else if((path[k] - points.back()).norm() > 1e-6)
+        {
+            arc.push_back(arc.back() + (path[k] - points.back()).norm());
+            points.push_back(path[k]);
+        }
+    }
+
+    if(points.size() < 2 || arc.back() < path_step)
+    {
+        grid_num = 0;
+        time_knots.clear();
+        return false;
+    }
+
+    // 按弧长重采样为等距网格
+    grid_num = ceil(arc.back() / path_step) + 1;
+    ds = arc.back() / (grid_num - 1);
+
+    position.resize(grid_num);
+    tangent.resize(grid_num);
+    curvature.resize(grid_num);
+    sdot_sq.resize(grid_num);
+    time_knots.resize(grid_num);
+
+    unsigned int k = 0;
+    for(int i = 0; i < grid_num; i++)
+    {
+        double s = min(i * ds, arc.back());
+        while(k + 2 < arc.size() && arc[k + 1] < s)
+        {
+            k++;
+        }
+        double ratio = (s - arc[k]) / (arc[k + 1] - arc[k]);
+        position[i] = points[k] + ratio * (points[k + 1] - points[k]);
+    }
+
+    // 中心差分，端点单侧差分；差分跨度不小于输入路径点间距的2倍，避免折线顶点处的曲率噪声
+    int w = ceil(2.0 * arc.back() / (points.size() - 1) / ds);
+    w = max(1, min(w, (grid_num - 1) / 2));
+
+    for(int i = 0; i < grid_num; i++)
+    {
+        int i0 = max(i - w, 0);
+        int i1 = min(i + w, grid_num - 1);
+        tangent[i] = (position[i1] - position[i0]) / ((i1 - i0) * ds);
+        if(tangent[i].norm() > 1e-9)
+        {
+            tangent[i].normalize();
+        }
+
+        if(grid_num > 2 * w)
+        {
+            int c = min(max(i, w), grid_num - 1 - w);
+            curvature[i] = (position[c + w] - 2.0 * position[c] + position[c - w]) / (w * w * ds * ds);
+        }else
+        {
+            curvature[i].setZero();
+        }
+    }
+
+    // 最大速度曲线
+    vector<double> limit(grid_num);
+    for(int i = 0; i < grid_num; i++)
+    {
+        limit[i] = max_sdot_sq(i);
+    }
+
+    // 约束只在网格点上施加，加速与减速切换处网格的u在下一网格点可能略微超限；
+    // 检查每个网格的u在两端是否均可行，超限处降低最大速度曲线后重新传递
+    for(int iteration = 0; iteration < 20; iteration++)
+    {
+        pass(limit);
+
+        bool violated = false;
+        for(int i = 0; i + 1 < grid_num; i++)
+        {
+            double u = (sdot_sq[i + 1] - sdot_sq[i]) / (2.0 * ds);
+            double u_min, u_max;
+
+            if(!(control_interval(i + 1, sdot_sq[i + 1], u_min, u_max) && u >= u_min - 1e-6 && u <= u_max + 1e-6))
+            {
+                limit[i] = min(limit[i], 0.95 * sdot_sq[i]);
+                limit[i + 1] = min(limit[i + 1], 0.95 * sdot_sq[i + 1]);
+                violated = true;
+            }
+        }
+
+        if(!violated)
+        {
+            break;
+        }
+    }
+
+    // 时间分配：网格内匀加速
+    time_knots[0] = 0.0;
+    for(int i = 0; i + 1 < grid_num; i++)
+    {
+        double v_sum = sqrt(sdot_sq[i]) + sqrt(sdot_sq[i + 1]);
+        time_knots[i + 1] = time_knots[i] + (v_sum > 1e-9 ? 2.0 * ds / v_sum : 0.0);
+    }
+
+    return true;
+}
+
+bool time_optimal_scaling::sample(float time_from_start, px4_command::TrajectoryPoint& _TrajectoryPoint) const
+{
+    if(grid_num == 0)
+    {
+        return false;
+    }
+
+    double t = min(max((double)time_from_start, 0.0), time_knots.back());
+
+    // 二分查找所在网格
+    int i = upper_bound(time_knots.begin() + 1, time_knots.end() - 1, t) - (time_knots.begin() + 1);
+
+    double v0 = sqrt(sdot_sq[i]);
+    double v1 = sqrt(sdot_sq[i + 1]);
+    double h = time_knots[i + 1] - time_knots[i];
+    double tau = t - time_knots[i];
+
+    // 匀加速 s̈ = u
+    double u = h > 1e-9 ? (v1 - v0) / h : 0.0;
+    double sdot = v0 + u * tau;
+    double s = min(v0 * tau + 0.5 * u * tau * tau, ds);
+    double ratio = s / ds;
+
+    // 网格内线性插值
+    Eigen::Vector3d p = position[i] + ratio * (position[i + 1] - position[i]);
+    Eigen::Vector3d dp = tangent[i] + ratio * (tangent[i + 1] - tangent[i]);
+    Eigen::Vector3d ddp = curvature[i] + ratio * (curvature[i + 1] - curvature[i]);
+
+    Eigen::Vector3d vel = dp * sdot;
+    Eigen::Vector3d acc = dp * u + ddp * sdot * sdot;
+
+    _TrajectoryPoint.time_from_start = time_from_start;
+    _TrajectoryPoint.Sub_mode = command_to_mavros::XYZ_POS;
+
+    for(int j = 0; j < 3; j++)
+    {
+        _TrajectoryPoint.position_ref[j] = p[j];
+        _TrajectoryPoint.velocity_ref[j] = vel[j];
+        _TrajectoryPoint.acceleration_ref[j] = acc[j];
+        _TrajectoryPoint.jerk_ref[j] = 0.0;
+        _TrajectoryPoint.snap_ref[j] = 0.0;
+    }
+
+    _TrajectoryPoint.yaw_ref = yaw_ref;
+    _TrajectoryPoint.yaw_rate_ref = 0.0;
+
+    return true;
+}
+
+void time_optimal_scaling::to_trajectory(float dt, px4_command::Trajectory& _Trajectory) const
+{
+    _Trajectory.points.clear();
+
+    if(grid_num == 0 || dt <= 0)
+    {
+        return;
+    }
+
+    int point_num = ceil(total_time() / dt) + 1;
+    _Trajectory.points.resize(point_num);
+
+    for(int i = 0; i < point_num; i++)
+    {
+        sample(min(i * dt, total_time()), _Trajectory.points[i]);
+    }
+}
+
+void time_optimal_scaling::printf_result()
+{
+    cout <<">>>>>>>>>>>>>>>>>>>>>>>>>>> Time-optimal Scaling <<<<<<<<<<<<<<<<<<<<<<<<<" <<endl;
+
+    //固定的浮点显示
+    cout.setf(ios::fixed);
+    //左对齐
+    cout.setf(ios::left);
+    // 强制显示小数点
+    cout.setf(ios::showpoint);
+
+    cout<<setprecision(2);
+
+    double v_max = 0.0;
+    for(int i = 0; i < grid_num; i++)
+    {
+        v_max = max(v_max, sqrt(sdot_sq[i]));
+    }
+
+    cout << "path_length : " << path_length() << " [m]  total_time : " << total_time() << " [s]  max_speed : " << v_max << " [m/s] " <<endl;
+}
+
+// 【打印参数函数】
+void time_optimal_scaling::printf_param()
+{
+    cout <<">>>>>>>>>>>>>>>>>>>>>>>>>>>>>>Time-optimal Scaling Parameter <<<<<<<<<<<<<<<<<<<<<<<<<<<" <<endl;
+    cout <<"XY_VEL_MAX : "<< xy_vel_max << " [m/s]  Z_VEL_MAX : "<< z_vel_max << " [m/s] " << endl;
+    cout <<"tilt_max : "<< tilt_max << " [deg]  acc_z_max : "<< acc_z_max << " [m/s^2] " << endl;
+    cout <<"margin : "<< margin << "  path_step : "<< path_step << " [m] " << endl;
+}
+
+#endif
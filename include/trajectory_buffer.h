@@ -0,0 +1,274 @@
+/***************************************************************************************************************************
+* trajectory_buffer.h
+*
+* Author: Qyp
+*
+* Update Time: 2019.8.7
+*
+* Introduction:  Time-indexed buffer for streamed trajectories (/px4_command/trajectory, Trajectory.msg)
+*         1. 构造时按Trajectory_buffer/capacity预分配，追加及插值均不分配内存
+*         2. 时间轴为进入Trajectory_Tracking模式后的时间，即TrajectoryPoint.time_from_start [s]
+*         3. 追加：新消息中时间不晚于已有点的部分覆盖旧轨迹（重规划），其余接在末尾；消息内时间须递增，不递增的点被跳过
+*         4. 查询：二分查找所在区间 O(log n)，位置用三次Hermite插值（使用速度），速度至snap及偏航角速度线性插值，偏航角按最短角度插值
+*            早于第一个点时保持第一个点，晚于最后一个点时悬停在最后一个点（位置以外的参考量为0）
+*         5. 已飞过的点在查询时释放（环形存储），因此可以边飞边追加任意长的轨迹，容量只需覆盖规划时域
+*         6. 记录最新一段轨迹的header.stamp，clear_before()清除早于给定时刻发送的轨迹（上一次Trajectory_Tracking遗留的轨迹）
+***************************************************************************************************************************/
+#ifndef TRAJECTORY_BUFFER_H
+#define TRAJECTORY_BUFFER_H
+
+#include <ros/ros.h>
+#include <math.h>
+#include <vector>
+
+#include <px4_command/Trajectory.h>
+#include <px4_command/TrajectoryPoint.h>
+
+using namespace std;
+
+class trajectory_buffer
+{
+    public:
+
+        //构造函数
+        trajectory_buffer(void):
+            trajectory_nh("~")
+        {
+            trajectory_nh.param<int>("Trajectory_buffer/capacity", capacity, 5000);
+            if(capacity < 2) capacity = 2;
+
+            points.resize(capacity);
+
+            head = 0;
+            count = 0;
+            dropped = 0;
+        }
+
+        int capacity;                               //最多缓存的轨迹点数
+        unsigned int dropped;                       //缓冲区已满而未能写入的点数
+
+        // 追加一段轨迹 [Input: Trajectory; Output: 写入的点数]
+        int append(const px4_command::Trajectory& _Trajectory);
+
+        // 查询time_from_start时刻的参考量，直接写入_TrajectoryPoint [Output: false for 缓冲区为空]
+        bool sample(float time_from_start, px4_command::TrajectoryPoint& _TrajectoryPoint);
+
+        void clear();
+
+        // 最新一段轨迹早于stamp发送时清空 [Output: true for 已清空]
+        bool clear_before(const ros::Time& stamp);
+
+        int size() const { return count; }
+
+        // 最后一个点的时刻 [s]
+        float end_time() const;
+
+        //Printf the trajectory_buffer parameter
+        void printf_param();
+
+    private:
+
+        ros::NodeHandle trajectory_nh;
+
+        struct trajectory_sample
+        {
+            float time;
+            uint8_t sub_mode;
+            float position[3];
+            float velocity[3];
+            float acceleration[3];
+            float jerk[3];
+            float snap[3];
+            float yaw;
+            float yaw_rate;
+        };
+
+        vector<trajectory_sample> points;           //环形存储，第i个点为points[(head + i) % capacity]
+        int head;
+        int count;
+        ros::Time stamp_last;                       //最新一段轨迹的header.stamp（未填写时为收到的时刻）
+
+        trajectory_sample& at(int i) { return points[(head + i) % capacity]; }
+        const trajectory_sample& at(int i) const { return points[(head + i) % capacity]; }
+
+        // 第一个时刻晚于time的点的序号，[0, count]
+        int upper_bound(float time) const;
+};
+
+int trajectory_buffer::upper_bound(float time) const
+{
+    int low = 0;
+    int high = count;
+
+    while(low < high)
+    {
+        int mid = (low + high) / 2;
+
+        if(at(mid).time > time)
+        {
+            high = mid;
+        }else
+        {
+            low = mid + 1;
+        }
+    }
+
+    return low;
+}
+
+int trajectory_buffer::append(const px4_command::Trajectory& _Trajectory)
+{
+    if(_Trajectory.points.empty())
+    {
+        return 0;
+    }
+
+    stamp_last = _Trajectory.header.stamp.isZero() ? ros::Time::now() : _Trajectory.header.stamp;
+
+    // 新轨迹覆盖不早于其第一个点的旧轨迹
+    count = upper_bound(_Trajectory.points[0].time_from_start - 1e-6);
+
+    int appended = 0;
+
+    for(unsigned int i = 0; i < _Trajectory.points.size(); i++)
+    {
+        const px4_command::TrajectoryPoint& point = _Trajectory.points[i];
+
+        if(count > 0 && point.time_from_start <= at(count - 1).time)
+        {
+            continue;
+        }
+
+        if(count == capacity)
+        {
+            dropped = dropped + _Trajectory.points.size() - i;
+            break;
+        }
+
+        trajectory_sample& sample = at(count);
+
+        sample.time = point.time_from_start;
+        sample.sub_mode = point.Sub_mode;
+        for(int j = 0; j < 3; j++)
+        {
+            sample.position[j] = point.position_ref[j];
+            sample.velocity[j] = point.velocity_ref[j];
+            sample.acceleration[j] = point.acceleration_ref[j];
+            sample.jerk[j] = point.jerk_ref[j];
+            sample.snap[j] = point.snap_ref[j];
+        }
+        sample.yaw = point.yaw_ref;
+        sample.yaw_rate = point.yaw_rate_ref;
+
+        count++;
+        appended++;
+    }
+
+    return appended;
+}
+
+bool trajectory_buffer::sample(float time_from_start, px4_command::TrajectoryPoint& _TrajectoryPoint)
+{
+    if(count == 0)
+    {
+        return false;
+    }
+
+    _TrajectoryPoint.time_from_start = time_from_start;
+
+    int k = upper_bound(time_from_start);
+
+    // 早于第一个点或晚于最后一个点
+    if(k == 0 || k == count)
+    {
+        const trajectory_sample& p = at(k == 0 ? 0 : count - 1);
+
+        _TrajectoryPoint.Sub_mode = p.sub_mode;
+        for(int j = 0; j < 3; j++)
+        {
+            _TrajectoryPoint.position_ref[j] = p.position[j];
+            _TrajectoryPoint.velocity_ref[j] = k == 0 ? p.velocity[j] : 0.0;
+            _TrajectoryPoint.acceleration_ref[j] = k == 0 ? p.acceleration[j] : 0.0;
+            _TrajectoryPoint.jerk_ref[j] = k == 0 ? p.jerk[j] : 0.0;
+            _TrajectoryPoint.snap_ref[j] = k == 0 ? p.snap[j] : 0.0;
+        }
+        _TrajectoryPoint.yaw_ref = p.yaw;
+        _TrajectoryPoint.yaw_rate_ref = k == 0 ? p.yaw_rate : 0.0;
+
+        // 已飞完时只保留最后一个点
+        if(k == count)
+        {
+            head = (head + count - 1) % capacity;
+            count = 1;
+        }
+
+        return true;
+    }
+
+    const trajectory_sample& p0 = at(k - 1);
+    const trajectory_sample& p1 = at(k);
+
+    float h = p1.time - p0.time;
+    float s = (time_from_start - p0.time) / h;
+
+    // 三次Hermite基函数
+    float s2 = s * s;
+    float s3 = s2 * s;
+    float h00 = 2 * s3 - 3 * s2 + 1;
+    float h10 = s3 - 2 * s2 + s;
+    float h01 = -2 * s3 + 3 * s2;
+    float h11 = s3 - s2;
+
+    _TrajectoryPoint.Sub_mode = p0.sub_mode;
+    for(int j = 0; j < 3; j++)
+    {
+        _TrajectoryPoint.position_ref[j] = h00 * p0.position[j] + h10 * h * p0.velocity[j] + h01 * p1.position[j] + h11 * h * p1.velocity[j];
+        _TrajectoryPoint.velocity_ref[j] = p0.velocity[j] + s * (p1.velocity[j] - p0.velocity[j]);
+        _TrajectoryPoint.acceleration_ref[j] = p0.acceleration[j] + s * (p1.acceleration[j] - p0.acceleration[j]);
+        _TrajectoryPoint.jerk_ref[j] = p0.jerk[j] + s * (p1.jerk[j] - p0.jerk[j]);
+        _TrajectoryPoint.snap_ref[j] = p0.snap[j] + s * (p1.snap[j] - p0.snap[j]);
+    }
+    _TrajectoryPoint.yaw_rate_ref = p0.yaw_rate + s * (p1.yaw_rate - p0.yaw_rate);
+
+    float yaw_error = p1.yaw - p0.yaw;
+    yaw_error = atan2(sin(yaw_error), cos(yaw_error));
+    _TrajectoryPoint.yaw_ref = p0.yaw + s * yaw_error;
+    _TrajectoryPoint.yaw_ref = atan2(sin(_TrajectoryPoint.yaw_ref), cos(_TrajectoryPoint.yaw_ref));
+
+    // 释放已飞过的点，保留当前区间的起点
+    head = (head + k - 1) % capacity;
+    count = count - (k - 1);
+
+    return true;
+}
+
+void trajectory_buffer::clear()
+{
+    head = 0;
+    count = 0;
+}
+
+bool trajectory_buffer::clear_before(const ros::Time& stamp)
+{
+    if(count == 0 || stamp_last >= stamp)
+    {
+        return false;
+    }
+
+    clear();
+    return true;
+}
+
+float trajectory_buffer::end_time() const
+{
+    return count > 0 ? at(count - 1).time : 0.0;
+}
+
+// 【打印参数函数】
+void trajectory_buffer::printf_param()
+{
+    cout <<">>>>>>>>>>>>>>>>>>>>>>>>>>>>>>Trajectory_buffer Parameter <<<<<<<<<<<<<<<<<<<<<<<<<<<" <<endl;
+    cout <<"capacity : "<< capacity << " [points] " << endl;
+}
+
+#endif
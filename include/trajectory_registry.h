@@ -0,0 +1,74 @@
+/***************************************************************************************************************************
+* trajectory_registry.h
+*
+* Author: Qyp
+*
+* Update Time: 2019.8.12
+*
+* Introduction:  Registry of the parametric trajectories
+*         1. 根据编号创建对应的解析轨迹，只有被选中的轨迹会被构造（读取参数）
+*         2. 新增轨迹时：继承parametric_trajectory，在Trajectory_Type中增加编号，并在create()和name()中注册
+***************************************************************************************************************************/
+#ifndef TRAJECTORY_REGISTRY_H
+#define TRAJECTORY_REGISTRY_H
+
+#include <parametric_trajectory.h>
+#include <circle_trajectory.h>
+#include <lissajous_trajectory.h>
+#include <polyline_trajectory.h>
+
+namespace trajectory_registry
+{
+
+//轨迹编号，对应参数Trajectory_type
+enum Trajectory_Type
+{
+    Circle = 0,
+    Helix = 1,
+    Lemniscate = 2,
+    Lissajous = 3,
+    Polyline = 4,
+    Trajectory_Num
+};
+
+// 创建轨迹，编号无效时返回NULL
+parametric_trajectory* create(int trajectory_type)
+{
+    switch (trajectory_type)
+    {
+    case Circle:
+        return new Circle_Trajectory;
+    case Helix:
+        return new Helix_Trajectory;
+    case Lemniscate:
+        return new Lemniscate_Trajectory;
+    case Lissajous:
+        return new Lissajous_Trajectory;
+    case Polyline:
+        return new Polyline_Trajectory;
+    default:
+        return NULL;
+    }
+}
+
+const char* name(int trajectory_type)
+{
+    switch (trajectory_type)
+    {
+    case Circle:
+        return "circle";
+    case Helix:
+        return "helix";
+    case Lemniscate:
+        return "lemniscate";
+    case Lissajous:
+        return "lissajous";
+    case Polyline:
+        return "polyline";
+    default:
+        return "unknown";
+    }
+}
+
+}
+#endif
@@ -6,9 +6,12 @@
  * Update Time: 2018.8.17
  *
  * 说明: mavros正方形飞行示例程序
- *      1.
- *      2.
- *      3.
+ *      1. use_min_snap = 0: 依次发送正方形的4个角点(Move_ENU)，每个点保持sleep_time秒
+ *      2. use_min_snap = 1: 以4个角点为航点生成最小snap轨迹，发送至/px4_command/trajectory，再切换至Trajectory_Tracking模式
+ *         (px4_pos_controller须设置Trajectory_source为1)，避免阶跃指令带来的大超调
+ *         use_time_scaling = 1 时保留最小snap轨迹的几何路径，按Parameter_for_control.yaml中的速度、倾斜角限幅重新分配时间
+ *         (time_optimal_scaling.h)，得到不触发控制器限幅的最短飞行时间
+ *      3. 完成后降落
 ***************************************************************************************************************************/
 
 #include <ros/ros.h>
@@ -24,7 +27,10 @@
 #include <stdio.h>
 #include <std_msgs/Bool.h>
 #include <px4_command/ControlCommand.h>
+#include <px4_command/Trajectory.h>
 #include <command_to_mavros.h>
+#include <minimum_snap.h>
+#include <time_optimal_scaling.h>
 
 using namespace std;
  
@@ -34,6 +40,9 @@ px4_command::ControlCommand Command_Now;
 float size_square;                  //正方形边长
 float height_square;                //飞行高度
 float sleep_time;
+int use_min_snap;                   //1 for 最小snap轨迹
+float trajectory_dt;                //轨迹采样间隔 [s]
+int use_time_scaling;               //1 for 按控制器限幅重新分配时间
 int main(int argc, char **argv)
 {
     ros::init(argc, argv, "square");
@@ -49,6 +58,15 @@ int main(int argc, char **argv)
     nh.param<float>("size_square", size_square, 1.5);
     nh.param<float>("height_square", height_square, 1.0);
     nh.param<float>("sleep_time", sleep_time, 10.0);
+    nh.param<int>("use_min_snap", use_min_snap, 0);
+    nh.param<float>("trajectory_dt", trajectory_dt, 0.05);
+    nh.param<int>("use_time_scaling", use_time_scaling, 0);
+
+    // 【发布】最小snap轨迹，latch保证控制节点晚于本节点订阅时也能收到
+    ros::Publisher trajectory_pub = nh.advertise<px4_command::Trajectory>("/px4_command/trajectory", 1, true);
+
+    minimum_snap _minimum_snap;
+    time_optimal_scaling _time_optimal_scaling;
 
 
 
@@ -57,6 +75,17 @@ int main(int argc, char **argv)
     // 输入1,继续，其他，退出程序
     cout << "size_square: "<<size_square<<"[m]"<<endl;
     cout << "height_square: "<<height_square<<"[m]"<<endl;
+    cout << "use_min_snap: "<<use_min_snap<<endl;
+    if(use_min_snap == 1)
+    {
+        _minimum_snap.printf_param();
+        cout << "use_time_scaling: "<<use_time_scaling<<endl;
+        if(use_time_scaling == 1)
+        {
+            _time_optimal_scaling.printf_param();
+        }
+        cout << "Make sure Trajectory_source is 1 in px4_pos_controller."<<endl;
+    }
     cout << "Please check the parameter and setting，enter 1 to continue， else for quit: "<<endl;
     cin >> check_flag;
 
@@ -94,6 +123,84 @@ int main(int argc, char **argv)
 
     }
 
+    // 最小snap轨迹：起飞点 -> 4个角点 -> 左下角，一次性生成并发送，随后切换至Trajectory_Tracking模式
+    if(use_min_snap == 1)
+    {
+        min_snap_waypoints waypoints;
+        waypoints.push_back(Eigen::Vector4d(0, 0, height_square, 0));
+        waypoints.push_back(Eigen::Vector4d(-size_square/2, -size_square/2, height_square, 0));
+        waypoints.push_back(Eigen::Vector4d(size_square/2, -size_square/2, height_square, 0));
+        waypoints.push_back(Eigen::Vector4d(size_square/2, size_square/2, height_square, 0));
+        waypoints.push_back(Eigen::Vector4d(-size_square/2, size_square/2, height_square, 0));
+        waypoints.push_back(Eigen::Vector4d(-size_square/2, -size_square/2, height_square, 0));
+
+        if(!_minimum_snap.solve(waypoints))
+        {
+            cout << "Minimum snap solve failed."<<endl;
+            return -1;
+        }
+        _minimum_snap.printf_result();
+
+        px4_command::Trajectory trajectory;
+        float trajectory_time = _minimum_snap.total_time();
+
+        if(use_time_scaling == 1)
+        {
+            // 最小snap轨迹只作为几何路径，密集采样后重新分配时间
+            vector<Eigen::Vector3d> path;
+            px4_command::TrajectoryPoint point;
+            for(float t = 0; t < _minimum_snap.total_time() + 0.01; t = t + 0.01)
+            {
+                _minimum_snap.sample(t, point);
+                path.push_back(Eigen::Vector3d(point.position_ref[0], point.position_ref[1], point.position_ref[2]));
+            }
+
+            if(!_time_optimal_scaling.solve(path, 0.0))
+            {
+                cout << "Time scaling failed."<<endl;
+                return -1;
+            }
+            _time_optimal_scaling.printf_result();
+
+            _time_optimal_scaling.to_trajectory(trajectory_dt, trajectory);
+            trajectory_time = _time_optimal_scaling.total_time();
+        }else
+        {
+            _minimum_snap.to_trajectory(trajectory_dt, trajectory);
+        }
+
+        trajectory.header.stamp = ros::Time::now();
+        trajectory_pub.publish(trajectory);
+
+        // 轨迹结束后多保持sleep_time秒
+        i = 0;
+        while (i < trajectory_time + sleep_time)
+        {
+            Command_Now.header.stamp = ros::Time::now();
+            Command_Now.Mode = command_to_mavros::Trajectory_Tracking;
+            Command_Now.Command_ID = comid;
+            comid++;
+
+            move_pub.publish(Command_Now);
+
+            rate.sleep();
+
+            cout << "Trajectory_Tracking : "<< i << " / " << trajectory_time <<" [s]"<<endl;
+
+            i++;
+        }
+
+        Command_Now.header.stamp = ros::Time::now();
+        Command_Now.Mode = command_to_mavros::Land;
+        move_pub.publish(Command_Now);
+
+        rate.sleep();
+
+        cout << "Land"<<endl;
+
+        return 0;
+    }
+
     //依次发送4个目标点给position_control.cpp
     //第一个目标点，左下角
     i = 0;
@@ -0,0 +1,328 @@
+/***************************************************************************************************************************
+* px4_benchmark.cpp
+*
+* Author: Qyp
+*
+* Update Time: 2019.7.28
+*
+* Introduction:  Micro-benchmark of the control hot path
+*         1. 测试每次调用的耗时[ns]及堆内存分配次数：各位置控制律、accelToThrust、thrustToThrottle、ThrottleToAttitude、
+*            att_controller、rotation_to_euler、各滤波器的apply()、最小snap轨迹的求解(50航点)与查询及各解析轨迹的单点/预测时域(50点)计算
+*         2. 内存分配次数通过重载全局operator new统计
+*         3. 不需要roscore（控制器参数使用默认值）；结果以json格式输出至终端或文件，用于对比不同平台/不同版本
+*         4. 用法：rosrun px4_command px4_benchmark [iterations] [output.json]
+***************************************************************************************************************************/
+
+#include <ros/ros.h>
+#include <Eigen/Eigen>
+#include <time.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <new>
+#include <string>
+#include <vector>
+
+#include <math_utils.h>
+#include <px4_command_utils.h>
+#include <pos_controller_registry.h>
+#include <att_controller.h>
+#include <minimum_snap.h>
+#include <trajectory_registry.h>
+#include <LowPassFilter.h>
+#include <HighPassFilter.h>
+#include <LeadLagFilter.h>
+
+#include <px4_command/DroneState.h>
+#include <px4_command/TrajectoryPoint.h>
+#include <px4_command/AttitudeReference.h>
+#include <px4_command/ControlOutput.h>
+
+using namespace std;
+
+//>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>内存分配统计<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<
+static unsigned long alloc_count = 0;
+
+// 全局operator new/delete（含sized delete）统一经过以下两个不内联的函数，分配与释放成对
+__attribute__((noinline)) static void* counted_malloc(size_t size)
+{
+    alloc_count++;
+    void* p = malloc(size == 0 ? 1 : size);
+    if(p == NULL)
+    {
+        throw std::bad_alloc();
+    }
+    return p;
+}
+
+__attribute__((noinline)) static void counted_free(void* p) noexcept
+{
+    free(p);
+}
+
+void* operator new(size_t size) { return counted_malloc(size); }
+void* operator new[](size_t size) { return counted_malloc(size); }
+
+void operator delete(void* p) noexcept { counted_free(p); }
+void operator delete[](void* p) noexcept { counted_free(p); }
+void operator delete(void* p, size_t) noexcept { counted_free(p); }
+void operator delete[](void* p, size_t) noexcept { counted_free(p); }
+
+//>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>测试函数<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<
+struct benchmark_result
+{
+    string name;
+    double ns_per_call;
+    double allocs_per_call;
+    long iterations;
+};
+
+// 防止被测代码被编译器优化掉
+volatile float benchmark_sink = 0.0;
+
+vector<benchmark_result> results;
+
+static double now_ns()
+{
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return t.tv_sec * 1e9 + t.tv_nsec;
+}
+
+// 先预热iterations/10次，再计时; func(i)返回一个浮点数写入benchmark_sink
+template <typename Func>
+void run_benchmark(const string& name, long iterations, Func func)
+{
+    for(long i = 0; i < iterations / 10; i++)
+    {
+        benchmark_sink = benchmark_sink + func(i);
+    }
+
+    unsigned long alloc_begin = alloc_count;
+    double time_begin = now_ns();
+
+    for(long i = 0; i < iterations; i++)
+    {
+        benchmark_sink = benchmark_sink + func(i);
+    }
+
+    double time_end = now_ns();
+    unsigned long alloc_end = alloc_count;
+
+    benchmark_result result;
+    result.name = name;
+    result.iterations = iterations;
+    result.ns_per_call = (time_end - time_begin) / iterations;
+    result.allocs_per_call = (double)(alloc_end - alloc_begin) / iterations;
+
+    results.push_back(result);
+
+    printf("%-40s %10.1f ns/call %8.3f allocs/call\n", name.c_str(), result.ns_per_call, result.allocs_per_call);
+}
+
+// 随迭代次数变化的输入，避免常量折叠；误差保持在小范围内，与悬停跟踪时的工况一致（不触发饱和打印）
+static void fill_state(long i, px4_command::DroneState& _DroneState, px4_command::TrajectoryPoint& _Reference_State)
+{
+    float t = i * 0.02;
+
+    for(int j = 0; j < 3; j++)
+    {
+        _DroneState.position[j] = 0.01 * sin(t + j);
+        _DroneState.velocity[j] = 0.01 * cos(t + j);
+        _Reference_State.position_ref[j] = 0.0;
+        _Reference_State.velocity_ref[j] = 0.0;
+        _Reference_State.acceleration_ref[j] = 0.0;
+    }
+    _DroneState.attitude[2] = 0.1 * sin(t);
+}
+
+int main(int argc, char **argv)
+{
+    // 不使用rosout，未启动roscore时也可以运行
+    ros::init(argc, argv, "px4_benchmark", ros::init_options::NoRosout);
+
+    long iterations = 100000;
+    string output_file;
+
+    if(argc > 1)
+    {
+        iterations = atol(argv[1]);
+        if(iterations <= 0) iterations = 100000;
+    }
+    if(argc > 2)
+    {
+        output_file = argv[2];
+    }
+
+    //>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>> 位置控制律 <<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<
+    px4_command::DroneState _DroneState;
+    px4_command::TrajectoryPoint _Reference_State;
+    _DroneState.mode = "OFFBOARD";
+    _DroneState.flight_mode = px4_command::DroneState::MODE_OFFBOARD;
+    _DroneState.armed = true;
+    _Reference_State.Sub_mode = command_to_mavros::XYZ_POS;
+    _Reference_State.yaw_ref = 0.0;
+
+    px4_command::ControlOutput _ControlOutput;
+
+    for(int id = 0; id < pos_controller_registry::Controller_Num; id++)
+    {
+        pos_controller_base* _pos_controller = pos_controller_registry::create(id);
+        _pos_controller->set_initial_pos(Eigen::Vector3d(0.0,0.0,0.0));
+
+        run_benchmark(string("pos_controller_") + pos_controller_registry::name(id), iterations,
+            [&](long i)
+            {
+                fill_state(i, _DroneState, _Reference_State);
+                _pos_controller->pos_controller(_DroneState, _Reference_State, 0.02, _ControlOutput);
+                return _ControlOutput.Throttle[2];
+            });
+
+        delete _pos_controller;
+    }
+
+    //>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>> 推力/姿态转换 <<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<
+    run_benchmark("accelToThrust", iterations,
+        [&](long i)
+        {
+            Eigen::Vector3d accel_sp(0.5 * sin(i * 0.01), 0.5 * cos(i * 0.01), 9.81);
+            return (float)px4_command_utils::accelToThrust(accel_sp, 1.2, 20.0)[0];
+        });
+
+    run_benchmark("thrustToThrottle", iterations,
+        [&](long i)
+        {
+            Eigen::Vector3d thrust_sp(0.3 * sin(i * 0.01), 0.3 * cos(i * 0.01), 2.9);
+            return (float)px4_command_utils::thrustToThrottle(thrust_sp)[2];
+        });
+
+    px4_command::AttitudeReference _AttitudeReference;
+
+    run_benchmark("ThrottleToAttitude", iterations,
+        [&](long i)
+        {
+            Eigen::Vector3d throttle_sp(0.05 * sin(i * 0.01), 0.05 * cos(i * 0.01), 0.5);
+            px4_command_utils::ThrottleToAttitude(throttle_sp, 0.1 * sin(i * 0.01), _AttitudeReference);
+            return _AttitudeReference.desired_throttle;
+        });
+
+    att_controller _att_controller;
+    Eigen::Vector3d rates_sp;
+
+    run_benchmark("att_controller", iterations,
+        [&](long i)
+        {
+            Eigen::Quaterniond q(Eigen::AngleAxisd(0.05 * sin(i * 0.01), Eigen::Vector3d::UnitX()));
+            _att_controller.att_control(q, _AttitudeReference, rates_sp);
+            return (float)rates_sp[0];
+        });
+
+    run_benchmark("rotation_to_euler", iterations,
+        [&](long i)
+        {
+            Eigen::Matrix3d dcm = Eigen::AngleAxisd(0.1 * sin(i * 0.01), Eigen::Vector3d::UnitZ()).toRotationMatrix();
+            Eigen::Vector3d euler_angle;
+            rotation_to_euler(dcm, euler_angle);
+            return (float)euler_angle[2];
+        });
+
+    //>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>> 轨迹生成 <<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<
+    minimum_snap _minimum_snap;
+    min_snap_waypoints waypoints;
+    for(int i = 0; i < 50; i++)
+    {
+        waypoints.push_back(Eigen::Vector4d(2.0 * cos(i * 0.7), 2.0 * sin(i * 0.9), 1.0 + 0.3 * sin(i), 0.0));
+    }
+
+    // 求解耗时为毫秒量级，减少迭代次数
+    run_benchmark("minimum_snap_solve_50", max(iterations / 1000, 10L),
+        [&](long i)
+        {
+            waypoints[0][2] = 1.0 + 0.01 * (i % 10);
+            _minimum_snap.solve(waypoints);
+            return _minimum_snap.total_time();
+        });
+
+    run_benchmark("minimum_snap_sample", iterations,
+        [&](long i)
+        {
+            _minimum_snap.sample(fmod(i * 0.02, _minimum_snap.total_time()), _Reference_State);
+            return _Reference_State.position_ref[0];
+        });
+
+    trajectory_horizon _trajectory_horizon;
+
+    for(int id = 0; id < trajectory_registry::Trajectory_Num; id++)
+    {
+        parametric_trajectory* _parametric_trajectory = trajectory_registry::create(id);
+
+        run_benchmark(string("trajectory_sample_") + trajectory_registry::name(id), iterations,
+            [&](long i)
+            {
+                _parametric_trajectory->sample(i * 0.001, _Reference_State);
+                return _Reference_State.position_ref[0];
+            });
+
+        run_benchmark(string("trajectory_horizon_50_") + trajectory_registry::name(id), iterations / 10,
+            [&](long i)
+            {
+                _parametric_trajectory->evaluate_horizon(i * 0.001, 0.02, 50, _trajectory_horizon);
+                return _trajectory_horizon.position(49, 0);
+            });
+
+        delete _parametric_trajectory;
+    }
+
+    //>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>> 滤波器 <<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<
+    LowPassFilter LPF;
+    HighPassFilter HPF;
+    LeadLagFilter LLF;
+    LPF.set_Time_constant(0.1);
+    HPF.set_Time_constant(0.1);
+    LLF.set_Time_constant(0.1, 2.0);
+
+    run_benchmark("LowPassFilter::apply", iterations,
+        [&](long i)
+        {
+            return LPF.apply(sin(i * 0.01), 0.02);
+        });
+
+    run_benchmark("HighPassFilter::apply", iterations,
+        [&](long i)
+        {
+            return HPF.apply(sin(i * 0.01), 0.02);
+        });
+
+    run_benchmark("LeadLagFilter::apply", iterations,
+        [&](long i)
+        {
+            return LLF.apply(sin(i * 0.01), 0.02);
+        });
+
+    //>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>> 输出json <<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<
+    FILE* fp = stdout;
+    if(!output_file.empty())
+    {
+        fp = fopen(output_file.c_str(), "w");
+        if(fp == NULL)
+        {
+            printf("Can not open %s\n", output_file.c_str());
+            return -1;
+        }
+    }
+
+    fprintf(fp, "{\n  \"iterations\": %ld,\n  \"results\": [\n", iterations);
+    for(unsigned int i = 0; i < results.size(); i++)
+    {
+        fprintf(fp, "    {\"name\": \"%s\", \"ns_per_call\": %.2f, \"allocs_per_call\": %.4f}%s\n",
+            results[i].name.c_str(), results[i].ns_per_call, results[i].allocs_per_call, i + 1 < results.size() ? "," : "");
+    }
+    fprintf(fp, "  ]\n}\n");
+
+    if(fp != stdout)
+    {
+        fclose(fp);
+        printf("Results saved to %s\n", output_file.c_str());
+    }
+
+    return 0;
+}
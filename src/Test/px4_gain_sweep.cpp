@@ -0,0 +1,505 @@
+/***************************************************************************************************************************
+* px4_gain_sweep.cpp
+*
+* Author: Qyp
+*
+* Update Time: 2019.8.20
+*
+* Introduction:  Parallel gain sweep of a position controller over the headless closed-loop simulation
+*         1. switch_ude选择控制律（同px4_pos_controller），Sweep/gain_1 ~ Sweep/gain_4为扫描的增益名称（同参数文件中的键，如Kp_xy、T_ude_z），
+*            在[min, max]内取num个点（num > 1且min > 0时按对数间隔），所有组合构成网格；未扫描的参数取参数文件中的值
+*         2. 每组增益在Sweep/missions（逗号分隔：step, circle, helix, lemniscate, lissajous, polyline）的各参考轨迹上用sim_closed_loop仿真，
+*            控制器为pos_controller_registry中与实飞相同的类，由一个原型clone()后修改公有增益成员
+*         3. 指标：各轨迹位置误差均方根的平均值及control_effort(油门矢量变化率均方根)的平均值，任一轨迹失败则该组增益失败
+*         4. 按所有CPU核并行（Sweep/threads，0为全部核），每个线程拥有独立的sim_closed_loop，结果与线程数无关
+*         5. 输出两项指标下的Pareto最优增益组（按误差排序），Sweep/output_file非空时输出所有组合的csv文件
+*         6. 不需要roscore：未启动roscore时使用各参数默认值；通过px4_gain_sweep.launch启动时读取参数文件
+***************************************************************************************************************************/
+
+#include <ros/ros.h>
+#include <Eigen/Eigen>
+#include <math.h>
+#include <stdio.h>
+#include <string>
+#include <vector>
+#include <thread>
+#include <atomic>
+#include <algorithm>
+#include <functional>
+#include <iomanip>
+
+#include <pos_controller_registry.h>
+#include <trajectory_registry.h>
+#include <sim_closed_loop.h>
+
+using namespace std;
+
+#define SWEEP_GAIN_NUM 4
+
+//>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>增益表<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<
+// 三轴增益：<name>_xy对应x、y两个分量，<name>_z对应z分量
+bool match_vector(const string& gain_name, const string& name, Eigen::Vector3f& gain, vector<float*>& targets)
+{
+    if(gain_name == name + "_xy")
+    {
+        targets.push_back(&gain[0]);
+        targets.push_back(&gain[1]);
+        return true;
+    }
+    if(gain_name == name + "_z")
+    {
+        targets.push_back(&gain[2]);
+        return true;
+    }
+    return false;
+}
+
+bool match_scalar(const string& gain_name, const string& name, float& gain, vector<float*>& targets)
+{
+    if(gain_name == name)
+    {
+        targets.push_back(&gain);
+        return true;
+    }
+    return false;
+}
+
+// 由参数文件中的键找到控制器的增益成员 [Output: targets, 找不到时返回false]
+bool find_gain(pos_controller_base* controller, int controller_type, const string& gain_name, vector<float*>& targets)
+{
+    targets.clear();
+
+    switch (controller_type)
+    {
+    case pos_controller_registry::Cascade_PID:
+    {
+        pos_controller_cascade_PID* c = static_cast<pos_controller_cascade_PID*>(controller);
+        return match_scalar(gain_name, "Kp_xy", c->Kp_xy, targets) || match_scalar(gain_name, "Kp_z", c->Kp_z, targets)
+            || match_scalar(gain_name, "Kp_vxvy", c->Kp_vxvy, targets) || match_scalar(gain_name, "Kp_vz", c->Kp_vz, targets)
+            || match_scalar(gain_name, "Ki_vxvy", c->Ki_vxvy, targets) || match_scalar(gain_name, "Ki_vz", c->Ki_vz, targets)
+            || match_scalar(gain_name, "Kd_vxvy", c->Kd_vxvy, targets) || match_scalar(gain_name, "Kd_vz", c->Kd_vz, targets)
+            || match_scalar(gain_name, "Hover_throttle", c->Hover_throttle, targets);
+    }
+    case pos_controller_registry::PID:
+    {
+        pos_controller_PID* c = static_cast<pos_controller_PID*>(controller);
+        return match_vector(gain_name, "Kp", c->Kp, targets) || match_vector(gain_name, "Kd", c->Kd, targets)
+            || match_vector(gain_name, "Ki", c->Ki, targets);
+    }
+    case pos_controller_registry::UDE:
+    {
+        pos_controller_UDE* c = static_cast<pos_controller_UDE*>(controller);
+        return match_vector(gain_name, "Kp", c->Kp, targets) || match_vector(gain_name, "Kd", c->Kd, targets)
+            || match_vector(gain_name, "T_ude", c->T_ude, targets);
+    }
+    case pos_controller_registry::Passivity:
+    {
+        pos_controller_passivity* c = static_cast<pos_controller_passivity*>(controller);
+        return match_vector(gain_name, "Kp", c->Kp, targets) || match_vector(gain_name, "Kd", c->Kd, targets)
+            || match_vector(gain_name, "T_ude", c->T_ude, targets) || match_scalar(gain_name, "T_ps", c->T_ps, targets);
+    }
+    case pos_controller_registry::NE:
+    {
+        pos_controller_NE* c = static_cast<pos_controller_NE*>(controller);
+        return match_vector(gain_name, "Kp", c->Kp, targets) || match_vector(gain_name, "Kd", c->Kd, targets)
+            || match_vector(gain_name, "T_ude", c->T_ude, targets) || match_scalar(gain_name, "T_ne", c->T_ne, targets);
+    }
+    case pos_controller_registry::MPC:
+    {
+        pos_controller_MPC* c = static_cast<pos_controller_MPC*>(controller);
+        return match_vector(gain_name, "Q_pos", c->Q_pos, targets) || match_vector(gain_name, "Q_vel", c->Q_vel, targets)
+            || match_vector(gain_name, "R", c->R_acc, targets) || match_vector(gain_name, "Ki", c->Ki, targets);
+    }
+    case pos_controller_registry::SE3:
+    {
+        pos_controller_SE3* c = static_cast<pos_controller_SE3*>(controller);
+        return match_vector(gain_name, "Kp", c->Kp, targets) || match_vector(gain_name, "Kv", c->Kv, targets)
+            || match_vector(gain_name, "Ki", c->Ki, targets) || match_vector(gain_name, "kR", c->kR, targets);
+    }
+    case pos_controller_registry::INDI:
+    {
+        pos_controller_INDI* c = static_cast<pos_controller_INDI*>(controller);
+        return match_vector(gain_name, "Kp", c->Kp, targets) || match_vector(gain_name, "Kv", c->Kv, targets);
+    }
+    default:
+        return false;
+    }
+}
+
+// 增益修改后更新控制器中由增益计算得到的量（滤波器、MPC的KKT分解）
+void update_controller(pos_controller_base* controller, int controller_type)
+{
+    switch (controller_type)
+    {
+    case pos_controller_registry::Passivity:
+        static_cast<pos_controller_passivity*>(controller)->set_filter();
+        break;
+    case pos_controller_registry::NE:
+        static_cast<pos_controller_NE*>(controller)->set_filter();
+        break;
+    case pos_controller_registry::MPC:
+        static_cast<pos_controller_MPC*>(controller)->setup();
+        break;
+    default:
+        break;
+    }
+}
+
+//>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>扫描<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<
+struct sweep_gain
+{
+    string name;
+    float min;
+    float max;
+    int num;
+};
+
+struct sweep_mission
+{
+    string name;
+    int reference_type;             // Sim/reference
+    int trajectory_type;            // Trajectory_type
+};
+
+struct sweep_point
+{
+    vector<float> gains;
+    float rms_error;                // 各轨迹平均 [m]
+    float control_effort;           // 各轨迹平均 [1/s]
+    float max_tilt;                 // 各轨迹最大 [deg]
+    bool crashed;
+    bool pareto;
+};
+
+float grid_value(const sweep_gain& gain, int index)
+{
+    if(gain.num < 2)
+    {
+        return gain.min;
+    }
+
+    float ratio = (float)index / (gain.num - 1);
+    if(gain.min > 0 && gain.max > 0)
+    {
+        return gain.min * pow(gain.max / gain.min, ratio);
+    }
+    return gain.min + (gain.max - gain.min) * ratio;
+}
+
+// 解析Sweep/missions [Output: false for 未知的轨迹名称]
+bool parse_missions(const string& missions, vector<sweep_mission>& result)
+{
+    size_t begin = 0;
+    while(begin <= missions.size())
+    {
+        size_t end = missions.find(',', begin);
+        if(end == string::npos) end = missions.size();
+
+        string name = missions.substr(begin, end - begin);
+        name.erase(0, name.find_first_not_of(' '));
+        name.erase(name.find_last_not_of(' ') + 1);
+
+        if(!name.empty())
+        {
+            sweep_mission mission;
+            mission.name = name;
+            mission.reference_type = 0;
+            mission.trajectory_type = 0;
+
+            if(name != "step")
+            {
+                mission.reference_type = 1;
+                mission.trajectory_type = -1;
+                for(int i = 0; i < trajectory_registry::Trajectory_Num; i++)
+                {
+                    if(name == trajectory_registry::name(i))
+                    {
+                        mission.trajectory_type = i;
+                    }
+                }
+                if(mission.trajectory_type < 0)
+                {
+                    cout << "Unknown mission: " << name << endl;
+                    return false;
+                }
+            }
+            result.push_back(mission);
+        }
+        begin = end + 1;
+    }
+    return !result.empty();
+}
+
+// 工作线程：依次取未完成的网格点并仿真
+void sweep_worker(int controller_type, const pos_controller_base* prototype, const vector<sweep_gain>& gains,
+                  const vector<sweep_mission>& missions, vector<sim_closed_loop*>& sims, vector<sweep_point>& points, atomic<int>& next)
+{
+    vector<float*> targets;
+
+    while(true)
+    {
+        int index = next++;
+        if(index >= (int)points.size())
+        {
+            break;
+        }
+
+        sweep_point& point = points[index];
+        point.rms_error = 0.0;
+        point.control_effort = 0.0;
+        point.max_tilt = 0.0;
+        point.crashed = false;
+
+        for(unsigned int m = 0; m < missions.size(); m++)
+        {
+            pos_controller_base* controller = pos_controller_registry::clone(controller_type, prototype);
+
+            for(unsigned int i = 0; i < gains.size(); i++)
+            {
+                find_gain(controller, controller_type, gains[i].name, targets);
+                for(unsigned int j = 0; j < targets.size(); j++)
+                {
+                    *targets[j] = point.gains[i];
+                }
+            }
+            update_controller(controller, controller_type);
+
+            sim_result result = sims[m]->run(controller, "");
+            delete controller;
+
+            point.rms_error += result.rms_error / missions.size();
+            point.control_effort += result.control_effort / missions.size();
+            point.max_tilt = max(point.max_tilt, result.max_tilt);
+
+            if(result.crashed)
+            {
+                point.crashed = true;
+                break;
+            }
+        }
+    }
+}
+
+// 标记Pareto最优点：不存在误差和控制量都不大于它（且至少一项更小）的其他点
+void mark_pareto(vector<sweep_point>& points, vector<int>& pareto)
+{
+    vector<int> order;
+    for(unsigned int i = 0; i < points.size(); i++)
+    {
+        points[i].pareto = false;
+        if(!points[i].crashed)
+        {
+            order.push_back(i);
+        }
+    }
+
+    sort(order.begin(), order.end(), [&points](int a, int b)
+    {
+        if(points[a].rms_error != points[b].rms_error) return points[a].rms_error < points[b].rms_error;
+        return points[a].control_effort < points[b].control_effort;
+    });
+
+    // 按误差递增，控制量严格递减的点即为Pareto前沿
+    pareto.clear();
+    float effort_min = 1e10;
+    for(unsigned int i = 0; i < order.size(); i++)
+    {
+        if(points[order[i]].control_effort < effort_min)
+        {
+            effort_min = points[order[i]].control_effort;
+            points[order[i]].pareto = true;
+            pareto.push_back(order[i]);
+        }
+    }
+}
+
+int main(int argc, char **argv)
+{
+    // 不使用rosout，未启动roscore时也可以运行
+    ros::init(argc, argv, "px4_gain_sweep", ros::init_options::NoRosout);
+    ros::NodeHandle nh("~");
+
+    int switch_ude;
+    int threads_num;
+    string missions_string;
+    string output_file;
+    nh.param<int>("switch_ude", switch_ude, 2);
+    nh.param<string>("Sweep/missions", missions_string, "step,circle,polyline");
+    nh.param<int>("Sweep/threads", threads_num, 0);
+    nh.param<string>("Sweep/output_file", output_file, "");
+
+    pos_controller_base* prototype = pos_controller_registry::create(switch_ude);
+    if(prototype == NULL || switch_ude == pos_controller_registry::Autotune)
+    {
+        cout << "Wrong controller type: " << switch_ude << endl;
+        return -1;
+    }
+
+    // 扫描的增益
+    vector<sweep_gain> gains;
+    vector<float*> targets;
+    for(int i = 1; i <= SWEEP_GAIN_NUM; i++)
+    {
+        char key[32];
+        sweep_gain gain;
+
+        sprintf(key, "Sweep/gain_%d", i);
+        nh.param<string>(key, gain.name, "");
+        if(gain.name.empty())
+        {
+            continue;
+        }
+
+        sprintf(key, "Sweep/gain_%d_min", i);
+        nh.param<float>(key, gain.min, 0.5);
+        sprintf(key, "Sweep/gain_%d_max", i);
+        nh.param<float>(key, gain.max, 2.0);
+        sprintf(key, "Sweep/gain_%d_num", i);
+        nh.param<int>(key, gain.num, 5);
+        if(gain.num < 1) gain.num = 1;
+
+        if(!find_gain(prototype, switch_ude, gain.name, targets))
+        {
+            cout << "Unknown gain for " << pos_controller_registry::name(switch_ude) << ": " << gain.name << endl;
+            return -1;
+        }
+        gains.push_back(gain);
+    }
+
+    vector<sweep_mission> missions;
+    if(!parse_missions(missions_string, missions))
+    {
+        return -1;
+    }
+
+    // 网格
+    int points_num = 1;
+    for(unsigned int i = 0; i < gains.size(); i++)
+    {
+        points_num *= gains[i].num;
+    }
+
+    vector<sweep_point> points(points_num);
+    for(int k = 0; k < points_num; k++)
+    {
+        int index = k;
+        points[k].gains.resize(gains.size());
+        for(unsigned int i = 0; i < gains.size(); i++)
+        {
+            points[k].gains[i] = grid_value(gains[i], index % gains[i].num);
+            index /= gains[i].num;
+        }
+    }
+
+    if(threads_num <= 0)
+    {
+        threads_num = thread::hardware_concurrency();
+        if(threads_num <= 0) threads_num = 1;
+    }
+    threads_num = min(threads_num, points_num);
+
+    // 每个线程每条轨迹一个仿真器（构造时读取参数，在主线程完成）
+    vector< vector<sim_closed_loop*> > sims(threads_num);
+    for(int t = 0; t < threads_num; t++)
+    {
+        for(unsigned int m = 0; m < missions.size(); m++)
+        {
+            sim_closed_loop* sim = new sim_closed_loop;
+            sim->set_reference(missions[m].reference_type, missions[m].trajectory_type);
+            sims[t].push_back(sim);
+        }
+    }
+
+    sims[0][0]->printf_param();
+    cout <<">>>>>>>>>>>>>>>>>>>>>>>>>>>>>> Gain Sweep: " << pos_controller_registry::name(switch_ude) << " <<<<<<<<<<<<<<<<<<<<<<<<<<" <<endl;
+    for(unsigned int i = 0; i < gains.size(); i++)
+    {
+        cout << gains[i].name << " : [" << gains[i].min << ", " << gains[i].max << "] x " << gains[i].num << endl;
+    }
+    cout << "missions :";
+    for(unsigned int m = 0; m < missions.size(); m++)
+    {
+        cout << " " << missions[m].name;
+    }
+    cout << endl;
+    cout << "points : " << points_num << "  flights : " << points_num * missions.size() << "  threads : " << threads_num << endl;
+
+    ros::WallTime begin_time = ros::WallTime::now();
+
+    atomic<int> next(0);
+    vector<thread> workers;
+    for(int t = 0; t < threads_num; t++)
+    {
+        workers.push_back(thread(sweep_worker, switch_ude, prototype, cref(gains), cref(missions), ref(sims[t]), ref(points), ref(next)));
+    }
+    for(int t = 0; t < threads_num; t++)
+    {
+        workers[t].join();
+    }
+
+    float time_wall = (ros::WallTime::now() - begin_time).toSec();
+
+    vector<int> pareto;
+    mark_pareto(points, pareto);
+
+    int crashed_num = 0;
+    for(int k = 0; k < points_num; k++)
+    {
+        if(points[k].crashed) crashed_num++;
+    }
+
+    cout.setf(ios::fixed);
+    cout << setprecision(4);
+    cout << "time_wall : " << time_wall << " [s]  crashed : " << crashed_num << " / " << points_num << endl;
+
+    cout <<">>>>>>>>>>>>>>>>>>>>>>>>>>>>>> Pareto front (rms_error vs control_effort) <<<<<<<<<<<<<<<<<<<<<<<<<<" <<endl;
+    for(unsigned int p = 0; p < pareto.size(); p++)
+    {
+        const sweep_point& point = points[pareto[p]];
+        cout << "rms_error : " << point.rms_error << " [m]  control_effort : " << point.control_effort << " [1/s]  max_tilt : " << point.max_tilt << " [deg] |";
+        for(unsigned int i = 0; i < gains.size(); i++)
+        {
+            cout << " " << gains[i].name << " : " << point.gains[i];
+        }
+        cout << endl;
+    }
+
+    if(!output_file.empty())
+    {
+        FILE* fp = fopen(output_file.c_str(), "w");
+        if(fp != NULL)
+        {
+            for(unsigned int i = 0; i < gains.size(); i++)
+            {
+                fprintf(fp, "%s,", gains[i].name.c_str());
+            }
+            fprintf(fp, "rms_error,control_effort,max_tilt,crashed,pareto\n");
+
+            for(int k = 0; k < points_num; k++)
+            {
+                for(unsigned int i = 0; i < gains.size(); i++)
+                {
+                    fprintf(fp, "%.4f,", points[k].gains[i]);
+                }
+                fprintf(fp, "%.4f,%.4f,%.2f,%d,%d\n", points[k].rms_error, points[k].control_effort, points[k].max_tilt,
+                        points[k].crashed ? 1 : 0, points[k].pareto ? 1 : 0);
+            }
+            fclose(fp);
+            cout << "All points written to " << output_file << endl;
+        }else
+        {
+            cout << "Can not open " << output_file << endl;
+        }
+    }
+
+    for(int t = 0; t < threads_num; t++)
+    {
+        for(unsigned int m = 0; m < missions.size(); m++)
+        {
+            delete sims[t][m];
+        }
+    }
+    delete prototype;
+
+    return 0;
+}
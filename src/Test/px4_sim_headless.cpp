@@ -0,0 +1,73 @@
+/***************************************************************************************************************************
+* px4_sim_headless.cpp
+*
+* Author: Qyp
+*
+* Update Time: 2019.7.26
+*
+* Introduction:  Headless closed-loop simulation of the position controllers (no Gazebo / SITL)
+*         1. 使用quadrotor_dynamics.h中的六自由度模型代替飞控及仿真器，控制链与px4_pos_controller一致
+*         2. switch_ude选择控制律（同px4_pos_controller），switch_ude = -1 时依次仿真所有控制律并对比
+*         3. 不需要roscore：未启动roscore时使用各参数默认值；通过px4_sim_headless.launch启动时读取参数文件
+*         4. Sim/log_file非空时输出csv文件（所有控制律仿真时文件名后加控制律名称）
+***************************************************************************************************************************/
+
+#include <ros/ros.h>
+#include <string>
+
+#include <pos_controller_registry.h>
+#include <quadrotor_dynamics.h>
+#include <sim_closed_loop.h>
+
+using namespace std;
+
+int main(int argc, char **argv)
+{
+    // 不使用rosout，未启动roscore时也可以运行
+    ros::init(argc, argv, "px4_sim_headless", ros::init_options::NoRosout);
+    ros::NodeHandle nh("~");
+
+    int switch_ude;
+    string log_file;
+    nh.param<int>("switch_ude", switch_ude, 0);
+    nh.param<string>("Sim/log_file", log_file, "");
+
+    sim_closed_loop _sim_closed_loop;
+
+    _sim_closed_loop.quad.printf_param();
+    _sim_closed_loop.printf_param();
+
+    int id_begin = switch_ude;
+    int id_end = switch_ude + 1;
+    if(switch_ude < 0)
+    {
+        id_begin = 0;
+        id_end = pos_controller_registry::Controller_Num;
+    }
+
+    for(int id = id_begin; id < id_end; id++)
+    {
+        pos_controller_base* _pos_controller = pos_controller_registry::create(id);
+
+        if(_pos_controller == NULL)
+        {
+            cout << "Wrong controller type: " << id << endl;
+            return -1;
+        }
+
+        string file = log_file;
+        if(!file.empty() && switch_ude < 0)
+        {
+            file = file + "_" + pos_controller_registry::name(id) + ".csv";
+        }
+
+        sim_result result = _sim_closed_loop.run(_pos_controller, file);
+
+        cout <<">>>>>>>>>>>>>>>>>>>>>>>>>>>>>> Result: " << pos_controller_registry::name(id) << " <<<<<<<<<<<<<<<<<<<<<<<<<<" <<endl;
+        _sim_closed_loop.printf_result(result);
+
+        delete _pos_controller;
+    }
+
+    return 0;
+}
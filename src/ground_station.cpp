@@ -10,6 +10,7 @@
 
 #include <px4_command_utils.h>
 #include <OptiTrackFeedBackRigidBody.h>
+#include <mocap_tracker.h>
 #include <px4_command/ControlCommand.h>
 #include <px4_command/DroneState.h>
 #include <px4_command/TrajectoryPoint.h>
@@ -46,6 +47,10 @@ rigidbody_state UAVstate;
 Eigen::Quaterniond q_fcu_target;
 Eigen::Vector3d euler_fcu_target;
 float Thrust_target;
+int mocap_source;                                         //0:本节点订阅动捕 1:使用px4_mocap_tracker发布的多刚体状态
+string rigid_body_name;
+px4_command::RigidBodyArray _RigidBodyArray;
+int rigid_body_index = -1;
 
 //>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>函数声明<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<
 void printf_info();                                                                       //打印函数
@@ -90,14 +95,26 @@ void optitrack_cb(const geometry_msgs::PoseStamped::ConstPtr& msg)
 
 }
 
+void rigid_bodies_cb(const px4_command::RigidBodyArray::ConstPtr& msg)
+{
+    _RigidBodyArray = *msg;
+}
+
 //>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>主 函 数<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<
 int main(int argc, char **argv)
 {
     ros::init(argc, argv, "ground_station");
     ros::NodeHandle nh("~");
 
-    // 【订阅】optitrack估计位置
-    ros::Subscriber optitrack_sub = nh.subscribe<geometry_msgs::PoseStamped>("/vrpn_client_node/UAV/pose", 10, optitrack_cb);
+    // 0 for 订阅/vrpn_client_node/<rigid_body_name>/pose, 1 for 读取px4_mocap_tracker发布的/px4_command/rigid_bodies
+    nh.param<int>("mocap_source", mocap_source, 0);
+    nh.param<string>("rigid_body_name", rigid_body_name, "UAV");
+
+    // 【订阅】optitrack估计位置 (mocap_source为0时)
+    ros::Subscriber optitrack_sub;
+
+    // 【订阅】多刚体动捕状态 (mocap_source为1时)
+    ros::Subscriber rigid_bodies_sub;
 
     ros::Subscriber log_sub = nh.subscribe<px4_command::Topic_for_log>("/px4_command/topic_for_log", 10, log_cb);
 
@@ -106,7 +123,16 @@ int main(int argc, char **argv)
     // 频率
     ros::Rate rate(10.0);
 
-    OptiTrackFeedBackRigidBody UAV("/vrpn_client_node/UAV/pose",nh,3,3);
+    OptiTrackFeedBackRigidBody* UAV = NULL;
+    if(mocap_source == 1)
+    {
+        rigid_bodies_sub = nh.subscribe<px4_command::RigidBodyArray>("/px4_command/rigid_bodies", 10, rigid_bodies_cb);
+    }
+    else
+    {
+        optitrack_sub = nh.subscribe<geometry_msgs::PoseStamped>("/vrpn_client_node/" + rigid_body_name + "/pose", 10, optitrack_cb);
+        UAV = new OptiTrackFeedBackRigidBody(("/vrpn_client_node/" + rigid_body_name + "/pose").c_str(),nh,3,3);
+    }
 
 //>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>Main Loop<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<
     while(ros::ok())
@@ -117,14 +143,24 @@ int main(int argc, char **argv)
         //利用OptiTrackFeedBackRigidBody类获取optitrack的数据
         //UAV.GetOptiTrackState();
 
-        UAV.RosWhileLoopRun();
-        UAV.GetState(UAVstate);
+        if(UAV != NULL)
+        {
+            UAV->RosWhileLoopRun();
+            UAV->GetState(UAVstate);
+        }
+        else
+        {
+            mocap_tracker::get_state(_RigidBodyArray, mocap_tracker::find(_RigidBodyArray, rigid_body_name, rigid_body_index), UAVstate);
+            pos_drone_mocap = UAVstate.Position;
+        }
 
         //打印
         printf_info();
         rate.sleep();
     }
 
+    delete UAV;
+
     return 0;
 
 }
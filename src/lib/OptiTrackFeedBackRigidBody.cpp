@@ -1,6 +1,7 @@
 #include "OptiTrackFeedBackRigidBody.h"
 
-OptiTrackFeedBackRigidBody::OptiTrackFeedBackRigidBody(const char* name,ros::NodeHandle& n,unsigned int linear_window, unsigned int angular_window)
+OptiTrackFeedBackRigidBody::OptiTrackFeedBackRigidBody(const char* name,ros::NodeHandle& n,unsigned int linear_window, unsigned int angular_window,
+                                                       unsigned int linear_filter, unsigned int order)
 {
     // load filter window size
     linear_velocity_window = linear_window;
@@ -17,24 +18,35 @@ OptiTrackFeedBackRigidBody::OptiTrackFeedBackRigidBody(const char* name,ros::Nod
         ROS_INFO("Input Valude is [%d]",angular_velocity_window);
         angular_velocity_window = max_windowsize;
     }
+    if(linear_velocity_window<1)
+    {
+        linear_velocity_window = 1;
+    }
+    if(angular_velocity_window<1)
+    {
+        angular_velocity_window = 1;
+    }
+    // load the linear velocity filter, the Savitzky-Golay fit needs more poses than polynomial coefficients
+    velocity_filter = linear_filter;
+    polynomial_order = order;
+    if(velocity_filter==VELOCITY_FILTER_SAVITZKY_GOLAY && (polynomial_order<1 || linear_velocity_window<=polynomial_order))
+    {
+        ROS_INFO("Savitzky-Golay Window Size [%d] must be larger than Polynomial Order [%d], use Moving Window Averaging",linear_velocity_window,polynomial_order);
+        velocity_filter = VELOCITY_FILTER_MOVING_AVERAGE;
+    }
     // set up subscriber to vrpn optitrack beedback
-    subOptiTrack = n.subscribe(name, 1, &OptiTrackFeedBackRigidBody::OptiTrackCallback,this);
+    // every pose is differentiated in the callback, the queue keeps the poses arriving between two ros while loop runs
+    subOptiTrack = n.subscribe(name, 10, &OptiTrackFeedBackRigidBody::OptiTrackCallback,this);
     //Initialize all velocity
-    for(int i =0;i<max_windowsize;i++)
+    velocity_raw.resize(linear_velocity_window);
+    angular_velocity_raw.resize(angular_velocity_window);
+    position_history.resize(linear_velocity_window);
+    time_history.resize(linear_velocity_window);
+    SetZeroVelocity();
+    if(velocity_filter==VELOCITY_FILTER_SAVITZKY_GOLAY)
     {
-        velocity_raw[i](0)=0;
-        velocity_raw[i](1)=0;
-        velocity_raw[i](2)=0;
-        angular_velocity_raw[i](0)=0;
-        angular_velocity_raw[i](1)=0;
-        angular_velocity_raw[i](2)=0;
+        CalculateSavitzkyGolayWeights();
     }
-    velocity_filtered(0)=0;
-    velocity_filtered(1)=0;
-    velocity_filtered(2)=0;
-    angular_velocity_filtered(0)=0;
-    angular_velocity_filtered(1)=0;
-    angular_velocity_filtered(2)=0;
     //Initialize all pose
     for(int i = 0;i<2;i++)
     {
@@ -62,6 +74,13 @@ OptiTrackFeedBackRigidBody::OptiTrackFeedBackRigidBody(const char* name,ros::Nod
     // Initialize flag
     OptiTrackFlag = 0;
     FeedbackState = 0;
+    // Initialize timing
+    dropout_time = 0.1;
+    prediction_max = 0.05;
+    time_received = 0;
+    latency = 0;
+    latency_samples = 0;
+    discarded_poses = 0;
 }
 
 void OptiTrackFeedBackRigidBody::CalculateVelocityFromPose()
@@ -83,7 +102,7 @@ void OptiTrackFeedBackRigidBody::CalculateVelocityFromPose()
     Vector3d angular_velocity_onestep;
   if (pose[0].t >0)// calculate only when last time stamp has been recorded.
   {
-      // step (2)
+      // step (2), the callback guarantees 0 < dt <= dropout_time
       dt = pose[1].t - pose[0].t;// time step
       // calculate linear velocity
       velocity_onestep = (pose[1].Position- pose[0].Position)/dt;
@@ -103,6 +122,10 @@ void OptiTrackFeedBackRigidBody::CalculateVelocityFromPose()
   PushRawVelocity(velocity_onestep,angular_velocity_onestep);
   // step (5): update filtered velocity
   MovingWindowAveraging();
+  if(velocity_filter==VELOCITY_FILTER_SAVITZKY_GOLAY)
+  {
+      SavitzkyGolayDifferentiation();
+  }
 }
 void OptiTrackFeedBackRigidBody::PushPose()
 {
@@ -161,53 +184,104 @@ void OptiTrackFeedBackRigidBody::PushPose()
     pose[1].Position(0) =  OptiTrackdata.pose.position.x;
     pose[1].Position(1) =  OptiTrackdata.pose.position.y;
     pose[1].Position(2) =  OptiTrackdata.pose.position.z;
+    // keep the position history for the Savitzky-Golay differentiator
+    position_head = (position_head + 1) % linear_velocity_window;
+    position_history[position_head] = pose[1].Position;
+    time_history[position_head] = pose[1].t;
+    if(position_count<linear_velocity_window)
+    {
+        position_count++;
+    }
 }
 
 void OptiTrackFeedBackRigidBody::PushRawVelocity(Vector3d& new_linear_velocity, Vector3d& new_angular_velocity)
 {
     /* Logic:
-     * a(i-1) = a(i), i = 2...windowsize
-     * should fristly start from  i = 2. a(1) = a(2); a(2) = a(3);....; a(N-1) = a(N)
-     * secondly a(N) = a_new
+     * the buffer is a ring, head points at the latest value and head+1 at the oldest one
+     * the oldest value is overwritten by the new one and the running sum is updated: sum = sum - a_oldest + a_new
+     * the sum is recomputed from the buffer each time the head wraps around, so the rounding error does not accumulate
     */
    // linear velocity
-    for(int i = 1;i<linear_velocity_window;i++)//first step
+    velocity_head = (velocity_head + 1) % linear_velocity_window;
+    velocity_sum += new_linear_velocity - velocity_raw[velocity_head];
+    velocity_raw[velocity_head] = new_linear_velocity;
+    if(velocity_head==0)
     {
-        velocity_raw[i-1] = velocity_raw[i];
+        velocity_sum.setZero();
+        for(unsigned int i = 0;i<linear_velocity_window;i++)
+        {
+            velocity_sum += velocity_raw[i];
+        }
     }
-    velocity_raw[linear_velocity_window-1] = new_linear_velocity;// second step update the last variable in the velocity buffer
     // angular velocity
-    for(int i = 1;i<angular_velocity_window;i++)//first step
+    angular_velocity_head = (angular_velocity_head + 1) % angular_velocity_window;
+    angular_velocity_sum += new_angular_velocity - angular_velocity_raw[angular_velocity_head];
+    angular_velocity_raw[angular_velocity_head] = new_angular_velocity;
+    if(angular_velocity_head==0)
     {
-        angular_velocity_raw[i-1] = angular_velocity_raw[i];
+        angular_velocity_sum.setZero();
+        for(unsigned int i = 0;i<angular_velocity_window;i++)
+        {
+            angular_velocity_sum += angular_velocity_raw[i];
+        }
     }
-    angular_velocity_raw[angular_velocity_window-1] = new_angular_velocity;// second step update the last variable in the velocity buffer   
 }
 
 void OptiTrackFeedBackRigidBody::MovingWindowAveraging()
 {
 
-    /* Logic: Average the raw velocity measurement in the
+    /* Logic: Average the raw velocity measurement in the window, the sum is kept by PushRawVelocity
+    */
+    velocity_filtered = velocity_sum/(double)linear_velocity_window;
+    angular_velocity_filtered = angular_velocity_sum/(double)angular_velocity_window;
+}
+
+void OptiTrackFeedBackRigidBody::CalculateSavitzkyGolayWeights()
+{
+    /* Logic:
+     * fit p(k) = c0 + c1 k + ... + cn k^n to the last N positions at k = -(N-1),...,-1,0 (least squares)
+     * the derivative at the latest sample is dp/dk(0) = c1 = e1^T (A^T A)^-1 A^T p, with A(i,j) = k_i^j
+     * the weights e1^T (A^T A)^-1 A^T only depend on N and n, so they are computed once here
     */
-    double weight_linear = (double)1/linear_velocity_window;// the weight on each velocity to be summed up.
-    double weight_angular = (double)1/angular_velocity_window;// the weight on each velocity to be summed up.
-    // create a temporary variable to store the summed velocity and initialize it witht the 1st buffer value
-    Vector3d velocitytemp;
-    Vector3d angular_velocitytemp;
-    velocitytemp = weight_linear*velocity_raw[0];
-    angular_velocitytemp = weight_angular*angular_velocity_raw[0];
-
-    for(int i = 1;i<linear_velocity_window;i++)// sum starts from the second buffer value
+    unsigned int N = linear_velocity_window;
+    MatrixXd A(N, polynomial_order + 1);
+    for(unsigned int i = 0;i<N;i++)
     {
-        velocitytemp += weight_linear*velocity_raw[i];
+        double k = (double)i - (double)(N - 1);
+        A(i,0) = 1.0;
+        for(unsigned int j = 1;j<=polynomial_order;j++)
+        {
+            A(i,j) = A(i,j-1)*k;
+        }
     }
-    for(int i = 1;i<angular_velocity_window;i++)// sum starts from the second buffer value
+    MatrixXd coefficients = (A.transpose()*A).ldlt().solve(A.transpose());
+    savitzky_golay_weights = coefficients.row(1).transpose();
+}
+
+void OptiTrackFeedBackRigidBody::SavitzkyGolayDifferentiation()
+{
+    /* Logic:
+     * 1) wait until the position buffer is full, the moving window average is used until then
+     * 2) the sample time is the average one over the window, assuming vrpn delivers the poses at a constant rate
+     * 3) v = sum(w_i * p_i)/dt, with p_i from the oldest to the latest position
+    */
+    unsigned int N = linear_velocity_window;
+    if(position_count<N)
+    {
+        return;
+    }
+    unsigned int oldest = (position_head + 1) % N;
+    double dt = (time_history[position_head] - time_history[oldest])/(double)(N - 1);
+    if(dt<=0.0)
+    {
+        return;
+    }
+    Vector3d velocitytemp = Vector3d::Zero();
+    for(unsigned int i = 0;i<N;i++)
     {
-        angular_velocitytemp += weight_angular*angular_velocity_raw[i];
+        velocitytemp += savitzky_golay_weights(i)*position_history[(oldest + i) % N];
     }
-    // the filtered vlocity is just the weighted summed result
-    velocity_filtered = velocitytemp;
-    angular_velocity_filtered = angular_velocitytemp;
+    velocity_filtered = velocitytemp/dt;
 }
 
 void OptiTrackFeedBackRigidBody::GetState(rigidbody_state& state)
@@ -229,25 +303,76 @@ void OptiTrackFeedBackRigidBody::GetState(rigidbody_state& state)
     state.quaterion(2) = pose[1].q2;
     state.quaterion(3) = pose[1].q3;
 }
+void OptiTrackFeedBackRigidBody::GetPredictedState(rigidbody_state& state, double t)
+{
+    /* Logic:
+     * 1) the latest pose was measured latency seconds before it was received, and t - time_received has passed since then
+     * 2) the horizon is limited to [0, prediction_max], so a dropout or a bad latency estimate does not extrapolate far
+     * 3) constant linear velocity: P = P + V_I h; constant body angular velocity: R_IB = R_IB exp(Omega_BI^x h)
+     * 4) time_stamp is moved forward by the horizon, in the clock of the mocap stamps
+    */
+    GetState(state);
+    if(FeedbackState==0)
+    {
+        return;
+    }
+    double horizon = t - time_received + latency;
+    horizon = std::min(std::max(horizon, 0.0), prediction_max);
+    state.Position = state.Position + state.V_I*horizon;
+    Quaterniond q(state.quaterion(0), state.quaterion(1), state.quaterion(2), state.quaterion(3));
+    Vector3d rotation = state.Omega_BI*horizon;
+    if(rotation.norm()>1e-9)
+    {
+        q = q*Quaterniond(AngleAxisd(rotation.norm(), rotation.normalized()));
+        q.normalize();
+    }
+    state.quaterion(0) = q.w();
+    state.quaterion(1) = q.x();
+    state.quaterion(2) = q.y();
+    state.quaterion(3) = q.z();
+    state.R_IB = q.toRotationMatrix();
+    state.R_BI = state.R_IB.transpose();
+    // roll pitch yaw, same convention as GetEulerAngleFromQuaterion_NormalConvention
+    state.Euler(0) = atan2(2.0*(q.w()*q.x() + q.y()*q.z()), 1.0 - 2.0*(q.x()*q.x() + q.y()*q.y()));
+    state.Euler(1) = asin(std::min(std::max(2.0*(q.w()*q.y() - q.z()*q.x()), -1.0), 1.0));
+    state.Euler(2) = atan2(2.0*(q.w()*q.z() + q.x()*q.y()), 1.0 - 2.0*(q.y()*q.y() + q.z()*q.z()));
+    state.time_stamp = state.time_stamp + horizon;
+}
+void OptiTrackFeedBackRigidBody::SetTiming(double dropout, double prediction)
+{
+    dropout_time = dropout;
+    prediction_max = prediction;
+}
+double OptiTrackFeedBackRigidBody::GetLatency()
+{
+    return latency;
+}
+unsigned int OptiTrackFeedBackRigidBody::GetDiscardedPoses()
+{
+    return discarded_poses;
+}
 void OptiTrackFeedBackRigidBody::GetRaWVelocity(Vector3d& linear_velocity,Vector3d& angular_velocity)
 {
-    linear_velocity = velocity_raw[linear_velocity_window-1];// return the filtered velocity
-    angular_velocity = angular_velocity_raw[angular_velocity_window-1];// return the filtered velocity
+    linear_velocity = velocity_raw[velocity_head];// return the latest raw velocity
+    angular_velocity = angular_velocity_raw[angular_velocity_head];// return the latest raw velocity
 }
 void  OptiTrackFeedBackRigidBody::SetZeroVelocity()
 {
-    for(int i =0;i<linear_velocity_window;i++)
+    for(unsigned int i =0;i<linear_velocity_window;i++)
     {
-        velocity_raw[i](0)=0;
-        velocity_raw[i](1)=0;
-        velocity_raw[i](2)=0;
+        velocity_raw[i].setZero();
     }
-    for(int i =0;i<angular_velocity_window;i++)
+    for(unsigned int i =0;i<angular_velocity_window;i++)
     {
-        angular_velocity_raw[i](0)=0;
-        angular_velocity_raw[i](1)=0;
-        angular_velocity_raw[i](2)=0;
+        angular_velocity_raw[i].setZero();
     }
+    velocity_head = 0;
+    angular_velocity_head = 0;
+    velocity_sum.setZero();
+    angular_velocity_sum.setZero();
+    // the position history restarts as well, the Savitzky-Golay fit must not span a gap in the feedback
+    position_head = 0;
+    position_count = 0;
     velocity_filtered(0)=0;
     velocity_filtered(1)=0;
     velocity_filtered(2)=0;
@@ -258,9 +383,10 @@ void  OptiTrackFeedBackRigidBody::SetZeroVelocity()
 
 void OptiTrackFeedBackRigidBody::RosWhileLoopRun()
 {
-    if(OptiTrackFlag==1)
-    {// update the velocity only when there is OptiTrack feedback
-        CalculateVelocityFromPose();
+    // a loop run without a new pose is not a dropout as long as the latest pose is younger than dropout_time
+    // (the ros while loop may run faster than the mocap, or the pose may just miss this run)
+    if(OptiTrackFlag==1 || (FeedbackState==1 && ros::Time::now().toSec() - time_received <= dropout_time))
+    {// the velocity has been updated in the callback for every pose received since the last run
         FeedbackState=1;
     }else{
         // if the optitrack measurements no longer feedback, when the pose update will stop and we only return 0 velocity
@@ -346,7 +472,28 @@ void OptiTrackFeedBackRigidBody::GetEulerAngleFromQuaterion_OptiTrackYUpConventi
 void OptiTrackFeedBackRigidBody::OptiTrackCallback(const geometry_msgs::PoseStamped& msg)
 {
         // must use head information to distiguish the correct 
+        double t_received = ros::Time::now().toSec();
+        ros::Time stamp = msg.header.stamp.isZero() ? ros::Time(t_received) : msg.header.stamp;// no stamp: use the receive time
+        // same expression as PushPose, so that a repeated stamp compares equal
+        double t_stamp = (double)stamp.sec + (double)stamp.nsec*0.000000001;
+        if(pose[1].t>0 && t_stamp<=pose[1].t)
+        {// duplicate or out-of-order stamp: differentiating it would give an infinite or reversed velocity
+            discarded_poses++;
+            return;
+        }
+        if(pose[1].t>0 && t_stamp-pose[1].t>dropout_time)
+        {// restart after a gap, the velocity must not be differentiated across it
+            SetZeroVelocity();
+            pose[1].t = 0;
+        }
+        // transport latency, first order filter (time constant ~ 20 samples) to reject the jitter
+        double latency_sample = t_received - t_stamp;
+        latency = latency_samples==0 ? latency_sample : latency + 0.05*(latency_sample - latency);
+        latency_samples++;
+        time_received = t_received;
         OptiTrackdata = msg; // update optitrack data
+        OptiTrackdata.header.stamp = stamp;
+        CalculateVelocityFromPose();// differentiate at the mocap rate rather than the ros while loop rate
         OptiTrackFlag = 1;// signal a new measurement feed has been revcieved.
 }
 
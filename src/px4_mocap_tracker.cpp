@@ -0,0 +1,79 @@
+/***************************************************************************************************************************
+* px4_mocap_tracker.cpp
+*
+* Author: Qyp
+*
+* Update Time: 2019.8.26
+*
+* Introduction:  Mocap ingestion node for multiple rigid bodies
+*         1. 订阅Mocap/bodies中全部刚体的动捕位姿（vrpn_client_ros），时间戳校验、丢失检测及速度差分见mocap_tracker.h
+*         2. 以Mocap/rate发布/px4_command/rigid_bodies（RigidBodyArray，一条消息包含全部刚体）
+*         3. px4_pos_estimator(pos_estimator/mocap_source为1)及ground_station(mocap_source为1)从该话题按刚体名读取，
+*            同一刚体只在本节点订阅及差分一次
+***************************************************************************************************************************/
+
+//头文件
+#include <ros/ros.h>
+
+#include <iostream>
+#include <mocap_tracker.h>
+#include <px4_command/RigidBodyArray.h>
+
+using namespace std;
+
+//>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>主 函 数<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<
+int main(int argc, char **argv)
+{
+    ros::init(argc, argv, "px4_mocap_tracker");
+    ros::NodeHandle nh("~");
+
+    float tracker_rate;
+    int print_divider;
+
+    // 发布频率，应不低于使用者的频率
+    nh.param<float>("Mocap/rate", tracker_rate, 100.0);
+
+    // 每print_divider个周期打印一次
+    nh.param<int>("Mocap/print_divider", print_divider, 100);
+
+    mocap_tracker _mocap_tracker(nh);
+    _mocap_tracker.printf_param();
+
+    if(_mocap_tracker.size() == 0)
+    {
+        ROS_ERROR("Mocap/bodies is empty, no rigid body to track");
+        return -1;
+    }
+
+    // 【发布】全部刚体的状态
+    ros::Publisher rigid_bodies_pub = nh.advertise<px4_command::RigidBodyArray>("/px4_command/rigid_bodies", 10);
+
+    px4_command::RigidBodyArray _RigidBodyArray;
+
+    ros::Rate rate(tracker_rate);
+
+    unsigned long loop_count = 0;
+
+//>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>Main Loop<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<
+    while(ros::ok())
+    {
+        // 处理所有刚体在上一周期内到达的位姿
+        ros::spinOnce();
+
+        _mocap_tracker.update(ros::Time::now().toSec());
+
+        _mocap_tracker.fill_array(_RigidBodyArray);
+        _RigidBodyArray.header.stamp = ros::Time::now();
+        rigid_bodies_pub.publish(_RigidBodyArray);
+
+        if(print_divider > 0 && loop_count % print_divider == 0)
+        {
+            _mocap_tracker.printf_result();
+        }
+        loop_count++;
+
+        rate.sleep();
+    }
+
+    return 0;
+}
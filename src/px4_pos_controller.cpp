@@ -8,27 +8,49 @@
 * Introduction:  PX4 Position Controller 
 *         1. 从应用层节点订阅/px4_command/control_command话题（ControlCommand.msg），接收来自上层的控制指令。
 *         2. 从command_from_mavros.h读取无人机的状态信息（DroneState.msg）。
-*         3. 调用位置环控制算法，计算加速度控制量。可选择cascade_PID, PID, UDE, passivity-UDE, NE+UDE位置控制算法。
+*         3. 调用位置环控制算法，计算加速度控制量。可选择cascade_PID, PID, UDE, passivity-UDE, NE+UDE, MPC, SE3, INDI位置控制算法，或对cascade_PID进行继电自动整定。
 *         4. 通过command_to_mavros.h将计算出来的控制指令发送至飞控（通过mavros包）(mavros package will send the message to PX4 as Mavlink msg)
 *         5. PX4 firmware will recieve the Mavlink msg by mavlink_receiver.cpp in mavlink module.
 *         6. 发送相关信息至地面站节点(/px4_command/attitude_reference)，供监控使用。
+*         7. 可选事件驱动模式(Event_driven)：每收到一次DroneState立即执行控制，定周期循环仅作为看门狗。
+*         8. 可选机载姿态环(Body_rate)：控制循环以Control_loop/rate(200-400Hz)运行姿态环并发送机体角速度+油门，
+*            位置环每Body_rate/pos_divider个周期执行一次，姿态反馈直接订阅/mavros/imu/data。
+*         9. 回调在AsyncSpinner线程中处理（状态及IMU使用独立的回调队列），回调只写入state_snapshot，
+*            控制线程在每个周期开始时无锁读取最新快照，不会因回调处理而阻塞。
+*         10. Trajectory_Tracking模式可选解析轨迹(Trajectory_type: 圆形、螺旋、8字、Lissajous、折线)或订阅/px4_command/trajectory(Trajectory.msg)的流式轨迹，
+*            流式轨迹存入预分配的trajectory_buffer，每个周期按时间插值，可在飞行中继续追加；流式轨迹飞完后悬停于最后一个点，不自动退出，
+*            退出Trajectory_Tracking之前发送的轨迹在下一次进入时被丢弃（须在进入前、退出后发送新轨迹）。
+*            轨迹消息拷贝进trajectory_buffer后交还回调线程释放，控制线程不释放消息内存。
+*         11. 可选姿态前馈(Feedforward)：Move_ENU及Trajectory_Tracking模式下由实际发出的期望姿态的变化率(enable 1)或参考量的jerk、snap(enable 2)
+*            计算角速度前馈（见attitude_feedforward.h），机载姿态环模式下叠加至期望角速度并在位置环两次更新之间推算期望姿态，
+*            否则将期望姿态/油门超前lead_time发送。
+*         12. 可选有效质量及悬停油门在线估计(Thrust_estimator)：由测得的加速度及发出的油门递推最小二乘估计，发布至/px4_command/thrust_estimate，
+*            enable为2时将估计值用于位置控制器（accelToThrust的质量、cascade_PID的悬停油门）。
+*         13. 可选状态插值(State_history)：保存最近的DroneState（按header.stamp），每个控制周期以 now - lag 插值或外推得到状态，
+*            状态时刻与控制周期对齐，不再取决于回调到达的时刻，见state_history.h。
 ***************************************************************************************************************************/
 
 #include <ros/ros.h>
+#include <ros/callback_queue.h>
 #include <Eigen/Eigen>
 
 #include <state_from_mavros.h>
 #include <command_to_mavros.h>
 
-#include <pos_controller_PID.h>
-#include <pos_controller_UDE.h>
-#include <pos_controller_Passivity.h>
-#include <pos_controller_cascade_PID.h>
-#include <pos_controller_NE.h>
+#include <pos_controller_registry.h>
+#include <att_controller.h>
 
 #include <px4_command_utils.h>
 
-#include <circle_trajectory.h>
+#include <trajectory_registry.h>
+
+#include <state_history.h>
+#include <trajectory_buffer.h>
+#include <realtime_loop.h>
+#include <latency_tracer.h>
+#include <state_snapshot.h>
+#include <thrust_estimator.h>
+#include <attitude_feedforward.h>
 
 #include <px4_command/ControlCommand.h>
 #include <px4_command/DroneState.h>
@@ -36,10 +58,12 @@
 #include <px4_command/AttitudeReference.h>
 #include <px4_command/Trajectory.h>
 #include <px4_command/Topic_for_log.h>
-#include <px4_command/Trajectory.h>
 #include <LowPassFilter.h>
 
 #include <px4_command/ControlOutput.h>
+#include <px4_command/ControlLoopStatus.h>
+#include <px4_command/LatencyBreakdown.h>
+#include <px4_command/ThrustEstimate.h>
 
 using namespace std;
 //>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>变量声明<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<
@@ -57,7 +81,77 @@ float Takeoff_height;                                       //起飞高度
 float Disarm_height;                                        //自动上锁高度
 float Use_accel;                                            // 1 for use the accel command
 int Flag_printf;
-
+int switch_ude;                                             //选择控制律 0 for cascade_PID, 1 for PID, 2 for UDE, 3 for passivity, 4 for NE, 5 for MPC, 6 for SE3, 7 for INDI, 8 for autotune (cascade_PID)
+
+float Control_rate;                                         //控制主循环频率
+int Use_realtime;                                           //1 for SCHED_FIFO实时调度
+int Realtime_priority;
+int Realtime_cpu_id;                                        //-1 for 不绑定CPU
+
+int Event_driven;                                           //1 for 每收到一次DroneState立即执行一次控制
+float Event_timeout;                                        //事件驱动模式下的看门狗时间 [s]
+float dt_min, dt_max;                                       //控制周期dt的限幅
+std::atomic<bool> flag_control_start(false);                //主循环开始后，drone_state_cb才会唤醒控制线程
+
+int Use_feedforward;                                        //0 for 关闭, 1 for 由期望姿态变化率计算前馈, 2 for 由参考量jerk、snap计算前馈
+attitude_feedforward* _attitude_feedforward;                //姿态前馈，仅Feedforward/enable非0时创建
+float Feedforward_lead;                                     //非机载姿态环模式下期望姿态的超前时间 [s]
+
+int Body_rate_output;                                       //1 for 机载闭合姿态环，发送机体角速度+油门
+int Pos_divider;                                            //位置环分频：每Pos_divider个控制周期执行一次位置环
+unsigned int pos_tick = 0;
+float pos_dt = 0.0;                                         //距上一次位置环的时间 [s]
+bool flag_att_reference = false;                            //本次位置环是否给出了需要跟踪的期望姿态
+bool flag_imu_received = false;
+Eigen::Quaterniond q_imu;                                   //来自/mavros/imu/data的姿态（姿态环反馈）
+Eigen::Vector3d rates_sp;                                   //姿态环输出：期望机体角速度 [rad/s]
+
+int Thrust_estimation;                                      //0 for 关闭, 1 for 估计有效质量及悬停油门并发布, 2 for 同时用于位置控制器
+float throttle_sent = 0.0;                                  //上一次控制步发出的期望油门（Use_accel模式下未知，为0）
+px4_command::ThrustEstimate _ThrustEstimate;
+ros::Publisher thrust_estimate_pub;
+
+int Use_state_history;                                      //1 for 控制周期时刻的状态插值/外推
+state_history* _state_history;                              //状态历史，仅State_history/enable为1时创建
+std::atomic<bool> flag_state_history(false);                //状态历史创建后，drone_state_cb才写入drone_state_queue
+
+// 回调线程 -> 控制线程
+struct drone_state_sample
+{
+    px4_command::DroneState state;
+    ros::Time stamp_arrival;                                //回调线程收到该消息的时刻
+};
+state_snapshot<drone_state_sample> drone_state_snapshot;
+state_snapshot<Eigen::Quaterniond> imu_snapshot;
+state_snapshot<px4_command::ControlCommand> command_snapshot;
+message_queue<px4_command::Trajectory::ConstPtr, 32> trajectory_queue;   //轨迹分段须全部处理，不能只保留最新一条
+message_queue<px4_command::Trajectory::ConstPtr, 32> trajectory_return_queue;    //控制线程用完的轨迹分段交还回调线程释放，控制步中不释放消息内存
+message_queue<px4_command::DroneState, 32> drone_state_queue;           //状态插值需要每个状态，不能只保留最新一条
+control_trigger _control_trigger;                           //事件驱动模式下由状态(或IMU)回调唤醒控制线程
+
+realtime_loop _realtime_loop;                               //控制循环计时及时序统计
+px4_command::ControlLoopStatus _ControlLoopStatus;
+ros::Publisher log_pub;
+ros::Publisher loop_status_pub;
+ros::Publisher latency_pub;
+latency_tracer _latency_tracer;                             //定位数据到mavros期望值的延迟统计
+px4_command::LatencyBreakdown _LatencyBreakdown;
+ros::Time begin_time;
+
+command_to_mavros* _command_to_mavros;                      //用于与mavros通讯的类
+pos_controller_base* _pos_controller;                       //位置控制类，由switch_ude选择
+parametric_trajectory* _parametric_trajectory;              //解析轨迹类，由Trajectory_type选择
+trajectory_buffer* _trajectory_buffer;                      //流式轨迹缓存
+ros::Time trajectory_exit_stamp;                            //上一次退出Trajectory_Tracking的时刻，早于该时刻发送的流式轨迹不再使用
+int Trajectory_source;                                      //0 for 解析轨迹, 1 for /px4_command/trajectory
+int Trajectory_type;                                        //解析轨迹编号，见trajectory_registry.h
+att_controller* _att_controller;                            //机载姿态环，仅Body_rate模式下创建
+thrust_estimator* _thrust_estimator;                        //有效质量估计，仅Thrust_estimator/enable非0时创建
+float time_trajectory = 0.0;
+
+LowPassFilter LPF_x;                                        //输入干扰的低通滤波
+LowPassFilter LPF_y;
+LowPassFilter LPF_z;
 
 float disturbance_a_xy,disturbance_b_xy;
 float disturbance_a_z,disturbance_b_z;
@@ -81,29 +175,62 @@ Eigen::Vector3d Takeoff_position = Eigen::Vector3d(0.0,0.0,0.0);
 //>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>函数声明<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<
 int check_failsafe();
 void printf_param();
+void control_step(float dt);
+void attitude_step();
+void update_attitude_reference();
+void send_setpoint();
+void run_control_step();
+void read_snapshots();
 //>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>回调函数<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<
+// 以下回调均在AsyncSpinner线程中执行，只写入快照，不访问控制线程的变量
 void Command_cb(const px4_command::ControlCommand::ConstPtr& msg)
 {
-    Command_Now = *msg;
-    
-    // 无人机一旦接受到Land指令，则会屏蔽其他指令
-    if(Command_Last.Mode == command_to_mavros::Land)
+    command_snapshot.write(*msg);
+}
+
+void drone_state_cb(const px4_command::DroneState::ConstPtr& msg)
+{
+    drone_state_sample& sample = drone_state_snapshot.write_buffer();
+    sample.state = *msg;
+    sample.stamp_arrival = ros::Time::now();
+    drone_state_snapshot.publish();
+
+    if(flag_state_history)
     {
-        Command_Now.Mode = command_to_mavros::Land;
+        drone_state_queue.push(*msg);
     }
 
-    // Check for geo fence: If drone is out of the geo fence, it will land now.
-    if(check_failsafe() == 1)
+    // 事件驱动模式：状态到达后立即唤醒控制线程（机载姿态环模式下由IMU触发）
+    if(Event_driven == 1 && Body_rate_output == 0 && flag_control_start)
     {
-        Command_Now.Mode = command_to_mavros::Land;
+        _control_trigger.notify();
     }
 }
 
-void drone_state_cb(const px4_command::DroneState::ConstPtr& msg)
+void trajectory_cb(const px4_command::Trajectory::ConstPtr& msg)
+{
+    // 释放控制线程已处理的轨迹分段
+    px4_command::Trajectory::ConstPtr trajectory_used;
+    while(trajectory_return_queue.pop(trajectory_used))
+    {
+        trajectory_used.reset();
+    }
+
+    if(!trajectory_queue.push(msg))
+    {
+        cout << "Trajectory queue is full, segment dropped." <<endl;
+    }
+}
+
+void imu_cb(const sensor_msgs::Imu::ConstPtr& msg)
 {
-    _DroneState = *msg;
+    imu_snapshot.write(Eigen::Quaterniond(msg->orientation.w, msg->orientation.x, msg->orientation.y, msg->orientation.z));
 
-    _DroneState.time_from_start = cur_time;
+    // 机载姿态环以IMU为最内环反馈，事件驱动模式下每收到一次IMU执行一次控制
+    if(Event_driven == 1 && Body_rate_output == 1 && flag_control_start)
+    {
+        _control_trigger.notify();
+    }
 }
 
 //>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>主 函 数<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<
@@ -112,22 +239,78 @@ int main(int argc, char **argv)
     ros::init(argc, argv, "px4_pos_controller");
     ros::NodeHandle nh("~");
 
+    // 状态及IMU使用独立的回调队列及线程，不会排在指令或mavros反馈等回调之后
+    ros::CallbackQueue state_queue;
+    ros::NodeHandle state_nh("~");
+    state_nh.setCallbackQueue(&state_queue);
+
     //【订阅】指令
     // 本话题来自根据需求自定义的上层模块，比如track_land.cpp 比如move.cpp
     ros::Subscriber Command_sub = nh.subscribe<px4_command::ControlCommand>("/px4_command/control_command", 10, Command_cb);
 
+    //【订阅】期望轨迹，用于Trajectory_Tracking模式(Trajectory_source为1时)
+    // 本话题来自上层规划模块，可分段发送，time_from_start为进入Trajectory_Tracking模式后的时间
+    ros::Subscriber trajectory_sub = nh.subscribe<px4_command::Trajectory>("/px4_command/trajectory", 10, trajectory_cb);
+
     //【订阅】无人机当前状态
     // 本话题来自根据需求自定px4_pos_estimator.cpp
-    ros::Subscriber drone_state_sub = nh.subscribe<px4_command::DroneState>("/px4_command/drone_state", 10, drone_state_cb);
+    ros::Subscriber drone_state_sub = state_nh.subscribe<px4_command::DroneState>("/px4_command/drone_state", 10, drone_state_cb);
 
     // 发布log消息至ground_station.cpp
-    ros::Publisher log_pub = nh.advertise<px4_command::Topic_for_log>("/px4_command/topic_for_log", 10);
+    log_pub = nh.advertise<px4_command::Topic_for_log>("/px4_command/topic_for_log", 10);
+
+    // 发布控制主循环时序统计（周期、计算耗时、抖动、超时次数）
+    loop_status_pub = nh.advertise<px4_command::ControlLoopStatus>("/px4_command/control_loop_status", 10);
+
+    // 发布定位数据到mavros期望值的各环节延迟及滚动直方图
+    latency_pub = nh.advertise<px4_command::LatencyBreakdown>("/px4_command/latency_breakdown", 10);
+
+    // 发布有效质量及悬停油门的在线估计
+    thrust_estimate_pub = nh.advertise<px4_command::ThrustEstimate>("/px4_command/thrust_estimate", 10);
 
     // 参数读取
     nh.param<float>("Takeoff_height", Takeoff_height, 1.0);
     nh.param<float>("Disarm_height", Disarm_height, 0.15);
     nh.param<float>("Use_accel", Use_accel, 0.0);
     nh.param<int>("Flag_printf", Flag_printf, 0.0);
+    nh.param<int>("switch_ude", switch_ude, 0);
+
+    nh.param<float>("Control_loop/rate", Control_rate, 50.0);
+    nh.param<int>("Control_loop/realtime", Use_realtime, 0);
+    nh.param<int>("Control_loop/priority", Realtime_priority, 80);
+    nh.param<int>("Control_loop/cpu_id", Realtime_cpu_id, -1);
+
+    float latency_bin_width;
+    int latency_bin_num, latency_window;
+    nh.param<float>("Latency/bin_width", latency_bin_width, 1.0);
+    nh.param<int>("Latency/bin_num", latency_bin_num, 50);
+    nh.param<int>("Latency/window", latency_window, 1000);
+    _latency_tracer.init(latency_bin_width, latency_bin_num, latency_window);
+
+    nh.param<int>("Event_driven/enable", Event_driven, 0);
+    nh.param<float>("Event_driven/timeout", Event_timeout, 0.05);
+
+    nh.param<int>("Trajectory_source", Trajectory_source, 0);
+    nh.param<int>("Trajectory_type", Trajectory_type, 0);
+
+    nh.param<int>("Feedforward/enable", Use_feedforward, 0);
+    nh.param<float>("Feedforward/lead_time", Feedforward_lead, 0.02);
+
+    nh.param<int>("Body_rate/enable", Body_rate_output, 0);
+    nh.param<int>("Body_rate/pos_divider", Pos_divider, 5);
+    if(Pos_divider < 1) Pos_divider = 1;
+
+    nh.param<int>("Thrust_estimator/enable", Thrust_estimation, 0);
+
+    nh.param<int>("State_history/enable", Use_state_history, 0);
+
+    //【订阅】飞控姿态及角速度，仅用于机载姿态环
+    // 本话题来自飞控(通过Mavros功能包 /plugins/imu.cpp读取)
+    ros::Subscriber imu_sub;
+    if(Body_rate_output == 1)
+    {
+        imu_sub = state_nh.subscribe<sensor_msgs::Imu>("/mavros/imu/data", 10, imu_cb);
+    }
 
     nh.param<float>("disturbance_a_xy", disturbance_a_xy, 0.5);
     nh.param<float>("disturbance_b_xy", disturbance_b_xy, 0.0);
@@ -150,53 +333,82 @@ int main(int argc, char **argv)
     nh.param<float>("geo_fence/z_min", geo_fence_z[0], -100.0);
     nh.param<float>("geo_fence/z_max", geo_fence_z[1], 100.0);
 
-    // 位置控制一般选取为50Hz，主要取决于位置状态的更新频率
-    ros::Rate rate(50.0);
-
-    LowPassFilter LPF_x;
-    LowPassFilter LPF_y;
-    LowPassFilter LPF_z;
+    // 定周期模式下dt限幅为标称周期的0.5-1.5倍；事件驱动模式下dt由状态到达间隔决定，上限为看门狗时间
+    if(Event_driven == 1)
+    {
+        dt_min = 0.001;
+        dt_max = Event_timeout;
+    }else
+    {
+        dt_min = 0.5 / Control_rate;
+        dt_max = 1.5 / Control_rate;
+    }
 
     LPF_x.set_Time_constant(disturbance_T);
     LPF_y.set_Time_constant(disturbance_T);
     LPF_z.set_Time_constant(disturbance_T);
 
     // 用于与mavros通讯的类，通过mavros发送控制指令至飞控【本程序->mavros->飞控】
-    command_to_mavros _command_to_mavros;
+    _command_to_mavros = new command_to_mavros;
     
-    // 位置控制类 - 根据switch_ude选择其中一个使用，默认为PID
-    pos_controller_cascade_PID pos_controller_cascade_pid;
-    pos_controller_PID pos_controller_pid;
-    pos_controller_UDE pos_controller_ude;
-    pos_controller_passivity pos_controller_ps;
-    pos_controller_NE pos_controller_ne;
+    // 位置控制类 - 根据switch_ude只创建其中一个，默认为cascade_PID
+    _pos_controller = pos_controller_registry::create(switch_ude);
+
+    if(_pos_controller == NULL)
+    {
+        cout << "Wrong controller type: " << switch_ude << ", 0 for cascade_PID, 1 for PID, 2 for UDE, 3 for passivity, 4 for NE, 5 for MPC, 6 for SE3, 7 for INDI, 8 for autotune (cascade_PID)"<<endl;
+        return -1;
+    }
 
-    // 选择控制律
-    int switch_ude;
- //   cout << "Please choose the controller: 0 for cascade_PID, 1 for PID, 2 for UDE, 3 for passivity, 4 for NE: "<<endl;
-//    cin >> switch_ude;
-	switch_ude = 0;
-    if(switch_ude == 0)
+    cout << "Position controller : " << pos_controller_registry::name(switch_ude) <<endl;
+    _pos_controller->printf_param();
+
+    // 机载姿态环 - 仅Body_rate模式下创建
+    _att_controller = NULL;
+    if(Body_rate_output == 1)
     {
-        pos_controller_cascade_pid.printf_param();
-    }else if(switch_ude == 1)
+        _att_controller = new att_controller;
+        _att_controller->printf_param();
+    }
+
+    // 有效质量估计 - 仅Thrust_estimator/enable非0时创建
+    _thrust_estimator = NULL;
+    if(Thrust_estimation != 0)
     {
-        pos_controller_pid.printf_param();
-    }else if(switch_ude == 2)
+        _thrust_estimator = new thrust_estimator;
+        _thrust_estimator->printf_param();
+    }
+
+    // 姿态前馈 - 仅Feedforward/enable非0时创建
+    _attitude_feedforward = NULL;
+    if(Use_feedforward != 0)
     {
-        pos_controller_ude.printf_param();
-    }else if(switch_ude == 3)
+        _attitude_feedforward = new attitude_feedforward;
+        _attitude_feedforward->printf_param();
+    }
+
+    // 状态历史 - 仅State_history/enable为1时创建
+    _state_history = NULL;
+    if(Use_state_history == 1)
     {
-        pos_controller_ps.printf_param();
-    }else if(switch_ude == 4)
+        _state_history = new state_history;
+        _state_history->printf_param();
+        flag_state_history = true;
+    }
+
+    // 解析轨迹类，只创建被选中的轨迹
+    _parametric_trajectory = trajectory_registry::create(Trajectory_type);
+
+    if(_parametric_trajectory == NULL)
     {
-        pos_controller_ne.printf_param();
+        cout << "Wrong trajectory type: " << Trajectory_type << ", 0 for circle, 1 for helix, 2 for lemniscate, 3 for lissajous, 4 for polyline"<<endl;
+        return -1;
     }
+ //   _parametric_trajectory->printf_param();
 
-    // 圆形轨迹追踪类
-    Circle_Trajectory _Circle_Trajectory;
-    float time_trajectory = 0.0;
- //   _Circle_Trajectory.printf_param();
+    // 流式轨迹缓存，构造时预分配
+    _trajectory_buffer = new trajectory_buffer;
+    _trajectory_buffer->printf_param();
 
     printf_param();
 
@@ -211,12 +423,15 @@ int main(int argc, char **argv)
         return -1;
     }
 
-    // 先读取一些飞控的数据
-    for(int i=0;i<50;i++)
-    {
-        ros::spinOnce();
-        rate.sleep();
-    }
+    // 回调线程：state_spinner处理状态及IMU，spinner处理全局队列（指令、command_to_mavros中的mavros反馈）
+    ros::AsyncSpinner state_spinner(1, &state_queue);
+    ros::AsyncSpinner spinner(1);
+    state_spinner.start();
+    spinner.start();
+
+    // 先读取一些飞控的数据（等待50个控制周期）
+    ros::Duration(50.0 / Control_rate).sleep();
+    read_snapshots();
 
     // Set the takeoff position
     Takeoff_position[0] = _DroneState.position[0];
@@ -224,9 +439,12 @@ int main(int argc, char **argv)
     Takeoff_position[2] = _DroneState.position[2];
 
     // NE控制律需要设置起飞初始值
-    if(switch_ude == 4)
+    _pos_controller->set_initial_pos(Takeoff_position);
+
+    // 有效质量估计只在离地后更新
+    if(_thrust_estimator != NULL)
     {
-        pos_controller_ne.set_initial_pos(Takeoff_position);
+        _thrust_estimator->set_ground_height(Takeoff_position[2]);
     }
 
     // 初始化命令-
@@ -245,574 +463,705 @@ int main(int argc, char **argv)
     Command_Now.Reference_State.acceleration_ref[2] = 0;
     Command_Now.Reference_State.yaw_ref = 0;
 
+    // 实时调度只作用于本线程（控制线程），ros内部的网络线程已在此之前创建，不受影响
+    _realtime_loop.init(Control_rate, Use_realtime, Realtime_priority, Realtime_cpu_id);
+    _realtime_loop.printf_param();
+
     // 记录启控时间
-    ros::Time begin_time = ros::Time::now();
-    float last_time = px4_command_utils::get_time_in_sec(begin_time);
-    float dt = 0;
+    begin_time = ros::Time::now();
+    _realtime_loop.start();
+    flag_control_start = true;
 //>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>主  循  环<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<
     while(ros::ok())
     {
-        // 当前时间
-        cur_time = px4_command_utils::get_time_in_sec(begin_time);
-        dt = cur_time  - last_time;
-        dt = constrain_function2(dt, 0.01, 0.03);
-        last_time = cur_time;
-
-        //执行回调函数
-        ros::spinOnce();
-
-        switch (Command_Now.Mode)
+        if(Event_driven == 1)
         {
-        // 【Idle】 怠速旋转，此时可以切入offboard模式，但不会起飞。
-        case command_to_mavros::Idle:
-            _command_to_mavros.idle();
-            break;
-
-        // 【Takeoff】 从摆放初始位置原地起飞至指定高度，偏航角也保持当前角度
-        case command_to_mavros::Takeoff:
-            Command_to_gs.Mode = Command_Now.Mode;
-            Command_to_gs.Command_ID = Command_Now.Command_ID;
-            Command_to_gs.Reference_State.Sub_mode  = command_to_mavros::XYZ_POS;
-            Command_to_gs.Reference_State.position_ref[0] = Takeoff_position[0];
-            Command_to_gs.Reference_State.position_ref[1] = Takeoff_position[1];
-            Command_to_gs.Reference_State.position_ref[2] = Takeoff_position[2] + Takeoff_height;
-            Command_to_gs.Reference_State.velocity_ref[0] = 0;
-            Command_to_gs.Reference_State.velocity_ref[1] = 0;
-            Command_to_gs.Reference_State.velocity_ref[2] = 0;
-            Command_to_gs.Reference_State.acceleration_ref[0] = 0;
-            Command_to_gs.Reference_State.acceleration_ref[1] = 0;
-            Command_to_gs.Reference_State.acceleration_ref[2] = 0;
-            Command_to_gs.Reference_State.yaw_ref = _DroneState.attitude[2]; //rad
-
-            if(switch_ude == 0)
-            {
-                _ControlOutput = pos_controller_cascade_pid.pos_controller(_DroneState, Command_to_gs.Reference_State, dt);
-            }else if(switch_ude == 1)
-            {
-                _ControlOutput = pos_controller_pid.pos_controller(_DroneState, Command_to_gs.Reference_State, dt);
-            }else if(switch_ude == 2)
+            // 事件驱动：等待drone_state_cb(或imu_cb)唤醒后立即执行控制
+            // 看门狗：超过Event_timeout未收到DroneState，则用上一次的状态执行控制，保证offboard指令不中断
+            if(!_control_trigger.wait(Event_timeout))
             {
-                _ControlOutput = pos_controller_ude.pos_controller(_DroneState, Command_to_gs.Reference_State, dt);
-            }else if(switch_ude == 3)
-            {
-                _ControlOutput = pos_controller_ps.pos_controller(_DroneState, Command_to_gs.Reference_State, dt);
-            }else if(switch_ude == 4)
-            {
-                _ControlOutput = pos_controller_ne.pos_controller(_DroneState, Command_to_gs.Reference_State, dt);
+                _realtime_loop.deadline_miss++;
             }
-            
-            throttle_sp[0] = _ControlOutput.Throttle[0];
-            throttle_sp[1] = _ControlOutput.Throttle[1];
-            throttle_sp[2] = _ControlOutput.Throttle[2];
-
-            _AttitudeReference = px4_command_utils::ThrottleToAttitude(throttle_sp, Command_to_gs.Reference_State.yaw_ref);
 
-            if(Use_accel > 0.5)
-            {
-                _command_to_mavros.send_accel_setpoint(throttle_sp,Command_to_gs.Reference_State.yaw_ref);
-            }else
-            {
-                _command_to_mavros.send_attitude_setpoint(_AttitudeReference);            
-            }
-            
-            break;
-
-        // 【Move_ENU】 ENU系移动。只有PID算法中才有追踪速度的选项，其他控制只能追踪位置
-        case command_to_mavros::Move_ENU:
-            Command_to_gs = Command_Now;
+            run_control_step();
+        }else
+        {
+            run_control_step();
 
-            if(switch_ude == 0)
-            {
-                _ControlOutput = pos_controller_cascade_pid.pos_controller(_DroneState, Command_to_gs.Reference_State, dt);
-            }else if(switch_ude == 1)
-            {
-                _ControlOutput = pos_controller_pid.pos_controller(_DroneState, Command_to_gs.Reference_State, dt);
-            }else if(switch_ude == 2)
-            {
-                _ControlOutput = pos_controller_ude.pos_controller(_DroneState, Command_to_gs.Reference_State, dt);
-            }else if(switch_ude == 3)
-            {
-                _ControlOutput = pos_controller_ps.pos_controller(_DroneState, Command_to_gs.Reference_State, dt);
-            }else if(switch_ude == 4)
-            {
-                _ControlOutput = pos_controller_ne.pos_controller(_DroneState, Command_to_gs.Reference_State, dt);
-            }
-            
-            throttle_sp[0] = _ControlOutput.Throttle[0];
-            throttle_sp[1] = _ControlOutput.Throttle[1];
-            throttle_sp[2] = _ControlOutput.Throttle[2];
+            _realtime_loop.sleep();
+        }
+    }
 
-            _AttitudeReference = px4_command_utils::ThrottleToAttitude(throttle_sp, Command_to_gs.Reference_State.yaw_ref);
+    _pos_controller->non_realtime_update();
 
-            if(Use_accel > 0.5)
-            {
-                _command_to_mavros.send_accel_setpoint(throttle_sp,Command_to_gs.Reference_State.yaw_ref);
-            }else
-            {
-                _command_to_mavros.send_attitude_setpoint(_AttitudeReference);            
-            }
-            break;
+    delete _pos_controller;
+    delete _att_controller;
+    delete _thrust_estimator;
+    delete _attitude_feedforward;
+    delete _command_to_mavros;
+    delete _parametric_trajectory;
+    delete _trajectory_buffer;
 
-        // 【Move_Body】 机体系移动。
-        case command_to_mavros::Move_Body:
-            Command_to_gs.Mode = Command_Now.Mode;
-            Command_to_gs.Command_ID = Command_Now.Command_ID;
-            //只有在comid增加时才会进入解算 ： 机体系 至 惯性系
-            if( Command_Now.Command_ID  >  Command_Last.Command_ID )
-            {
-                //xy velocity mode
-                if( Command_Now.Reference_State.Sub_mode  & 0b10 )
-                {
-                    float d_vel_body[2] = {Command_Now.Reference_State.velocity_ref[0], Command_Now.Reference_State.velocity_ref[1]};         //the desired xy velocity in Body Frame
-                    float d_vel_enu[2];                                                           //the desired xy velocity in NED Frame
-
-                    //根据无人机当前偏航角进行坐标系转换
-                    px4_command_utils::rotation_yaw(_DroneState.attitude[2], d_vel_body, d_vel_enu);
-                    Command_to_gs.Reference_State.position_ref[0] = 0;
-                    Command_to_gs.Reference_State.position_ref[1] = 0;
-                    Command_to_gs.Reference_State.velocity_ref[0] = d_vel_enu[0];
-                    Command_to_gs.Reference_State.velocity_ref[1] = d_vel_enu[1];
-                }
-                //xy position mode
-                else
-                {
-                    float d_pos_body[2] = {Command_Now.Reference_State.position_ref[0], Command_Now.Reference_State.position_ref[1]};         //the desired xy position in Body Frame
-                    float d_pos_enu[2];                                                           //the desired xy position in enu Frame (The origin point is the drone)
-                    px4_command_utils::rotation_yaw(_DroneState.attitude[2], d_pos_body, d_pos_enu);
-
-                    Command_to_gs.Reference_State.position_ref[0] = _DroneState.position[0] + d_pos_enu[0];
-                    Command_to_gs.Reference_State.position_ref[1] = _DroneState.position[1] + d_pos_enu[1];
-                    Command_to_gs.Reference_State.velocity_ref[0] = 0;
-                    Command_to_gs.Reference_State.velocity_ref[1] = 0;
-                }
+    return 0;
 
-                //z velocity mode
-                if( Command_Now.Reference_State.Sub_mode  & 0b01 )
-                {
-                    Command_to_gs.Reference_State.position_ref[2] = 0;
-                    Command_to_gs.Reference_State.velocity_ref[2] = Command_Now.Reference_State.velocity_ref[2];
-                }
-                //z posiiton mode
-                {
-                    Command_to_gs.Reference_State.position_ref[2] = _DroneState.position[2] + Command_Now.Reference_State.position_ref[2];
-                    Command_to_gs.Reference_State.velocity_ref[2] = 0; 
-                }
+}
 
-                Command_to_gs.Reference_State.yaw_ref = _DroneState.attitude[2] + Command_Now.Reference_State.yaw_ref;
+// 执行一次控制：模式切换、位置控制、发送至mavros、日志
+void control_step(float dt)
+{
+    // 当前时间
+    cur_time = px4_command_utils::get_time_in_sec(begin_time);
 
-                float d_acc_body[2] = {Command_Now.Reference_State.acceleration_ref[0], Command_Now.Reference_State.acceleration_ref[1]};       
-                float d_acc_enu[2]; 
+    _latency_tracer.step_begin();
 
-                px4_command_utils::rotation_yaw(_DroneState.attitude[2], d_acc_body, d_acc_enu);
-                Command_to_gs.Reference_State.acceleration_ref[0] = d_acc_enu[0];
-                Command_to_gs.Reference_State.acceleration_ref[1] = d_acc_enu[1];
-                Command_to_gs.Reference_State.acceleration_ref[2] = Command_Now.Reference_State.acceleration_ref[2];
+    // 由send_setpoint()置位，Idle、上锁等不需要姿态环的情况保持false
+    flag_att_reference = false;
 
-            }
+    // 有效质量估计：当前测得的加速度对应上一次发出的油门
+    if(_thrust_estimator != NULL)
+    {
+        _thrust_estimator->update(_DroneState, throttle_sent, dt);
 
-            if(switch_ude == 0)
-            {
-                _ControlOutput = pos_controller_cascade_pid.pos_controller(_DroneState, Command_to_gs.Reference_State, dt);
-            }else if(switch_ude == 1)
-            {
-                _ControlOutput = pos_controller_pid.pos_controller(_DroneState, Command_to_gs.Reference_State, dt);
-            }else if(switch_ude == 2)
-            {
-                _ControlOutput = pos_controller_ude.pos_controller(_DroneState, Command_to_gs.Reference_State, dt);
-            }else if(switch_ude == 3)
-            {
-                _ControlOutput = pos_controller_ps.pos_controller(_DroneState, Command_to_gs.Reference_State, dt);
-            }else if(switch_ude == 4)
-            {
-                _ControlOutput = pos_controller_ne.pos_controller(_DroneState, Command_to_gs.Reference_State, dt);
-            }
-            
-            throttle_sp[0] = _ControlOutput.Throttle[0];
-            throttle_sp[1] = _ControlOutput.Throttle[1];
-            throttle_sp[2] = _ControlOutput.Throttle[2];
+        if(Thrust_estimation == 2 && _thrust_estimator->valid)
+        {
+            _pos_controller->set_thrust_model(_thrust_estimator->mass, _thrust_estimator->hover_throttle);
+        }
+    }
+    // 由send_setpoint()记录本次发出的油门
+    throttle_sent = 0.0;
 
-            _AttitudeReference = px4_command_utils::ThrottleToAttitude(throttle_sp, Command_to_gs.Reference_State.yaw_ref);
+    switch (Command_Now.Mode)
+    {
+    // 【Idle】 怠速旋转，此时可以切入offboard模式，但不会起飞。
+    case command_to_mavros::Idle:
+        _command_to_mavros->idle();
+        break;
+
+    // 【Takeoff】 从摆放初始位置原地起飞至指定高度，偏航角也保持当前角度
+    case command_to_mavros::Takeoff:
+        Command_to_gs.Mode = Command_Now.Mode;
+        Command_to_gs.Command_ID = Command_Now.Command_ID;
+        Command_to_gs.Reference_State.Sub_mode  = command_to_mavros::XYZ_POS;
+        Command_to_gs.Reference_State.position_ref[0] = Takeoff_position[0];
+        Command_to_gs.Reference_State.position_ref[1] = Takeoff_position[1];
+        Command_to_gs.Reference_State.position_ref[2] = Takeoff_position[2] + Takeoff_height;
+        Command_to_gs.Reference_State.velocity_ref[0] = 0;
+        Command_to_gs.Reference_State.velocity_ref[1] = 0;
+        Command_to_gs.Reference_State.velocity_ref[2] = 0;
+        Command_to_gs.Reference_State.acceleration_ref[0] = 0;
+        Command_to_gs.Reference_State.acceleration_ref[1] = 0;
+        Command_to_gs.Reference_State.acceleration_ref[2] = 0;
+        Command_to_gs.Reference_State.yaw_ref = _DroneState.attitude[2]; //rad
+
+        _pos_controller->pos_controller(_DroneState, Command_to_gs.Reference_State, dt, _ControlOutput);
+        
+        throttle_sp[0] = _ControlOutput.Throttle[0];
+        throttle_sp[1] = _ControlOutput.Throttle[1];
+        throttle_sp[2] = _ControlOutput.Throttle[2];
 
+        update_attitude_reference();
 
-            if(Use_accel > 0.5)
-            {
-                _command_to_mavros.send_accel_setpoint(throttle_sp,Command_to_gs.Reference_State.yaw_ref);
-            }else
-            {
-                _command_to_mavros.send_attitude_setpoint(_AttitudeReference);            
-            }
+        send_setpoint();
+        
+        break;
 
-            break;
+    // 【Move_ENU】 ENU系移动。只有PID算法中才有追踪速度的选项，其他控制只能追踪位置
+    case command_to_mavros::Move_ENU:
+        Command_to_gs.Mode = Command_Now.Mode;
 
-        // 【Hold】 悬停。当前位置悬停
-        case command_to_mavros::Hold:
-            Command_to_gs.Mode = Command_Now.Mode;
+        // 只在收到新指令或刚切入本模式时拷贝参考量，避免每个控制周期整条消息拷贝
+        if(Command_Now.Command_ID != Command_to_gs.Command_ID || Command_Last.Mode != command_to_mavros::Move_ENU)
+        {
             Command_to_gs.Command_ID = Command_Now.Command_ID;
-            if (Command_Last.Mode != command_to_mavros::Hold)
-            {
-                Command_to_gs.Reference_State.Sub_mode  = command_to_mavros::XYZ_POS;
-                Command_to_gs.Reference_State.position_ref[0] = _DroneState.position[0];
-                Command_to_gs.Reference_State.position_ref[1] = _DroneState.position[1];
-                Command_to_gs.Reference_State.position_ref[2] = _DroneState.position[2];
-                Command_to_gs.Reference_State.velocity_ref[0] = 0;
-                Command_to_gs.Reference_State.velocity_ref[1] = 0;
-                Command_to_gs.Reference_State.velocity_ref[2] = 0;
-                Command_to_gs.Reference_State.acceleration_ref[0] = 0;
-                Command_to_gs.Reference_State.acceleration_ref[1] = 0;
-                Command_to_gs.Reference_State.acceleration_ref[2] = 0;
-                Command_to_gs.Reference_State.yaw_ref = _DroneState.attitude[2]; //rad
-            }
+            Command_to_gs.Reference_State = Command_Now.Reference_State;
+        }
 
-            if(switch_ude == 0)
-            {
-                _ControlOutput = pos_controller_cascade_pid.pos_controller(_DroneState, Command_to_gs.Reference_State, dt);
-            }else if(switch_ude == 1)
-            {
-                _ControlOutput = pos_controller_pid.pos_controller(_DroneState, Command_to_gs.Reference_State, dt);
-            }else if(switch_ude == 2)
-            {
-                _ControlOutput = pos_controller_ude.pos_controller(_DroneState, Command_to_gs.Reference_State, dt);
-            }else if(switch_ude == 3)
-            {
-                _ControlOutput = pos_controller_ps.pos_controller(_DroneState, Command_to_gs.Reference_State, dt);
-            }else if(switch_ude == 4)
-            {
-                _ControlOutput = pos_controller_ne.pos_controller(_DroneState, Command_to_gs.Reference_State, dt);
-            }
-            
-            throttle_sp[0] = _ControlOutput.Throttle[0];
-            throttle_sp[1] = _ControlOutput.Throttle[1];
-            throttle_sp[2] = _ControlOutput.Throttle[2];
+        _pos_controller->pos_controller(_DroneState, Command_to_gs.Reference_State, dt, _ControlOutput);
+        
+        throttle_sp[0] = _ControlOutput.Throttle[0];
+        throttle_sp[1] = _ControlOutput.Throttle[1];
+        throttle_sp[2] = _ControlOutput.Throttle[2];
 
-            _AttitudeReference = px4_command_utils::ThrottleToAttitude(throttle_sp, Command_to_gs.Reference_State.yaw_ref);
+        update_attitude_reference();
 
-            if(Use_accel > 0.5)
-            {
-                _command_to_mavros.send_accel_setpoint(throttle_sp,Command_to_gs.Reference_State.yaw_ref);
-            }else
+        send_setpoint();
+        break;
+
+    // 【Move_Body】 机体系移动。
+    case command_to_mavros::Move_Body:
+        Command_to_gs.Mode = Command_Now.Mode;
+        Command_to_gs.Command_ID = Command_Now.Command_ID;
+        //只有在comid增加时才会进入解算 ： 机体系 至 惯性系
+        if( Command_Now.Command_ID  >  Command_Last.Command_ID )
+        {
+            //xy velocity mode
+            if( Command_Now.Reference_State.Sub_mode  & 0b10 )
             {
-                _command_to_mavros.send_attitude_setpoint(_AttitudeReference);            
+                float d_vel_body[2] = {Command_Now.Reference_State.velocity_ref[0], Command_Now.Reference_State.velocity_ref[1]};         //the desired xy velocity in Body Frame
+                float d_vel_enu[2];                                                           //the desired xy velocity in NED Frame
+
+                //根据无人机当前偏航角进行坐标系转换
+                px4_command_utils::rotation_yaw(_DroneState.attitude[2], d_vel_body, d_vel_enu);
+                Command_to_gs.Reference_State.position_ref[0] = 0;
+                Command_to_gs.Reference_State.position_ref[1] = 0;
+                Command_to_gs.Reference_State.velocity_ref[0] = d_vel_enu[0];
+                Command_to_gs.Reference_State.velocity_ref[1] = d_vel_enu[1];
             }
-            break;
-
-        // 【Land】 降落。当前位置原地降落，降落后会自动上锁，且切换为mannual模式
-        case command_to_mavros::Land:
-            Command_to_gs.Mode = Command_Now.Mode;
-            Command_to_gs.Command_ID = Command_Now.Command_ID;
-            if (Command_Last.Mode != command_to_mavros::Land)
+            //xy position mode
+            else
             {
-                Command_to_gs.Reference_State.Sub_mode  = command_to_mavros::XYZ_POS;
-                Command_to_gs.Reference_State.position_ref[0] = _DroneState.position[0];
-                Command_to_gs.Reference_State.position_ref[1] = _DroneState.position[1];
-                Command_to_gs.Reference_State.position_ref[2] = Takeoff_position[2];
+                float d_pos_body[2] = {Command_Now.Reference_State.position_ref[0], Command_Now.Reference_State.position_ref[1]};         //the desired xy position in Body Frame
+                float d_pos_enu[2];                                                           //the desired xy position in enu Frame (The origin point is the drone)
+                px4_command_utils::rotation_yaw(_DroneState.attitude[2], d_pos_body, d_pos_enu);
+
+                Command_to_gs.Reference_State.position_ref[0] = _DroneState.position[0] + d_pos_enu[0];
+                Command_to_gs.Reference_State.position_ref[1] = _DroneState.position[1] + d_pos_enu[1];
                 Command_to_gs.Reference_State.velocity_ref[0] = 0;
                 Command_to_gs.Reference_State.velocity_ref[1] = 0;
-                Command_to_gs.Reference_State.velocity_ref[2] = 0;
-                Command_to_gs.Reference_State.acceleration_ref[0] = 0;
-                Command_to_gs.Reference_State.acceleration_ref[1] = 0;
-                Command_to_gs.Reference_State.acceleration_ref[2] = 0;
-                Command_to_gs.Reference_State.yaw_ref = _DroneState.attitude[2]; //rad
             }
 
-            //如果距离起飞高度小于10厘米，则直接上锁并切换为手动模式；
-            if(abs(_DroneState.position[2] - Takeoff_position[2]) < Disarm_height)
+            //z velocity mode
+            if( Command_Now.Reference_State.Sub_mode  & 0b01 )
             {
-                if(_DroneState.mode == "OFFBOARD")
-                {
-                    _command_to_mavros.mode_cmd.request.custom_mode = "MANUAL";
-                    _command_to_mavros.set_mode_client.call(_command_to_mavros.mode_cmd);
-                }
-
-                if(_DroneState.armed)
-                {
-                    _command_to_mavros.arm_cmd.request.value = false;
-                    _command_to_mavros.arming_client.call(_command_to_mavros.arm_cmd);
-
-                }
-
-                if (_command_to_mavros.arm_cmd.response.success)
-                {
-                    cout<<"Disarm successfully!"<<endl;
-                }
-            }else
+                Command_to_gs.Reference_State.position_ref[2] = 0;
+                Command_to_gs.Reference_State.velocity_ref[2] = Command_Now.Reference_State.velocity_ref[2];
+            }
+            //z posiiton mode
             {
-                if(switch_ude == 0)
-                {
-                    _ControlOutput = pos_controller_cascade_pid.pos_controller(_DroneState, Command_to_gs.Reference_State, dt);
-                }else if(switch_ude == 1)
-                {
-                    _ControlOutput = pos_controller_pid.pos_controller(_DroneState, Command_to_gs.Reference_State, dt);
-                }else if(switch_ude == 2)
-                {
-                    _ControlOutput = pos_controller_ude.pos_controller(_DroneState, Command_to_gs.Reference_State, dt);
-                }else if(switch_ude == 3)
-                {
-                    _ControlOutput = pos_controller_ps.pos_controller(_DroneState, Command_to_gs.Reference_State, dt);
-                }else if(switch_ude == 4)
-                {
-                    _ControlOutput = pos_controller_ne.pos_controller(_DroneState, Command_to_gs.Reference_State, dt);
-                }
-                
-                throttle_sp[0] = _ControlOutput.Throttle[0];
-                throttle_sp[1] = _ControlOutput.Throttle[1];
-                throttle_sp[2] = _ControlOutput.Throttle[2];
-
-                _AttitudeReference = px4_command_utils::ThrottleToAttitude(throttle_sp, Command_to_gs.Reference_State.yaw_ref);
-
-                if(Use_accel > 0.5)
-                {
-                    _command_to_mavros.send_accel_setpoint(throttle_sp,Command_to_gs.Reference_State.yaw_ref);
-                }else
-                {
-                    _command_to_mavros.send_attitude_setpoint(_AttitudeReference);            
-                }
-             }
+                Command_to_gs.Reference_State.position_ref[2] = _DroneState.position[2] + Command_Now.Reference_State.position_ref[2];
+                Command_to_gs.Reference_State.velocity_ref[2] = 0; 
+            }
 
+            Command_to_gs.Reference_State.yaw_ref = _DroneState.attitude[2] + Command_Now.Reference_State.yaw_ref;
 
-            break;
+            float d_acc_body[2] = {Command_Now.Reference_State.acceleration_ref[0], Command_Now.Reference_State.acceleration_ref[1]};       
+            float d_acc_enu[2]; 
 
-        // 【Disarm】 紧急上锁。直接上锁，不建议使用，危险。
-        case command_to_mavros::Disarm:
-            Command_to_gs.Mode = Command_Now.Mode;
-            Command_to_gs.Command_ID = Command_Now.Command_ID;
-            
-            if(_DroneState.mode == "OFFBOARD")
-            {
-                _command_to_mavros.mode_cmd.request.custom_mode = "MANUAL";
-                _command_to_mavros.set_mode_client.call(_command_to_mavros.mode_cmd);
-            }
+            px4_command_utils::rotation_yaw(_DroneState.attitude[2], d_acc_body, d_acc_enu);
+            Command_to_gs.Reference_State.acceleration_ref[0] = d_acc_enu[0];
+            Command_to_gs.Reference_State.acceleration_ref[1] = d_acc_enu[1];
+            Command_to_gs.Reference_State.acceleration_ref[2] = Command_Now.Reference_State.acceleration_ref[2];
 
-            if(_DroneState.armed)
-            {
-                _command_to_mavros.arm_cmd.request.value = false;
-                _command_to_mavros.arming_client.call(_command_to_mavros.arm_cmd);
-
-            }
+        }
 
-            if (_command_to_mavros.arm_cmd.response.success)
-            {
-                cout<<"Disarm successfully!"<<endl;
-            }
+        _pos_controller->pos_controller(_DroneState, Command_to_gs.Reference_State, dt, _ControlOutput);
+        
+        throttle_sp[0] = _ControlOutput.Throttle[0];
+        throttle_sp[1] = _ControlOutput.Throttle[1];
+        throttle_sp[2] = _ControlOutput.Throttle[2];
 
-            break;
+        update_attitude_reference();
 
-        // 【PPN_land】 暂空。可进行自定义
-        case command_to_mavros::PPN_land:
 
-            if (Command_Last.Mode != command_to_mavros::PPN_land)
-            {
-                pos_des_prev[0] = _DroneState.position[0];
-                pos_des_prev[1] = _DroneState.position[1];
-                pos_des_prev[2] = _DroneState.position[2];
-            }
+        send_setpoint();
 
-            Command_to_gs.Mode = Command_Now.Mode;
-            Command_to_gs.Command_ID = Command_Now.Command_ID;
+        break;
 
+    // 【Hold】 悬停。当前位置悬停
+    case command_to_mavros::Hold:
+        Command_to_gs.Mode = Command_Now.Mode;
+        Command_to_gs.Command_ID = Command_Now.Command_ID;
+        if (Command_Last.Mode != command_to_mavros::Hold)
+        {
             Command_to_gs.Reference_State.Sub_mode  = command_to_mavros::XYZ_POS;
+            Command_to_gs.Reference_State.position_ref[0] = _DroneState.position[0];
+            Command_to_gs.Reference_State.position_ref[1] = _DroneState.position[1];
+            Command_to_gs.Reference_State.position_ref[2] = _DroneState.position[2];
+            Command_to_gs.Reference_State.velocity_ref[0] = 0;
+            Command_to_gs.Reference_State.velocity_ref[1] = 0;
+            Command_to_gs.Reference_State.velocity_ref[2] = 0;
+            Command_to_gs.Reference_State.acceleration_ref[0] = 0;
+            Command_to_gs.Reference_State.acceleration_ref[1] = 0;
+            Command_to_gs.Reference_State.acceleration_ref[2] = 0;
+            Command_to_gs.Reference_State.yaw_ref = _DroneState.attitude[2]; //rad
+        }
 
-            vel_command[0] = ppn_kx * ( Command_Now.Reference_State.position_ref[0] - _DroneState.position[0]);
-            vel_command[1] = ppn_ky * ( Command_Now.Reference_State.position_ref[1] - _DroneState.position[1]);
-            vel_command[2] = ppn_kz * ( Command_Now.Reference_State.position_ref[2] - _DroneState.position[2]);
+        _pos_controller->pos_controller(_DroneState, Command_to_gs.Reference_State, dt, _ControlOutput);
+        
+        throttle_sp[0] = _ControlOutput.Throttle[0];
+        throttle_sp[1] = _ControlOutput.Throttle[1];
+        throttle_sp[2] = _ControlOutput.Throttle[2];
 
-            for (int i=0; i<3; i++)
-            {
-                Command_to_gs.Reference_State.position_ref[i] = pos_des_prev[i] + vel_command[i]*dt;
-            }
+        update_attitude_reference();
 
+        send_setpoint();
+        break;
+
+    // 【Land】 降落。当前位置原地降落，降落后会自动上锁，且切换为mannual模式
+    case command_to_mavros::Land:
+        Command_to_gs.Mode = Command_Now.Mode;
+        Command_to_gs.Command_ID = Command_Now.Command_ID;
+        if (Command_Last.Mode != command_to_mavros::Land)
+        {
+            Command_to_gs.Reference_State.Sub_mode  = command_to_mavros::XYZ_POS;
+            Command_to_gs.Reference_State.position_ref[0] = _DroneState.position[0];
+            Command_to_gs.Reference_State.position_ref[1] = _DroneState.position[1];
+            Command_to_gs.Reference_State.position_ref[2] = Takeoff_position[2];
             Command_to_gs.Reference_State.velocity_ref[0] = 0;
             Command_to_gs.Reference_State.velocity_ref[1] = 0;
             Command_to_gs.Reference_State.velocity_ref[2] = 0;
             Command_to_gs.Reference_State.acceleration_ref[0] = 0;
             Command_to_gs.Reference_State.acceleration_ref[1] = 0;
             Command_to_gs.Reference_State.acceleration_ref[2] = 0;
-            Command_to_gs.Reference_State.yaw_ref = 0; //rad
+            Command_to_gs.Reference_State.yaw_ref = _DroneState.attitude[2]; //rad
+        }
 
-            for (int i=0; i<3; i++)
+        //如果距离起飞高度小于10厘米，则直接上锁并切换为手动模式；
+        if(abs(_DroneState.position[2] - Takeoff_position[2]) < Disarm_height)
+        {
+            if(_DroneState.flight_mode == px4_command::DroneState::MODE_OFFBOARD)
             {
-                pos_des_prev[i] = Command_to_gs.Reference_State.position_ref[i];
+                _command_to_mavros->mode_cmd.request.custom_mode = "MANUAL";
+                _command_to_mavros->set_mode_client.call(_command_to_mavros->mode_cmd);
             }
-        
-            if(switch_ude == 0)
-            {
-                _ControlOutput = pos_controller_cascade_pid.pos_controller(_DroneState, Command_to_gs.Reference_State, dt);
-            }else if(switch_ude == 1)
-            {
-                _ControlOutput = pos_controller_pid.pos_controller(_DroneState, Command_to_gs.Reference_State, dt);
-            }else if(switch_ude == 2)
-            {
-                _ControlOutput = pos_controller_ude.pos_controller(_DroneState, Command_to_gs.Reference_State, dt);
-            }else if(switch_ude == 3)
+
+            if(_DroneState.armed)
             {
-                _ControlOutput = pos_controller_ps.pos_controller(_DroneState, Command_to_gs.Reference_State, dt);
-            }else if(switch_ude == 4)
+                _command_to_mavros->arm_cmd.request.value = false;
+                _command_to_mavros->arming_client.call(_command_to_mavros->arm_cmd);
+
+            }
+
+            if (_command_to_mavros->arm_cmd.response.success)
             {
-                _ControlOutput = pos_controller_ne.pos_controller(_DroneState, Command_to_gs.Reference_State, dt);
+                cout<<"Disarm successfully!"<<endl;
             }
+        }else
+        {
+            _pos_controller->pos_controller(_DroneState, Command_to_gs.Reference_State, dt, _ControlOutput);
             
             throttle_sp[0] = _ControlOutput.Throttle[0];
             throttle_sp[1] = _ControlOutput.Throttle[1];
             throttle_sp[2] = _ControlOutput.Throttle[2];
 
-            _AttitudeReference = px4_command_utils::ThrottleToAttitude(throttle_sp, Command_to_gs.Reference_State.yaw_ref);
+            update_attitude_reference();
 
-            if(Use_accel > 0.5)
-            {
-                _command_to_mavros.send_accel_setpoint(throttle_sp,Command_to_gs.Reference_State.yaw_ref);
-            }else
-            {
-                _command_to_mavros.send_attitude_setpoint(_AttitudeReference);            
-            }
+            send_setpoint();
+         }
 
-            
-            break;
+
+        break;
+
+    // 【Disarm】 紧急上锁。直接上锁，不建议使用，危险。
+    case command_to_mavros::Disarm:
+        Command_to_gs.Mode = Command_Now.Mode;
+        Command_to_gs.Command_ID = Command_Now.Command_ID;
         
-        // Trajectory_Tracking 轨迹追踪控制，与上述追踪点或者追踪速度不同，此时期望输入为一段轨迹
-        case command_to_mavros::Trajectory_Tracking:
-            Command_to_gs.Mode = Command_Now.Mode;
-            Command_to_gs.Command_ID = Command_Now.Command_ID;
-            
-            if (Command_Last.Mode != command_to_mavros::Trajectory_Tracking)
-            {
-                time_trajectory = 0.0;
-            }
+        if(_DroneState.flight_mode == px4_command::DroneState::MODE_OFFBOARD)
+        {
+            _command_to_mavros->mode_cmd.request.custom_mode = "MANUAL";
+            _command_to_mavros->set_mode_client.call(_command_to_mavros->mode_cmd);
+        }
 
-            time_trajectory = time_trajectory + dt;
+        if(_DroneState.armed)
+        {
+            _command_to_mavros->arm_cmd.request.value = false;
+            _command_to_mavros->arming_client.call(_command_to_mavros->arm_cmd);
 
-            Command_to_gs.Reference_State = _Circle_Trajectory.Circle_trajectory_generation(time_trajectory);
+        }
 
-            //_Circle_Trajectory.printf_result(Command_to_gs.Reference_State);
+        if (_command_to_mavros->arm_cmd.response.success)
+        {
+            cout<<"Disarm successfully!"<<endl;
+        }
 
-            if(switch_ude == 0)
-            {
-                _ControlOutput = pos_controller_cascade_pid.pos_controller(_DroneState, Command_to_gs.Reference_State, dt);
-            }else if(switch_ude == 1)
-            {
-                _ControlOutput = pos_controller_pid.pos_controller(_DroneState, Command_to_gs.Reference_State, dt);
-            }else if(switch_ude == 2)
-            {
-                _ControlOutput = pos_controller_ude.pos_controller(_DroneState, Command_to_gs.Reference_State, dt);
-            }else if(switch_ude == 3)
-            {
-                _ControlOutput = pos_controller_ps.pos_controller(_DroneState, Command_to_gs.Reference_State, dt);
-            }else if(switch_ude == 4)
-            {
-                _ControlOutput = pos_controller_ne.pos_controller(_DroneState, Command_to_gs.Reference_State, dt);
-            }
+        break;
 
-            // 输入干扰
-            Eigen::Vector3d random;
+    // 【PPN_land】 暂空。可进行自定义
+    case command_to_mavros::PPN_land:
 
-            // 先生成随机数
-            random[0] = px4_command_utils::random_num(disturbance_a_xy, disturbance_b_xy);
-            random[1] = px4_command_utils::random_num(disturbance_a_xy, disturbance_b_xy);
-            random[2] = px4_command_utils::random_num(disturbance_a_z, disturbance_b_z);
+        if (Command_Last.Mode != command_to_mavros::PPN_land)
+        {
+            pos_des_prev[0] = _DroneState.position[0];
+            pos_des_prev[1] = _DroneState.position[1];
+            pos_des_prev[2] = _DroneState.position[2];
+        }
 
-            // 低通滤波
-            random[0] = LPF_x.apply(random[0], 0.02);
-            random[1] = LPF_y.apply(random[1], 0.02);
-            random[2] = LPF_z.apply(random[2], 0.02);
+        Command_to_gs.Mode = Command_Now.Mode;
+        Command_to_gs.Command_ID = Command_Now.Command_ID;
 
-            if(time_trajectory>disturbance_start_time && time_trajectory<disturbance_end_time)
-            {
-                //应用输入干扰信号
-                _ControlOutput.Throttle[0] = _ControlOutput.Throttle[0] + random[0];
-                _ControlOutput.Throttle[1] = _ControlOutput.Throttle[1] + random[1];
-                _ControlOutput.Throttle[2] = _ControlOutput.Throttle[2] + random[2];
-            }
+        Command_to_gs.Reference_State.Sub_mode  = command_to_mavros::XYZ_POS;
 
-            throttle_sp[0] = _ControlOutput.Throttle[0];
-            throttle_sp[1] = _ControlOutput.Throttle[1];
-            throttle_sp[2] = _ControlOutput.Throttle[2];
+        vel_command[0] = ppn_kx * ( Command_Now.Reference_State.position_ref[0] - _DroneState.position[0]);
+        vel_command[1] = ppn_ky * ( Command_Now.Reference_State.position_ref[1] - _DroneState.position[1]);
+        vel_command[2] = ppn_kz * ( Command_Now.Reference_State.position_ref[2] - _DroneState.position[2]);
 
-            _AttitudeReference = px4_command_utils::ThrottleToAttitude(throttle_sp, Command_to_gs.Reference_State.yaw_ref);
+        for (int i=0; i<3; i++)
+        {
+            Command_to_gs.Reference_State.position_ref[i] = pos_des_prev[i] + vel_command[i]*dt;
+        }
 
-            if(Use_accel > 0.5)
-            {
-                _command_to_mavros.send_accel_setpoint(throttle_sp,Command_to_gs.Reference_State.yaw_ref);
-            }else
-            {
-                _command_to_mavros.send_attitude_setpoint(_AttitudeReference);            
-            }
-            
-            // Quit  悬停于最后一个目标点
-            if (time_trajectory >= _Circle_Trajectory.time_total)
-            {
-                Command_Now.Mode = command_to_mavros::Move_ENU;
-                Command_Now.Reference_State = Command_to_gs.Reference_State;
-            }
+        Command_to_gs.Reference_State.velocity_ref[0] = 0;
+        Command_to_gs.Reference_State.velocity_ref[1] = 0;
+        Command_to_gs.Reference_State.velocity_ref[2] = 0;
+        Command_to_gs.Reference_State.acceleration_ref[0] = 0;
+        Command_to_gs.Reference_State.acceleration_ref[1] = 0;
+        Command_to_gs.Reference_State.acceleration_ref[2] = 0;
+        Command_to_gs.Reference_State.yaw_ref = 0; //rad
 
-            break;
+        for (int i=0; i<3; i++)
+        {
+            pos_des_prev[i] = Command_to_gs.Reference_State.position_ref[i];
         }
+    
+        _pos_controller->pos_controller(_DroneState, Command_to_gs.Reference_State, dt, _ControlOutput);
+        
+        throttle_sp[0] = _ControlOutput.Throttle[0];
+        throttle_sp[1] = _ControlOutput.Throttle[1];
+        throttle_sp[2] = _ControlOutput.Throttle[2];
 
-        if(Flag_printf == 1)
+        update_attitude_reference();
+
+        send_setpoint();
+
+        
+        break;
+    
+    // Trajectory_Tracking 轨迹追踪控制，与上述追踪点或者追踪速度不同，此时期望输入为一段轨迹
+    case command_to_mavros::Trajectory_Tracking:
+        Command_to_gs.Mode = Command_Now.Mode;
+        Command_to_gs.Command_ID = Command_Now.Command_ID;
+        
+        if (Command_Last.Mode != command_to_mavros::Trajectory_Tracking)
         {
-            //cout <<">>>>>>>>>>>>>>>>>>>>>> px4_pos_controller <<<<<<<<<<<<<<<<<<<<<<<<<<<<<" <<endl;
-            // 打印无人机状态
-            px4_command_utils::prinft_drone_state(_DroneState);
+            time_trajectory = 0.0;
 
-            // 打印上层控制指令
-            px4_command_utils::printf_command_control(Command_to_gs);
+            // 丢弃上一次Trajectory_Tracking遗留的流式轨迹，只保留退出之后发送的轨迹
+            _trajectory_buffer->clear_before(trajectory_exit_stamp);
+        }
 
-            // 打印位置控制器中间计算量
-            if(switch_ude == 0)
-            {
-                pos_controller_cascade_pid.printf_result();
-            }else if(switch_ude == 1)
-            {
-                pos_controller_pid.printf_result();
-            }else if(switch_ude == 2)
-            {
-                pos_controller_ude.printf_result();
-            }else if(switch_ude == 3)
-            {
-                pos_controller_ps.printf_result();
-            }else if(switch_ude == 4)
+        time_trajectory = time_trajectory + dt;
+
+        if(Trajectory_source == 1)
+        {
+            // 尚未收到轨迹时保持上一个参考位置
+            if(!_trajectory_buffer->sample(time_trajectory, Command_to_gs.Reference_State))
             {
-                pos_controller_ne.printf_result();
+                for(int i = 0; i < 3; i++)
+                {
+                    Command_to_gs.Reference_State.velocity_ref[i] = 0;
+                    Command_to_gs.Reference_State.acceleration_ref[i] = 0;
+                }
             }
+        }else
+        {
+            _parametric_trajectory->sample(time_trajectory, Command_to_gs.Reference_State);
+        }
+
+        _pos_controller->pos_controller(_DroneState, Command_to_gs.Reference_State, dt, _ControlOutput);
+
+        // 输入干扰
+        Eigen::Vector3d random;
+
+        // 先生成随机数
+        random[0] = px4_command_utils::random_num(disturbance_a_xy, disturbance_b_xy);
+        random[1] = px4_command_utils::random_num(disturbance_a_xy, disturbance_b_xy);
+        random[2] = px4_command_utils::random_num(disturbance_a_z, disturbance_b_z);
+
+        // 低通滤波
+        random[0] = LPF_x.apply(random[0], 0.02);
+        random[1] = LPF_y.apply(random[1], 0.02);
+        random[2] = LPF_z.apply(random[2], 0.02);
+
+        // 干扰加在Throttle上，对直接给出期望姿态的控制律(SE3)无效
+        if(time_trajectory>disturbance_start_time && time_trajectory<disturbance_end_time)
+        {
+            //应用输入干扰信号
+            _ControlOutput.Throttle[0] = _ControlOutput.Throttle[0] + random[0];
+            _ControlOutput.Throttle[1] = _ControlOutput.Throttle[1] + random[1];
+            _ControlOutput.Throttle[2] = _ControlOutput.Throttle[2] + random[2];
+        }
+
+        throttle_sp[0] = _ControlOutput.Throttle[0];
+        throttle_sp[1] = _ControlOutput.Throttle[1];
+        throttle_sp[2] = _ControlOutput.Throttle[2];
+
+        update_attitude_reference();
+
+        send_setpoint();
+        
+        // Quit  悬停于最后一个目标点
+        // 流式轨迹长度不定，不自动退出：飞完后保持最后一个点，可继续追加
+        if (Trajectory_source == 0 && time_trajectory >= _parametric_trajectory->time_total)
+        {
+            Command_Now.Mode = command_to_mavros::Move_ENU;
+            Command_Now.Reference_State = Command_to_gs.Reference_State;
+            Command_to_gs.Mode = Command_Now.Mode;
+        }
+
+        break;
+    }
+
+    _latency_tracer.setpoint_sent();
+
+    // 指令及姿态参考量携带定位数据源的时间戳，用于延迟追踪
+    Command_to_gs.header.stamp = _DroneState.header.stamp;
+    _AttitudeReference.header.stamp = _DroneState.header.stamp;
+
+    if(Flag_printf == 1)
+    {
+        //cout <<">>>>>>>>>>>>>>>>>>>>>> px4_pos_controller <<<<<<<<<<<<<<<<<<<<<<<<<<<<<" <<endl;
+        // 打印无人机状态
+        px4_command_utils::prinft_drone_state(_DroneState);
+
+        // 打印上层控制指令
+        px4_command_utils::printf_command_control(Command_to_gs);
+
+        // 打印位置控制器中间计算量
+        _pos_controller->printf_result();
 
-            // 打印位置控制器输出结果
-            px4_command_utils::prinft_attitude_reference(_AttitudeReference);
+        // 打印位置控制器输出结果
+        px4_command_utils::prinft_attitude_reference(_AttitudeReference);
 
-        }else if(((int)(cur_time*10) % 50) == 0)
+        // 打印机载姿态环输出结果
+        if(Body_rate_output == 1)
         {
-            cout << "px4_pos_controller is running for :" << cur_time << " [s] "<<endl;
+            _att_controller->printf_result();
         }
 
-        // For log
-        if(time_trajectory == 0)
+        // 打印有效质量估计结果
+        if(_thrust_estimator != NULL)
         {
-            _Topic_for_log.time = -1.0;
+            _thrust_estimator->printf_result();
         }
-        else
+
+        // 打印状态插值的外推时间
+        if(_state_history != NULL)
         {
-            _Topic_for_log.time = time_trajectory;
+            _state_history->printf_result();
         }
 
-        _Topic_for_log.header.stamp = ros::Time::now();
-        _Topic_for_log.Drone_State = _DroneState;
-        _Topic_for_log.Control_Command = Command_to_gs;
-        _Topic_for_log.Attitude_Reference = _AttitudeReference;
-        _Topic_for_log.Control_Output = _ControlOutput;
+    }else if(((int)(cur_time*10) % 50) == 0)
+    {
+        cout << "px4_pos_controller is running for :" << cur_time << " [s] "<<endl;
+    }
+
+    // For log
+    if(time_trajectory == 0)
+    {
+        _Topic_for_log.time = -1.0;
+    }
+    else
+    {
+        _Topic_for_log.time = time_trajectory;
+    }
+
+    _Topic_for_log.header.stamp = ros::Time::now();
+    _Topic_for_log.Drone_State = _DroneState;
+    _Topic_for_log.Control_Command = Command_to_gs;
+    _Topic_for_log.Attitude_Reference = _AttitudeReference;
+    _Topic_for_log.Control_Output = _ControlOutput;
 
-        log_pub.publish(_Topic_for_log);
+    log_pub.publish(_Topic_for_log);
 
-        Command_Last = Command_Now;
+    if(_thrust_estimator != NULL)
+    {
+        _ThrustEstimate.header.stamp = _Topic_for_log.header.stamp;
+        _thrust_estimator->fill_estimate(_ThrustEstimate);
+        thrust_estimate_pub.publish(_ThrustEstimate);
+    }
 
-        rate.sleep();
+    if(Command_Last.Mode == command_to_mavros::Trajectory_Tracking && Command_Now.Mode != command_to_mavros::Trajectory_Tracking)
+    {
+        trajectory_exit_stamp = ros::Time::now();
     }
 
-    return 0;
+    // 只用到上一条指令的模式及编号
+    Command_Last.Mode = Command_Now.Mode;
+    Command_Last.Command_ID = Command_Now.Command_ID;
+}
+
+// 由位置环结果得到期望姿态及油门：SE3等控制律直接给出，其余由Throttle经ThrottleToAttitude计算
+void update_attitude_reference()
+{
+    if(!_pos_controller->attitude_reference(_AttitudeReference))
+    {
+        px4_command_utils::ThrottleToAttitude(throttle_sp, Command_to_gs.Reference_State.yaw_ref, _AttitudeReference);
+    }
+}
+
+// 发送位置环的结果：期望加速度或期望姿态；机载姿态环模式下只标记期望姿态有效，由attitude_step()高频发送机体角速度
+void send_setpoint()
+{
+    // 只有外部给出完整参考量的模式才使用前馈
+    if(_attitude_feedforward != NULL && (Command_to_gs.Mode == command_to_mavros::Move_ENU || Command_to_gs.Mode == command_to_mavros::Trajectory_Tracking))
+    {
+        // 模式切换时期望姿态不连续，重新开始差分
+        if(Command_to_gs.Mode != Command_Last.Mode)
+        {
+            _attitude_feedforward->reset();
+        }
+
+        _attitude_feedforward->update(Command_to_gs.Reference_State, cur_time, _AttitudeReference);
+
+        // 飞控姿态环只接收期望姿态，以超前量补偿位置环周期及姿态环的滞后
+        if(Body_rate_output == 0 && Feedforward_lead > 0.0)
+        {
+            px4_command_utils::propagate_attitude_reference(Feedforward_lead, _AttitudeReference);
+        }
+    }
+
+    if(Body_rate_output == 1)
+    {
+        flag_att_reference = true;
+        throttle_sent = _AttitudeReference.desired_throttle;
+    }else if(Use_accel > 0.5)
+    {
+        _command_to_mavros->send_accel_setpoint(throttle_sp,Command_to_gs.Reference_State.yaw_ref);
+    }else
+    {
+        _command_to_mavros->send_attitude_setpoint(_AttitudeReference);
+        throttle_sent = _AttitudeReference.desired_throttle;
+    }
+}
+
+// 机载姿态环：跟踪最近一次位置环给出的期望姿态，发送期望机体角速度及油门
+void attitude_step()
+{
+    if(!flag_att_reference)
+    {
+        return;
+    }
+
+    // 姿态反馈优先使用IMU（与姿态环同频），未收到时使用DroneState中的姿态
+    Eigen::Quaterniond q_fcu = q_imu;
+    if(!flag_imu_received)
+    {
+        q_fcu = Eigen::Quaterniond(_DroneState.attitude_q.w, _DroneState.attitude_q.x, _DroneState.attitude_q.y, _DroneState.attitude_q.z);
+    }
+
+    if(!_pos_controller->rate_control(q_fcu, _AttitudeReference, rates_sp))
+    {
+        _att_controller->att_control(q_fcu, _AttitudeReference, rates_sp);
+    }
+
+    _command_to_mavros->send_attitude_rate_setpoint(rates_sp, _AttitudeReference.desired_throttle);
+}
+
+// 计时并执行一次控制，dt为单调时钟测得的与上一次控制之间的间隔
+void run_control_step()
+{
+    // 限幅仅为保护积分项，超时情况见control_loop_status
+    float dt = _realtime_loop.begin_cycle();
+    dt = constrain_function2(dt, dt_min, dt_max);
+
+    read_snapshots();
+
+    if(Body_rate_output == 1)
+    {
+        // 多速率：位置环每Pos_divider个周期执行一次（dt为期间累计时间），姿态环每个周期执行
+        pos_dt = pos_dt + dt;
+        if(pos_tick % Pos_divider == 0)
+        {
+            control_step(pos_dt);
+            pos_dt = 0.0;
+        }else if(_attitude_feedforward != NULL && flag_att_reference)
+        {
+            // 位置环两次更新之间按前馈推算期望姿态
+            px4_command_utils::propagate_attitude_reference(dt, _AttitudeReference);
+        }
+        pos_tick++;
+
+        attitude_step();
+    }else
+    {
+        control_step(dt);
+    }
+
+    _realtime_loop.end_cycle();
+
+    // 事件驱动模式下不调用sleep()，以本次开始时刻加标称周期作为下一次状态的期望到达时刻
+    if(Event_driven == 1)
+    {
+        _realtime_loop.rearm();
+    }
+
+    // 1Hz发布控制主循环时序统计
+    if(_realtime_loop.cycle_count % (unsigned int)_realtime_loop.loop_rate == 0)
+    {
+        _realtime_loop.fill_status(_ControlLoopStatus);
+        loop_status_pub.publish(_ControlLoopStatus);
 
+        _latency_tracer.fill_breakdown(_LatencyBreakdown);
+        latency_pub.publish(_LatencyBreakdown);
+
+        // 控制器的打印、写文件等非实时操作
+        _pos_controller->non_realtime_update();
+    }
 }
 
+// 读取回调线程发布的最新状态、IMU及指令，只在有新数据时拷贝
+void read_snapshots()
+{
+    if(drone_state_snapshot.update())
+    {
+        const drone_state_sample& sample = drone_state_snapshot.read_buffer();
+
+        _DroneState = sample.state;
+        _DroneState.time_from_start = cur_time;
+
+        _latency_tracer.state_received(_DroneState, sample.stamp_arrival);
+    }
+
+    // 状态插值：每个周期都以本周期时刻采样，而不只是在新状态到达时更新
+    if(_state_history != NULL)
+    {
+        px4_command::DroneState state;
+        while(drone_state_queue.pop(state))
+        {
+            _state_history->push(state);
+        }
+
+        if(_state_history->sample(ros::Time::now().toSec() - _state_history->lag, _DroneState))
+        {
+            _DroneState.time_from_start = cur_time;
+        }
+    }
+
+    if(imu_snapshot.read(q_imu))
+    {
+        flag_imu_received = true;
+    }
+
+    px4_command::Trajectory::ConstPtr trajectory;
+    while(trajectory_queue.pop(trajectory))
+    {
+        // 新一次Trajectory_Tracking的轨迹不与上一次遗留的点拼接
+        _trajectory_buffer->clear_before(trajectory_exit_stamp);
+        _trajectory_buffer->append(*trajectory);
+
+        // 交还回调线程释放；回调每次先清空交还队列，其中的分段数不超过trajectory_queue的容量，push失败时才在此释放
+        trajectory_return_queue.push(trajectory);
+    }
+    trajectory.reset();
+
+    if(command_snapshot.read(Command_Now))
+    {
+        // 无人机一旦接受到Land指令，则会屏蔽其他指令
+        if(Command_Last.Mode == command_to_mavros::Land)
+        {
+            Command_Now.Mode = command_to_mavros::Land;
+        }
+
+        // Check for geo fence: If drone is out of the geo fence, it will land now.
+        if(check_failsafe() == 1)
+        {
+            Command_Now.Mode = command_to_mavros::Land;
+        }
+    }
+}
 
 void printf_param()
 {
     cout <<">>>>>>>>>>>>>>>>>>>>>>>>>>>>>> Parameter <<<<<<<<<<<<<<<<<<<<<<<<<<<" <<endl;
     cout << "Takeoff_height: "<< Takeoff_height<<" [m] "<<endl;
     cout << "Disarm_height : "<< Disarm_height <<" [m] "<<endl;
+    cout << "switch_ude : "<< switch_ude <<" ["<< pos_controller_registry::name(switch_ude) <<"] "<<endl;
+    cout << "Event_driven : "<< Event_driven <<"  timeout : "<< Event_timeout <<" [s] "<<endl;
+    cout << "Trajectory_source : "<< Trajectory_source <<" [0 for parametric trajectory ("<< trajectory_registry::name(Trajectory_type) <<"), 1 for /px4_command/trajectory] "<<endl;
+    cout << "Feedforward : "<< Use_feedforward <<"  lead_time : "<< Feedforward_lead <<" [s] "<<endl;
+    cout << "Thrust_estimator : "<< Thrust_estimation <<" [0 for off, 1 for estimate, 2 for estimate and feed to the controller] "<<endl;
+    cout << "Body_rate : "<< Body_rate_output <<"  pos_divider : "<< Pos_divider <<"  (position loop "<< Control_rate / Pos_divider <<" [Hz]) "<<endl;
     cout << "geo_fence_x : "<< geo_fence_x[0] << " [m]  to  "<<geo_fence_x[1] << " [m]"<< endl;
     cout << "geo_fence_y : "<< geo_fence_y[0] << " [m]  to  "<<geo_fence_y[1] << " [m]"<< endl;
     cout << "geo_fence_z : "<< geo_fence_z[0] << " [m]  to  "<<geo_fence_z[1] << " [m]"<< endl;
@@ -25,16 +25,25 @@
 *         2. Subscribe position and yaw information from Vicon node(vrpn-client-ros节点), transfrom from vicon frame to ENU frame
 *         3. Send the position and yaw information to FCU using Mavros package (/mavros/mocap/pose or /mavros/vision_estimate/pose)
 *         4. Subscribe position and yaw information from FCU, used for compare
+*         5. vision/laser/sonic/tfmini及飞控状态的回调在AsyncSpinner线程中处理，通过state_snapshot交给主循环；
+*            动捕(OptiTrackFeedBackRigidBody)在主循环中处理，使用独立回调队列，由主循环在RosWhileLoopRun前处理
+*         6. pos_estimator/Use_ekf为1时，以pos_ekf融合飞控IMU(/mavros/imu/data原始频率)与vision、laser、动捕、sonic、TFmini，
+*            DroneState的位置及速度来自EKF（此时Use_mocap_raw无效）；IMU及量测经无锁队列交给主循环，EKF只在主循环中访问；
+*            EKF输出无效时（未初始化、IMU中断或位置方差过大）退回Use_mocap_raw选择的数据源。主循环频率为pos_estimator/rate
+*         7. 动捕丢弃重复/乱序时间戳，超过mocap_dropout_time无数据视为丢失；mocap_prediction为1时按测得的传输延迟将发布的动捕状态外推至当前时刻
+*         8. pos_estimator/mocap_source为1时不再自行订阅动捕，从px4_mocap_tracker发布的/px4_command/rigid_bodies中按rigid_body_name读取
 ***************************************************************************************************************************/
 
 
 //头文件
 #include <ros/ros.h>
+#include <ros/callback_queue.h>
 
 #include <iostream>
 #include <Eigen/Eigen>
 #include <state_from_mavros.h>
 #include <OptiTrackFeedBackRigidBody.h>
+#include <mocap_tracker.h>
 #include <math_utils.h>
 #include <Frame_tf_utils.h>
 //msg 头文件
@@ -58,19 +67,32 @@
 #include <px4_command/DroneState.h>
 #include <LowPassFilter.h>
 #include <px4_command_utils.h>
+#include <state_snapshot.h>
+#include <pos_ekf.h>
 using namespace std;
 //---------------------------------------相关参数-----------------------------------------------
 int flag_use_laser_or_vicon;                               //0:使用vision数据作为定位数据 1:使用laser数据作为定位数据
 float Use_mocap_raw;
 int linear_window;
 int angular_window;
+int velocity_filter;                                    //动捕线速度滤波 0:滑动平均 1:Savitzky-Golay
+int poly_order;                                         //Savitzky-Golay多项式阶数
+float mocap_dropout_time;                               //超过该时间无动捕数据视为丢失 [s]
+int mocap_prediction;                                   //1:按测得的传输延迟将动捕状态外推至当前时刻
+float mocap_prediction_max;                             //外推时间上限 [s]
+int mocap_source;                                       //0:本节点订阅动捕 1:使用px4_mocap_tracker发布的多刚体状态
+string rigid_body_name;                                 //动捕刚体名
 float noise_a,noise_b;
 float noise_T;
+int Use_ekf;                                            //0:按Use_mocap_raw选择数据源 1:使用EKF融合结果
+float estimator_rate;                                   //主循环频率 [Hz]
 rigidbody_state UAVstate;
 //---------------------------------------vision vio定位相关------------------------------------------
 Eigen::Vector3d pos_drone_vio;                          //无人机当前位置 (vision)
 Eigen::Quaterniond q_vio;
 Eigen::Vector3d Euler_vio;                              //无人机当前姿态 (vision)
+ros::Time stamp_vio;                                    //vision数据时间戳
+ros::Time stamp_vio_received;                           //收到vision数据的时刻
 //---------------------------------------laser定位相关------------------------------------------
 Eigen::Vector3d pos_drone_laser;                          //无人机当前位置 (laser)
 Eigen::Quaterniond q_laser;
@@ -78,6 +100,26 @@ Eigen::Vector3d Euler_laser;                                         //无人机
 
 geometry_msgs::TransformStamped laser;                          //当前时刻cartorgrapher发布的数据
 geometry_msgs::TransformStamped laser_last;
+//---------------------------------------回调线程 -> 主循环------------------------------------------
+struct external_pose
+{
+    Eigen::Vector3d position;
+    Eigen::Quaterniond q;
+    ros::Time stamp;                                    //数据源时间戳
+    ros::Time stamp_received;                           //收到数据的时刻
+};
+state_snapshot<external_pose> vision_snapshot;
+state_snapshot<external_pose> laser_snapshot;           //只使用xy
+state_snapshot<double> sonic_snapshot;                  //超声波高度 [m]
+state_snapshot<double> tfmini_snapshot;                 //tfmini原始距离 [m]，在主循环中映射为垂直高度
+//---------------------------------------EKF相关------------------------------------------
+pos_ekf* _pos_ekf = NULL;
+message_queue<ekf_imu, 256> imu_queue;                                      //mavros回调线程 -> 主循环
+message_queue<ekf_measurement, EKF_MEASUREMENT_BUFFER_SIZE> measurement_queue; //全局回调线程 -> 主循环
+double time_mocap_last = 0.0;                           //上一次送入EKF的动捕时间戳
+//---------------------------------------多刚体动捕相关------------------------------------------
+px4_command::RigidBodyArray::ConstPtr rigid_bodies;     //在主循环的mocap_queue.callAvailable中更新
+int rigid_body_index = -1;                              //刚体在RigidBodyArray中的索引
 //---------------------------------------无人机位置及速度--------------------------------------------
 Eigen::Vector3d pos_drone_fcu;                           //无人机当前位置 (来自fcu)
 Eigen::Vector3d vel_drone_fcu;                           //无人机上一时刻位置 (来自fcu)
@@ -93,6 +135,8 @@ void send_to_fcu();
 void publish_drone_state();
 void printf_param();
 double vrt_h_map(const double& tfmini_raw,const double& roll,const double& pitch);
+void read_snapshots();
+void push_measurement(int source, const ros::Time& stamp, const Eigen::Vector3d& z);
 //>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>回调函数<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<
 void laser_cb(const tf2_msgs::TFMessage::ConstPtr& msg)
 {
@@ -109,16 +153,21 @@ void laser_cb(const tf2_msgs::TFMessage::ConstPtr& msg)
         //这里需要做这个判断是因为cartographer发布位置时有一个小bug，ENU到NED不展开讲。
         if (dt_laser != 0)
         {
+            external_pose& pose = laser_snapshot.write_buffer();
+
             //位置 xy  [将解算的位置从laser坐标系转换至ENU坐标系]???
-            pos_drone_laser[0]  = laser.transform.translation.x;
-            pos_drone_laser[1]  = laser.transform.translation.y;
+            pose.position[0]  = laser.transform.translation.x;
+            pose.position[1]  = laser.transform.translation.y;
+            pose.position[2]  = 0.0;
             // Read the Quaternion from the Carto Package [Frame: Laser[ENU]]
-            Eigen::Quaterniond q_laser_enu(laser.transform.rotation.w, laser.transform.rotation.x, laser.transform.rotation.y, laser.transform.rotation.z);
+            pose.q = Eigen::Quaterniond(laser.transform.rotation.w, laser.transform.rotation.x, laser.transform.rotation.y, laser.transform.rotation.z);
+
+            pose.stamp = laser.header.stamp;
+            pose.stamp_received = ros::Time::now();
 
-            q_laser = q_laser_enu;
+            laser_snapshot.publish();
 
-            // Transform the Quaternion to Euler Angles
-            Euler_laser = quaternion_to_euler(q_laser);
+            push_measurement(pos_ekf::SOURCE_LASER, laser.header.stamp, Eigen::Vector3d(laser.transform.translation.x, laser.transform.translation.y, 0.0));
         }
 
         laser_last = laser;
@@ -126,44 +175,114 @@ void laser_cb(const tf2_msgs::TFMessage::ConstPtr& msg)
 }
 void vision_cb(const geometry_msgs::PoseStamped::ConstPtr& msg)
 {
-	geometry_msgs::PoseStamped vision_pose;
+	external_pose& pose = vision_snapshot.write_buffer();
 
-	vision_pose = *msg;
-	pos_drone_vio[0] = vision_pose.pose.position.x;
-	pos_drone_vio[1] = vision_pose.pose.position.y;
-	pos_drone_vio[2] = vision_pose.pose.position.z;
+	pose.stamp = msg->header.stamp;
+	pose.stamp_received = ros::Time::now();
+	pose.position[0] = msg->pose.position.x;
+	pose.position[1] = msg->pose.position.y;
+	pose.position[2] = msg->pose.position.z;
 
+	pose.q.x() = msg->pose.orientation.x;
+	pose.q.y() = msg->pose.orientation.y;
+	pose.q.z() = msg->pose.orientation.z;
+	pose.q.w() = msg->pose.orientation.w;
 
-	
+	vision_snapshot.publish();
 
-	q_vio.x() = vision_pose.pose.orientation.x;
-	q_vio.y() = vision_pose.pose.orientation.y;
-	q_vio.z() = vision_pose.pose.orientation.z;
-	q_vio.w() = vision_pose.pose.orientation.w;
+	push_measurement(pos_ekf::SOURCE_VISION, msg->header.stamp, Eigen::Vector3d(msg->pose.position.x, msg->pose.position.y, msg->pose.position.z));
+}
+void sonic_cb(const std_msgs::UInt16::ConstPtr& msg)
+{
+    //位置
+    sonic_snapshot.write((float)msg->data / 1000);
 
+    // 超声波消息无时间戳，以收到时刻代替
+    push_measurement(pos_ekf::SOURCE_SONIC, ros::Time(), Eigen::Vector3d(0.0, 0.0, (float)msg->data / 1000));
+}
 
-	// Transform the Quaternion to Euler Angles
-	Euler_vio = quaternion_to_euler(q_vio);
+void tfmini_cb(const sensor_msgs::Range::ConstPtr& msg)
+{
+    // 垂直高度的映射需要飞控姿态，在主循环中进行
+    tfmini_snapshot.write(msg->range);
 
+    // EKF中使用测量时刻的姿态进行垂直高度映射
+    push_measurement(pos_ekf::SOURCE_TFMINI, msg->header.stamp, Eigen::Vector3d(0.0, 0.0, msg->range));
 }
-void sonic_cb(const std_msgs::UInt16::ConstPtr& msg)
+
+// 【主循环】px4_mocap_tracker发布的多刚体状态，回调在mocap_queue中
+void rigid_bodies_cb(const px4_command::RigidBodyArray::ConstPtr& msg)
 {
-    std_msgs::UInt16 sonic;
+    rigid_bodies = msg;
+}
 
-    sonic = *msg;
+// 【mavros回调线程】IMU原始频率送入EKF
+void imu_cb(const sensor_msgs::Imu::ConstPtr& msg)
+{
+    ekf_imu imu;
 
-    //位置
-    pos_drone_laser[2]  = (float)sonic.data / 1000;
+    imu.t = (msg->header.stamp.isZero() ? ros::Time::now() : msg->header.stamp).toSec();
+    imu.specific_force = Eigen::Vector3d(msg->linear_acceleration.x, msg->linear_acceleration.y, msg->linear_acceleration.z);
+    imu.q = Eigen::Quaterniond(msg->orientation.w, msg->orientation.x, msg->orientation.y, msg->orientation.z);
+
+    imu_queue.push(imu);
 }
 
-void tfmini_cb(const sensor_msgs::Range::ConstPtr& msg)
+// 【全局回调线程】量测送入EKF队列，时间戳为0时以收到时刻代替
+void push_measurement(int source, const ros::Time& stamp, const Eigen::Vector3d& z)
+{
+    if(_pos_ekf == NULL)
+    {
+        return;
+    }
+
+    ekf_measurement measurement;
+
+    measurement.t = (stamp.isZero() ? ros::Time::now() : stamp).toSec();
+    measurement.source = source;
+    measurement.z = z;
+
+    measurement_queue.push(measurement);
+}
+
+// 读取回调线程发布的最新定位数据，只在有新数据时更新（须在更新Att_fcu之后调用）
+void read_snapshots()
 {
-    sensor_msgs::Range tfmini;
-    tfmini = *msg;
+    external_pose pose;
+
+    if(vision_snapshot.read(pose))
+    {
+        stamp_vio = pose.stamp;
+        stamp_vio_received = pose.stamp_received;
+        pos_drone_vio = pose.position;
+        q_vio = pose.q;
+
+        // Transform the Quaternion to Euler Angles
+        Euler_vio = quaternion_to_euler(q_vio);
+    }
+
+    if(laser_snapshot.read(pose))
+    {
+        pos_drone_laser[0] = pose.position[0];
+        pos_drone_laser[1] = pose.position[1];
+        q_laser = pose.q;
+
+        // Transform the Quaternion to Euler Angles
+        Euler_laser = quaternion_to_euler(q_laser);
+    }
 
-    //进行垂直高度的映射，反映真实的z轴高度
-    pos_drone_laser[2] = vrt_h_map(tfmini.range,Att_fcu[0],Att_fcu[1]);
+    double range;
+
+    if(sonic_snapshot.read(range))
+    {
+        pos_drone_laser[2] = range;
+    }
 
+    if(tfmini_snapshot.read(range))
+    {
+        //进行垂直高度的映射，反映真实的z轴高度
+        pos_drone_laser[2] = vrt_h_map(range,Att_fcu[0],Att_fcu[1]);
+    }
 }
 
 //当无人机倾斜时,计算映射出的垂直高度
@@ -200,15 +319,41 @@ int main(int argc, char **argv)
     // window for linear velocity
     nh.param<int>("pos_estimator/angular_window", angular_window, 3);
 
+    // 0 for moving window average, 1 for Savitzky-Golay differentiator over linear_window poses
+    nh.param<int>("pos_estimator/velocity_filter", velocity_filter, 0);
+
+    nh.param<int>("pos_estimator/poly_order", poly_order, 2);
+
+    nh.param<float>("pos_estimator/mocap_dropout_time", mocap_dropout_time, 0.1);
+
+    // 0 for 使用动捕时间戳时刻的状态, 1 for 外推至当前时刻 (仅Use_mocap_raw为2时)
+    nh.param<int>("pos_estimator/mocap_prediction", mocap_prediction, 0);
+
+    nh.param<float>("pos_estimator/mocap_prediction_max", mocap_prediction_max, 0.05);
+
     nh.param<float>("pos_estimator/noise_a", noise_a, 0.0);
 
     nh.param<float>("pos_estimator/noise_b", noise_b, 0.0);
 
     nh.param<float>("pos_estimator/noise_T", noise_T, 0.5);
 
+    // 0 for 按Use_mocap_raw选择数据源, 1 for 使用EKF融合结果
+    nh.param<int>("pos_estimator/Use_ekf", Use_ekf, 0);
+
+    nh.param<float>("pos_estimator/rate", estimator_rate, 100.0);
+
     printf_param();
 
-    //nh.param<string>("pos_estimator/rigid_body_name", rigid_body_name, '/vrpn_client_node/UAV/pose');
+    if(Use_ekf == 1)
+    {
+        _pos_ekf = new pos_ekf();
+        _pos_ekf->printf_param();
+    }
+
+    // 0 for 订阅/vrpn_client_node/UAV/pose, 1 for 读取px4_mocap_tracker发布的/px4_command/rigid_bodies
+    nh.param<int>("pos_estimator/mocap_source", mocap_source, 0);
+
+    nh.param<string>("pos_estimator/rigid_body_name", rigid_body_name, "UAV");
 
 
     LowPassFilter LPF_x;
@@ -239,38 +384,114 @@ int main(int argc, char **argv)
     drone_state_pub = nh.advertise<px4_command::DroneState>("/px4_command/drone_state", 10);
 
     // 用于与mavros通讯的类，通过mavros接收来至飞控的消息【飞控->mavros->本程序】
-    state_from_mavros _state_from_mavros;
+    // 飞控状态使用独立的回调队列及线程
+    ros::CallbackQueue mavros_queue;
+    state_from_mavros _state_from_mavros(&mavros_queue);
+
+    // 【订阅】IMU原始数据，供EKF以原始频率预测（与飞控状态同一回调线程）
+    ros::NodeHandle mavros_nh("~");
+    mavros_nh.setCallbackQueue(&mavros_queue);
+    ros::Subscriber imu_sub;
+    if(_pos_ekf != NULL)
+    {
+        imu_sub = mavros_nh.subscribe<sensor_msgs::Imu>("/mavros/imu/data", 100, imu_cb);
+    }
+
+    // 动捕的速度差分在RosWhileLoopRun中进行，回调放在独立队列中由主循环处理
+    ros::CallbackQueue mocap_queue;
+    ros::NodeHandle mocap_nh("~");
+    mocap_nh.setCallbackQueue(&mocap_queue);
+    OptiTrackFeedBackRigidBody* UAV = NULL;
+    ros::Subscriber rigid_bodies_sub;
+    if(mocap_source == 1)
+    {
+        rigid_bodies_sub = mocap_nh.subscribe<px4_command::RigidBodyArray>("/px4_command/rigid_bodies", 10, rigid_bodies_cb);
+    }
+    else
+    {
+        UAV = new OptiTrackFeedBackRigidBody(("/vrpn_client_node/" + rigid_body_name + "/pose").c_str(),mocap_nh,linear_window,angular_window,velocity_filter,poly_order);
+        UAV->SetTiming(mocap_dropout_time, mocap_prediction_max);
+    }
 
-    OptiTrackFeedBackRigidBody UAV("/vrpn_client_node/UAV/pose",nh,linear_window,angular_window);
+    // 回调线程：mavros_spinner处理飞控状态，spinner处理全局队列（vision、laser、sonic、tfmini）
+    ros::AsyncSpinner mavros_spinner(1, &mavros_queue);
+    ros::AsyncSpinner spinner(1);
+    mavros_spinner.start();
+    spinner.start();
 
     // 频率
-    ros::Rate rate(100.0);
+    ros::Rate rate(estimator_rate);
 
 //>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>Main Loop<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<
     while(ros::ok())
     {
-        //回调一次 更新传感器状态
-        ros::spinOnce();
+        // 读取飞控状态的最新快照（无新数据时保持上一次的数据）
+        _state_from_mavros.snapshot.update();
+        const px4_command::DroneState& _DroneState_fcu = _state_from_mavros.snapshot.read_buffer();
+
+        for (int i=0;i<3;i++)
+        {
+            pos_drone_fcu[i] = _DroneState_fcu.position[i];
+            vel_drone_fcu[i] = _DroneState_fcu.velocity[i];
+            Att_fcu[i] = _DroneState_fcu.attitude[i];
+            Att_rate_fcu[i] = _DroneState_fcu.attitude_rate[i];
+        }
+
+        // 更新传感器状态
+        read_snapshots();
 
         // 将定位信息及偏航角信息发送至飞控，根据参数flag_use_laser_or_vicon选择定位信息来源
         send_to_fcu();
 
         //利用OptiTrackFeedBackRigidBody类获取optitrack的数据 -- for test -code by longhao
-        UAV.RosWhileLoopRun();
-        UAV.GetState(UAVstate);
+        ros::Time stamp_mocap_received = ros::Time::now();
+        mocap_queue.callAvailable();
+        if(UAV != NULL)
+        {
+            UAV->RosWhileLoopRun();
+            UAV->GetState(UAVstate);
+        }
+        else if(rigid_bodies)
+        {
+            mocap_tracker::get_state(*rigid_bodies, mocap_tracker::find(*rigid_bodies, rigid_body_name, rigid_body_index), UAVstate);
+            if(rigid_body_index >= 0)
+            {
+                stamp_mocap_received = rigid_bodies->stamp_received[rigid_body_index];
+            }
+        }
 
-        for (int i=0;i<3;i++)
+        // EKF：取出回调线程送来的IMU及量测，推进延迟时间轴
+        if(_pos_ekf != NULL)
         {
-            pos_drone_fcu[i] = _state_from_mavros._DroneState.position[i];                           
-            vel_drone_fcu[i] = _state_from_mavros._DroneState.velocity[i];                           
-            Att_fcu[i] = _state_from_mavros._DroneState.attitude[i];  
-            Att_rate_fcu[i] = _state_from_mavros._DroneState.attitude_rate[i];  
+            ekf_imu imu;
+            while(imu_queue.pop(imu))
+            {
+                _pos_ekf->push_imu(imu);
+            }
+
+            ekf_measurement measurement;
+            while(measurement_queue.pop(measurement))
+            {
+                _pos_ekf->push_measurement(measurement);
+            }
+
+            if(UAVstate.time_stamp > 0.0 && UAVstate.time_stamp != time_mocap_last)
+            {
+                measurement.t = UAVstate.time_stamp;
+                measurement.source = pos_ekf::SOURCE_MOCAP;
+                measurement.z = UAVstate.Position;
+                _pos_ekf->push_measurement(measurement);
+
+                time_mocap_last = UAVstate.time_stamp;
+            }
+
+            _pos_ekf->update();
         }
 
         // 发布无人机状态至px4_pos_controller.cpp节点，根据参数Use_mocap_raw选择位置速度消息来源
         // get drone state from _state_from_mavros
-        _DroneState = _state_from_mavros._DroneState;
-        _DroneState.header.stamp = ros::Time::now();
+        // header.stamp为定位数据源的时间戳（默认为飞控local_position的时间戳），stamp_received为收到该数据的时刻
+        _DroneState = _DroneState_fcu;
 
 
         Eigen::Vector3d random;
@@ -301,16 +522,51 @@ int main(int argc, char **argv)
             {
                 _DroneState.position[i] = pos_drone_vio[i];
             }
+            _DroneState.header.stamp = stamp_vio;
+            _DroneState.stamp_received = stamp_vio_received;
         }
         else if (Use_mocap_raw == 2) 
         {
+            // EKF使用时间戳时刻的原始状态（自行处理延迟），这里只外推发布的状态
+            if (mocap_prediction == 1 && UAV != NULL)
+            {
+                UAV->GetPredictedState(UAVstate, ros::Time::now().toSec());
+            }
+            else if (mocap_prediction == 1 && rigid_bodies)
+            {
+                mocap_tracker::get_state(*rigid_bodies, rigid_body_index, UAVstate, ros::Time::now().toSec(), mocap_prediction_max);
+            }
+
             for (int i=0;i<3;i++)
             {
                 _DroneState.position[i] = UAVstate.Position[i];
                 _DroneState.velocity[i] = UAVstate.V_I[i];
             }
+            // 动捕数据在本循环的callAvailable中处理，以本循环处理时刻近似收到时刻（mocap_source为1时为px4_mocap_tracker收到的时刻）
+            _DroneState.header.stamp = ros::Time(UAVstate.time_stamp);
+            _DroneState.stamp_received = stamp_mocap_received;
         }
 
+        // EKF输出有效时覆盖上面选择的位置及速度，时间戳为最新IMU的时间戳
+        Eigen::Vector3d pos_ekf_out, vel_ekf_out;
+        double t_ekf_out;
+        if(_pos_ekf != NULL && _pos_ekf->get_output(ros::Time::now().toSec(), pos_ekf_out, vel_ekf_out, t_ekf_out))
+        {
+            for (int i=0;i<3;i++)
+            {
+                _DroneState.position[i] = pos_ekf_out[i];
+                _DroneState.velocity[i] = vel_ekf_out[i];
+            }
+            _DroneState.header.stamp = ros::Time(t_ekf_out);
+            _DroneState.stamp_received = ros::Time::now();
+        }
+
+        // 数据源未提供时间戳时，以收到时刻代替
+        if(_DroneState.header.stamp.isZero())
+        {
+            _DroneState.header.stamp = _DroneState.stamp_received.isZero() ? ros::Time::now() : _DroneState.stamp_received;
+        }
+        _DroneState.stamp_published = ros::Time::now();
         drone_state_pub.publish(_DroneState);
 
         // 打印
@@ -318,6 +574,9 @@ int main(int argc, char **argv)
         rate.sleep();
     }
 
+    delete _pos_ekf;
+    delete UAV;
+
     return 0;
 
 }
@@ -394,6 +653,13 @@ void printf_info()
         cout << "Vel_fcu [X Y Z] : " << vel_drone_fcu[0] << " [m/s] "<< vel_drone_fcu[1] <<" [m/s] "<< vel_drone_fcu[2] <<" [m/s] "<<endl;
         cout << "Att_fcu [R P Y] : " << Att_fcu[0] * 180/M_PI <<" [deg] "<< Att_fcu[1] * 180/M_PI << " [deg] "<< Att_fcu[2] * 180/M_PI<<" [deg] "<<endl;
 
+    if(_pos_ekf != NULL)
+    {
+        _pos_ekf->printf_result(ros::Time::now().toSec());
+        cout.setf(ios::showpos);
+        cout<<setprecision(2);
+    }
+
 }
 
 void printf_param()
@@ -403,6 +669,8 @@ void printf_param()
     cout << "noise_a: "<< noise_a<<" [m] "<<endl;
     cout << "noise_b: "<< noise_b<<" [m] "<<endl;
     cout << "noise_T: "<< noise_T<<" [m] "<<endl;
+    cout << "mocap_dropout_time: "<< mocap_dropout_time<<" [s]  mocap_prediction: "<< mocap_prediction<<"  mocap_prediction_max: "<< mocap_prediction_max<<" [s] "<<endl;
+    cout << "Use_ekf: "<< Use_ekf<<"  rate: "<< estimator_rate<<" [Hz] "<<endl;
     
 
 }
@@ -259,7 +259,7 @@ int main(int argc, char **argv)
             //如果距离起飞高度小于10厘米，则直接上锁并切换为手动模式；
             if(abs(_DroneState.position[2] - Takeoff_position[2]) < Disarm_height)
             {
-                if(_DroneState.mode == "OFFBOARD")
+                if(_DroneState.flight_mode == px4_command::DroneState::MODE_OFFBOARD)
                 {
                     _command_to_mavros.mode_cmd.request.custom_mode = "MANUAL";
                     _command_to_mavros.set_mode_client.call(_command_to_mavros.mode_cmd);
@@ -285,7 +285,7 @@ int main(int argc, char **argv)
             break;
 
         case command_to_mavros::Disarm:
-            if(_DroneState.mode == "OFFBOARD")
+            if(_DroneState.flight_mode == px4_command::DroneState::MODE_OFFBOARD)
             {
                 _command_to_mavros.mode_cmd.request.custom_mode = "MANUAL";
                 _command_to_mavros.set_mode_client.call(_command_to_mavros.mode_cmd);